@@ -0,0 +1,1587 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup mockvarserver Mock Variable Server
+ * @brief In-process stand-in for the variable server client library
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file mockvarserver.c
+
+    Mock Variable Server
+
+    The Mock Variable Server provides in-process implementations of the
+    variable server client functions used by the save pipeline.  It
+    synthesizes a configurable number of dirty variables of mixed types
+    and instance identifiers so the save pipeline can be measured
+    without a running variable server.
+
+    The batched retrieval call VAR_GetBatch is also provided, and is
+    used when the pipeline is built with SAVESVC_VAR_GETBATCH.
+
+    Optionally, some string variables can be given large values.
+
+    Variables carry flags which are matched by QUERY_FLAGS queries, and
+    QUERY_MATCH queries match a substring of the variable name.
+    Modified variables are flagged dirty, and variables with a MODIFIED
+    notification request are reported to a notification callback.
+
+    Variables can also be set, so configuration files can be restored
+    into the mock variables.  Names may carry an "[id]" instance
+    identifier prefix.
+
+    Every variable server call is counted, since each would be a
+    round trip to the real variable server.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <varserver/varserver.h>
+#include <varserver/varquery.h>
+#include "snapshot.h"
+#include "mockvarserver.h"
+
+/*==============================================================================
+       Type Definitions
+==============================================================================*/
+
+/*! synthesized variable */
+typedef struct _mockVar
+{
+    /*! variable type */
+    VarType type;
+
+    /*! variable instance identifier */
+    uint32_t instanceID;
+
+    /*! variable value (the generation number for string variables) */
+    VarData val;
+
+    /*! value set by VAR_Set for a string variable, or NULL for the
+        generated value */
+    char *str;
+
+    /*! variable flags */
+    uint32_t flags;
+
+    /*! indicates a MODIFIED notification has been requested */
+    bool notify;
+
+} MockVar;
+
+/*==============================================================================
+       Function declarations
+==============================================================================*/
+static int GetVar( size_t idx, VarQuery *query, VarObject *obj );
+static size_t GetBatchRecord( size_t idx, char *buf, size_t len );
+static size_t GetString( size_t idx, char *buf, size_t len );
+static size_t NextMatch( size_t idx, VarQuery *query );
+static int FromString( char *str, VarObject *pVarObject );
+
+/*==============================================================================
+      File Scoped Variables
+==============================================================================*/
+
+/*! synthesized variables */
+static MockVar *vars;
+
+/*! number of synthesized variables */
+static size_t numVars;
+
+/*! index of the next variable to modify */
+static size_t modifyIdx;
+
+/*! number of variable server calls */
+static uint64_t calls;
+
+/*! length of large string values, or zero for no large values */
+static size_t largeLen;
+
+/*! MODIFIED notification callback */
+static void (*notifyFn)( VAR_HANDLE hVar );
+
+/*! variable server handle returned by VARSERVER_Open */
+static int mockHandle;
+
+/*! variable types to synthesize */
+static const VarType types[] =
+{
+    VARTYPE_UINT16,
+    VARTYPE_INT16,
+    VARTYPE_UINT32,
+    VARTYPE_INT32,
+    VARTYPE_UINT64,
+    VARTYPE_INT64,
+    VARTYPE_FLOAT,
+    VARTYPE_STR
+};
+
+/*==============================================================================
+       Function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  MOCKVARSERVER_Init                                                        */
+/*!
+    Synthesize the mock variables
+
+    The MOCKVARSERVER_Init function creates the specified number of
+    dirty variables.  Types are assigned round robin, and one variable
+    in eight has a non-zero instance identifier.
+
+    @param[in]
+        count
+            number of variables to synthesize
+
+    @retval EOK - success
+    @retval ENOMEM - memory allocation failed
+
+==============================================================================*/
+int MOCKVARSERVER_Init( size_t count )
+{
+    int result = ENOMEM;
+    size_t i;
+
+    MOCKVARSERVER_Free();
+
+    vars = calloc( count, sizeof( MockVar ) );
+    if ( vars != NULL )
+    {
+        numVars = count;
+
+        for ( i = 0; i < count; i++ )
+        {
+            vars[i].type = types[i % ( sizeof types / sizeof types[0] )];
+            vars[i].instanceID = ( ( i % 8 ) == 7 ) ? ( i % 5 ) + 1 : 0;
+            vars[i].val.ull = i;
+            vars[i].flags = VARFLAG_DIRTY;
+        }
+
+        result = EOK;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  MOCKVARSERVER_Modify                                                      */
+/*!
+    Modify mock variables
+
+    The MOCKVARSERVER_Modify function changes the value of the specified
+    number of variables, cycling through all of the variables.
+    Modified variables are flagged dirty, and the notification callback
+    is called for those with a MODIFIED notification request.
+
+    @param[in]
+        count
+            number of variables to modify
+
+==============================================================================*/
+void MOCKVARSERVER_Modify( size_t count )
+{
+    MockVar *pVar;
+
+    while ( ( count-- > 0 ) && ( numVars > 0 ) )
+    {
+        pVar = &vars[modifyIdx];
+
+        switch( pVar->type )
+        {
+            case VARTYPE_UINT16:
+                pVar->val.ui++;
+                break;
+
+            case VARTYPE_INT16:
+                pVar->val.i = -pVar->val.i - 1;
+                break;
+
+            case VARTYPE_UINT32:
+                pVar->val.ul += 7919;
+                break;
+
+            case VARTYPE_INT32:
+                pVar->val.l = -pVar->val.l - 1;
+                break;
+
+            case VARTYPE_INT64:
+                pVar->val.ll = -pVar->val.ll - 1;
+                break;
+
+            case VARTYPE_FLOAT:
+                pVar->val.f = ( pVar->val.f * 1.5f ) + 0.25f;
+                break;
+
+            default:
+                pVar->val.ull++;
+                free( pVar->str );
+                pVar->str = NULL;
+                break;
+        }
+
+        pVar->flags |= VARFLAG_DIRTY;
+        if ( ( pVar->notify == true ) && ( notifyFn != NULL ) )
+        {
+            notifyFn( (VAR_HANDLE)( modifyIdx + 1 ) );
+        }
+
+        modifyIdx = ( modifyIdx + 1 ) % numVars;
+    }
+}
+
+/*============================================================================*/
+/*  MOCKVARSERVER_SetLargeValues                                              */
+/*!
+    Enable large string values
+
+    The MOCKVARSERVER_SetLargeValues function pads one string variable
+    in sixteen to the specified length, to exercise the handling of
+    values larger than the usual retrieval buffers.
+
+    @param[in]
+        len
+            length of the large string values, or zero to disable them
+
+==============================================================================*/
+void MOCKVARSERVER_SetLargeValues( size_t len )
+{
+    largeLen = len;
+}
+
+/*============================================================================*/
+/*  MOCKVARSERVER_SetDirty                                                    */
+/*!
+    Set the number of dirty variables
+
+    The MOCKVARSERVER_SetDirty function flags the specified number of
+    variables as dirty, and clears the dirty flag of the rest.  The
+    next variables to be modified are the first clean ones.
+
+    @param[in]
+        count
+            number of dirty variables
+
+==============================================================================*/
+void MOCKVARSERVER_SetDirty( size_t count )
+{
+    size_t i;
+
+    for ( i = 0; i < numVars; i++ )
+    {
+        if ( i < count )
+        {
+            vars[i].flags |= VARFLAG_DIRTY;
+        }
+        else
+        {
+            vars[i].flags &= ~VARFLAG_DIRTY;
+        }
+    }
+
+    modifyIdx = ( count < numVars ) ? count : 0;
+}
+
+/*============================================================================*/
+/*  MOCKVARSERVER_SetNotify                                                   */
+/*!
+    Set the MODIFIED notification callback
+
+    @param[in]
+        fn
+            function called with the handle of each modified variable
+            which has a MODIFIED notification request
+
+==============================================================================*/
+void MOCKVARSERVER_SetNotify( void (*fn)( VAR_HANDLE hVar ) )
+{
+    notifyFn = fn;
+}
+
+/*============================================================================*/
+/*  MOCKVARSERVER_Calls                                                       */
+/*!
+    Get the number of variable server calls
+
+    @retval the number of variable server calls made
+
+==============================================================================*/
+uint64_t MOCKVARSERVER_Calls( void )
+{
+    return calls;
+}
+
+/*============================================================================*/
+/*  MOCKVARSERVER_Free                                                        */
+/*!
+    Release the mock variables
+
+==============================================================================*/
+void MOCKVARSERVER_Free( void )
+{
+    size_t i;
+
+    for ( i = 0; i < numVars; i++ )
+    {
+        free( vars[i].str );
+    }
+
+    free( vars );
+    vars = NULL;
+    numVars = 0;
+    modifyIdx = 0;
+}
+
+/*============================================================================*/
+/*  VAR_GetFirst                                                              */
+/*!
+    Get the first variable matching a query
+
+    Only QUERY_FLAGS and QUERY_MATCH queries are filtered; every
+    variable matches any other query.  The query handle is used as the iteration cursor.
+
+    @param[in]
+        hVarServer
+            handle to the variable server (unused)
+
+    @param[in,out]
+        query
+            pointer to the variable query
+
+    @param[out]
+        obj
+            pointer to the variable object to populate
+
+    @retval EOK - a variable was found
+    @retval ENOENT - no variable was found
+
+==============================================================================*/
+int VAR_GetFirst( VARSERVER_HANDLE hVarServer,
+                  VarQuery *query,
+                  VarObject *obj )
+{
+    (void)hVarServer;
+
+    calls++;
+
+    return ( query != NULL ) ? GetVar( NextMatch( 0, query ), query, obj )
+                             : EINVAL;
+}
+
+/*============================================================================*/
+/*  VAR_GetNext                                                               */
+/*!
+    Get the next variable matching a query
+
+    @param[in]
+        hVarServer
+            handle to the variable server (unused)
+
+    @param[in,out]
+        query
+            pointer to the variable query
+
+    @param[out]
+        obj
+            pointer to the variable object to populate
+
+    @retval EOK - a variable was found
+    @retval ENOENT - no more variables were found
+
+==============================================================================*/
+int VAR_GetNext( VARSERVER_HANDLE hVarServer,
+                 VarQuery *query,
+                 VarObject *obj )
+{
+    (void)hVarServer;
+
+    calls++;
+
+    return ( query != NULL ) ? GetVar( NextMatch( query->hVar, query ),
+                                       query,
+                                       obj )
+                             : EINVAL;
+}
+
+/*============================================================================*/
+/*  VAR_Get                                                                   */
+/*!
+    Get a variable by handle
+
+    @param[in]
+        hVarServer
+            handle to the variable server (unused)
+
+    @param[in]
+        hVar
+            handle of the variable
+
+    @param[in,out]
+        obj
+            pointer to the variable object to populate
+
+    @retval EOK - the variable was found
+    @retval EINVAL - invalid arguments
+    @retval ENOENT - the variable does not exist
+    @retval E2BIG - the variable value does not fit in the object buffer
+
+==============================================================================*/
+int VAR_Get( VARSERVER_HANDLE hVarServer, VAR_HANDLE hVar, VarObject *obj )
+{
+    VarQuery query;
+
+    (void)hVarServer;
+
+    calls++;
+
+    return ( hVar != VAR_INVALID ) ? GetVar( hVar - 1, &query, obj ) : ENOENT;
+}
+
+/*============================================================================*/
+/*  VAR_GetLength                                                             */
+/*!
+    Get the length of a variable value
+
+    @param[in]
+        hVarServer
+            handle to the variable server (unused)
+
+    @param[in]
+        hVar
+            handle of the variable
+
+    @param[out]
+        len
+            pointer to the location to store the value length.  This
+            includes the NUL terminator of a string
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval ENOENT - the variable does not exist
+
+==============================================================================*/
+int VAR_GetLength( VARSERVER_HANDLE hVarServer, VAR_HANDLE hVar, size_t *len )
+{
+    int result = EINVAL;
+    size_t idx = (size_t)hVar - 1;
+
+    (void)hVarServer;
+
+    if ( len != NULL )
+    {
+        calls++;
+
+        result = ENOENT;
+        if ( ( hVar != VAR_INVALID ) && ( idx < numVars ) )
+        {
+            *len = ( vars[idx].type == VARTYPE_STR ) ? GetString( idx, NULL, 0 )
+                                                     : sizeof( VarData );
+            result = EOK;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  VAR_GetBatch                                                              */
+/*!
+    Get a batch of variables matching a query
+
+    The VAR_GetBatch function writes as many variable records as fit
+    into the buffer, continuing from the position held in the query
+    handle.
+
+    @param[in]
+        hVarServer
+            handle to the variable server (unused)
+
+    @param[in,out]
+        query
+            pointer to the variable query
+
+    @param[out]
+        buf
+            pointer to the record buffer
+
+    @param[in,out]
+        len
+            size of the record buffer on entry, number of bytes
+            written on exit
+
+    @param[out]
+        count
+            number of records written
+
+    @retval EOK - records were written
+    @retval EINVAL - invalid arguments
+    @retval ENOENT - no more variables were found
+    @retval E2BIG - the next record does not fit into the buffer
+
+==============================================================================*/
+int VAR_GetBatch( VARSERVER_HANDLE hVarServer,
+                  VarQuery *query,
+                  void *buf,
+                  size_t *len,
+                  size_t *count )
+{
+    int result = EINVAL;
+    size_t idx;
+    size_t used = 0;
+    size_t n;
+
+    (void)hVarServer;
+
+    if ( ( query != NULL ) &&
+         ( buf != NULL ) &&
+         ( len != NULL ) &&
+         ( count != NULL ) )
+    {
+        calls++;
+
+        *count = 0;
+        idx = NextMatch( query->hVar, query );
+
+        while ( idx < numVars )
+        {
+            n = GetBatchRecord( idx, (char *)buf + used, *len - used );
+            if ( n == 0 )
+            {
+                break;
+            }
+
+            used += n;
+            idx = NextMatch( idx + 1, query );
+            (*count)++;
+        }
+
+        query->hVar = (VAR_HANDLE)idx;
+
+        if ( *count > 0 )
+        {
+            result = EOK;
+            *len = used;
+        }
+        else if ( idx < numVars )
+        {
+            result = E2BIG;
+            *len = SNAPSHOT_RecordSize( MAX_NAME_LEN,
+                                        GetString( idx, NULL, 0 ) );
+        }
+        else
+        {
+            result = ENOENT;
+            *len = 0;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  VAR_FindByName                                                            */
+/*!
+    Find a variable by name
+
+    @param[in]
+        hVarServer
+            handle to the variable server (unused)
+
+    @param[in]
+        name
+            name of the variable.  An "[id]" prefix must match the
+            instance identifier of the variable
+
+    @retval handle of the variable
+    @retval VAR_INVALID if the variable does not exist
+
+==============================================================================*/
+VAR_HANDLE VAR_FindByName( VARSERVER_HANDLE hVarServer, char *name )
+{
+    VAR_HANDLE hVar = VAR_INVALID;
+    unsigned int instanceID = 0;
+    bool prefixed = false;
+    size_t group;
+    size_t idx;
+    int n = 0;
+
+    (void)hVarServer;
+
+    calls++;
+
+    if ( ( name != NULL ) &&
+         ( name[0] == '[' ) &&
+         ( sscanf( name, "[%u]%n", &instanceID, &n ) == 1 ) &&
+         ( n > 0 ) )
+    {
+        name += n;
+        prefixed = true;
+    }
+
+    n = 0;
+    if ( ( name != NULL ) &&
+         ( sscanf( name, "/bench/group%zu/var%zu%n", &group, &idx, &n ) == 2 ) &&
+         ( name[n] == '\0' ) &&
+         ( idx < numVars ) &&
+         ( group == idx / 64 ) &&
+         ( ( prefixed == false ) || ( vars[idx].instanceID == instanceID ) ) )
+    {
+        hVar = (VAR_HANDLE)( idx + 1 );
+    }
+
+    return hVar;
+}
+
+/*============================================================================*/
+/*  VAR_GetType                                                               */
+/*!
+    Get the type of a variable
+
+    @param[in]
+        hVarServer
+            handle to the variable server (unused)
+
+    @param[in]
+        hVar
+            handle of the variable
+
+    @param[out]
+        pVarType
+            pointer to the location to store the variable type
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval ENOENT - the variable does not exist
+
+==============================================================================*/
+int VAR_GetType( VARSERVER_HANDLE hVarServer,
+                 VAR_HANDLE hVar,
+                 VarType *pVarType )
+{
+    int result = EINVAL;
+    size_t idx = (size_t)hVar - 1;
+
+    (void)hVarServer;
+
+    if ( pVarType != NULL )
+    {
+        calls++;
+
+        result = ENOENT;
+        if ( ( hVar != VAR_INVALID ) && ( idx < numVars ) )
+        {
+            *pVarType = vars[idx].type;
+            result = EOK;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  VAR_Set                                                                   */
+/*!
+    Set the value of a variable
+
+    The variable is flagged dirty, and the notification callback is
+    called if it has a MODIFIED notification request.
+
+    @param[in]
+        hVarServer
+            handle to the variable server (unused)
+
+    @param[in]
+        hVar
+            handle of the variable
+
+    @param[in]
+        obj
+            pointer to the value to set, which must have the type
+            of the variable
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments or the type does not match
+    @retval ENOENT - the variable does not exist
+    @retval ENOMEM - memory allocation failed
+
+==============================================================================*/
+int VAR_Set( VARSERVER_HANDLE hVarServer, VAR_HANDLE hVar, VarObject *obj )
+{
+    int result = EINVAL;
+    size_t idx = (size_t)hVar - 1;
+    MockVar *pVar = NULL;
+    char *str;
+
+    (void)hVarServer;
+
+    if ( obj != NULL )
+    {
+        calls++;
+
+        result = ENOENT;
+        if ( ( hVar != VAR_INVALID ) && ( idx < numVars ) )
+        {
+            pVar = &vars[idx];
+            result = ( obj->type == pVar->type ) ? EOK : EINVAL;
+        }
+    }
+
+    if ( result == EOK )
+    {
+        if ( pVar->type == VARTYPE_STR )
+        {
+            str = strdup( ( obj->val.str != NULL ) ? obj->val.str : "" );
+            if ( str != NULL )
+            {
+                free( pVar->str );
+                pVar->str = str;
+            }
+            else
+            {
+                result = ENOMEM;
+            }
+        }
+        else
+        {
+            pVar->val = obj->val;
+        }
+    }
+
+    if ( result == EOK )
+    {
+        pVar->flags |= VARFLAG_DIRTY;
+        if ( ( pVar->notify == true ) && ( notifyFn != NULL ) )
+        {
+            notifyFn( hVar );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  VAR_Notify                                                                */
+/*!
+    Request a notification for a variable
+
+    Only MODIFIED notifications are supported.
+
+    @param[in]
+        hVarServer
+            handle to the variable server (unused)
+
+    @param[in]
+        hVar
+            handle of the variable
+
+    @param[in]
+        notificationType
+            type of notification requested
+
+    @retval EOK - the notification was requested
+    @retval ENOENT - the variable does not exist
+    @retval ENOTSUP - unsupported notification type
+
+==============================================================================*/
+int VAR_Notify( VARSERVER_HANDLE hVarServer,
+                VAR_HANDLE hVar,
+                NotificationType notificationType )
+{
+    int result = ENOENT;
+    size_t idx = (size_t)hVar - 1;
+
+    (void)hVarServer;
+
+    calls++;
+
+    if ( ( notificationType != NOTIFY_MODIFIED ) &&
+         ( notificationType != NOTIFY_PRINT ) )
+    {
+        result = ENOTSUP;
+    }
+    else if ( ( hVar != VAR_INVALID ) && ( idx < numVars ) )
+    {
+        /* PRINT notifications are accepted, but never sent */
+        if ( notificationType == NOTIFY_MODIFIED )
+        {
+            vars[idx].notify = true;
+        }
+
+        result = EOK;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  VAR_GetFlags                                                              */
+/*!
+    Get the flags of a variable
+
+    @param[in]
+        hVarServer
+            handle to the variable server (unused)
+
+    @param[in]
+        hVar
+            handle of the variable
+
+    @param[out]
+        flags
+            pointer to the location to store the variable flags
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval ENOENT - the variable does not exist
+
+==============================================================================*/
+int VAR_GetFlags( VARSERVER_HANDLE hVarServer,
+                  VAR_HANDLE hVar,
+                  uint32_t *flags )
+{
+    int result = EINVAL;
+    size_t idx = (size_t)hVar - 1;
+
+    (void)hVarServer;
+
+    if ( flags != NULL )
+    {
+        calls++;
+
+        result = ENOENT;
+        if ( ( hVar != VAR_INVALID ) && ( idx < numVars ) )
+        {
+            *flags = vars[idx].flags;
+            result = EOK;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  VAR_SetFlags                                                              */
+/*!
+    Set flags of a variable
+
+    @param[in]
+        hVarServer
+            handle to the variable server (unused)
+
+    @param[in]
+        hVar
+            handle of the variable
+
+    @param[in]
+        flags
+            flags to set
+
+    @retval EOK - success
+    @retval ENOENT - the variable does not exist
+
+==============================================================================*/
+int VAR_SetFlags( VARSERVER_HANDLE hVarServer,
+                  VAR_HANDLE hVar,
+                  uint32_t flags )
+{
+    int result = ENOENT;
+    size_t idx = (size_t)hVar - 1;
+
+    (void)hVarServer;
+
+    calls++;
+
+    if ( ( hVar != VAR_INVALID ) && ( idx < numVars ) )
+    {
+        vars[idx].flags |= flags;
+        result = EOK;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  VAR_ClearFlags                                                            */
+/*!
+    Clear flags of a variable
+
+    @param[in]
+        hVarServer
+            handle to the variable server (unused)
+
+    @param[in]
+        hVar
+            handle of the variable
+
+    @param[in]
+        flags
+            flags to clear
+
+    @retval EOK - success
+    @retval ENOENT - the variable does not exist
+
+==============================================================================*/
+int VAR_ClearFlags( VARSERVER_HANDLE hVarServer,
+                    VAR_HANDLE hVar,
+                    uint32_t flags )
+{
+    int result = ENOENT;
+    size_t idx = (size_t)hVar - 1;
+
+    (void)hVarServer;
+
+    calls++;
+
+    if ( ( hVar != VAR_INVALID ) && ( idx < numVars ) )
+    {
+        vars[idx].flags &= ~flags;
+        result = EOK;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  VAR_OpenPrintSession                                                      */
+/*!
+    Open a print session
+
+    The mock print session identifier is the handle of the variable
+    being printed, and the output is written to standard output.
+
+    @param[in]
+        hVarServer
+            handle to the variable server (unused)
+
+    @param[in]
+        id
+            print session identifier
+
+    @param[out]
+        hVar
+            pointer to the location to store the variable handle
+
+    @param[out]
+        fd
+            pointer to the location to store the output file descriptor
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+
+==============================================================================*/
+int VAR_OpenPrintSession( VARSERVER_HANDLE hVarServer,
+                          int32_t id,
+                          VAR_HANDLE *hVar,
+                          int *fd )
+{
+    int result = EINVAL;
+
+    (void)hVarServer;
+
+    if ( ( hVar != NULL ) &&
+         ( fd != NULL ) )
+    {
+        calls++;
+
+        *hVar = (VAR_HANDLE)id;
+        *fd = STDOUT_FILENO;
+        result = EOK;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  VAR_ClosePrintSession                                                     */
+/*!
+    Close a print session
+
+    @param[in]
+        hVarServer
+            handle to the variable server (unused)
+
+    @param[in]
+        id
+            print session identifier (unused)
+
+    @param[in]
+        fd
+            output file descriptor (unused)
+
+    @retval EOK - success
+
+==============================================================================*/
+int VAR_ClosePrintSession( VARSERVER_HANDLE hVarServer,
+                           int32_t id,
+                           int fd )
+{
+    (void)hVarServer;
+    (void)id;
+    (void)fd;
+
+    calls++;
+
+    return EOK;
+}
+
+/*============================================================================*/
+/*  VARSERVER_Open                                                            */
+/*!
+    Open a connection to the mock variable server
+
+    @retval handle to the mock variable server
+
+==============================================================================*/
+VARSERVER_HANDLE VARSERVER_Open( void )
+{
+    calls++;
+
+    return (VARSERVER_HANDLE)&mockHandle;
+}
+
+/*============================================================================*/
+/*  VARSERVER_Close                                                           */
+/*!
+    Close a connection to the mock variable server
+
+    @param[in]
+        hVarServer
+            handle to the variable server (unused)
+
+    @retval EOK - success
+
+==============================================================================*/
+int VARSERVER_Close( VARSERVER_HANDLE hVarServer )
+{
+    (void)hVarServer;
+
+    calls++;
+
+    return EOK;
+}
+
+/*============================================================================*/
+/*  VAROBJECT_ToString                                                        */
+/*!
+    Convert a variable object to a string
+
+    @param[in]
+        pVarObject
+            pointer to the variable object to convert
+
+    @param[out]
+        buf
+            pointer to the output buffer
+
+    @param[in]
+        len
+            size of the output buffer
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval ENOTSUP - unsupported variable type
+    @retval E2BIG - the output buffer is too small
+
+==============================================================================*/
+int VAROBJECT_ToString( VarObject *pVarObject, char *buf, size_t len )
+{
+    int result = EINVAL;
+    int n = 0;
+
+    if ( ( pVarObject != NULL ) &&
+         ( buf != NULL ) &&
+         ( len > 0 ) )
+    {
+        result = EOK;
+
+        switch( pVarObject->type )
+        {
+            case VARTYPE_UINT16:
+                n = snprintf( buf, len, "%u", pVarObject->val.ui );
+                break;
+
+            case VARTYPE_INT16:
+                n = snprintf( buf, len, "%d", pVarObject->val.i );
+                break;
+
+            case VARTYPE_UINT32:
+                n = snprintf( buf, len, "%" PRIu32, pVarObject->val.ul );
+                break;
+
+            case VARTYPE_INT32:
+                n = snprintf( buf, len, "%" PRId32, pVarObject->val.l );
+                break;
+
+            case VARTYPE_UINT64:
+                n = snprintf( buf, len, "%" PRIu64, pVarObject->val.ull );
+                break;
+
+            case VARTYPE_INT64:
+                n = snprintf( buf, len, "%" PRId64, pVarObject->val.ll );
+                break;
+
+            case VARTYPE_FLOAT:
+                n = snprintf( buf, len, "%f", pVarObject->val.f );
+                break;
+
+            case VARTYPE_STR:
+                n = snprintf( buf, len, "%s", pVarObject->val.str );
+                break;
+
+            default:
+                result = ENOTSUP;
+                break;
+        }
+
+        if ( ( result == EOK ) && ( (size_t)n >= len ) )
+        {
+            result = E2BIG;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  VAROBJECT_ValueFromString                                                 */
+/*!
+    Convert a string to a value of the type of a variable object
+
+    @param[in]
+        str
+            pointer to the value text.  A string value refers to it
+
+    @param[in,out]
+        pVarObject
+            pointer to the variable object, whose type selects the
+            conversion
+
+    @param[in]
+        options
+            conversion options (unused)
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments, or the text is not a valid value
+    @retval ERANGE - the value is out of the range of the type
+    @retval ENOTSUP - unsupported variable type
+
+==============================================================================*/
+int VAROBJECT_ValueFromString( char *str,
+                               VarObject *pVarObject,
+                               uint32_t options )
+{
+    int result = EINVAL;
+
+    (void)options;
+
+    if ( ( str != NULL ) &&
+         ( pVarObject != NULL ) )
+    {
+        result = FromString( str, pVarObject );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  GetVar                                                                    */
+/*!
+    Populate a query result from a mock variable
+
+    @param[in]
+        idx
+            index of the variable to get
+
+    @param[in,out]
+        query
+            pointer to the variable query
+
+    @param[out]
+        obj
+            pointer to the variable object to populate
+
+    @retval EOK - the variable was found
+    @retval EINVAL - invalid arguments
+    @retval ENOENT - no variable exists at the index
+    @retval E2BIG - the variable value does not fit in the object buffer
+
+==============================================================================*/
+static int GetVar( size_t idx, VarQuery *query, VarObject *obj )
+{
+    int result = EINVAL;
+    MockVar *pVar;
+
+    if ( ( query != NULL ) &&
+         ( obj != NULL ) )
+    {
+        result = ENOENT;
+
+        if ( idx < numVars )
+        {
+            pVar = &vars[idx];
+
+            /* the handle is the iteration cursor */
+            query->hVar = (VAR_HANDLE)( idx + 1 );
+            query->instanceID = pVar->instanceID;
+            snprintf( query->name,
+                      sizeof query->name,
+                      "/bench/group%zu/var%zu",
+                      idx / 64,
+                      idx );
+
+            obj->type = pVar->type;
+            result = EOK;
+
+            if ( pVar->type == VARTYPE_STR )
+            {
+                if ( GetString( idx, obj->val.str, obj->len ) > obj->len )
+                {
+                    result = E2BIG;
+                }
+            }
+            else
+            {
+                obj->val = pVar->val;
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  GetBatchRecord                                                            */
+/*!
+    Write a mock variable as a batch record
+
+    @param[in]
+        idx
+            index of the variable to write
+
+    @param[out]
+        buf
+            pointer to the location to write the record
+
+    @param[in]
+        len
+            space available for the record
+
+    @retval size of the record written
+    @retval 0 if the record does not fit
+
+==============================================================================*/
+static size_t GetBatchRecord( size_t idx, char *buf, size_t len )
+{
+    SnapshotRecord *pRecord = (SnapshotRecord *)buf;
+    MockVar *pVar = &vars[idx];
+    char name[MAX_NAME_LEN + 1];
+    size_t namelen;
+    size_t vallen = 0;
+    size_t size;
+
+    namelen = (size_t)snprintf( name,
+                                sizeof name,
+                                "/bench/group%zu/var%zu",
+                                idx / 64,
+                                idx );
+
+    if ( pVar->type == VARTYPE_STR )
+    {
+        vallen = GetString( idx, NULL, 0 );
+    }
+
+    size = SNAPSHOT_RecordSize( namelen, vallen );
+    if ( size <= len )
+    {
+        pRecord->hVar = (VAR_HANDLE)( idx + 1 );
+        pRecord->instanceID = pVar->instanceID;
+        pRecord->type = pVar->type;
+        pRecord->namelen = namelen;
+        pRecord->len = vallen;
+        memset( &pRecord->val, 0, sizeof( VarData ) );
+        memcpy( SNAPSHOT_Name( pRecord ), name, namelen + 1 );
+
+        if ( pVar->type == VARTYPE_STR )
+        {
+            (void)GetString( idx, SNAPSHOT_Data( pRecord ), vallen );
+        }
+        else
+        {
+            pRecord->val = pVar->val;
+        }
+    }
+    else
+    {
+        size = 0;
+    }
+
+    return size;
+}
+
+/*============================================================================*/
+/*  GetString                                                                 */
+/*!
+    Generate the value of a mock string variable
+
+    The value is built from the variable index and its generation
+    number, unless it was set by VAR_Set.  If large values are enabled,
+    one string variable in sixteen is padded to the large value length.
+
+    @param[in]
+        idx
+            index of the string variable
+
+    @param[out]
+        buf
+            pointer to the output buffer, or NULL to get the length
+
+    @param[in]
+        len
+            size of the output buffer
+
+    @retval size of the value including its NUL terminator.  The value
+            is only written if this does not exceed len
+
+==============================================================================*/
+static size_t GetString( size_t idx, char *buf, size_t len )
+{
+    char value[64];
+    size_t n;
+    size_t size;
+
+    if ( vars[idx].str != NULL )
+    {
+        /* the value was set by VAR_Set */
+        size = strlen( vars[idx].str ) + 1;
+        if ( ( buf != NULL ) && ( size <= len ) )
+        {
+            memcpy( buf, vars[idx].str, size );
+        }
+    }
+    else
+    {
+        n = (size_t)snprintf( value,
+                              sizeof value,
+                              "value-%zu-%" PRIu64,
+                              idx,
+                              vars[idx].val.ull );
+
+        size = n + 1;
+        if ( ( largeLen > n ) && ( ( ( idx / 8 ) % 16 ) == 15 ) )
+        {
+            size = largeLen + 1;
+        }
+
+        if ( ( buf != NULL ) && ( size <= len ) )
+        {
+            memcpy( buf, value, n );
+            memset( &buf[n], 'x', size - 1 - n );
+            buf[size - 1] = 0;
+        }
+    }
+
+    return size;
+}
+
+/*============================================================================*/
+/*  NextMatch                                                                 */
+/*!
+    Find the next mock variable matching a query
+
+    @param[in]
+        idx
+            index of the first variable to check
+
+    @param[in]
+        query
+            pointer to the variable query
+
+    @retval index of the next matching variable, or the number of
+            variables if there are no more matches
+
+==============================================================================*/
+static size_t NextMatch( size_t idx, VarQuery *query )
+{
+    char name[MAX_NAME_LEN + 1];
+
+    for ( ; idx < numVars; idx++ )
+    {
+        if ( ( ( query->type & QUERY_FLAGS ) != 0 ) &&
+             ( ( vars[idx].flags & query->flags ) != query->flags ) )
+        {
+            continue;
+        }
+
+        if ( ( ( query->type & QUERY_MATCH ) != 0 ) &&
+             ( query->match != NULL ) )
+        {
+            snprintf( name,
+                      sizeof name,
+                      "/bench/group%zu/var%zu",
+                      idx / 64,
+                      idx );
+            if ( strstr( name, query->match ) == NULL )
+            {
+                continue;
+            }
+        }
+
+        break;
+    }
+
+    return idx;
+}
+
+/*============================================================================*/
+/*  FromString                                                                */
+/*!
+    Convert a string to a value of the type of a variable object
+
+    Numbers are decimal, and the whole string must be converted.
+
+    @param[in]
+        str
+            pointer to the value text.  A string value refers to it
+
+    @param[in,out]
+        pVarObject
+            pointer to the variable object
+
+    @retval EOK - success
+    @retval EINVAL - the text is not a valid value
+    @retval ERANGE - the value is out of the range of the type
+    @retval ENOTSUP - unsupported variable type
+
+==============================================================================*/
+static int FromString( char *str, VarObject *pVarObject )
+{
+    int result = EOK;
+    unsigned long long u = 0;
+    long long s = 0;
+    char *end = str;
+
+    errno = 0;
+
+    switch( pVarObject->type )
+    {
+        case VARTYPE_UINT16:
+        case VARTYPE_UINT32:
+        case VARTYPE_UINT64:
+            u = ( str[0] != '-' ) ? strtoull( str, &end, 10 ) : 0;
+            break;
+
+        case VARTYPE_INT16:
+        case VARTYPE_INT32:
+        case VARTYPE_INT64:
+            s = strtoll( str, &end, 10 );
+            break;
+
+        case VARTYPE_FLOAT:
+            pVarObject->val.f = strtof( str, &end );
+            break;
+
+        case VARTYPE_STR:
+            pVarObject->val.str = str;
+            pVarObject->len = strlen( str ) + 1;
+            end = &str[pVarObject->len - 1];
+            break;
+
+        default:
+            result = ENOTSUP;
+            break;
+    }
+
+    if ( result != EOK )
+    {
+        /* unsupported type */
+    }
+    else if ( ( ( end == str ) && ( pVarObject->type != VARTYPE_STR ) ) ||
+              ( *end != '\0' ) )
+    {
+        result = EINVAL;
+    }
+    else if ( ( errno == ERANGE ) ||
+              ( ( pVarObject->type == VARTYPE_UINT16 ) &&
+                ( u > UINT16_MAX ) ) ||
+              ( ( pVarObject->type == VARTYPE_UINT32 ) &&
+                ( u > UINT32_MAX ) ) ||
+              ( ( pVarObject->type == VARTYPE_INT16 ) &&
+                ( ( s < INT16_MIN ) || ( s > INT16_MAX ) ) ) ||
+              ( ( pVarObject->type == VARTYPE_INT32 ) &&
+                ( ( s < INT32_MIN ) || ( s > INT32_MAX ) ) ) )
+    {
+        result = ERANGE;
+    }
+    else
+    {
+        switch( pVarObject->type )
+        {
+            case VARTYPE_UINT16:
+                pVarObject->val.ui = (uint16_t)u;
+                break;
+
+            case VARTYPE_UINT32:
+                pVarObject->val.ul = (uint32_t)u;
+                break;
+
+            case VARTYPE_UINT64:
+                pVarObject->val.ull = (uint64_t)u;
+                break;
+
+            case VARTYPE_INT16:
+                pVarObject->val.i = (int16_t)s;
+                break;
+
+            case VARTYPE_INT32:
+                pVarObject->val.l = (int32_t)s;
+                break;
+
+            case VARTYPE_INT64:
+                pVarObject->val.ll = (int64_t)s;
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    return result;
+}
+
+/*! @}
+ * end of mockvarserver group */
@@ -0,0 +1,49 @@
+#!/bin/sh
+#
+# Compare the time taken to restore a configuration file with loadconfig
+# and with saverestore.  The variables in the file must exist in the
+# running variable server.
+#
+# usage: restorebench.sh [-n runs] configfile
+#
+# The commands can be overridden with the LOADCONFIG and SAVERESTORE
+# environment variables.  The configuration file name is appended to
+# each command.
+
+LOADCONFIG=${LOADCONFIG:-"loadconfig -f"}
+SAVERESTORE=${SAVERESTORE:-"saverestore"}
+RUNS=10
+
+while getopts "n:h" opt; do
+    case $opt in
+        n) RUNS=$OPTARG ;;
+        *) echo "usage: $0 [-n runs] configfile" >&2; exit 1 ;;
+    esac
+done
+shift $((OPTIND - 1))
+
+FILE=$1
+if [ -z "$FILE" ] || [ ! -f "$FILE" ]; then
+    echo "usage: $0 [-n runs] configfile" >&2
+    exit 1
+fi
+
+# run a restore command RUNS times and print the mean time per run
+run() {
+    name=$1
+    shift
+
+    start=$(date +%s%N)
+    i=0
+    while [ $i -lt "$RUNS" ]; do
+        $* "$FILE" > /dev/null || echo "$name failed" >&2
+        i=$((i + 1))
+    done
+    end=$(date +%s%N)
+
+    echo "$name: $(( (end - start) / RUNS / 1000 )) us per restore"
+}
+
+echo "file: $FILE ($(wc -l < "$FILE") lines, $RUNS runs)"
+run loadconfig $LOADCONFIG
+run saverestore $SAVERESTORE
@@ -0,0 +1,753 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup savebench Save Benchmark
+ * @brief Save Service performance benchmark
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file savebench.c
+
+    Save Benchmark
+
+    The Save Benchmark runs the Save Service save pipeline against
+    the in-process mock variable server and reports the save rate,
+    save latency percentiles, the number of bytes written, the number
+    of write system calls issued, and the number of variable server
+    calls made.
+
+    Between saves a configurable number of variables are modified
+    so the saves are not skipped as unchanged.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <varserver/varserver.h>
+#include "savesvc.h"
+#include "mockvarserver.h"
+#include "shard.h"
+
+/*==============================================================================
+       Type Definitions
+==============================================================================*/
+
+/*! benchmark parameters */
+typedef struct _benchParams
+{
+    /*! number of variables to synthesize */
+    size_t vars;
+
+    /*! number of saves to perform */
+    size_t saves;
+
+    /*! number of variables to modify between saves */
+    size_t changes;
+
+    /*! indicates the number of changes was specified */
+    bool changesSet;
+
+    /*! length of large string values, or zero for no large values */
+    size_t large;
+
+    /*! number of initially dirty variables */
+    size_t dirty;
+
+    /*! indicates the number of initially dirty variables was specified */
+    bool dirtySet;
+
+} BenchParams;
+
+/*==============================================================================
+       Function declarations
+==============================================================================*/
+static void usage( char *cmdname );
+static int ProcessOptions( int argC,
+                           char *argV[],
+                           SaveSvcState *pState,
+                           BenchParams *pParams );
+static int RunBenchmark( SaveSvcState *pState, BenchParams *pParams );
+static uint64_t TimeNowNs( void );
+static int CompareU64( const void *a, const void *b );
+static int StartTracking( SaveSvcState *pState );
+static void MarkModified( VAR_HANDLE hVar );
+static int StartRing( SaveSvcState *pState );
+
+/*==============================================================================
+       Definitions
+==============================================================================*/
+
+/*! default benchmark output filename */
+#define DEFAULT_BENCH_FILENAME "/tmp/savebench.cfg"
+
+/*! default number of variables */
+#define DEFAULT_BENCH_VARS ( 10000 )
+
+/*! default number of saves */
+#define DEFAULT_BENCH_SAVES ( 100 )
+
+/*==============================================================================
+      File Scoped Variables
+==============================================================================*/
+
+/*! dirty set updated by the mock notification callback */
+static DirtySet *pTracked;
+
+/*==============================================================================
+       Function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  main                                                                      */
+/*!
+    Main entry point for the save benchmark
+
+    @param[in]
+        argc
+            number of arguments on the command line
+            (including the command itself)
+
+    @param[in]
+        argv
+            array of pointers to the command line arguments
+
+    @return 0 on success, 1 on failure
+
+==============================================================================*/
+int main(int argC, char *argV[])
+{
+    SaveSvcState *pState;
+    BenchParams params;
+    int result = EINVAL;
+
+    memset( &params, 0, sizeof( BenchParams ) );
+    params.vars = DEFAULT_BENCH_VARS;
+    params.saves = DEFAULT_BENCH_SAVES;
+
+    pState = (SaveSvcState *)calloc(1, sizeof( SaveSvcState ) );
+    if ( pState != NULL )
+    {
+        pState->filename = DEFAULT_BENCH_FILENAME;
+        pState->fd = -1;
+        pState->bufsize = OUTBUF_DEFAULT_SIZE;
+        pState->compactSize = DEFAULT_COMPACT_SIZE;
+        pState->compactRatio = DEFAULT_COMPACT_RATIO;
+        pState->batchsize = SNAPSHOT_DEFAULT_BATCH_SIZE;
+        pState->shardWorkers = DEFAULT_SHARD_WORKERS;
+
+        ProcessOptions( argC, argV, pState, &params );
+
+        if ( params.changesSet == false )
+        {
+            /* by default modify 1% of the variables between saves */
+            params.changes = ( params.vars / 100 ) + 1;
+        }
+
+        if ( ( OUTBUF_Init( &pState->out, pState->bufsize ) == EOK ) &&
+             ( SNAPSHOT_Init( &pState->snapshot[0],
+                              SNAPSHOT_DEFAULT_SIZE ) == EOK ) &&
+             ( ( pState->journal == false ) ||
+               ( InitJournal( pState ) == EOK ) ) &&
+             ( ( pState->shardDepth == 0 ) ||
+               ( SHARD_Init( pState ) == EOK ) ) &&
+             ( ( pState->clearDirty == false ) ||
+               ( InitHistory( pState ) == EOK ) ) &&
+             ( ( pState->pMetrics == NULL ) ||
+               ( METRICS_Init( pState->pMetrics ) == EOK ) ) &&
+             ( ( pState->ringDepth == 0 ) ||
+               ( StartRing( pState ) == EOK ) ) &&
+             ( MOCKVARSERVER_Init( params.vars ) == EOK ) )
+        {
+            MOCKVARSERVER_SetLargeValues( params.large );
+            if ( params.dirtySet == true )
+            {
+                MOCKVARSERVER_SetDirty( params.dirty );
+            }
+
+            if ( ( pState->track == false ) ||
+                 ( StartTracking( pState ) == EOK ) )
+            {
+                result = RunBenchmark( pState, &params );
+            }
+            else
+            {
+                fprintf( stderr, "Cannot initialize change tracking\n" );
+            }
+        }
+        else
+        {
+            fprintf( stderr, "Cannot initialize benchmark\n" );
+        }
+
+        MOCKVARSERVER_Free();
+        SHARD_Free( pState );
+        HISTORY_Free( &pState->history );
+        if ( pState->pMetrics != NULL )
+        {
+            METRICS_Free( pState->pMetrics );
+        }
+
+        if ( pState->pRing != NULL )
+        {
+            URING_Free( pState->pRing );
+        }
+        DIRTYSET_Free( &pState->dirty );
+        FILTER_Free( &pState->filter );
+        SNAPSHOT_Free( &pState->snapshot[0] );
+        SNAPSHOT_Free( &pState->readback );
+        VARTAB_Free( &pState->saved );
+        OUTBUF_Free( &pState->out );
+        ARENA_Free( &pState->arena );
+        free( pState );
+    }
+
+    return ( result == EOK ) ? 0 : 1;
+}
+
+/*============================================================================*/
+/*  usage                                                                     */
+/*!
+    Display the save benchmark usage
+
+    @param[in]
+       cmdname
+            pointer to the invoked command name
+
+    @return none
+
+==============================================================================*/
+static void usage( char *cmdname )
+{
+    if( cmdname != NULL )
+    {
+        fprintf(stderr,
+                "usage: %s [-n vars] [-s saves] [-c changes] [-f name] "
+                "[-b size] [-B size] [-S mode] [-F format] [-j] [-l len] [-d vars] "
+                "[-T] [-D depth] [-W workers] [-C] [-G] [-M] [-U depth] [-g] "
+                "[-p filter] [-h]\n"
+                " [-n vars] : number of dirty variables to synthesize\n"
+                " [-s saves] : number of saves to perform\n"
+                " [-c changes] : number of variables modified per save\n"
+                " [-f filename] : output file name\n"
+                " [-b size] : output buffer size (flush threshold) in bytes\n"
+                " [-B size] : variable retrieval batch size in bytes "
+                "(0 to disable)\n"
+                " [-S mode] : durability mode: "
+                "none, fdatasync, dirsync, or range\n"
+                " [-F format] : output file format: text or binary\n"
+                " [-j] : append changed variables to a journal\n"
+                " [-l len] : give one string variable in 16 a value "
+                "of len bytes\n"
+                " [-d vars] : number of variables which are initially dirty\n"
+                " [-T] : track modified variables instead of querying "
+                "for dirty variables\n"
+                " [-D depth] : shard the output by variable name prefixes "
+                "of depth components\n"
+                " [-W workers] : number of shard worker threads\n"
+                " [-C] : clear the dirty flags of committed variables\n"
+                " [-G] : record the generation marker of each save "
+                "(implies -C)\n"
+                " [-M] : report the save metrics\n"
+                " [-U depth] : commit the output with an io_uring queue "
+                "of depth entries\n"
+                " [-g] : register the output buffer with io_uring\n"
+                " [-p filter] : save only the variables selected by a "
+                "name prefix, or by regex=pattern or flags=flags "
+                "(repeatable)\n"
+                " [-h] : display this help\n",
+                cmdname );
+    }
+}
+
+/*============================================================================*/
+/*  ProcessOptions                                                            */
+/*!
+    Process the command line options
+
+    @param[in]
+        argC
+            number of arguments
+            (including the command itself)
+
+    @param[in]
+        argv
+            array of pointers to the command line arguments
+
+    @param[in,out]
+        pState
+            pointer to the save state
+
+    @param[in,out]
+        pParams
+            pointer to the benchmark parameters
+
+    @return none
+
+==============================================================================*/
+static int ProcessOptions( int argC,
+                           char *argV[],
+                           SaveSvcState *pState,
+                           BenchParams *pParams )
+{
+    int c;
+    const char *options = "hn:s:c:f:b:B:S:F:jl:d:TD:W:CGMU:gp:";
+
+    if( ( pState != NULL ) &&
+        ( pParams != NULL ) &&
+        ( argV != NULL ) )
+    {
+        while( ( c = getopt( argC, argV, options ) ) != -1 )
+        {
+            switch( c )
+            {
+                case 'n':
+                    pParams->vars = strtoul( optarg, NULL, 0 );
+                    break;
+
+                case 's':
+                    pParams->saves = strtoul( optarg, NULL, 0 );
+                    break;
+
+                case 'c':
+                    pParams->changes = strtoul( optarg, NULL, 0 );
+                    pParams->changesSet = true;
+                    break;
+
+                case 'f':
+                    pState->filename = optarg;
+                    break;
+
+                case 'b':
+                    pState->bufsize = strtoul( optarg, NULL, 0 );
+                    break;
+
+                case 'B':
+                    pState->batchsize = strtoul( optarg, NULL, 0 );
+                    break;
+
+                case 'S':
+                    if ( ParseDurability( optarg,
+                                          &pState->durability ) != EOK )
+                    {
+                        fprintf( stderr,
+                                 "Invalid durability mode: %s\n",
+                                 optarg );
+                    }
+                    break;
+
+                case 'F':
+                    if ( ParseFormat( optarg, &pState->format ) != EOK )
+                    {
+                        fprintf( stderr,
+                                 "Invalid output format: %s\n",
+                                 optarg );
+                    }
+                    break;
+
+                case 'j':
+                    pState->journal = true;
+                    break;
+
+                case 'l':
+                    pParams->large = strtoul( optarg, NULL, 0 );
+                    break;
+
+                case 'd':
+                    pParams->dirty = strtoul( optarg, NULL, 0 );
+                    pParams->dirtySet = true;
+                    break;
+
+                case 'T':
+                    pState->track = true;
+                    break;
+
+                case 'D':
+                    pState->shardDepth = strtoul( optarg, NULL, 0 );
+                    break;
+
+                case 'W':
+                    pState->shardWorkers = strtoul( optarg, NULL, 0 );
+                    break;
+
+                case 'C':
+                    pState->clearDirty = true;
+                    break;
+
+                case 'G':
+                    pState->consistent = true;
+                    pState->clearDirty = true;
+                    break;
+
+                case 'M':
+                    pState->pMetrics = &pState->metrics;
+                    break;
+
+                case 'U':
+                    pState->ringDepth = strtoul( optarg, NULL, 0 );
+                    break;
+
+                case 'g':
+                    pState->ringFixed = true;
+                    break;
+
+                case 'p':
+                    if ( FILTER_Parse( &pState->filter, optarg ) != EOK )
+                    {
+                        fprintf( stderr, "Invalid filter: %s\n", optarg );
+                    }
+                    break;
+
+                case 'h':
+                    usage( argV[0] );
+                    break;
+
+                default:
+                    break;
+            }
+        }
+
+        if ( ( pState->format == FORMAT_BINARY ) &&
+             ( pState->journal == true ) )
+        {
+            fprintf( stderr, "Journal is not supported in binary format\n" );
+            pState->journal = false;
+        }
+
+        if ( ( pState->shardDepth > 0 ) &&
+             ( pState->journal == true ) )
+        {
+            fprintf( stderr, "Journal is not supported with shards\n" );
+            pState->journal = false;
+        }
+    }
+
+    return 0;
+}
+
+/*============================================================================*/
+/*  RunBenchmark                                                              */
+/*!
+    Run the save benchmark
+
+    The RunBenchmark function performs the requested number of saves,
+    each consisting of a snapshot capture and a save, and reports
+    the results.
+
+    @param[in,out]
+        pState
+            pointer to the save state
+
+    @param[in]
+        pParams
+            pointer to the benchmark parameters
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval ENOMEM - memory allocation failed
+    @retval other error from the save
+
+==============================================================================*/
+static int RunBenchmark( SaveSvcState *pState, BenchParams *pParams )
+{
+    int result = EINVAL;
+    uint64_t *latency;
+    char text[BUFSIZ];
+    uint64_t start;
+    uint64_t total = 0;
+    uint64_t t0;
+    uint64_t calls;
+    size_t n = 0;
+    size_t i;
+
+    if ( ( pState != NULL ) &&
+         ( pParams != NULL ) &&
+         ( pParams->saves > 0 ) )
+    {
+        latency = calloc( pParams->saves, sizeof( uint64_t ) );
+        if ( latency != NULL )
+        {
+            result = EOK;
+
+            calls = MOCKVARSERVER_Calls();
+            start = TimeNowNs();
+
+            for ( i = 0; ( i < pParams->saves ) && ( result == EOK ); i++ )
+            {
+                MOCKVARSERVER_Modify( pParams->changes );
+
+                t0 = TimeNowNs();
+
+                result = CaptureDirtyVars( pState, &pState->snapshot[0] );
+                if ( result == EOK )
+                {
+                    result = SaveConfig( pState, &pState->snapshot[0] );
+                }
+
+                if ( ( result == EOK ) &&
+                     ( pState->clearDirty == true ) )
+                {
+                    result = ClearDirty( pState, &pState->snapshot[0], 1 );
+                }
+
+                latency[n] = TimeNowNs() - t0;
+                total += latency[n++];
+            }
+
+            if ( result == EOK )
+            {
+                qsort( latency, n, sizeof( uint64_t ), CompareU64 );
+
+                printf( "variables:          %zu\n", pParams->vars );
+                printf( "commit:             %s\n",
+                        ( pState->pRing == NULL ) ? "synchronous"
+                        : ( pState->ringBuf > 0 ) ? "io_uring (fixed buffer)"
+                                                  : "io_uring" );
+                printf( "changes per save:   %zu\n", pParams->changes );
+                printf( "saves:              %zu (%" PRIu64 " skipped)\n",
+                        n,
+                        pState->stats.skipped );
+                printf( "elapsed:            %.3f ms\n",
+                        ( TimeNowNs() - start ) / 1e6 );
+                printf( "saves per second:   %.1f\n",
+                        ( n * 1e9 ) / (double)total );
+                printf( "latency p50:        %.1f us\n",
+                        latency[( n * 50 ) / 100] / 1e3 );
+                printf( "latency p99:        %.1f us\n",
+                        latency[( n * 99 ) / 100] / 1e3 );
+                printf( "latency max:        %.1f us\n",
+                        latency[n - 1] / 1e3 );
+                printf( "bytes written:      %" PRIu64 " (%.0f per save)\n",
+                        pState->out.bytes,
+                        (double)pState->out.bytes / n );
+                printf( "write syscalls:     %" PRIu64 " (%.1f per save)\n",
+                        pState->out.syscalls,
+                        (double)pState->out.syscalls / n );
+                printf( "data sync time:     %" PRIu64 " us "
+                        "(max %" PRIu64 " us)\n",
+                        pState->stats.syncTimeUs,
+                        pState->stats.syncMaxUs );
+                printf( "dir sync time:      %" PRIu64 " us\n",
+                        pState->stats.dirSyncTimeUs );
+                printf( "varserver calls:    %" PRIu64 " (%.1f per save)\n",
+                        MOCKVARSERVER_Calls() - calls,
+                        (double)( MOCKVARSERVER_Calls() - calls ) / n );
+                printf( "variable table:     %zu vars (%zu bytes)\n",
+                        pState->saved.count,
+                        VARTAB_Memory( &pState->saved ) );
+                printf( "save arena:         %zu bytes (peak %zu, "
+                        "%" PRIu64 " heap allocations)\n",
+                        pState->arena.size,
+                        pState->arena.peak,
+                        pState->arena.heapAllocs );
+
+                if ( ( pState->pMetrics != NULL ) &&
+                     ( METRICS_Format( pState->pMetrics,
+                                       text,
+                                       sizeof text ) == EOK ) )
+                {
+                    printf( "metrics:\n%s", text );
+                }
+            }
+            else
+            {
+                fprintf( stderr, "Save failed: %s\n", strerror( result ) );
+            }
+
+            free( latency );
+        }
+        else
+        {
+            result = ENOMEM;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  StartTracking                                                             */
+/*!
+    Start tracking modified mock variables
+
+    @param[in,out]
+        pState
+            pointer to the save state
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval ENOMEM - memory allocation failed
+
+==============================================================================*/
+static int StartTracking( SaveSvcState *pState )
+{
+    int result;
+
+    result = DIRTYSET_Init( &pState->dirty, DIRTYSET_DEFAULT_SIZE );
+    if ( result == EOK )
+    {
+        result = InitTracking( pState );
+        if ( result == EOK )
+        {
+            pTracked = &pState->dirty;
+            MOCKVARSERVER_SetNotify( MarkModified );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  MarkModified                                                              */
+/*!
+    Mock MODIFIED notification callback
+
+    The MarkModified function stands in for the SIG_VAR_MODIFIED signal
+    handling of the save service.
+
+    @param[in]
+        hVar
+            handle of the modified variable
+
+==============================================================================*/
+static void MarkModified( VAR_HANDLE hVar )
+{
+    (void)DIRTYSET_Mark( pTracked, hVar );
+}
+
+/*============================================================================*/
+/*  TimeNowNs                                                                 */
+/*!
+    Get the current monotonic time
+
+    @retval the current monotonic time in nanoseconds
+
+==============================================================================*/
+static uint64_t TimeNowNs( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+
+    return ( (uint64_t)ts.tv_sec * 1000000000 ) + ts.tv_nsec;
+}
+
+/*============================================================================*/
+/*  CompareU64                                                                */
+/*!
+    Compare two 64-bit unsigned integers for qsort
+
+    @param[in]
+        a
+            pointer to the first value
+
+    @param[in]
+        b
+            pointer to the second value
+
+    @retval -1, 0, or 1 as a is less than, equal to, or greater than b
+
+==============================================================================*/
+static int CompareU64( const void *a, const void *b )
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return ( x > y ) - ( x < y );
+}
+
+/*============================================================================*/
+/*  StartRing                                                                 */
+/*!
+    Start committing the output with io_uring
+
+    If io_uring is unavailable, the benchmark commits with synchronous
+    system calls, as the Save Service does.
+
+    @param[in]
+        pState
+            pointer to the SaveSvc state
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+
+==============================================================================*/
+static int StartRing( SaveSvcState *pState )
+{
+    int result = EINVAL;
+    struct iovec iov;
+    int rc;
+
+    if ( pState != NULL )
+    {
+        result = EOK;
+
+        rc = URING_Init( &pState->ring, pState->ringDepth );
+        if ( rc == EOK )
+        {
+            pState->pRing = &pState->ring;
+        }
+        else
+        {
+            fprintf( stderr, "io_uring unavailable: %s\n", strerror( rc ) );
+        }
+
+        if ( ( pState->pRing != NULL ) &&
+             ( pState->ringFixed == true ) )
+        {
+            iov.iov_base = pState->out.buf;
+            iov.iov_len = pState->out.size;
+
+            rc = URING_RegisterBuffers( pState->pRing, &iov, 1 );
+            if ( rc == EOK )
+            {
+                pState->ringBuf = 1;
+            }
+            else
+            {
+                fprintf( stderr,
+                         "Cannot register io_uring buffer: %s\n",
+                         strerror( rc ) );
+            }
+        }
+    }
+
+    return result;
+}
+
+/*! @}
+ * end of savebench group */
@@ -0,0 +1,93 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+
+#ifndef ARENA_H
+#define ARENA_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*==============================================================================
+        Definitions
+==============================================================================*/
+
+/*! default size (in bytes) of the first arena block */
+#define ARENA_DEFAULT_SIZE ( 64 * 1024 )
+
+/*! alignment (in bytes) of arena allocations */
+#define ARENA_ALIGNMENT ( 16 )
+
+/*==============================================================================
+        Type Definitions
+==============================================================================*/
+
+/*! arena memory block.  The block memory follows the block header,
+    aligned to ARENA_ALIGNMENT */
+typedef struct _ArenaBlock
+{
+    /*! next (older) block of the arena */
+    struct _ArenaBlock *next;
+
+    /*! size of the block memory */
+    size_t size;
+
+    /*! number of bytes of the block memory in use */
+    size_t used;
+
+} ArenaBlock;
+
+/*! bump allocator for the working memory of a single save */
+typedef struct _Arena
+{
+    /*! current block, followed by the blocks filled before it */
+    ArenaBlock *blocks;
+
+    /*! total size of the arena blocks */
+    size_t size;
+
+    /*! number of bytes allocated since the arena was last reset */
+    size_t used;
+
+    /*! largest number of bytes allocated between resets */
+    size_t peak;
+
+    /*! number of blocks allocated from the heap */
+    uint64_t heapAllocs;
+
+} Arena;
+
+/*==============================================================================
+        Public Function Declarations
+==============================================================================*/
+
+void *ARENA_Alloc( Arena *pArena, size_t size );
+void ARENA_Reset( Arena *pArena );
+void ARENA_Free( Arena *pArena );
+
+#endif
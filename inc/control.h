@@ -0,0 +1,53 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef CONTROL_H
+#define CONTROL_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stddef.h>
+
+/*==============================================================================
+        Definitions
+==============================================================================*/
+
+/*! maximum length of a control command */
+#define CONTROL_MAX_COMMAND ( 64 )
+
+/*! maximum number of control connections awaiting a reply */
+#define CONTROL_MAX_WAITERS ( 16 )
+
+/*==============================================================================
+        Public Function Declarations
+==============================================================================*/
+
+int CONTROL_Listen( const char *path );
+int CONTROL_Accept( int fd );
+int CONTROL_Read( int fd, char *buf, size_t len );
+int CONTROL_Reply( int fd, const char *reply );
+
+#endif
@@ -0,0 +1,124 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef DIRTYSET_H
+#define DIRTYSET_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <varserver/varserver.h>
+#include "snapshot.h"
+
+/*==============================================================================
+        Definitions
+==============================================================================*/
+
+/*! default number of slots in a dirty set */
+#define DIRTYSET_DEFAULT_SIZE ( 1024 )
+
+/*==============================================================================
+        Type Definitions
+==============================================================================*/
+
+/*! tracked variable */
+typedef struct _DirtySetEntry
+{
+    /*! variable handle.  VAR_INVALID for an unused slot */
+    VAR_HANDLE hVar;
+
+    /*! variable instance identifier */
+    uint32_t instanceID;
+
+    /*! offset of the variable name in the name pool */
+    uint32_t name;
+
+    /*! indicates the variable has been modified */
+    bool dirty;
+
+    /*! generation of the dirty set when the variable was last modified */
+    uint64_t generation;
+
+} DirtySetEntry;
+
+/*! set of tracked variables, and the subset which have been modified */
+typedef struct _DirtySet
+{
+    /*! array of table slots, indexed by variable handle hash */
+    DirtySetEntry *entries;
+
+    /*! number of table slots (always a power of two) */
+    size_t size;
+
+    /*! number of tracked variables */
+    size_t count;
+
+    /*! pool of NUL terminated variable names */
+    char *names;
+
+    /*! size of the name pool */
+    size_t namesSize;
+
+    /*! number of bytes of the name pool in use */
+    size_t namesLen;
+
+    /*! handles of the modified variables, in the order first modified */
+    VAR_HANDLE *list;
+
+    /*! size of the modified variable list */
+    size_t listSize;
+
+    /*! number of modified variables */
+    size_t dirty;
+
+    /*! generation marker of the most recent capture.  Modified
+        variables are stamped with it */
+    uint64_t generation;
+
+} DirtySet;
+
+/*==============================================================================
+        Public Function Declarations
+==============================================================================*/
+
+int DIRTYSET_Init( DirtySet *pDirtySet, size_t size );
+int DIRTYSET_Register( DirtySet *pDirtySet,
+                       VAR_HANDLE hVar,
+                       uint32_t instanceID,
+                       const char *name );
+int DIRTYSET_Mark( DirtySet *pDirtySet, VAR_HANDLE hVar );
+int DIRTYSET_Capture( DirtySet *pDirtySet,
+                      Snapshot *pSnapshot,
+                      VARSERVER_HANDLE hVarServer );
+int DIRTYSET_Clear( DirtySet *pDirtySet,
+                    VAR_HANDLE hVar,
+                    uint64_t generation );
+void DIRTYSET_Compact( DirtySet *pDirtySet );
+void DIRTYSET_Free( DirtySet *pDirtySet );
+
+#endif
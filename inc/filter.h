@@ -0,0 +1,121 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+
+#ifndef FILTER_H
+#define FILTER_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <regex.h>
+#include <varserver/varserver.h>
+#include <varserver/varquery.h>
+
+/*==============================================================================
+        Definitions
+==============================================================================*/
+
+/*! initial number of nodes in a prefix trie */
+#define FILTER_DEFAULT_NODES ( 64 )
+
+/*==============================================================================
+        Type Definitions
+==============================================================================*/
+
+/*! prefix trie node.  The children of a node are a linked list of
+    siblings, each matching one more character of the name */
+typedef struct _FilterNode
+{
+    /*! index of the first child node, or zero if there are none */
+    uint32_t child;
+
+    /*! index of the next sibling node, or zero if there are none */
+    uint32_t next;
+
+    /*! name character matched by the node */
+    char c;
+
+    /*! indicates a prefix ends at this node */
+    bool end;
+
+} FilterNode;
+
+/*! variable filter.  A zeroed filter selects every variable */
+typedef struct _Filter
+{
+    /*! prefix trie nodes.  The first node is the root, matching the
+        empty string */
+    FilterNode *nodes;
+
+    /*! size of the node array */
+    size_t size;
+
+    /*! number of nodes in use */
+    size_t count;
+
+    /*! number of name prefixes in the trie */
+    size_t prefixes;
+
+    /*! the name prefix, if there is only one, for the variable server
+        to narrow the query with */
+    char *prefix;
+
+    /*! name regular expression, or NULL if names are not matched
+        against a regular expression */
+    char *pattern;
+
+    /*! compiled name regular expression */
+    regex_t regex;
+
+    /*! tag specification, or NULL if variables are not selected by tag */
+    char *tags;
+
+    /*! flags which a selected variable must have, in addition to the
+        dirty flag */
+    uint32_t flags;
+
+} Filter;
+
+/*==============================================================================
+        Public Function Declarations
+==============================================================================*/
+
+int FILTER_Parse( Filter *pFilter, const char *spec );
+int FILTER_AddPrefix( Filter *pFilter, const char *prefix );
+int FILTER_SetRegex( Filter *pFilter, const char *pattern );
+int FILTER_SetTags( Filter *pFilter, const char *tags );
+int FILTER_SetFlags( Filter *pFilter, const char *flags );
+int FILTER_CopyQuery( Filter *pFilter, const Filter *pSource );
+bool FILTER_HasNames( const Filter *pFilter );
+bool FILTER_Match( const Filter *pFilter, const char *name );
+bool FILTER_SameQuery( const Filter *pFilter, const Filter *pOther );
+void FILTER_Query( const Filter *pFilter, VarQuery *pQuery, bool names );
+void FILTER_Free( Filter *pFilter );
+
+#endif
@@ -0,0 +1,94 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include "snapshot.h"
+#include "filter.h"
+
+/*==============================================================================
+        Definitions
+==============================================================================*/
+
+/*! default number of slots in a save history */
+#define HISTORY_DEFAULT_SIZE ( 1024 )
+
+/*==============================================================================
+        Type Definitions
+==============================================================================*/
+
+/*! save history slot */
+typedef struct _HistorySlot
+{
+    /*! hash of the variable instance identifier and name */
+    uint64_t hash;
+
+    /*! index of the variable record plus one.  Zero for an unused slot */
+    uint32_t idx;
+
+} HistorySlot;
+
+/*! most recently saved value of every variable which has been saved */
+typedef struct _History
+{
+    /*! array of table slots, indexed by variable hash */
+    HistorySlot *slots;
+
+    /*! number of table slots (always a power of two) */
+    size_t size;
+
+    /*! variable records, in the order the variables were first saved */
+    SnapshotRecord **records;
+
+    /*! size of the variable record array */
+    size_t recordsSize;
+
+    /*! number of variables */
+    size_t count;
+
+    /*! snapshot of all of the variables, built for a full save */
+    Snapshot full;
+
+} History;
+
+/*==============================================================================
+        Public Function Declarations
+==============================================================================*/
+
+int HISTORY_Init( History *pHistory, size_t size );
+int HISTORY_Update( History *pHistory,
+                    Snapshot *pSnapshot,
+                    const Filter *pFilter );
+int HISTORY_Load( History *pHistory, const char *filename );
+Snapshot *HISTORY_Build( History *pHistory );
+void HISTORY_Free( History *pHistory );
+
+#endif
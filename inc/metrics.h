@@ -0,0 +1,162 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef METRICS_H
+#define METRICS_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <varserver/varserver.h>
+
+/*==============================================================================
+        Definitions
+==============================================================================*/
+
+/*! number of linear sub-buckets in each power of two histogram range */
+#define METRICS_SUB_BUCKETS ( 8 )
+
+/*! number of histogram buckets, covering the full range of a uint64_t */
+#define METRICS_BUCKETS ( 62 * METRICS_SUB_BUCKETS )
+
+/*==============================================================================
+        Type Definitions
+==============================================================================*/
+
+/*! save phases which are timed */
+typedef enum _metricPhase
+{
+    /*! capturing the dirty variables from the variable server */
+    METRIC_QUERY = 0,
+
+    /*! formatting the output */
+    METRIC_FORMAT,
+
+    /*! write system calls */
+    METRIC_WRITE,
+
+    /*! syncing the output data to storage */
+    METRIC_FSYNC,
+
+    /*! committing the output (link, rename, and directory sync) */
+    METRIC_RENAME,
+
+    /*! the whole save of a profile (excluding the query) */
+    METRIC_SAVE,
+
+    /*! number of timed phases */
+    METRIC_PHASES
+
+} MetricPhase;
+
+/*! measurements of a single save */
+typedef struct _metricSample
+{
+    /*! time spent in each phase (in microseconds) */
+    uint64_t us[METRIC_PHASES];
+
+    /*! phases (one bit per phase) which were timed */
+    uint32_t phases;
+
+    /*! number of variables written */
+    uint64_t vars;
+
+    /*! number of bytes written */
+    uint64_t bytes;
+
+} MetricSample;
+
+/*! log-linear histogram of durations (in microseconds) */
+typedef struct _metricHistogram
+{
+    /*! number of durations in each bucket */
+    uint64_t counts[METRICS_BUCKETS];
+
+    /*! number of durations */
+    uint64_t count;
+
+    /*! longest duration */
+    uint64_t max;
+
+} MetricHistogram;
+
+/*! save service metrics */
+typedef struct _metrics
+{
+    /*! mutex protecting the metrics, which are updated by the writer
+        thread and read by the main thread */
+    pthread_mutex_t lock;
+
+    /*! number of saves performed */
+    uint64_t saves;
+
+    /*! number of saves which failed */
+    uint64_t failures;
+
+    /*! number of saves skipped because the output was unchanged */
+    uint64_t skipped;
+
+    /*! number of variables written by successful saves */
+    uint64_t vars;
+
+    /*! number of bytes written */
+    uint64_t bytes;
+
+    /*! duration histogram of each phase */
+    MetricHistogram phase[METRIC_PHASES];
+
+    /*! variable server handle of each exported metric */
+    VAR_HANDLE *handles;
+
+} Metrics;
+
+/*==============================================================================
+        Public Function Declarations
+==============================================================================*/
+
+int METRICS_Init( Metrics *pMetrics );
+void METRICS_Add( MetricSample *pSample, MetricPhase phase, uint64_t us );
+void METRICS_Phase( Metrics *pMetrics, MetricPhase phase, uint64_t us );
+void METRICS_Record( Metrics *pMetrics,
+                     MetricSample *pSample,
+                     int result,
+                     bool skipped );
+uint64_t METRICS_Percentile( Metrics *pMetrics,
+                             MetricPhase phase,
+                             unsigned int percent );
+int METRICS_Export( Metrics *pMetrics,
+                    VARSERVER_HANDLE hVarServer,
+                    const char *prefix );
+int METRICS_Print( Metrics *pMetrics,
+                   VARSERVER_HANDLE hVarServer,
+                   int32_t id );
+int METRICS_Format( Metrics *pMetrics, char *buf, size_t len );
+void METRICS_Free( Metrics *pMetrics );
+
+#endif
@@ -0,0 +1,108 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef OUTBUF_H
+#define OUTBUF_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*==============================================================================
+        Definitions
+==============================================================================*/
+
+/*! default output buffer size (flush threshold) in bytes */
+#define OUTBUF_DEFAULT_SIZE ( 256 * 1024 )
+
+/*! minimum output buffer size in bytes */
+#define OUTBUF_MIN_SIZE ( 4 * 1024 )
+
+/*==============================================================================
+        Type Definitions
+==============================================================================*/
+
+/*! buffered output writer */
+typedef struct _OutBuf
+{
+    /*! output file descriptor */
+    int fd;
+
+    /*! pointer to the output buffer */
+    char *buf;
+
+    /*! size of the output buffer.  This is also the flush threshold */
+    size_t size;
+
+    /*! number of bytes currently held in the output buffer */
+    size_t len;
+
+    /*! first error encountered since the output was attached */
+    int error;
+
+    /*! running hash of the output since the output was attached */
+    uint64_t hash;
+
+    /*! number of bytes of output since the output was attached */
+    uint64_t count;
+
+    /*! number of bytes written to the file descriptor */
+    uint64_t bytes;
+
+    /*! number of write system calls issued */
+    uint64_t syscalls;
+
+    /*! total time spent writing to the file descriptor (in microseconds) */
+    uint64_t writeTimeUs;
+
+    /*! indicates writeback is started as soon as data is written */
+    bool writeback;
+
+    /*! file offset of the next data to be written */
+    uint64_t offset;
+
+} OutBuf;
+
+/*==============================================================================
+        Public Function Declarations
+==============================================================================*/
+
+int OUTBUF_Init( OutBuf *pOutBuf, size_t size );
+void OUTBUF_Attach( OutBuf *pOutBuf, int fd );
+int OUTBUF_Write( OutBuf *pOutBuf, const void *data, size_t len );
+int OUTBUF_Puts( OutBuf *pOutBuf, const char *str );
+int OUTBUF_Annotate( OutBuf *pOutBuf, const char *str );
+char *OUTBUF_Reserve( OutBuf *pOutBuf, size_t len );
+void OUTBUF_Commit( OutBuf *pOutBuf, size_t len );
+int OUTBUF_Flush( OutBuf *pOutBuf );
+void OUTBUF_Consume( OutBuf *pOutBuf, size_t len );
+void OUTBUF_Discard( OutBuf *pOutBuf );
+void OUTBUF_SetWriteback( OutBuf *pOutBuf, bool enable, uint64_t offset );
+void OUTBUF_Free( OutBuf *pOutBuf );
+
+#endif
@@ -0,0 +1,53 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdint.h>
+#include <varserver/varserver.h>
+#include "savesvc.h"
+
+/*==============================================================================
+        Definitions
+==============================================================================*/
+
+/*! mask selecting all of the profiles of a save service state */
+#define PROFILE_ALL( n ) \
+    ( ( (n) >= MAX_PROFILES ) ? ~(uint64_t)0 : ( ( (uint64_t)1 << (n) ) - 1 ) )
+
+/*==============================================================================
+        Public Function Declarations
+==============================================================================*/
+
+int PROFILE_Add( SaveSvcState *pState, SaveSvcState *pProfile );
+int PROFILE_Load( SaveSvcState *pState, const char *filename );
+uint64_t PROFILE_Triggered( SaveSvcState *pState, VAR_HANDLE hVar );
+void PROFILE_Free( SaveSvcState *pState );
+
+#endif
@@ -0,0 +1,123 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef RESTORE_H
+#define RESTORE_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <varserver/varserver.h>
+
+/*==============================================================================
+        Definitions
+==============================================================================*/
+
+/*! default number of variables set per batch */
+#define RESTORE_DEFAULT_BATCH_SIZE ( 256 )
+
+/*==============================================================================
+        Type Definitions
+==============================================================================*/
+
+/*! resolved variable handle */
+typedef struct _RestoreHandle
+{
+    /*! hash of the variable name.  Zero for an unused entry */
+    uint64_t hash;
+
+    /*! variable name, including any instance identifier prefix */
+    char *name;
+
+    /*! variable handle, or VAR_INVALID if the variable does not exist */
+    VAR_HANDLE hVar;
+
+    /*! variable type */
+    VarType type;
+
+} RestoreHandle;
+
+/*! restore state */
+typedef struct _RestoreState
+{
+    /*! variable server handle */
+    VARSERVER_HANDLE hVarServer;
+
+    /*! verbose output */
+    bool verbose;
+
+    /*! resolved handle cache */
+    RestoreHandle *cache;
+
+    /*! number of handle cache entries */
+    size_t cacheSize;
+
+    /*! number of handle cache entries in use */
+    size_t cacheCount;
+
+    /*! handles of the variables in the pending batch */
+    VAR_HANDLE *handles;
+
+    /*! values of the variables in the pending batch */
+    VarObject *values;
+
+    /*! maximum number of variables in a batch */
+    size_t batchsize;
+
+    /*! number of variables in the pending batch */
+    size_t pending;
+
+    /*! number of variables set */
+    uint64_t set;
+
+    /*! number of variables which could not be set */
+    uint64_t failed;
+
+    /*! number of variable names resolved with the variable server */
+    uint64_t lookups;
+
+    /*! number of set calls made to the variable server */
+    uint64_t calls;
+
+    /*! indicates the files of a manifest are being restored */
+    bool manifest;
+
+    /*! name of the file restored before the current one, or NULL */
+    const char *previous;
+
+} RestoreState;
+
+/*==============================================================================
+        Public Function Declarations
+==============================================================================*/
+
+int RESTORE_Init( RestoreState *pState, VARSERVER_HANDLE hVarServer );
+int RESTORE_File( RestoreState *pState, const char *filename );
+void RESTORE_Free( RestoreState *pState );
+
+#endif
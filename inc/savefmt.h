@@ -0,0 +1,175 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef SAVEFMT_H
+#define SAVEFMT_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "outbuf.h"
+#include "snapshot.h"
+
+/*==============================================================================
+        Definitions
+==============================================================================*/
+
+/*! binary configuration file magic number */
+#define SAVEFMT_MAGIC "SVCB"
+
+/*! binary configuration file format version */
+#define SAVEFMT_VERSION ( 1 )
+
+/*! byte order marker, used to detect a file written on a foreign host */
+#define SAVEFMT_BYTE_ORDER ( 0x01020304 )
+
+/*! text configuration file title */
+#define CONFIG_TITLE "@config User Settings\n"
+
+/*! text configuration file generation marker comment */
+#define GENERATION_COMMENT "# generation "
+
+/*! journal base comment, followed by the hash of the configuration file
+    the journal is replayed over */
+#define JOURNAL_BASE_COMMENT "# base "
+
+/*! size of the original file header, without the generation marker.
+    Files with this header are still read, with a zero generation */
+#define SAVEFMT_MIN_HEADER_SIZE ( offsetof( SaveFmtHeader, generation ) )
+
+/*==============================================================================
+        Type Definitions
+==============================================================================*/
+
+/*! binary configuration file value types.  These are independent of the
+    variable server type enumeration so the file format is stable */
+typedef enum _SaveFmtType
+{
+    SAVEFMT_TYPE_INVALID = 0,
+    SAVEFMT_TYPE_UINT16,
+    SAVEFMT_TYPE_INT16,
+    SAVEFMT_TYPE_UINT32,
+    SAVEFMT_TYPE_INT32,
+    SAVEFMT_TYPE_UINT64,
+    SAVEFMT_TYPE_INT64,
+    SAVEFMT_TYPE_FLOAT,
+    SAVEFMT_TYPE_STR,
+    SAVEFMT_TYPE_BLOB
+
+} SaveFmtType;
+
+/*! binary configuration file header.  The count, length, checksum,
+    and generation are zero while the file is being written, and are
+    filled in by SAVEFMT_End.  Fields are only ever added to the end of
+    the header, so readers use headerSize to find the records */
+typedef struct _SaveFmtHeader
+{
+    /*! magic number: SAVEFMT_MAGIC */
+    char magic[4];
+
+    /*! file format version: SAVEFMT_VERSION */
+    uint16_t version;
+
+    /*! size of this header in bytes.  Records start at this offset */
+    uint16_t headerSize;
+
+    /*! byte order marker: SAVEFMT_BYTE_ORDER */
+    uint32_t byteOrder;
+
+    /*! number of records */
+    uint32_t count;
+
+    /*! length of the record data in bytes */
+    uint64_t length;
+
+    /*! FNV-1a hash of the record data */
+    uint64_t checksum;
+
+    /*! generation marker of the snapshot the records were written
+        from, or zero if the snapshot has no generation */
+    uint64_t generation;
+
+} SaveFmtHeader;
+
+/*! binary configuration file record header.  The variable name
+    (without a NUL terminator) follows the record header, followed by
+    the value.  Numeric values are stored in their native width,
+    strings include their NUL terminator.  Records are not aligned */
+typedef struct _SaveFmtRecord
+{
+    /*! value type: SaveFmtType */
+    uint8_t type;
+
+    /*! reserved: zero */
+    uint8_t reserved;
+
+    /*! length of the variable name */
+    uint16_t namelen;
+
+    /*! variable instance identifier */
+    uint32_t instanceID;
+
+    /*! length of the value in bytes */
+    uint32_t len;
+
+} SaveFmtRecord;
+
+/*! binary configuration file writer */
+typedef struct _SaveFmtWriter
+{
+    /*! buffered output the records are written to */
+    OutBuf *pOut;
+
+    /*! number of records written */
+    uint32_t count;
+
+    /*! number of bytes of record data written */
+    uint64_t length;
+
+    /*! running hash of the record data */
+    uint64_t checksum;
+
+    /*! generation marker to record in the file header */
+    uint64_t generation;
+
+} SaveFmtWriter;
+
+/*==============================================================================
+        Public Function Declarations
+==============================================================================*/
+
+int SAVEFMT_Begin( SaveFmtWriter *pWriter, OutBuf *pOut );
+int SAVEFMT_Write( SaveFmtWriter *pWriter, SnapshotRecord *pRecord );
+int SAVEFMT_End( SaveFmtWriter *pWriter, int fd );
+int SAVEFMT_Load( const char *filename, Snapshot *pSnapshot );
+int SAVEFMT_HashFile( const char *filename,
+                      uint64_t *hash,
+                      uint64_t *size,
+                      uint64_t *generation );
+
+#endif
@@ -0,0 +1,467 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef SAVESVC_H
+#define SAVESVC_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <varserver/varserver.h>
+#include "outbuf.h"
+#include "vartab.h"
+#include "snapshot.h"
+#include "savefmt.h"
+#include "dirtyset.h"
+#include "history.h"
+#include "metrics.h"
+#include "uring.h"
+#include "filter.h"
+#include "arena.h"
+
+/*==============================================================================
+        Definitions
+==============================================================================*/
+
+/*! default journal size (in bytes) which triggers a compaction */
+#define DEFAULT_COMPACT_SIZE ( 64 * 1024 )
+
+/*! default journal to base file size ratio (percent) which triggers
+    a compaction */
+#define DEFAULT_COMPACT_RATIO ( 50 )
+
+/*! number of snapshot buffers */
+#define SNAPSHOT_BUFFERS ( 2 )
+
+/*! maximum number of save profiles */
+#define MAX_PROFILES ( 64 )
+
+/*! size of the buffer for the formatted save statistics */
+#define STATS_TEXT_SIZE ( 512 )
+
+/*! default number of worker threads serializing the output shards */
+#define DEFAULT_SHARD_WORKERS ( 3 )
+
+/*! largest text representation of a value which will be saved */
+#define MAX_VALUE_TEXT_SIZE ( 64 * 1024 * 1024 )
+
+/*==============================================================================
+        Type Definitions
+==============================================================================*/
+
+/*! durability modes */
+typedef enum _durability
+{
+    /*! no explicit syncing of the output */
+    DURABILITY_NONE = 0,
+
+    /*! fdatasync the output before it is committed */
+    DURABILITY_FDATASYNC,
+
+    /*! fdatasync the output, and fsync the directory after the commit */
+    DURABILITY_DIRSYNC,
+
+    /*! start writeback as the output is written, then fdatasync the
+        output and fsync the directory after the commit */
+    DURABILITY_RANGE
+
+} Durability;
+
+/*! configuration file formats */
+typedef enum _saveFormat
+{
+    /*! text format compatible with the loadconfig utility */
+    FORMAT_TEXT = 0,
+
+    /*! binary format with typed values (see savefmt.h) */
+    FORMAT_BINARY
+
+} SaveFormat;
+
+/*! save statistics */
+typedef struct _saveSvcStats
+{
+    /*! number of saves performed */
+    uint64_t saves;
+
+    /*! number of saves which failed */
+    uint64_t failures;
+
+    /*! number of saves skipped because the output was unchanged */
+    uint64_t skipped;
+
+    /*! number of output data syncs */
+    uint64_t syncs;
+
+    /*! total time spent in output data syncs (in microseconds) */
+    uint64_t syncTimeUs;
+
+    /*! longest output data sync (in microseconds) */
+    uint64_t syncMaxUs;
+
+    /*! number of directory syncs */
+    uint64_t dirSyncs;
+
+    /*! total time spent in directory syncs (in microseconds) */
+    uint64_t dirSyncTimeUs;
+
+} SaveSvcStats;
+
+/*! snapshot buffer states */
+typedef enum _snapBufState
+{
+    /*! the snapshot buffer is not in use */
+    SNAPBUF_FREE = 0,
+
+    /*! the snapshot buffer is being filled by the main thread */
+    SNAPBUF_FILLING,
+
+    /*! the snapshot buffer is waiting for the writer thread */
+    SNAPBUF_READY,
+
+    /*! the snapshot buffer is being written by the writer thread */
+    SNAPBUF_WRITING,
+
+    /*! the snapshot buffer has been committed, and the main thread is
+        to clear the dirty flags of its variables */
+    SNAPBUF_COMMITTED
+
+} SnapBufState;
+
+/*! save service state */
+typedef struct _savesvcState
+{
+    /*! handle to the variable server */
+    VARSERVER_HANDLE hVarServer;
+
+    /*! output file name */
+    char *filename;
+
+    /*! trigger variable name */
+    char *triggervar;
+
+    /*! handle to the trigger variable */
+    VAR_HANDLE hTriggerVar;
+
+    /*! filter selecting the variables to save.  An empty filter saves
+        all of the dirty variables */
+    Filter filter;
+
+    /*! number of leading variable name components which select the
+        output shard, or zero to save to a single output file */
+    unsigned int shardDepth;
+
+    /*! number of worker threads serializing the output shards */
+    size_t shardWorkers;
+
+    /*! output shards, or NULL if the output is not sharded */
+    struct _shardSet *shards;
+
+    /*! save profile file name, or NULL for a single profile given by
+        the trigger variable and output file name */
+    char *profilefile;
+
+    /*! save profiles served by this instance.  Each profile is a
+        separate state with its own trigger, output file, and filter.
+        The first profile may be this state itself */
+    struct _savesvcState **profiles;
+
+    /*! number of save profiles */
+    size_t nprofiles;
+
+    /*! verbose output flag */
+    bool verbose;
+
+    /*! output file descriptor */
+    int fd;
+
+    /*! temporary output file name */
+    char tmpfile[BUFSIZ];
+
+    /*! indicates the output file is an anonymous O_TMPFILE inode */
+    bool anonymous;
+
+    /*! indicates the temporary output file name exists */
+    bool named;
+
+    /*! indicates O_TMPFILE is not supported for the output directory */
+    bool noTmpfile;
+
+    /*! size of the output buffer (flush threshold) */
+    size_t bufsize;
+
+    /*! buffered output writer */
+    OutBuf out;
+
+    /*! journal mode flag */
+    bool journal;
+
+    /*! journal file name */
+    char journalfile[BUFSIZ];
+
+    /*! journal size (in bytes) which triggers a compaction */
+    size_t compactSize;
+
+    /*! journal size as a percentage of the base file size which
+        triggers a compaction */
+    unsigned int compactRatio;
+
+    /*! size of the base configuration file */
+    uint64_t baseSize;
+
+    /*! size of the journal file */
+    uint64_t journalSize;
+
+    /*! table of the interned variable keys and most recently saved
+        variable values */
+    VarTab saved;
+
+    /*! indicates the saved variable table matches the committed files */
+    bool synced;
+
+    /*! indicates only changed variables are to be written */
+    bool delta;
+
+    /*! number of variables written by the last WriteConfigVars */
+    size_t count;
+
+    /*! quiet time (in milliseconds) required after a trigger before
+        a save is performed */
+    unsigned int debounceMs;
+
+    /*! maximum time (in milliseconds) a save can be deferred after
+        the first pending trigger */
+    unsigned int maxLatencyMs;
+
+    /*! interval (in milliseconds) between automatic saves, or zero
+        to disable automatic saves */
+    unsigned int autosaveMs;
+
+    /*! interval (in milliseconds) between reconciliations of the dirty
+        set with the dirty flags of the variables, or zero to only
+        reconcile before a full save */
+    unsigned int reconcileMs;
+
+    /*! time limit (in milliseconds) for the final save on shutdown, or
+        zero to exit without a final save */
+    unsigned int shutdownMs;
+
+    /*! control socket path, or NULL for no control socket */
+    char *ctlpath;
+
+    /*! indicates the committed file hash and size are known */
+    bool committed;
+
+    /*! hash of the committed configuration file */
+    uint64_t committedHash;
+
+    /*! size of the committed configuration file */
+    uint64_t committedSize;
+
+    /*! indicates the last output matched the committed file */
+    bool unchanged;
+
+    /*! buffer for values converted to text by VAROBJECT_ToString.
+        This is allocated from the save arena, and grows to fit the
+        largest value converted in the save */
+    char *valbuf;
+
+    /*! size of the value text buffer */
+    size_t valbufSize;
+
+    /*! save arena holding the working memory of the current save */
+    Arena arena;
+
+    /*! save statistics */
+    SaveSvcStats stats;
+
+    /*! formatted copy of the save statistics, published by the writer
+        thread under the pipeline lock for the stats command */
+    char statsText[STATS_TEXT_SIZE];
+
+    /*! indicates the next save re-writes the whole configuration file,
+        published by the writer thread under the pipeline lock */
+    bool fullSave;
+
+    /*! name prefix of the exported metric variables, or NULL if the
+        metrics are not exported */
+    char *metricsPrefix;
+
+    /*! save metrics of the service */
+    Metrics metrics;
+
+    /*! pointer to the save metrics shared by all of the profiles, or
+        NULL if the saves are not measured */
+    Metrics *pMetrics;
+
+    /*! measurements of the current save */
+    MetricSample sample;
+
+    /*! io_uring submission queue depth, or zero to commit the output
+        with synchronous system calls */
+    unsigned int ringDepth;
+
+    /*! indicates the output buffers are registered with io_uring */
+    bool ringFixed;
+
+    /*! io_uring instance of the service */
+    URing ring;
+
+    /*! pointer to the io_uring instance used to commit the output, or
+        NULL to commit the output with synchronous system calls */
+    URing *pRing;
+
+    /*! index of the output buffer registered with io_uring plus one,
+        or zero if the output buffer is not registered */
+    unsigned int ringBuf;
+
+    /*! durability mode */
+    Durability durability;
+
+    /*! configuration file format */
+    SaveFormat format;
+
+    /*! indicates per-variable change tracking is enabled */
+    bool track;
+
+    /*! set of variables modified since the last save */
+    DirtySet dirty;
+
+    /*! indicates the dirty flags of the saved variables are cleared
+        once they are committed, rather than retaining every variable
+        which was ever modified */
+    bool clearDirty;
+
+    /*! most recently saved value of every saved variable, used to
+        rebuild the full configuration when dirty flags are cleared */
+    History history;
+
+    /*! indicates the generation marker of each capture is recorded in
+        the output, so the output is known to hold every variable
+        modified before the marker */
+    bool consistent;
+
+    /*! generation marker of the most recent capture, or of the
+        committed configuration file before the first capture */
+    uint64_t generation;
+
+    /*! binary configuration file writer */
+    SaveFmtWriter binary;
+
+    /*! size (in bytes) of each batched variable retrieval */
+    size_t batchsize;
+
+    /*! dedicated writer thread flag */
+    bool pipeline;
+
+    /*! snapshot buffers */
+    Snapshot snapshot[SNAPSHOT_BUFFERS];
+
+    /*! snapshot of the values read back by ClearDirty, retained for
+        re-use by subsequent saves */
+    Snapshot readback;
+
+    /*! snapshot buffer states */
+    SnapBufState snapBufState[SNAPSHOT_BUFFERS];
+
+    /*! writer thread */
+    pthread_t writer;
+
+    /*! indicates the writer thread was started */
+    bool writerStarted;
+
+    /*! indicates the writer thread is to exit once it is idle */
+    bool stop;
+
+    /*! mutex protecting the snapshot buffer states */
+    pthread_mutex_t lock;
+
+    /*! condition signalled when a snapshot buffer is ready */
+    pthread_cond_t ready;
+
+    /*! condition signalled when a snapshot buffer is released */
+    pthread_cond_t idle;
+
+    /*! sequence number of each snapshot buffer's save request */
+    uint64_t snapSeq[SNAPSHOT_BUFFERS];
+
+    /*! profiles (one bit per profile) to save from each snapshot buffer */
+    uint64_t snapProfiles[SNAPSHOT_BUFFERS];
+
+    /*! profiles (one bit per profile) saved from each committed
+        snapshot buffer */
+    uint64_t snapSaved[SNAPSHOT_BUFFERS];
+
+    /*! result of capturing each snapshot buffer */
+    int snapResult[SNAPSHOT_BUFFERS];
+
+    /*! sequence number of the most recent save request */
+    uint64_t requestSeq;
+
+    /*! sequence number of the most recently completed save request */
+    uint64_t completedSeq;
+
+    /*! result of the most recently completed save request */
+    int completedResult;
+
+    /*! event file descriptor signalled by the writer thread when a
+        save request is completed */
+    int donefd;
+
+} SaveSvcState;
+
+/*==============================================================================
+        Public Function Declarations
+==============================================================================*/
+
+int CaptureDirtyVars( SaveSvcState *pState, Snapshot *pSnapshot );
+int InitTracking( SaveSvcState *pState );
+int ReconcileTracking( SaveSvcState *pState, size_t *pMarked );
+bool HasDirtyVars( SaveSvcState *pState );
+bool FullSaveDue( SaveSvcState *pState );
+int InitHistory( SaveSvcState *pState );
+int ClearDirty( SaveSvcState *pState, Snapshot *pSnapshot, uint64_t profiles );
+int SaveConfig( SaveSvcState *pState, Snapshot *pSnapshot );
+int InitJournal( SaveSvcState *pState );
+int InitConfig( SaveSvcState *pState );
+int WriteConfig( SaveSvcState *pState, Snapshot *pSnapshot );
+int WriteConfigVars( SaveSvcState *pState, Snapshot *pSnapshot );
+int FinalizeConfig( SaveSvcState *pState );
+void DiscardConfig( SaveSvcState *pState );
+int SaveText( SaveSvcState *pState, const char *text );
+int HashFile( const char *filename,
+              uint64_t *hash,
+              uint64_t *size,
+              uint64_t *generation );
+int ParseDurability( const char *name, Durability *pDurability );
+int ParseFormat( const char *name, SaveFormat *pFormat );
+int HashConfig( SaveSvcState *pState );
+int FormatStats( SaveSvcState *pState, char *buf, size_t len );
+
+#endif
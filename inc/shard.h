@@ -0,0 +1,118 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef SHARD_H
+#define SHARD_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "savesvc.h"
+#include "snapshot.h"
+#include "workpool.h"
+
+/*==============================================================================
+        Definitions
+==============================================================================*/
+
+/*! first line of a shard manifest file */
+#define SHARD_MANIFEST_HEADER "@manifest"
+
+/*! largest number of variable name components in a shard key */
+#define SHARD_MAX_DEPTH ( 32 )
+
+/*! largest number of shard worker threads */
+#define SHARD_MAX_WORKERS ( 64 )
+
+/*! initial size of a shard snapshot buffer */
+#define SHARD_SNAPSHOT_SIZE ( 4096 )
+
+/*==============================================================================
+        Type Definitions
+==============================================================================*/
+
+/*! output shard holding the variables with a common name prefix */
+typedef struct _shard
+{
+    /*! variable name prefix selecting the shard */
+    char *key;
+
+    /*! length of the variable name prefix */
+    size_t keylen;
+
+    /*! shard output state, with the shard file name */
+    SaveSvcState state;
+
+    /*! variables of the shard from the current save */
+    Snapshot snapshot;
+
+    /*! hash of the variables of the last committed save */
+    uint64_t hash;
+
+    /*! indicates the hash of the last committed save is known */
+    bool hashed;
+
+    /*! result of the current save of the shard */
+    int result;
+
+} Shard;
+
+/*! set of output shards of a save profile */
+typedef struct _shardSet
+{
+    /*! shards, sorted by name prefix */
+    Shard **shards;
+
+    /*! number of shards */
+    size_t count;
+
+    /*! most recently selected shard */
+    Shard *last;
+
+    /*! worker threads serializing the shards */
+    WorkPool pool;
+
+    /*! manifest text of the current save */
+    char *text;
+
+    /*! size of the manifest text buffer */
+    size_t textSize;
+
+    /*! committed manifest text, or NULL if there is none */
+    char *listed;
+
+} ShardSet;
+
+/*==============================================================================
+        Public Function Declarations
+==============================================================================*/
+
+int SHARD_Init( SaveSvcState *pState );
+int SHARD_Save( SaveSvcState *pState, Snapshot *pSnapshot );
+void SHARD_Free( SaveSvcState *pState );
+
+#endif
@@ -0,0 +1,149 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <varserver/varserver.h>
+#include <varserver/varquery.h>
+
+/*==============================================================================
+        Definitions
+==============================================================================*/
+
+/*! default initial size of a snapshot buffer */
+#define SNAPSHOT_DEFAULT_SIZE ( 64 * 1024 )
+
+/*! default size (in bytes) of a batched variable retrieval */
+#define SNAPSHOT_DEFAULT_BATCH_SIZE ( 64 * 1024 )
+
+/*==============================================================================
+        Type Definitions
+==============================================================================*/
+
+/*! snapshot of a single variable.  The NUL terminated variable name
+    immediately follows the record, and is followed by the value
+    data for string and blob variables */
+typedef struct _SnapshotRecord
+{
+    /*! handle of the variable */
+    VAR_HANDLE hVar;
+
+    /*! instance identifier of the variable */
+    uint32_t instanceID;
+
+    /*! type of the variable */
+    VarType type;
+
+    /*! length of the variable name (excluding the NUL terminator) */
+    uint32_t namelen;
+
+    /*! length of the string or blob value data */
+    uint32_t len;
+
+    /*! value of a non-string, non-blob variable */
+    VarData val;
+
+} SnapshotRecord;
+
+/*! function selecting the records kept by SNAPSHOT_Select */
+typedef bool (*SnapshotSelectFn)( void *arg, const char *name );
+
+/*! snapshot of a set of variables held in a contiguous buffer */
+typedef struct _Snapshot
+{
+    /*! pointer to the record buffer */
+    char *buf;
+
+    /*! size of the record buffer */
+    size_t size;
+
+    /*! number of bytes of the record buffer in use */
+    size_t len;
+
+    /*! number of records in the snapshot */
+    size_t count;
+
+    /*! buffer values are retrieved into before they are added */
+    char *value;
+
+    /*! size of the value buffer */
+    size_t valueSize;
+
+    /*! generation marker taken when the snapshot capture started, or
+        zero if the snapshot has no generation */
+    uint64_t generation;
+
+} Snapshot;
+
+/*==============================================================================
+        Public Function Declarations
+==============================================================================*/
+
+int SNAPSHOT_Init( Snapshot *pSnapshot, size_t size );
+void SNAPSHOT_Reset( Snapshot *pSnapshot );
+int SNAPSHOT_Add( Snapshot *pSnapshot,
+                  VAR_HANDLE hVar,
+                  uint32_t instanceID,
+                  const char *name,
+                  VarObject *pVarObject );
+int SNAPSHOT_Copy( Snapshot *pSnapshot, SnapshotRecord *pRecord );
+int SNAPSHOT_Get( Snapshot *pSnapshot,
+                  VARSERVER_HANDLE hVarServer,
+                  VAR_HANDLE hVar,
+                  uint32_t instanceID,
+                  const char *name );
+int SNAPSHOT_Capture( Snapshot *pSnapshot,
+                      VARSERVER_HANDLE hVarServer,
+                      VarQuery *pQuery,
+                      size_t batchsize );
+size_t SNAPSHOT_Select( Snapshot *pSnapshot,
+                        SnapshotSelectFn selectFn,
+                        void *arg );
+size_t SNAPSHOT_RecordSize( size_t namelen, size_t len );
+SnapshotRecord *SNAPSHOT_First( Snapshot *pSnapshot );
+SnapshotRecord *SNAPSHOT_Next( Snapshot *pSnapshot, SnapshotRecord *pRecord );
+char *SNAPSHOT_Name( SnapshotRecord *pRecord );
+void *SNAPSHOT_Data( SnapshotRecord *pRecord );
+void SNAPSHOT_Free( Snapshot *pSnapshot );
+
+#ifdef SAVESVC_VAR_GETBATCH
+/* Batched variable retrieval.  This is not yet part of the variable
+   server client library, so it is only used when the service is built
+   with SAVESVC_VAR_GETBATCH.  See SNAPSHOT_Capture for its contract. */
+int VAR_GetBatch( VARSERVER_HANDLE hVarServer,
+                  VarQuery *query,
+                  void *buf,
+                  size_t *len,
+                  size_t *count );
+#endif
+
+#endif
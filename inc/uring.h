@@ -0,0 +1,149 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef URING_H
+#define URING_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/uio.h>
+
+/*==============================================================================
+        Definitions
+==============================================================================*/
+
+/*! minimum submission queue depth, which holds a full commit chain */
+#define URING_MIN_DEPTH ( 4 )
+
+/*! largest submission queue depth supported by the kernel */
+#define URING_MAX_DEPTH ( 32768 )
+
+/*! default submission queue depth */
+#define URING_DEFAULT_DEPTH ( 8 )
+
+/*==============================================================================
+        Type Definitions
+==============================================================================*/
+
+/*! io_uring instance */
+typedef struct _uring
+{
+    /*! io_uring file descriptor */
+    int fd;
+
+    /*! first error which made the ring unusable */
+    int error;
+
+    /*! submission queue ring mapping */
+    void *sqRing;
+
+    /*! size of the submission queue ring mapping */
+    size_t sqRingSize;
+
+    /*! completion queue ring mapping.  This may be the submission
+        queue ring mapping */
+    void *cqRing;
+
+    /*! size of the completion queue ring mapping */
+    size_t cqRingSize;
+
+    /*! submission queue entries */
+    struct io_uring_sqe *sqes;
+
+    /*! size of the submission queue entries mapping */
+    size_t sqesSize;
+
+    /*! submission queue head (updated by the kernel) */
+    unsigned int *sqHead;
+
+    /*! submission queue tail */
+    unsigned int *sqTail;
+
+    /*! submission queue index mask */
+    unsigned int sqMask;
+
+    /*! submission queue index array */
+    unsigned int *sqArray;
+
+    /*! completion queue head */
+    unsigned int *cqHead;
+
+    /*! completion queue tail (updated by the kernel) */
+    unsigned int *cqTail;
+
+    /*! completion queue index mask */
+    unsigned int cqMask;
+
+    /*! completion queue entries */
+    struct io_uring_cqe *cqes;
+
+    /*! number of submission queue entries */
+    unsigned int entries;
+
+    /*! number of entries queued and not yet submitted */
+    unsigned int queued;
+
+    /*! indicates linkat operations are supported */
+    bool linkat;
+
+    /*! number of registered buffers */
+    unsigned int nbufs;
+
+} URing;
+
+/*==============================================================================
+        Public Function Declarations
+==============================================================================*/
+
+int URING_Init( URing *pRing, unsigned int depth );
+int URING_RegisterBuffers( URing *pRing,
+                           const struct iovec *iov,
+                           unsigned int count );
+int URING_Write( URing *pRing,
+                 int fd,
+                 const void *buf,
+                 size_t len,
+                 uint64_t offset,
+                 unsigned int bufIndex,
+                 uint64_t tag );
+int URING_Fdatasync( URing *pRing, int fd, uint64_t tag );
+int URING_LinkAt( URing *pRing,
+                  const char *oldpath,
+                  const char *newpath,
+                  int flags,
+                  uint64_t tag );
+int URING_RenameAt( URing *pRing,
+                    const char *oldpath,
+                    const char *newpath,
+                    uint64_t tag );
+int URING_Run( URing *pRing, int32_t *results, unsigned int count );
+void URING_Discard( URing *pRing );
+void URING_Free( URing *pRing );
+
+#endif
@@ -0,0 +1,52 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef VARFMT_H
+#define VARFMT_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <varserver/varserver.h>
+
+/*==============================================================================
+        Definitions
+==============================================================================*/
+
+/*! maximum length of a value formatted by VARFMT_Value */
+#define VARFMT_MAX_LEN ( 32 )
+
+/*==============================================================================
+        Public Function Declarations
+==============================================================================*/
+
+size_t VARFMT_Unsigned( char *buf, uint64_t val );
+size_t VARFMT_Signed( char *buf, int64_t val );
+size_t VARFMT_Float( char *buf, float val );
+size_t VARFMT_Value( char *buf, VarType type, const VarData *pVal );
+
+#endif
@@ -0,0 +1,130 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef VARTAB_H
+#define VARTAB_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <varserver/varserver.h>
+
+/*==============================================================================
+        Definitions
+==============================================================================*/
+
+/*! default number of slots in a saved variable table */
+#define VARTAB_DEFAULT_SIZE ( 1024 )
+
+/*! largest value (in bytes) kept in a saved variable table.  Only
+    the hash of a larger value is kept */
+#define VARTAB_MAX_VALUE_SIZE ( 256 )
+
+/*==============================================================================
+        Type Definitions
+==============================================================================*/
+
+/*! saved variable table entry */
+typedef struct _VarTabEntry
+{
+    /*! handle of the variable, or VAR_INVALID for an unused slot */
+    VAR_HANDLE hVar;
+
+    /*! instance identifier of the variable */
+    uint32_t instanceID;
+
+    /*! length of the variable key */
+    uint32_t keylen;
+
+    /*! length of the variable name at the end of the variable key */
+    uint32_t namelen;
+
+    /*! length of the last saved value */
+    uint32_t vallen;
+
+    /*! size of the text buffer */
+    uint32_t textSize;
+
+    /*! indicates a saved value is recorded */
+    bool saved;
+
+    /*! indicates the saved value is kept as text after the key, rather
+        than as a hash */
+    bool cached;
+
+    /*! hash of the last saved value */
+    uint64_t valhash;
+
+    /*! pre-formatted "key=" text: the variable name with optional [id]
+        prefix, followed by '=' and the last saved value if it is no
+        larger than VARTAB_MAX_VALUE_SIZE */
+    char *text;
+
+} VarTabEntry;
+
+/*! table of the variable keys and most recently saved values,
+    keyed by variable handle and instance identifier */
+typedef struct _VarTab
+{
+    /*! array of table slots */
+    VarTabEntry *entries;
+
+    /*! number of table slots (always a power of two) */
+    size_t size;
+
+    /*! number of occupied table slots */
+    size_t count;
+
+    /*! total size of the entry text buffers */
+    size_t textBytes;
+
+} VarTab;
+
+/*==============================================================================
+        Public Function Declarations
+==============================================================================*/
+
+int VARTAB_Init( VarTab *pVarTab, size_t size );
+VarTabEntry *VARTAB_Intern( VarTab *pVarTab,
+                            VAR_HANDLE hVar,
+                            uint32_t instanceID,
+                            const char *name,
+                            size_t namelen );
+bool VARTAB_Changed( VarTab *pVarTab,
+                     VarTabEntry *pEntry,
+                     const char *value,
+                     size_t len );
+bool VARTAB_Update( VarTab *pVarTab,
+                    VarTabEntry *pEntry,
+                    const char *value,
+                    size_t len );
+void VARTAB_Clear( VarTab *pVarTab );
+size_t VARTAB_Memory( VarTab *pVarTab );
+void VARTAB_Free( VarTab *pVarTab );
+
+#endif
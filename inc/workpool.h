@@ -0,0 +1,94 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef WORKPOOL_H
+#define WORKPOOL_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+/*==============================================================================
+        Type Definitions
+==============================================================================*/
+
+/*! work item function.  This is called with the work argument and the
+    index of the work item to perform */
+typedef void (*WorkFn)( void *arg, size_t idx );
+
+/*! pool of worker threads */
+typedef struct _WorkPool
+{
+    /*! worker threads */
+    pthread_t *threads;
+
+    /*! number of worker threads */
+    size_t nthreads;
+
+    /*! mutex protecting the work state */
+    pthread_mutex_t lock;
+
+    /*! condition signalled when work is started or the pool is stopped */
+    pthread_cond_t start;
+
+    /*! condition signalled when the last worker has finished */
+    pthread_cond_t done;
+
+    /*! work item function */
+    WorkFn fn;
+
+    /*! work item function argument */
+    void *arg;
+
+    /*! number of work items */
+    size_t count;
+
+    /*! index of the next work item to be performed */
+    size_t next;
+
+    /*! number of worker threads still performing work items */
+    size_t active;
+
+    /*! incremented each time work is started */
+    uint64_t generation;
+
+    /*! indicates the worker threads are to exit */
+    bool stop;
+
+} WorkPool;
+
+/*==============================================================================
+        Public Function Declarations
+==============================================================================*/
+
+int WORKPOOL_Init( WorkPool *pPool, size_t nthreads );
+int WORKPOOL_Run( WorkPool *pPool, WorkFn fn, void *arg, size_t count );
+void WORKPOOL_Free( WorkPool *pPool );
+
+#endif
@@ -0,0 +1,267 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+
+/*!
+ * @defgroup arena Save Arena
+ * @brief Bump allocator for the working memory of a save
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file arena.c
+
+    Save Arena
+
+    The Save Arena holds the transient working memory of a save.
+    Memory is allocated by advancing a pointer through the current
+    block, and is only released all at once when the arena is reset
+    after the save is finalized.
+
+    When the current block is full, another block is allocated from
+    the heap.  On reset, an arena which needed more than one block is
+    replaced by a single block large enough for the most memory used
+    by any save, so a save which uses no more than the previous saves
+    does not allocate from the heap at all.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdlib.h>
+#include <stdint.h>
+#include "arena.h"
+
+/*==============================================================================
+       Definitions
+==============================================================================*/
+
+/*! size of a block header, rounded up to keep the block memory aligned */
+#define ARENA_HEADER_SIZE \
+    ( ( sizeof( ArenaBlock ) + ARENA_ALIGNMENT - 1 ) & \
+      ~( (size_t)ARENA_ALIGNMENT - 1 ) )
+
+/*==============================================================================
+       Function declarations
+==============================================================================*/
+static ArenaBlock *NewBlock( Arena *pArena, size_t size );
+static void FreeBlocks( Arena *pArena );
+
+/*==============================================================================
+       Function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  ARENA_Alloc                                                               */
+/*!
+    Allocate memory from an arena
+
+    The ARENA_Alloc function allocates aligned memory from the current
+    arena block, adding a block if it is full.  The memory remains
+    valid until the arena is reset.
+
+    @param[in,out]
+        pArena
+            pointer to the arena
+
+    @param[in]
+        size
+            number of bytes to allocate
+
+    @retval pointer to the allocated memory
+    @retval NULL if memory allocation failed
+
+==============================================================================*/
+void *ARENA_Alloc( Arena *pArena, size_t size )
+{
+    ArenaBlock *pBlock;
+    void *p = NULL;
+    size_t len;
+
+    if ( ( pArena != NULL ) &&
+         ( size > 0 ) &&
+         ( size <= SIZE_MAX - ARENA_DEFAULT_SIZE ) )
+    {
+        len = ( size + ARENA_ALIGNMENT - 1 ) & ~( (size_t)ARENA_ALIGNMENT - 1 );
+
+        pBlock = pArena->blocks;
+        if ( ( pBlock == NULL ) ||
+             ( pBlock->size - pBlock->used < len ) )
+        {
+            pBlock = NewBlock( pArena, len );
+        }
+
+        if ( pBlock != NULL )
+        {
+            p = (char *)pBlock + ARENA_HEADER_SIZE + pBlock->used;
+            pBlock->used += len;
+            pArena->used += len;
+        }
+    }
+
+    return p;
+}
+
+/*============================================================================*/
+/*  ARENA_Reset                                                               */
+/*!
+    Release all of the memory allocated from an arena
+
+    The ARENA_Reset function records the memory used since the last
+    reset, and makes all of the arena memory available again.  If more
+    than one block was needed, the blocks are replaced by a single block
+    which can hold the most memory used between resets.
+
+    @param[in,out]
+        pArena
+            pointer to the arena
+
+==============================================================================*/
+void ARENA_Reset( Arena *pArena )
+{
+    if ( pArena != NULL )
+    {
+        if ( pArena->used > pArena->peak )
+        {
+            pArena->peak = pArena->used;
+        }
+
+        if ( ( pArena->blocks != NULL ) &&
+             ( pArena->blocks->next != NULL ) )
+        {
+            /* coalesce the blocks to fit the peak usage */
+            FreeBlocks( pArena );
+            (void)NewBlock( pArena, pArena->peak );
+        }
+
+        if ( pArena->blocks != NULL )
+        {
+            pArena->blocks->used = 0;
+        }
+
+        pArena->used = 0;
+    }
+}
+
+/*============================================================================*/
+/*  ARENA_Free                                                                */
+/*!
+    Release the memory blocks of an arena
+
+    @param[in,out]
+        pArena
+            pointer to the arena
+
+==============================================================================*/
+void ARENA_Free( Arena *pArena )
+{
+    if ( pArena != NULL )
+    {
+        FreeBlocks( pArena );
+        pArena->used = 0;
+    }
+}
+
+/*============================================================================*/
+/*  NewBlock                                                                  */
+/*!
+    Add a block to an arena
+
+    The NewBlock function allocates a block which can hold at least
+    the requested number of bytes, and makes it the current block.
+    Blocks are at least ARENA_DEFAULT_SIZE, and at least as large as
+    the arena already is, so the number of blocks grows logarithmically
+    with the arena size.
+
+    @param[in,out]
+        pArena
+            pointer to the arena
+
+    @param[in]
+        len
+            number of bytes the block must hold
+
+    @retval pointer to the new block
+    @retval NULL if memory allocation failed
+
+==============================================================================*/
+static ArenaBlock *NewBlock( Arena *pArena, size_t len )
+{
+    ArenaBlock *pBlock;
+    size_t size = ARENA_DEFAULT_SIZE;
+
+    if ( size < pArena->size )
+    {
+        size = pArena->size;
+    }
+
+    if ( size < len )
+    {
+        size = len;
+    }
+
+    pBlock = malloc( ARENA_HEADER_SIZE + size );
+    if ( pBlock != NULL )
+    {
+        pBlock->next = pArena->blocks;
+        pBlock->size = size;
+        pBlock->used = 0;
+        pArena->blocks = pBlock;
+        pArena->size += size;
+        pArena->heapAllocs++;
+    }
+
+    return pBlock;
+}
+
+/*============================================================================*/
+/*  FreeBlocks                                                                */
+/*!
+    Release all of the blocks of an arena
+
+    @param[in,out]
+        pArena
+            pointer to the arena
+
+==============================================================================*/
+static void FreeBlocks( Arena *pArena )
+{
+    ArenaBlock *pBlock;
+
+    while ( pArena->blocks != NULL )
+    {
+        pBlock = pArena->blocks;
+        pArena->blocks = pBlock->next;
+        free( pBlock );
+    }
+
+    pArena->size = 0;
+}
+
+/*! @}
+ * end of arena group */
@@ -0,0 +1,237 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup control Control Socket
+ * @brief Local control socket for the Save Service
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file control.c
+
+    Control Socket
+
+    The Control Socket is a local (AF_UNIX) stream socket on which
+    administrative commands are accepted.  Each connection carries a
+    single newline terminated command and receives a single newline
+    terminated reply, after which the connection is closed.
+
+    All of the socket descriptors are non-blocking so they can be
+    multiplexed with the other event sources of the Save Service.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <varserver/varserver.h>
+#include "control.h"
+
+/*==============================================================================
+       Function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  CONTROL_Listen                                                            */
+/*!
+    Create the control socket
+
+    The CONTROL_Listen function creates a listening control socket at
+    the specified path, replacing any stale socket left behind by a
+    previous instance.
+
+    @param[in]
+        path
+            file system path of the control socket
+
+    @retval listening socket descriptor
+    @retval -1 on failure (errno is set)
+
+==============================================================================*/
+int CONTROL_Listen( const char *path )
+{
+    struct sockaddr_un addr;
+    int fd = -1;
+
+    if ( ( path != NULL ) &&
+         ( strlen( path ) < sizeof( addr.sun_path ) ) )
+    {
+        memset( &addr, 0, sizeof( addr ) );
+        addr.sun_family = AF_UNIX;
+        strcpy( addr.sun_path, path );
+
+        (void)unlink( path );
+
+        fd = socket( AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
+        if ( ( fd != -1 ) &&
+             ( ( bind( fd, (struct sockaddr *)&addr, sizeof( addr ) ) != 0 ) ||
+               ( listen( fd, SOMAXCONN ) != 0 ) ) )
+        {
+            close( fd );
+            fd = -1;
+        }
+    }
+    else
+    {
+        errno = EINVAL;
+    }
+
+    return fd;
+}
+
+/*============================================================================*/
+/*  CONTROL_Accept                                                            */
+/*!
+    Accept a control connection
+
+    @param[in]
+        fd
+            listening socket descriptor
+
+    @retval connection socket descriptor
+    @retval -1 if there is no pending connection, or on failure
+            (errno is set)
+
+==============================================================================*/
+int CONTROL_Accept( int fd )
+{
+    return accept4( fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC );
+}
+
+/*============================================================================*/
+/*  CONTROL_Read                                                              */
+/*!
+    Read a control command
+
+    The CONTROL_Read function reads a command from a control connection
+    and strips the trailing line terminator.  The command must arrive
+    in a single segment, which is always the case for the short commands
+    sent over a local socket.
+
+    @param[in]
+        fd
+            connection socket descriptor
+
+    @param[out]
+        buf
+            pointer to the command buffer
+
+    @param[in]
+        len
+            size of the command buffer
+
+    @retval EOK - a command was read
+    @retval EINVAL - invalid arguments
+    @retval EAGAIN - no command is available yet
+    @retval ECONNRESET - the connection was closed
+    @retval other error from recv()
+
+==============================================================================*/
+int CONTROL_Read( int fd, char *buf, size_t len )
+{
+    int result = EINVAL;
+    ssize_t n;
+
+    if ( ( buf != NULL ) &&
+         ( len > 0 ) )
+    {
+        n = recv( fd, buf, len - 1, 0 );
+        if ( n > 0 )
+        {
+            while ( ( n > 0 ) &&
+                    ( ( buf[n - 1] == '\n' ) || ( buf[n - 1] == '\r' ) ) )
+            {
+                n--;
+            }
+
+            buf[n] = 0;
+            result = EOK;
+        }
+        else
+        {
+            result = ( n == 0 ) ? ECONNRESET : errno;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  CONTROL_Reply                                                             */
+/*!
+    Send a reply on a control connection
+
+    The CONTROL_Reply function sends a newline terminated reply.  Replies
+    are small, so they fit in the socket buffer of a connection which
+    has not yet received anything.
+
+    @param[in]
+        fd
+            connection socket descriptor
+
+    @param[in]
+        reply
+            reply text (without the line terminator)
+
+    @retval EOK - the reply was sent
+    @retval EINVAL - invalid arguments
+    @retval other error from sendmsg()
+
+==============================================================================*/
+int CONTROL_Reply( int fd, const char *reply )
+{
+    int result = EINVAL;
+    struct iovec iov[2];
+    struct msghdr msg;
+
+    if ( reply != NULL )
+    {
+        iov[0].iov_base = (void *)reply;
+        iov[0].iov_len = strlen( reply );
+        iov[1].iov_base = "\n";
+        iov[1].iov_len = 1;
+
+        memset( &msg, 0, sizeof( msg ) );
+        msg.msg_iov = iov;
+        msg.msg_iovlen = 2;
+
+        result = ( sendmsg( fd, &msg, MSG_NOSIGNAL ) != -1 ) ? EOK : errno;
+    }
+
+    return result;
+}
+
+/*! @}
+ * end of control group */
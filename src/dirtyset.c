@@ -0,0 +1,634 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup dirtyset Dirty Set
+ * @brief In-memory set of modified variables for the Save Service
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file dirtyset.c
+
+    Dirty Set
+
+    The Dirty Set tracks which of the non-volatile variables have
+    been modified, so a save can retrieve just those variables instead
+    of asking the variable server to search every variable for the
+    dirty flag.
+
+    Each tracked variable is registered once with its handle, instance
+    identifier and name.  The entries are held in an open addressing
+    hash table keyed by variable handle, with the names in a single
+    name pool, so a tracked variable costs 24 bytes plus its name.
+
+    Marking a variable as modified is a single hash lookup.  Each
+    variable is only added to the modified list once, no matter how
+    many times it is modified, and the list keeps the order in which
+    the variables were first modified.
+
+    Each capture sets the generation of the dirty set, and a modified
+    variable is stamped with the generation current when it was last
+    modified.  Once a capture has been committed, its variables which
+    have not been modified since are cleared from the modified list,
+    so a variable modified during or after the capture is always
+    captured again.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <varserver/varserver.h>
+#include "dirtyset.h"
+
+/*==============================================================================
+       Function declarations
+==============================================================================*/
+static DirtySetEntry *FindSlot( DirtySetEntry *entries,
+                                size_t size,
+                                VAR_HANDLE hVar );
+static int Grow( DirtySet *pDirtySet );
+static int AddName( DirtySet *pDirtySet, const char *name, uint32_t *offset );
+
+/*==============================================================================
+       Function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  DIRTYSET_Init                                                             */
+/*!
+    Initialize a dirty set
+
+    @param[in,out]
+        pDirtySet
+            pointer to the dirty set to initialize
+
+    @param[in]
+        size
+            initial number of table slots.  This is rounded up to
+            a power of two.
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval ENOMEM - memory allocation failed
+
+==============================================================================*/
+int DIRTYSET_Init( DirtySet *pDirtySet, size_t size )
+{
+    int result = EINVAL;
+    size_t n = 16;
+
+    if ( pDirtySet != NULL )
+    {
+        memset( pDirtySet, 0, sizeof( DirtySet ) );
+
+        while ( n < size )
+        {
+            n <<= 1;
+        }
+
+        pDirtySet->entries = calloc( n, sizeof( DirtySetEntry ) );
+        if ( pDirtySet->entries != NULL )
+        {
+            pDirtySet->size = n;
+            result = EOK;
+        }
+        else
+        {
+            result = ENOMEM;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  DIRTYSET_Register                                                         */
+/*!
+    Register a variable to be tracked
+
+    The DIRTYSET_Register function adds a variable to the set of
+    tracked variables.  Registering a variable which is already
+    tracked has no effect.
+
+    @param[in,out]
+        pDirtySet
+            pointer to the dirty set
+
+    @param[in]
+        hVar
+            handle of the variable
+
+    @param[in]
+        instanceID
+            instance identifier of the variable
+
+    @param[in]
+        name
+            name of the variable
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval ENOMEM - memory allocation failed
+
+==============================================================================*/
+int DIRTYSET_Register( DirtySet *pDirtySet,
+                       VAR_HANDLE hVar,
+                       uint32_t instanceID,
+                       const char *name )
+{
+    int result = EINVAL;
+    DirtySetEntry *pEntry;
+    uint32_t offset;
+
+    if ( ( pDirtySet != NULL ) &&
+         ( pDirtySet->entries != NULL ) &&
+         ( hVar != VAR_INVALID ) &&
+         ( name != NULL ) )
+    {
+        result = EOK;
+
+        /* keep the load factor below 3/4 */
+        if ( ( pDirtySet->count + 1 ) * 4 > pDirtySet->size * 3 )
+        {
+            result = Grow( pDirtySet );
+        }
+
+        if ( result == EOK )
+        {
+            pEntry = FindSlot( pDirtySet->entries, pDirtySet->size, hVar );
+            if ( pEntry->hVar == VAR_INVALID )
+            {
+                result = AddName( pDirtySet, name, &offset );
+                if ( result == EOK )
+                {
+                    pEntry->hVar = hVar;
+                    pEntry->instanceID = instanceID;
+                    pEntry->name = offset;
+                    pEntry->dirty = false;
+                    pDirtySet->count++;
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  DIRTYSET_Mark                                                             */
+/*!
+    Mark a tracked variable as modified
+
+    The variable is stamped with the current generation of the
+    dirty set, whether or not it was already marked.
+
+    @param[in,out]
+        pDirtySet
+            pointer to the dirty set
+
+    @param[in]
+        hVar
+            handle of the modified variable
+
+    @retval EOK - the variable is marked as modified
+    @retval EINVAL - invalid arguments
+    @retval ENOENT - the variable is not tracked
+    @retval ENOMEM - memory allocation failed
+
+==============================================================================*/
+int DIRTYSET_Mark( DirtySet *pDirtySet, VAR_HANDLE hVar )
+{
+    int result = EINVAL;
+    DirtySetEntry *pEntry;
+    VAR_HANDLE *list;
+    size_t size;
+
+    if ( ( pDirtySet != NULL ) &&
+         ( pDirtySet->entries != NULL ) &&
+         ( hVar != VAR_INVALID ) )
+    {
+        result = EOK;
+
+        pEntry = FindSlot( pDirtySet->entries, pDirtySet->size, hVar );
+        if ( pEntry->hVar == VAR_INVALID )
+        {
+            result = ENOENT;
+        }
+        else if ( pEntry->dirty == false )
+        {
+            if ( pDirtySet->dirty == pDirtySet->listSize )
+            {
+                size = ( pDirtySet->listSize > 0 ) ? pDirtySet->listSize * 2
+                                                   : DIRTYSET_DEFAULT_SIZE;
+                list = realloc( pDirtySet->list, size * sizeof( VAR_HANDLE ) );
+                if ( list != NULL )
+                {
+                    pDirtySet->list = list;
+                    pDirtySet->listSize = size;
+                }
+                else
+                {
+                    result = ENOMEM;
+                }
+            }
+
+            if ( result == EOK )
+            {
+                pDirtySet->list[pDirtySet->dirty++] = hVar;
+                pEntry->dirty = true;
+            }
+        }
+
+        if ( result == EOK )
+        {
+            pEntry->generation = pDirtySet->generation;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  DIRTYSET_Capture                                                          */
+/*!
+    Capture the modified variables into a snapshot
+
+    The DIRTYSET_Capture function retrieves the value of each of the
+    modified variables by handle.  The number of variable server calls
+    is proportional to the number of modified variables rather than the
+    total number of variables.
+
+    @param[in]
+        pDirtySet
+            pointer to the dirty set
+
+    @param[in,out]
+        pSnapshot
+            pointer to the snapshot to capture into
+
+    @param[in]
+        hVarServer
+            handle to the variable server
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval ENOMEM - memory allocation failed
+
+==============================================================================*/
+int DIRTYSET_Capture( DirtySet *pDirtySet,
+                      Snapshot *pSnapshot,
+                      VARSERVER_HANDLE hVarServer )
+{
+    int result = EINVAL;
+    DirtySetEntry *pEntry;
+    char *name;
+    size_t i;
+    int rc;
+
+    if ( ( pDirtySet != NULL ) &&
+         ( pDirtySet->entries != NULL ) &&
+         ( pSnapshot != NULL ) )
+    {
+        result = EOK;
+
+        SNAPSHOT_Reset( pSnapshot );
+
+        for ( i = 0; ( result == EOK ) && ( i < pDirtySet->dirty ); i++ )
+        {
+            pEntry = FindSlot( pDirtySet->entries,
+                               pDirtySet->size,
+                               pDirtySet->list[i] );
+            name = &pDirtySet->names[pEntry->name];
+
+            rc = SNAPSHOT_Get( pSnapshot,
+                               hVarServer,
+                               pEntry->hVar,
+                               pEntry->instanceID,
+                               name );
+            if ( rc == ENOMEM )
+            {
+                result = rc;
+            }
+            else if ( rc != EOK )
+            {
+                fprintf( stderr,
+                         "cannot capture %s: %s\n",
+                         name,
+                         strerror( rc ) );
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  DIRTYSET_Clear                                                            */
+/*!
+    Clear the mark of a committed variable
+
+    The DIRTYSET_Clear function clears the modified mark of a variable
+    captured by the capture of the specified generation, unless it
+    has been modified since that capture started.  The variable stays
+    in the modified list until DIRTYSET_Compact is called.
+
+    @param[in,out]
+        pDirtySet
+            pointer to the dirty set
+
+    @param[in]
+        hVar
+            handle of the committed variable
+
+    @param[in]
+        generation
+            generation marker of the committed capture
+
+    @retval EOK - the variable is no longer marked as modified
+    @retval EINVAL - invalid arguments
+    @retval ENOENT - the variable is not tracked
+    @retval EAGAIN - the variable has been modified since the capture
+
+==============================================================================*/
+int DIRTYSET_Clear( DirtySet *pDirtySet,
+                    VAR_HANDLE hVar,
+                    uint64_t generation )
+{
+    int result = EINVAL;
+    DirtySetEntry *pEntry;
+
+    if ( ( pDirtySet != NULL ) &&
+         ( pDirtySet->entries != NULL ) &&
+         ( hVar != VAR_INVALID ) )
+    {
+        pEntry = FindSlot( pDirtySet->entries, pDirtySet->size, hVar );
+        if ( pEntry->hVar == VAR_INVALID )
+        {
+            result = ENOENT;
+        }
+        else if ( ( pEntry->dirty == true ) &&
+                  ( pEntry->generation >= generation ) )
+        {
+            result = EAGAIN;
+        }
+        else
+        {
+            pEntry->dirty = false;
+            result = EOK;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  DIRTYSET_Compact                                                          */
+/*!
+    Remove the cleared variables from the modified list
+
+    The DIRTYSET_Compact function removes the variables cleared by
+    DIRTYSET_Clear from the modified list, keeping the order of the
+    remaining variables.  It must be called before the next variable
+    is marked, so a cleared variable which is marked again is not
+    listed twice.
+
+    @param[in,out]
+        pDirtySet
+            pointer to the dirty set
+
+==============================================================================*/
+void DIRTYSET_Compact( DirtySet *pDirtySet )
+{
+    DirtySetEntry *pEntry;
+    size_t n = 0;
+    size_t i;
+
+    if ( ( pDirtySet != NULL ) &&
+         ( pDirtySet->entries != NULL ) )
+    {
+        for ( i = 0; i < pDirtySet->dirty; i++ )
+        {
+            pEntry = FindSlot( pDirtySet->entries,
+                               pDirtySet->size,
+                               pDirtySet->list[i] );
+            if ( pEntry->dirty == true )
+            {
+                pDirtySet->list[n++] = pDirtySet->list[i];
+            }
+        }
+
+        pDirtySet->dirty = n;
+    }
+}
+
+/*============================================================================*/
+/*  DIRTYSET_Free                                                             */
+/*!
+    Release the memory used by a dirty set
+
+    @param[in,out]
+        pDirtySet
+            pointer to the dirty set
+
+==============================================================================*/
+void DIRTYSET_Free( DirtySet *pDirtySet )
+{
+    if ( pDirtySet != NULL )
+    {
+        free( pDirtySet->entries );
+        free( pDirtySet->names );
+        free( pDirtySet->list );
+        memset( pDirtySet, 0, sizeof( DirtySet ) );
+    }
+}
+
+/*============================================================================*/
+/*  FindSlot                                                                  */
+/*!
+    Find the slot of a variable handle
+
+    The FindSlot function returns the slot holding the specified handle,
+    or the empty slot where it would be inserted.
+
+    @param[in]
+        entries
+            array of table slots
+
+    @param[in]
+        size
+            number of table slots (a power of two)
+
+    @param[in]
+        hVar
+            variable handle to find
+
+    @retval pointer to the slot
+
+==============================================================================*/
+static DirtySetEntry *FindSlot( DirtySetEntry *entries,
+                                size_t size,
+                                VAR_HANDLE hVar )
+{
+    size_t mask = size - 1;
+    size_t idx;
+
+    /* handles are small sequential integers, so spread them with a
+       multiplicative hash */
+    idx = (size_t)( ( (uint64_t)hVar * 0x9E3779B97F4A7C15ULL ) >> 32 ) & mask;
+
+    while ( ( entries[idx].hVar != VAR_INVALID ) &&
+            ( entries[idx].hVar != hVar ) )
+    {
+        idx = ( idx + 1 ) & mask;
+    }
+
+    return &entries[idx];
+}
+
+/*============================================================================*/
+/*  Grow                                                                      */
+/*!
+    Double the number of slots in a dirty set
+
+    @param[in,out]
+        pDirtySet
+            pointer to the dirty set
+
+    @retval EOK - success
+    @retval ENOMEM - memory allocation failed
+
+==============================================================================*/
+static int Grow( DirtySet *pDirtySet )
+{
+    int result = ENOMEM;
+    DirtySetEntry *entries;
+    DirtySetEntry *pEntry;
+    size_t size;
+    size_t i;
+
+    size = pDirtySet->size * 2;
+    entries = calloc( size, sizeof( DirtySetEntry ) );
+    if ( entries != NULL )
+    {
+        for ( i = 0; i < pDirtySet->size; i++ )
+        {
+            if ( pDirtySet->entries[i].hVar != VAR_INVALID )
+            {
+                pEntry = FindSlot( entries,
+                                   size,
+                                   pDirtySet->entries[i].hVar );
+                *pEntry = pDirtySet->entries[i];
+            }
+        }
+
+        free( pDirtySet->entries );
+        pDirtySet->entries = entries;
+        pDirtySet->size = size;
+        result = EOK;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  AddName                                                                   */
+/*!
+    Add a variable name to the name pool
+
+    @param[in,out]
+        pDirtySet
+            pointer to the dirty set
+
+    @param[in]
+        name
+            variable name to add
+
+    @param[out]
+        offset
+            pointer to the location to store the offset of the name
+
+    @retval EOK - success
+    @retval ENOMEM - memory allocation failed
+
+==============================================================================*/
+static int AddName( DirtySet *pDirtySet, const char *name, uint32_t *offset )
+{
+    int result = EOK;
+    size_t len = strlen( name ) + 1;
+    size_t size = pDirtySet->namesSize;
+    char *names;
+
+    if ( pDirtySet->namesLen + len > size )
+    {
+        if ( size == 0 )
+        {
+            size = DIRTYSET_DEFAULT_SIZE * 32;
+        }
+
+        while ( pDirtySet->namesLen + len > size )
+        {
+            size *= 2;
+        }
+
+        if ( size > UINT32_MAX )
+        {
+            result = ENOMEM;
+        }
+        else
+        {
+            names = realloc( pDirtySet->names, size );
+            if ( names != NULL )
+            {
+                pDirtySet->names = names;
+                pDirtySet->namesSize = size;
+            }
+            else
+            {
+                result = ENOMEM;
+            }
+        }
+    }
+
+    if ( result == EOK )
+    {
+        *offset = (uint32_t)pDirtySet->namesLen;
+        memcpy( &pDirtySet->names[pDirtySet->namesLen], name, len );
+        pDirtySet->namesLen += len;
+    }
+
+    return result;
+}
+
+/*! @}
+ * end of dirtyset group */
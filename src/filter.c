@@ -0,0 +1,798 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+
+/*!
+ * @defgroup filter Variable Filter
+ * @brief Name, tag, and flag filters for the Save Service
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file filter.c
+
+    Variable Filter
+
+    A Variable Filter selects the variables saved by a profile by any
+    combination of name prefixes, a name regular expression, a tag
+    specification, and a flag mask.  Filters are given on the command
+    line or in the profile file as a list of specifications:
+
+        <name prefix>
+        regex=<extended regular expression>
+        tags=<tag specification>
+        flags=<flag>[,<flag>...]
+
+    A variable is selected if its name starts with any of the prefixes,
+    its name matches the regular expression, and it has all of the
+    tags and flags.
+
+    The tags and flags, and a single name prefix or the regular
+    expression, are added to the variable query so the variable server
+    can select the variables itself.  The variable server matches a
+    name prefix as a substring, and may not support every query type,
+    so names are always checked again by the client.
+
+    The name prefixes are compiled into a trie when the filter is
+    created, so checking a name costs one step per character of its
+    matched prefix no matter how many prefixes there are.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <regex.h>
+#include <varserver/varserver.h>
+#include <varserver/varquery.h>
+#include "filter.h"
+
+/*==============================================================================
+        Type Definitions
+==============================================================================*/
+
+/*! variable flag name */
+typedef struct _FlagName
+{
+    /*! name of the flag */
+    const char *name;
+
+    /*! flag value */
+    uint32_t flag;
+
+} FlagName;
+
+/*==============================================================================
+       Function declarations
+==============================================================================*/
+static int AddNode( Filter *pFilter, uint32_t parent, char c, uint32_t *idx );
+static bool MatchPrefix( const Filter *pFilter, const char *name );
+static int ParseFlag( const char *name, size_t len, uint32_t *flag );
+
+/*==============================================================================
+      File Scoped Variables
+==============================================================================*/
+
+/*! names of the flags which can be given in a flag filter */
+static const FlagName flagNames[] =
+{
+    { "volatile", VARFLAG_VOLATILE },
+    { "readonly", VARFLAG_READONLY },
+    { "hidden", VARFLAG_HIDDEN },
+    { "audit", VARFLAG_AUDIT }
+};
+
+/*==============================================================================
+       Function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  FILTER_Parse                                                              */
+/*!
+    Add a filter specification to a filter
+
+    The FILTER_Parse function adds a name prefix, or a regex=, tags=,
+    or flags= specification to the filter.
+
+    @param[in,out]
+        pFilter
+            pointer to the filter
+
+    @param[in]
+        spec
+            filter specification
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments or specification
+    @retval ENOMEM - memory allocation failed
+
+==============================================================================*/
+int FILTER_Parse( Filter *pFilter, const char *spec )
+{
+    int result = EINVAL;
+
+    if ( ( pFilter != NULL ) &&
+         ( spec != NULL ) )
+    {
+        if ( strncmp( spec, "regex=", 6 ) == 0 )
+        {
+            result = FILTER_SetRegex( pFilter, &spec[6] );
+        }
+        else if ( strncmp( spec, "tags=", 5 ) == 0 )
+        {
+            result = FILTER_SetTags( pFilter, &spec[5] );
+        }
+        else if ( strncmp( spec, "flags=", 6 ) == 0 )
+        {
+            result = FILTER_SetFlags( pFilter, &spec[6] );
+        }
+        else
+        {
+            result = FILTER_AddPrefix( pFilter, spec );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  FILTER_AddPrefix                                                          */
+/*!
+    Add a variable name prefix to a filter
+
+    The FILTER_AddPrefix function adds a name prefix to the prefix
+    trie of the filter.  Once a filter has a prefix, only variables
+    whose names start with one of its prefixes are selected.
+
+    @param[in,out]
+        pFilter
+            pointer to the filter
+
+    @param[in]
+        prefix
+            variable name prefix
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval ENOMEM - memory allocation failed
+
+==============================================================================*/
+int FILTER_AddPrefix( Filter *pFilter, const char *prefix )
+{
+    int result = EINVAL;
+    uint32_t idx = 0;
+    uint32_t child;
+    size_t i;
+
+    if ( ( pFilter != NULL ) &&
+         ( prefix != NULL ) )
+    {
+        result = EOK;
+
+        if ( pFilter->nodes == NULL )
+        {
+            /* create the root node */
+            pFilter->nodes = calloc( FILTER_DEFAULT_NODES,
+                                     sizeof( FilterNode ) );
+            if ( pFilter->nodes != NULL )
+            {
+                pFilter->size = FILTER_DEFAULT_NODES;
+                pFilter->count = 1;
+            }
+            else
+            {
+                result = ENOMEM;
+            }
+        }
+
+        for ( i = 0; ( result == EOK ) && ( prefix[i] != '\0' ); i++ )
+        {
+            child = pFilter->nodes[idx].child;
+            while ( ( child != 0 ) &&
+                    ( pFilter->nodes[child].c != prefix[i] ) )
+            {
+                child = pFilter->nodes[child].next;
+            }
+
+            if ( child == 0 )
+            {
+                result = AddNode( pFilter, idx, prefix[i], &child );
+            }
+
+            idx = child;
+        }
+
+        if ( result == EOK )
+        {
+            pFilter->nodes[idx].end = true;
+            pFilter->prefixes++;
+
+            /* a single prefix can be passed to the variable server */
+            free( pFilter->prefix );
+            pFilter->prefix = ( pFilter->prefixes == 1 ) ? strdup( prefix )
+                                                         : NULL;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  FILTER_SetRegex                                                           */
+/*!
+    Set the name regular expression of a filter
+
+    The FILTER_SetRegex function compiles an extended regular expression
+    which the names of the selected variables must match.  It replaces
+    any previous regular expression of the filter.
+
+    @param[in,out]
+        pFilter
+            pointer to the filter
+
+    @param[in]
+        pattern
+            extended regular expression
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments or regular expression
+    @retval ENOMEM - memory allocation failed
+
+==============================================================================*/
+int FILTER_SetRegex( Filter *pFilter, const char *pattern )
+{
+    int result = EINVAL;
+    regex_t regex;
+
+    if ( ( pFilter != NULL ) &&
+         ( pattern != NULL ) &&
+         ( regcomp( &regex, pattern, REG_EXTENDED | REG_NOSUB ) == 0 ) )
+    {
+        if ( pFilter->pattern != NULL )
+        {
+            regfree( &pFilter->regex );
+            free( pFilter->pattern );
+        }
+
+        pFilter->regex = regex;
+        pFilter->pattern = strdup( pattern );
+        if ( pFilter->pattern != NULL )
+        {
+            result = EOK;
+        }
+        else
+        {
+            regfree( &pFilter->regex );
+            result = ENOMEM;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  FILTER_SetTags                                                            */
+/*!
+    Set the tag specification of a filter
+
+    The tag specification is passed to the variable server, which
+    selects the variables with the tags.
+
+    @param[in,out]
+        pFilter
+            pointer to the filter
+
+    @param[in]
+        tags
+            comma separated list of tags
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval ENOMEM - memory allocation failed
+
+==============================================================================*/
+int FILTER_SetTags( Filter *pFilter, const char *tags )
+{
+    int result = EINVAL;
+    char *copy;
+
+    if ( ( pFilter != NULL ) &&
+         ( tags != NULL ) &&
+         ( tags[0] != '\0' ) )
+    {
+        copy = strdup( tags );
+        if ( copy != NULL )
+        {
+            free( pFilter->tags );
+            pFilter->tags = copy;
+            result = EOK;
+        }
+        else
+        {
+            result = ENOMEM;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  FILTER_SetFlags                                                           */
+/*!
+    Add to the flag mask of a filter
+
+    The FILTER_SetFlags function adds flags, given by name (volatile,
+    readonly, hidden, or audit) or by number, to the flags which
+    a selected variable must have.  The flag mask is passed to the
+    variable server along with the dirty flag.
+
+    @param[in,out]
+        pFilter
+            pointer to the filter
+
+    @param[in]
+        flags
+            comma separated list of flag names or numbers
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments or unknown flag
+    @retval ENOMEM - memory allocation failed
+
+==============================================================================*/
+int FILTER_SetFlags( Filter *pFilter, const char *flags )
+{
+    int result = EINVAL;
+    uint32_t mask = 0;
+    uint32_t flag;
+    size_t len;
+
+    if ( ( pFilter != NULL ) &&
+         ( flags != NULL ) )
+    {
+        result = EOK;
+
+        while ( ( result == EOK ) && ( *flags != '\0' ) )
+        {
+            len = strcspn( flags, "," );
+            result = ParseFlag( flags, len, &flag );
+            mask |= flag;
+
+            flags += len;
+            if ( *flags == ',' )
+            {
+                flags++;
+            }
+        }
+
+        if ( ( result == EOK ) &&
+             ( mask == 0 ) )
+        {
+            result = EINVAL;
+        }
+
+        if ( result == EOK )
+        {
+            pFilter->flags |= mask;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  FILTER_CopyQuery                                                          */
+/*!
+    Copy the tags and flags of one filter to another
+
+    @param[in,out]
+        pFilter
+            pointer to the filter to copy into
+
+    @param[in]
+        pSource
+            pointer to the filter to copy the tags and flags of
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval ENOMEM - memory allocation failed
+
+==============================================================================*/
+int FILTER_CopyQuery( Filter *pFilter, const Filter *pSource )
+{
+    int result = EINVAL;
+
+    if ( ( pFilter != NULL ) &&
+         ( pSource != NULL ) )
+    {
+        result = ( pSource->tags != NULL )
+                    ? FILTER_SetTags( pFilter, pSource->tags )
+                    : EOK;
+
+        pFilter->flags |= pSource->flags;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  FILTER_HasNames                                                           */
+/*!
+    Determine if a filter selects variables by name
+
+    @param[in]
+        pFilter
+            pointer to the filter
+
+    @retval true - the filter has a name prefix or regular expression
+    @retval false - the filter selects variables of any name
+
+==============================================================================*/
+bool FILTER_HasNames( const Filter *pFilter )
+{
+    return ( pFilter != NULL ) &&
+           ( ( pFilter->nodes != NULL ) || ( pFilter->pattern != NULL ) );
+}
+
+/*============================================================================*/
+/*  FILTER_Match                                                              */
+/*!
+    Check a variable name against a filter
+
+    The FILTER_Match function checks the name prefixes and regular
+    expression of the filter.  Tags and flags are only checked by the
+    variable server.
+
+    @param[in]
+        pFilter
+            pointer to the filter
+
+    @param[in]
+        name
+            name of the variable
+
+    @retval true - the name is selected by the filter
+    @retval false - the name is not selected by the filter
+
+==============================================================================*/
+bool FILTER_Match( const Filter *pFilter, const char *name )
+{
+    bool result = true;
+
+    if ( ( pFilter != NULL ) &&
+         ( name != NULL ) )
+    {
+        if ( pFilter->nodes != NULL )
+        {
+            result = MatchPrefix( pFilter, name );
+        }
+
+        if ( ( result == true ) &&
+             ( pFilter->pattern != NULL ) )
+        {
+            result = ( regexec( &pFilter->regex, name, 0, NULL, 0 ) == 0 );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  FILTER_SameQuery                                                          */
+/*!
+    Determine if two filters have the same tags and flags
+
+    @param[in]
+        pFilter
+            pointer to the first filter
+
+    @param[in]
+        pOther
+            pointer to the second filter
+
+    @retval true - the filters have the same tags and flags
+    @retval false - the filters differ in their tags or flags
+
+==============================================================================*/
+bool FILTER_SameQuery( const Filter *pFilter, const Filter *pOther )
+{
+    bool result = false;
+
+    if ( ( pFilter != NULL ) &&
+         ( pOther != NULL ) &&
+         ( pFilter->flags == pOther->flags ) )
+    {
+        if ( ( pFilter->tags == NULL ) || ( pOther->tags == NULL ) )
+        {
+            result = ( pFilter->tags == pOther->tags );
+        }
+        else
+        {
+            result = ( strcmp( pFilter->tags, pOther->tags ) == 0 );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  FILTER_Query                                                              */
+/*!
+    Add the filter to a variable query
+
+    The FILTER_Query function adds the tags and flags of the filter to
+    the variable query.  If requested, the name regular expression, or
+    a single name prefix, is added too.  The filter must outlive the
+    query.
+
+    @param[in]
+        pFilter
+            pointer to the filter
+
+    @param[in,out]
+        pQuery
+            pointer to the variable query
+
+    @param[in]
+        names
+            indicates the query is to be narrowed by the variable names
+
+==============================================================================*/
+void FILTER_Query( const Filter *pFilter, VarQuery *pQuery, bool names )
+{
+    if ( ( pFilter != NULL ) &&
+         ( pQuery != NULL ) )
+    {
+        if ( pFilter->tags != NULL )
+        {
+            pQuery->type |= QUERY_TAGS;
+            pQuery->tagspec = pFilter->tags;
+        }
+
+        if ( pFilter->flags != 0 )
+        {
+            pQuery->type |= QUERY_FLAGS;
+            pQuery->flags |= pFilter->flags;
+        }
+
+        if ( names == true )
+        {
+            if ( pFilter->pattern != NULL )
+            {
+                pQuery->type |= QUERY_REGEX;
+                pQuery->match = pFilter->pattern;
+            }
+            else if ( pFilter->prefix != NULL )
+            {
+                pQuery->type |= QUERY_MATCH;
+                pQuery->match = pFilter->prefix;
+            }
+        }
+    }
+}
+
+/*============================================================================*/
+/*  FILTER_Free                                                               */
+/*!
+    Release the memory used by a filter
+
+    The filter is left empty, selecting every variable.
+
+    @param[in,out]
+        pFilter
+            pointer to the filter
+
+==============================================================================*/
+void FILTER_Free( Filter *pFilter )
+{
+    if ( pFilter != NULL )
+    {
+        if ( pFilter->pattern != NULL )
+        {
+            regfree( &pFilter->regex );
+            free( pFilter->pattern );
+        }
+
+        free( pFilter->nodes );
+        free( pFilter->prefix );
+        free( pFilter->tags );
+        memset( pFilter, 0, sizeof( Filter ) );
+    }
+}
+
+/*============================================================================*/
+/*  AddNode                                                                   */
+/*!
+    Add a child node to the prefix trie
+
+    @param[in,out]
+        pFilter
+            pointer to the filter
+
+    @param[in]
+        parent
+            index of the parent node
+
+    @param[in]
+        c
+            name character matched by the new node
+
+    @param[out]
+        idx
+            pointer to the location to store the index of the new node
+
+    @retval EOK - success
+    @retval ENOMEM - memory allocation failed
+
+==============================================================================*/
+static int AddNode( Filter *pFilter, uint32_t parent, char c, uint32_t *idx )
+{
+    int result = EOK;
+    FilterNode *nodes;
+    FilterNode *pNode;
+    size_t size;
+
+    if ( pFilter->count == pFilter->size )
+    {
+        size = pFilter->size * 2;
+        nodes = ( size <= UINT32_MAX )
+                    ? realloc( pFilter->nodes, size * sizeof( FilterNode ) )
+                    : NULL;
+        if ( nodes != NULL )
+        {
+            pFilter->nodes = nodes;
+            pFilter->size = size;
+        }
+        else
+        {
+            result = ENOMEM;
+        }
+    }
+
+    if ( result == EOK )
+    {
+        *idx = (uint32_t)pFilter->count++;
+
+        /* link the new node as the first child of its parent */
+        pNode = &pFilter->nodes[*idx];
+        pNode->child = 0;
+        pNode->next = pFilter->nodes[parent].child;
+        pNode->c = c;
+        pNode->end = false;
+        pFilter->nodes[parent].child = *idx;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  MatchPrefix                                                               */
+/*!
+    Check if a name starts with any of the prefixes in the trie
+
+    @param[in]
+        pFilter
+            pointer to the filter
+
+    @param[in]
+        name
+            name of the variable
+
+    @retval true - the name starts with one of the prefixes
+    @retval false - the name does not start with any of the prefixes
+
+==============================================================================*/
+static bool MatchPrefix( const Filter *pFilter, const char *name )
+{
+    const FilterNode *nodes = pFilter->nodes;
+    uint32_t idx = 0;
+
+    while ( ( nodes[idx].end == false ) &&
+            ( *name != '\0' ) )
+    {
+        idx = nodes[idx].child;
+        while ( ( idx != 0 ) &&
+                ( nodes[idx].c != *name ) )
+        {
+            idx = nodes[idx].next;
+        }
+
+        if ( idx == 0 )
+        {
+            /* no prefix continues with this character */
+            break;
+        }
+
+        name++;
+    }
+
+    /* a failed search leaves idx at the root, which only ends a prefix
+       if the empty prefix was added */
+    return nodes[idx].end;
+}
+
+/*============================================================================*/
+/*  ParseFlag                                                                 */
+/*!
+    Convert a flag name or number to a flag
+
+    @param[in]
+        name
+            flag name or number, which need not be NUL terminated
+
+    @param[in]
+        len
+            length of the flag name or number
+
+    @param[out]
+        flag
+            pointer to the location to store the flag
+
+    @retval EOK - success
+    @retval EINVAL - unknown flag
+
+==============================================================================*/
+static int ParseFlag( const char *name, size_t len, uint32_t *flag )
+{
+    int result = EINVAL;
+    char buf[32];
+    char *end;
+    size_t i;
+
+    *flag = 0;
+
+    if ( ( len > 0 ) && ( len < sizeof buf ) )
+    {
+        memcpy( buf, name, len );
+        buf[len] = '\0';
+
+        for ( i = 0; i < sizeof( flagNames ) / sizeof( flagNames[0] ); i++ )
+        {
+            if ( strcmp( buf, flagNames[i].name ) == 0 )
+            {
+                *flag = flagNames[i].flag;
+                result = EOK;
+                break;
+            }
+        }
+
+        if ( result != EOK )
+        {
+            *flag = (uint32_t)strtoul( buf, &end, 0 );
+            result = ( ( *end == '\0' ) && ( *flag != 0 ) ) ? EOK : EINVAL;
+        }
+    }
+
+    return result;
+}
+
+/*! @}
+ * end of filter group */
@@ -0,0 +1,131 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup hash Hash Functions
+ * @brief Hash functions for the Save Service
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file hash.c
+
+    Hash Functions
+
+    The hash functions compute a 64-bit FNV-1a hash which can be
+    updated incrementally as data is produced.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include "hash.h"
+
+/*==============================================================================
+       Definitions
+==============================================================================*/
+
+/*! 64-bit FNV prime */
+#define HASH_FNV_PRIME ( 0x100000001b3ULL )
+
+/*==============================================================================
+       Function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  HASH_Update                                                               */
+/*!
+    Update a running hash
+
+    The HASH_Update function folds the specified data into a running
+    64-bit FNV-1a hash.  A new hash is started with HASH_INIT.
+
+    @param[in]
+        hash
+            the current hash value
+
+    @param[in]
+        data
+            pointer to the data to add to the hash
+
+    @param[in]
+        len
+            number of bytes of data
+
+    @retval the updated hash value
+
+==============================================================================*/
+uint64_t HASH_Update( uint64_t hash, const void *data, size_t len )
+{
+    const unsigned char *p = data;
+
+    if ( p != NULL )
+    {
+        while ( len-- > 0 )
+        {
+            hash ^= *p++;
+            hash *= HASH_FNV_PRIME;
+        }
+    }
+
+    return hash;
+}
+
+/*============================================================================*/
+/*  HASH_String                                                               */
+/*!
+    Hash a NUL terminated string
+
+    @param[in]
+        str
+            pointer to the NUL terminated string to hash
+
+    @retval the hash value of the string
+
+==============================================================================*/
+uint64_t HASH_String( const char *str )
+{
+    uint64_t hash = HASH_INIT;
+    const unsigned char *p = (const unsigned char *)str;
+
+    if ( p != NULL )
+    {
+        while ( *p != '\0' )
+        {
+            hash ^= *p++;
+            hash *= HASH_FNV_PRIME;
+        }
+    }
+
+    return hash;
+}
+
+/*! @}
+ * end of hash group */
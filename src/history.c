@@ -0,0 +1,751 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup history Save History
+ * @brief Most recently saved value of each variable for the Save Service
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file history.c
+
+    Save History
+
+    The Save History holds the most recently saved value of every
+    variable which has been saved.  It is used when the dirty flags of
+    the variables are cleared once they are committed: a save then
+    only captures the variables modified since the previous save, and
+    a full configuration file is rebuilt from the history so the
+    variables saved earlier are not lost.
+
+    Each variable is held as a copy of its snapshot record.  The
+    records are indexed by an open addressing hash table keyed by the
+    variable instance identifier and name, so updating the history
+    costs one lookup per captured variable, no matter how many
+    variables have been saved.  The records are kept in the order the
+    variables were first saved, so a full configuration file has a
+    stable layout.
+
+    The history is seeded from the committed configuration files, so
+    variables whose dirty flags were cleared by an earlier run of the
+    service are also kept.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <varserver/varserver.h>
+#include "hash.h"
+#include "snapshot.h"
+#include "savefmt.h"
+#include "shard.h"
+#include "history.h"
+
+/*==============================================================================
+       Function declarations
+==============================================================================*/
+static uint64_t HashRecord( SnapshotRecord *pRecord );
+static HistorySlot *FindSlot( History *pHistory,
+                              uint64_t hash,
+                              SnapshotRecord *pRecord );
+static int Store( History *pHistory, SnapshotRecord *pRecord );
+static int Grow( History *pHistory );
+static int LoadFile( History *pHistory,
+                     const char *filename,
+                     bool manifest );
+static int LoadText( FILE *fp, Snapshot *pSnapshot );
+static int LoadManifest( History *pHistory, const char *filename, FILE *fp );
+
+/*==============================================================================
+       Function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  HISTORY_Init                                                              */
+/*!
+    Initialize a save history
+
+    @param[in,out]
+        pHistory
+            pointer to the save history to initialize
+
+    @param[in]
+        size
+            initial number of table slots.  This is rounded up to
+            a power of two.
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval ENOMEM - memory allocation failed
+
+==============================================================================*/
+int HISTORY_Init( History *pHistory, size_t size )
+{
+    int result = EINVAL;
+    size_t n = 16;
+
+    if ( pHistory != NULL )
+    {
+        memset( pHistory, 0, sizeof( History ) );
+
+        while ( n < size )
+        {
+            n <<= 1;
+        }
+
+        pHistory->slots = calloc( n, sizeof( HistorySlot ) );
+        if ( pHistory->slots != NULL )
+        {
+            pHistory->size = n;
+            result = SNAPSHOT_Init( &pHistory->full, SNAPSHOT_DEFAULT_SIZE );
+        }
+        else
+        {
+            result = ENOMEM;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  HISTORY_Update                                                            */
+/*!
+    Update a save history with the variables of a snapshot
+
+    The HISTORY_Update function records the value of each variable in
+    the snapshot, replacing any previously recorded value.
+
+    @param[in,out]
+        pHistory
+            pointer to the save history
+
+    @param[in]
+        pSnapshot
+            pointer to the snapshot of the variables to record
+
+    @param[in]
+        pFilter
+            pointer to the filter selecting the variables to record, or
+            NULL to record all of the variables
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval ENOMEM - memory allocation failed
+
+==============================================================================*/
+int HISTORY_Update( History *pHistory,
+                    Snapshot *pSnapshot,
+                    const Filter *pFilter )
+{
+    int result = EINVAL;
+    SnapshotRecord *pRecord;
+
+    if ( ( pHistory != NULL ) &&
+         ( pHistory->slots != NULL ) &&
+         ( pSnapshot != NULL ) )
+    {
+        result = EOK;
+
+        pRecord = SNAPSHOT_First( pSnapshot );
+        while ( ( pRecord != NULL ) &&
+                ( result == EOK ) )
+        {
+            if ( FILTER_Match( pFilter, SNAPSHOT_Name( pRecord ) ) == true )
+            {
+                result = Store( pHistory, pRecord );
+            }
+
+            pRecord = SNAPSHOT_Next( pSnapshot, pRecord );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  HISTORY_Load                                                              */
+/*!
+    Load the variables of a committed configuration file into a history
+
+    The HISTORY_Load function records the variables of a text or
+    binary configuration file, a journal, or the shard files listed in
+    a shard manifest.  Values from a text file are recorded as
+    strings, which are written back unchanged.  A file which does not
+    exist is not an error.
+
+    @param[in,out]
+        pHistory
+            pointer to the save history
+
+    @param[in]
+        filename
+            name of the configuration file
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval ENOMEM - memory allocation failed
+    @retval other error from reading the file
+
+==============================================================================*/
+int HISTORY_Load( History *pHistory, const char *filename )
+{
+    int result = EINVAL;
+
+    if ( ( pHistory != NULL ) &&
+         ( filename != NULL ) )
+    {
+        result = LoadFile( pHistory, filename, true );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  HISTORY_Build                                                             */
+/*!
+    Build a snapshot of all of the variables in a save history
+
+    @param[in,out]
+        pHistory
+            pointer to the save history
+
+    @retval pointer to the snapshot of all of the variables.  This is
+            valid until the next call to HISTORY_Build or HISTORY_Free
+    @retval NULL if memory allocation failed
+
+==============================================================================*/
+Snapshot *HISTORY_Build( History *pHistory )
+{
+    Snapshot *pSnapshot = NULL;
+    int result = EOK;
+    size_t i;
+
+    if ( pHistory != NULL )
+    {
+        SNAPSHOT_Reset( &pHistory->full );
+
+        for ( i = 0; ( i < pHistory->count ) && ( result == EOK ); i++ )
+        {
+            result = SNAPSHOT_Copy( &pHistory->full, pHistory->records[i] );
+        }
+
+        if ( result == EOK )
+        {
+            pSnapshot = &pHistory->full;
+        }
+    }
+
+    return pSnapshot;
+}
+
+/*============================================================================*/
+/*  HISTORY_Free                                                              */
+/*!
+    Release the resources held by a save history
+
+    @param[in,out]
+        pHistory
+            pointer to the save history
+
+    @return none
+
+==============================================================================*/
+void HISTORY_Free( History *pHistory )
+{
+    size_t i;
+
+    if ( pHistory != NULL )
+    {
+        for ( i = 0; i < pHistory->count; i++ )
+        {
+            free( pHistory->records[i] );
+        }
+
+        free( pHistory->records );
+        free( pHistory->slots );
+        SNAPSHOT_Free( &pHistory->full );
+
+        memset( pHistory, 0, sizeof( History ) );
+    }
+}
+
+/*============================================================================*/
+/*  HashRecord                                                                */
+/*!
+    Hash the instance identifier and name of a variable record
+
+    @param[in]
+        pRecord
+            pointer to the variable record
+
+    @retval hash of the variable instance identifier and name
+
+==============================================================================*/
+static uint64_t HashRecord( SnapshotRecord *pRecord )
+{
+    uint64_t hash;
+
+    hash = HASH_Update( HASH_INIT,
+                        &pRecord->instanceID,
+                        sizeof( pRecord->instanceID ) );
+
+    return HASH_Update( hash, SNAPSHOT_Name( pRecord ), pRecord->namelen );
+}
+
+/*============================================================================*/
+/*  FindSlot                                                                  */
+/*!
+    Find the table slot of a variable
+
+    @param[in]
+        pHistory
+            pointer to the save history
+
+    @param[in]
+        hash
+            hash of the variable instance identifier and name
+
+    @param[in]
+        pRecord
+            pointer to a record of the variable
+
+    @retval pointer to the slot holding the variable, or to the unused
+            slot where it should be inserted
+
+==============================================================================*/
+static HistorySlot *FindSlot( History *pHistory,
+                              uint64_t hash,
+                              SnapshotRecord *pRecord )
+{
+    size_t mask = pHistory->size - 1;
+    size_t idx = (size_t)hash & mask;
+    HistorySlot *pSlot = &pHistory->slots[idx];
+    SnapshotRecord *pEntry;
+
+    while ( pSlot->idx != 0 )
+    {
+        if ( pSlot->hash == hash )
+        {
+            pEntry = pHistory->records[pSlot->idx - 1];
+            if ( ( pEntry->instanceID == pRecord->instanceID ) &&
+                 ( pEntry->namelen == pRecord->namelen ) &&
+                 ( memcmp( SNAPSHOT_Name( pEntry ),
+                           SNAPSHOT_Name( pRecord ),
+                           pRecord->namelen ) == 0 ) )
+            {
+                break;
+            }
+        }
+
+        idx = ( idx + 1 ) & mask;
+        pSlot = &pHistory->slots[idx];
+    }
+
+    return pSlot;
+}
+
+/*============================================================================*/
+/*  Store                                                                     */
+/*!
+    Record the value of a variable
+
+    @param[in,out]
+        pHistory
+            pointer to the save history
+
+    @param[in]
+        pRecord
+            pointer to the snapshot record of the variable
+
+    @retval EOK - success
+    @retval ENOMEM - memory allocation failed
+
+==============================================================================*/
+static int Store( History *pHistory, SnapshotRecord *pRecord )
+{
+    int result = EOK;
+    HistorySlot *pSlot;
+    SnapshotRecord *pCopy;
+    SnapshotRecord **records;
+    size_t size;
+    uint64_t hash;
+
+    /* keep the load factor below 3/4 */
+    if ( ( pHistory->count + 1 ) * 4 > pHistory->size * 3 )
+    {
+        result = Grow( pHistory );
+    }
+
+    if ( ( result == EOK ) &&
+         ( pHistory->count == pHistory->recordsSize ) )
+    {
+        size = ( pHistory->recordsSize > 0 ) ? pHistory->recordsSize * 2
+                                             : HISTORY_DEFAULT_SIZE;
+        records = realloc( pHistory->records,
+                           size * sizeof( SnapshotRecord * ) );
+        if ( records != NULL )
+        {
+            pHistory->records = records;
+            pHistory->recordsSize = size;
+        }
+        else
+        {
+            result = ENOMEM;
+        }
+    }
+
+    if ( result == EOK )
+    {
+        size = SNAPSHOT_RecordSize( pRecord->namelen, pRecord->len );
+        hash = HashRecord( pRecord );
+        pSlot = FindSlot( pHistory, hash, pRecord );
+        if ( pSlot->idx != 0 )
+        {
+            /* replace the recorded value, re-using its copy unless the
+               new value is larger */
+            pCopy = pHistory->records[pSlot->idx - 1];
+            if ( size > SNAPSHOT_RecordSize( pCopy->namelen, pCopy->len ) )
+            {
+                pCopy = realloc( pCopy, size );
+                if ( pCopy != NULL )
+                {
+                    pHistory->records[pSlot->idx - 1] = pCopy;
+                }
+            }
+        }
+        else
+        {
+            pCopy = malloc( size );
+            if ( pCopy != NULL )
+            {
+                pHistory->records[pHistory->count++] = pCopy;
+                pSlot->hash = hash;
+                pSlot->idx = (uint32_t)pHistory->count;
+            }
+        }
+
+        if ( pCopy != NULL )
+        {
+            memcpy( pCopy, pRecord, size );
+        }
+        else
+        {
+            result = ENOMEM;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Grow                                                                      */
+/*!
+    Double the number of slots in a save history
+
+    @param[in,out]
+        pHistory
+            pointer to the save history
+
+    @retval EOK - success
+    @retval ENOMEM - memory allocation failed
+
+==============================================================================*/
+static int Grow( History *pHistory )
+{
+    int result = ENOMEM;
+    HistorySlot *slots;
+    size_t size;
+    size_t mask;
+    size_t idx;
+    size_t i;
+
+    size = pHistory->size * 2;
+    slots = calloc( size, sizeof( HistorySlot ) );
+    if ( slots != NULL )
+    {
+        mask = size - 1;
+
+        for ( i = 0; i < pHistory->size; i++ )
+        {
+            if ( pHistory->slots[i].idx != 0 )
+            {
+                /* the recorded variables are unique, so only an
+                   unused slot is needed */
+                idx = (size_t)pHistory->slots[i].hash & mask;
+                while ( slots[idx].idx != 0 )
+                {
+                    idx = ( idx + 1 ) & mask;
+                }
+
+                slots[idx] = pHistory->slots[i];
+            }
+        }
+
+        free( pHistory->slots );
+        pHistory->slots = slots;
+        pHistory->size = size;
+        result = EOK;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  LoadFile                                                                  */
+/*!
+    Load the variables of a configuration file into a history
+
+    @param[in,out]
+        pHistory
+            pointer to the save history
+
+    @param[in]
+        filename
+            name of the configuration file
+
+    @param[in]
+        manifest
+            indicates the file may be a shard manifest
+
+    @retval EOK - success
+    @retval EINVAL - the file is a shard manifest listed by another
+            shard manifest
+    @retval ENOMEM - memory allocation failed
+    @retval other error from reading the file
+
+==============================================================================*/
+static int LoadFile( History *pHistory,
+                     const char *filename,
+                     bool manifest )
+{
+    int result;
+    char header[sizeof( SHARD_MANIFEST_HEADER )];
+    Snapshot snapshot;
+    size_t n;
+    FILE *fp;
+
+    result = SNAPSHOT_Init( &snapshot, SNAPSHOT_DEFAULT_SIZE );
+    if ( result == EOK )
+    {
+        fp = fopen( filename, "r" );
+        if ( fp != NULL )
+        {
+            n = fread( header, 1, sizeof header, fp );
+            if ( ( n >= strlen( SAVEFMT_MAGIC ) ) &&
+                 ( memcmp( header,
+                           SAVEFMT_MAGIC,
+                           strlen( SAVEFMT_MAGIC ) ) == 0 ) )
+            {
+                result = SAVEFMT_Load( filename, &snapshot );
+            }
+            else if ( ( n == sizeof header ) &&
+                      ( memcmp( header,
+                                SHARD_MANIFEST_HEADER "\n",
+                                sizeof header ) == 0 ) )
+            {
+                result = ( manifest == true )
+                            ? LoadManifest( pHistory, filename, fp )
+                            : EINVAL;
+            }
+            else
+            {
+                rewind( fp );
+                result = LoadText( fp, &snapshot );
+            }
+
+            fclose( fp );
+        }
+        else if ( errno != ENOENT )
+        {
+            result = errno;
+        }
+
+        if ( result == EOK )
+        {
+            result = HISTORY_Update( pHistory, &snapshot, NULL );
+        }
+
+        SNAPSHOT_Free( &snapshot );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  LoadText                                                                  */
+/*!
+    Load the variables of a text configuration file into a snapshot
+
+    The LoadText function adds the "name=value" and "[id]name=value"
+    lines of a text configuration file or journal to a snapshot as
+    string values.  Empty lines, comments, and directives are skipped.
+    The variable handles in the snapshot are set to VAR_INVALID.
+
+    @param[in]
+        fp
+            configuration file
+
+    @param[in,out]
+        pSnapshot
+            pointer to the snapshot to load the variables into
+
+    @retval EOK - success
+    @retval ENOMEM - memory allocation failed
+
+==============================================================================*/
+static int LoadText( FILE *fp, Snapshot *pSnapshot )
+{
+    int result = EOK;
+    VarObject obj;
+    uint32_t instanceID;
+    char *line = NULL;
+    size_t size = 0;
+    ssize_t len;
+    char *name;
+    char *value;
+    char *end;
+
+    while ( ( result == EOK ) &&
+            ( ( len = getline( &line, &size, fp ) ) > 0 ) )
+    {
+        while ( ( len > 0 ) &&
+                ( ( line[len - 1] == '\n' ) || ( line[len - 1] == '\r' ) ) )
+        {
+            line[--len] = '\0';
+        }
+
+        name = line;
+        instanceID = 0;
+        if ( name[0] == '[' )
+        {
+            instanceID = strtoul( &name[1], &end, 10 );
+            name = ( *end == ']' ) ? end + 1 : NULL;
+        }
+
+        value = ( name != NULL ) ? strchr( name, '=' ) : NULL;
+
+        if ( ( value != NULL ) &&
+             ( name[0] != '#' ) &&
+             ( name[0] != '@' ) &&
+             ( value > name ) )
+        {
+            *value++ = '\0';
+
+            memset( &obj, 0, sizeof obj );
+            obj.type = VARTYPE_STR;
+            obj.val.str = value;
+            obj.len = strlen( value ) + 1;
+
+            result = SNAPSHOT_Add( pSnapshot,
+                                   VAR_INVALID,
+                                   instanceID,
+                                   name,
+                                   &obj );
+        }
+    }
+
+    free( line );
+
+    return result;
+}
+
+/*============================================================================*/
+/*  LoadManifest                                                              */
+/*!
+    Load the shard files listed in a shard manifest into a history
+
+    @param[in,out]
+        pHistory
+            pointer to the save history
+
+    @param[in]
+        filename
+            name of the shard manifest
+
+    @param[in]
+        fp
+            shard manifest file, positioned after its header
+
+    @retval EOK - success
+    @retval ENOMEM - memory allocation failed
+    @retval other error from loading a shard file
+
+==============================================================================*/
+static int LoadManifest( History *pHistory, const char *filename, FILE *fp )
+{
+    int result = EOK;
+    const char *base = strrchr( filename, '/' );
+    int dirlen = ( base != NULL ) ? (int)( base - filename ) + 1 : 0;
+    char path[BUFSIZ];
+    char *line = NULL;
+    size_t size = 0;
+    ssize_t len;
+
+    while ( ( result == EOK ) &&
+            ( ( len = getline( &line, &size, fp ) ) > 0 ) )
+    {
+        if ( line[len - 1] == '\n' )
+        {
+            line[--len] = '\0';
+        }
+
+        if ( ( len > 0 ) &&
+             ( line[0] != '#' ) &&
+             ( line[0] != '@' ) )
+        {
+            if ( (size_t)snprintf( path,
+                                   sizeof path,
+                                   "%.*s%s",
+                                   dirlen,
+                                   filename,
+                                   line ) < sizeof path )
+            {
+                result = LoadFile( pHistory, path, false );
+            }
+            else
+            {
+                result = ENAMETOOLONG;
+            }
+        }
+    }
+
+    free( line );
+
+    return result;
+}
+
+/*! @}
+ * end of history group */
@@ -0,0 +1,754 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup metrics Save Metrics
+ * @brief Save latency and throughput metrics for the Save Service
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file metrics.c
+
+    Save Metrics
+
+    The Save Metrics count the saves, failures, unchanged (skipped)
+    saves, variables and bytes written, and keep a histogram of the
+    time spent in each phase of a save: querying the dirty variables,
+    formatting the output, writing it, syncing it to storage, and
+    committing it.
+
+    Each save is measured into a sample as it is performed, and the
+    sample is recorded into the metrics once the save is complete, so
+    the metrics lock is only taken once per save.
+
+    The histograms are log-linear: each power of two range of durations
+    is divided into eight buckets, so a percentile is reported within
+    12.5% of the measured duration using a fixed amount of memory.
+
+    The metrics can be exported as variables named after a prefix,
+    for example /sys/savesvc/saves or /sys/savesvc/fsync.  The service
+    requests PRINT notifications for each of these variables which
+    exists, and renders the metric when the variable is read, so the
+    metrics can be read with the standard variable server tools.
+    Counters are rendered as a number, and phases are rendered as
+    "count=N p50=N p99=N max=N" with durations in microseconds.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <varserver/varserver.h>
+#include "metrics.h"
+
+/*==============================================================================
+        Definitions
+==============================================================================*/
+
+/*! number of counters, which are exported before the phases */
+#define METRICS_COUNTERS ( 5 )
+
+/*! number of exported metrics */
+#define METRICS_EXPORTED ( METRICS_COUNTERS + METRIC_PHASES )
+
+/*! size of the buffer for a rendered metric */
+#define METRICS_TEXT_SIZE ( 128 )
+
+/*==============================================================================
+       Function declarations
+==============================================================================*/
+static size_t BucketIndex( uint64_t us );
+static uint64_t BucketLimit( size_t idx );
+static uint64_t Percentile( MetricHistogram *pHistogram,
+                            unsigned int percent );
+static int FormatMetric( Metrics *pMetrics,
+                         size_t idx,
+                         char *buf,
+                         size_t len );
+
+/*==============================================================================
+      File Scoped Variables
+==============================================================================*/
+
+/*! names of the exported metrics: the counters, then the phases in
+    MetricPhase order */
+static const char *metricNames[METRICS_EXPORTED] =
+{
+    "saves",
+    "failures",
+    "skipped",
+    "vars",
+    "bytes",
+    "query",
+    "format",
+    "write",
+    "fsync",
+    "rename",
+    "save"
+};
+
+/*==============================================================================
+       Function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  METRICS_Init                                                              */
+/*!
+    Initialize the save metrics
+
+    @param[in,out]
+        pMetrics
+            pointer to the metrics to initialize
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval other error from pthread_mutex_init()
+
+==============================================================================*/
+int METRICS_Init( Metrics *pMetrics )
+{
+    int result = EINVAL;
+
+    if ( pMetrics != NULL )
+    {
+        memset( pMetrics, 0, sizeof( Metrics ) );
+        result = pthread_mutex_init( &pMetrics->lock, NULL );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  METRICS_Add                                                               */
+/*!
+    Add time spent in a save phase to a sample
+
+    A phase may be performed more than once in a save, for example when
+    several shard files are written, so the times are accumulated.
+
+    @param[in,out]
+        pSample
+            pointer to the sample of the current save
+
+    @param[in]
+        phase
+            phase of the save
+
+    @param[in]
+        us
+            time spent in the phase (in microseconds)
+
+==============================================================================*/
+void METRICS_Add( MetricSample *pSample, MetricPhase phase, uint64_t us )
+{
+    if ( ( pSample != NULL ) &&
+         ( phase < METRIC_PHASES ) )
+    {
+        pSample->us[phase] += us;
+        pSample->phases |= ( 1U << phase );
+    }
+}
+
+/*============================================================================*/
+/*  METRICS_Phase                                                             */
+/*!
+    Record the duration of a single save phase
+
+    The METRICS_Phase function records a phase which is not measured as
+    part of a save sample, such as the query, which captures the dirty
+    variables once for all of the profiles being saved.
+
+    @param[in,out]
+        pMetrics
+            pointer to the metrics
+
+    @param[in]
+        phase
+            phase of the save
+
+    @param[in]
+        us
+            duration of the phase (in microseconds)
+
+==============================================================================*/
+void METRICS_Phase( Metrics *pMetrics, MetricPhase phase, uint64_t us )
+{
+    MetricHistogram *pHistogram;
+
+    if ( ( pMetrics != NULL ) &&
+         ( phase < METRIC_PHASES ) )
+    {
+        pthread_mutex_lock( &pMetrics->lock );
+
+        pHistogram = &pMetrics->phase[phase];
+        pHistogram->counts[BucketIndex( us )]++;
+        pHistogram->count++;
+        if ( us > pHistogram->max )
+        {
+            pHistogram->max = us;
+        }
+
+        pthread_mutex_unlock( &pMetrics->lock );
+    }
+}
+
+/*============================================================================*/
+/*  METRICS_Record                                                            */
+/*!
+    Record a completed save
+
+    The METRICS_Record function counts the save, and records the duration
+    of each phase which was timed in its sample.  Variables are only
+    counted for saves which succeeded.
+
+    @param[in,out]
+        pMetrics
+            pointer to the metrics
+
+    @param[in]
+        pSample
+            pointer to the sample of the save
+
+    @param[in]
+        result
+            result of the save
+
+    @param[in]
+        skipped
+            true if the save was skipped because the output was unchanged
+
+==============================================================================*/
+void METRICS_Record( Metrics *pMetrics,
+                     MetricSample *pSample,
+                     int result,
+                     bool skipped )
+{
+    MetricHistogram *pHistogram;
+    uint64_t us;
+    size_t i;
+
+    if ( ( pMetrics != NULL ) &&
+         ( pSample != NULL ) )
+    {
+        pthread_mutex_lock( &pMetrics->lock );
+
+        pMetrics->saves++;
+        pMetrics->bytes += pSample->bytes;
+
+        if ( result != EOK )
+        {
+            pMetrics->failures++;
+        }
+        else if ( skipped == true )
+        {
+            pMetrics->skipped++;
+        }
+        else
+        {
+            pMetrics->vars += pSample->vars;
+        }
+
+        for ( i = 0; i < METRIC_PHASES; i++ )
+        {
+            if ( ( pSample->phases & ( 1U << i ) ) != 0 )
+            {
+                us = pSample->us[i];
+                pHistogram = &pMetrics->phase[i];
+                pHistogram->counts[BucketIndex( us )]++;
+                pHistogram->count++;
+                if ( us > pHistogram->max )
+                {
+                    pHistogram->max = us;
+                }
+            }
+        }
+
+        pthread_mutex_unlock( &pMetrics->lock );
+    }
+}
+
+/*============================================================================*/
+/*  METRICS_Percentile                                                        */
+/*!
+    Get a percentile of the duration of a save phase
+
+    @param[in]
+        pMetrics
+            pointer to the metrics
+
+    @param[in]
+        phase
+            phase of the save
+
+    @param[in]
+        percent
+            percentile to get (0 to 100)
+
+    @retval the percentile duration (in microseconds)
+    @retval 0 if no durations have been recorded
+
+==============================================================================*/
+uint64_t METRICS_Percentile( Metrics *pMetrics,
+                             MetricPhase phase,
+                             unsigned int percent )
+{
+    uint64_t result = 0;
+
+    if ( ( pMetrics != NULL ) &&
+         ( phase < METRIC_PHASES ) )
+    {
+        pthread_mutex_lock( &pMetrics->lock );
+        result = Percentile( &pMetrics->phase[phase], percent );
+        pthread_mutex_unlock( &pMetrics->lock );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  METRICS_Export                                                            */
+/*!
+    Export the metrics as variables
+
+    The METRICS_Export function requests PRINT notifications for each
+    metric variable named prefix/metric (for example /sys/savesvc/fsync)
+    which exists.  Variables which do not exist are not exported, so only
+    the metrics of interest need to be created.
+
+    @param[in,out]
+        pMetrics
+            pointer to the metrics
+
+    @param[in]
+        hVarServer
+            handle to the variable server
+
+    @param[in]
+        prefix
+            name prefix of the metric variables
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval ENOMEM - memory allocation failed
+    @retval E2BIG - the prefix is too long
+    @retval ENOENT - none of the metric variables exist
+    @retval other error from VAR_Notify()
+
+==============================================================================*/
+int METRICS_Export( Metrics *pMetrics,
+                    VARSERVER_HANDLE hVarServer,
+                    const char *prefix )
+{
+    int result = EINVAL;
+    char name[MAX_NAME_LEN + 1];
+    size_t exported = 0;
+    VAR_HANDLE hVar;
+    size_t i;
+    int n;
+
+    if ( ( pMetrics != NULL ) &&
+         ( prefix != NULL ) )
+    {
+        pMetrics->handles = calloc( METRICS_EXPORTED, sizeof( VAR_HANDLE ) );
+        result = ( pMetrics->handles != NULL ) ? EOK : ENOMEM;
+
+        for ( i = 0; ( i < METRICS_EXPORTED ) && ( result == EOK ); i++ )
+        {
+            n = snprintf( name, sizeof name, "%s/%s", prefix, metricNames[i] );
+            hVar = VAR_INVALID;
+            if ( ( n < 0 ) || ( (size_t)n >= sizeof name ) )
+            {
+                result = E2BIG;
+            }
+            else
+            {
+                hVar = VAR_FindByName( hVarServer, name );
+            }
+
+            if ( hVar != VAR_INVALID )
+            {
+                result = VAR_Notify( hVarServer, hVar, NOTIFY_PRINT );
+                if ( result == EOK )
+                {
+                    pMetrics->handles[i] = hVar;
+                    exported++;
+                }
+            }
+        }
+
+        if ( ( result == EOK ) &&
+             ( exported == 0 ) )
+        {
+            result = ENOENT;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  METRICS_Print                                                             */
+/*!
+    Render an exported metric
+
+    The METRICS_Print function handles a PRINT notification for an
+    exported metric variable by writing the current value of the metric
+    to the print session of the requesting client.
+
+    @param[in]
+        pMetrics
+            pointer to the metrics
+
+    @param[in]
+        hVarServer
+            handle to the variable server
+
+    @param[in]
+        id
+            print session identifier from the PRINT notification
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval ENOENT - the variable is not an exported metric
+    @retval other error from the print session
+
+==============================================================================*/
+int METRICS_Print( Metrics *pMetrics,
+                   VARSERVER_HANDLE hVarServer,
+                   int32_t id )
+{
+    int result = EINVAL;
+    char text[METRICS_TEXT_SIZE];
+    VAR_HANDLE hVar = VAR_INVALID;
+    int fd = -1;
+    size_t i;
+
+    if ( ( pMetrics != NULL ) &&
+         ( pMetrics->handles != NULL ) )
+    {
+        result = VAR_OpenPrintSession( hVarServer, id, &hVar, &fd );
+        if ( result == EOK )
+        {
+            result = ENOENT;
+            for ( i = 0; i < METRICS_EXPORTED; i++ )
+            {
+                if ( ( hVar != VAR_INVALID ) &&
+                     ( pMetrics->handles[i] == hVar ) )
+                {
+                    result = FormatMetric( pMetrics, i, text, sizeof text );
+                    break;
+                }
+            }
+
+            if ( result == EOK )
+            {
+                dprintf( fd, "%s", text );
+            }
+
+            /* always close the session so the client is released */
+            (void)VAR_ClosePrintSession( hVarServer, id, fd );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  METRICS_Format                                                            */
+/*!
+    Format all of the metrics as text
+
+    The METRICS_Format function formats the counters, followed by one
+    line per phase.
+
+    @param[in]
+        pMetrics
+            pointer to the metrics
+
+    @param[out]
+        buf
+            pointer to the output buffer
+
+    @param[in]
+        len
+            size of the output buffer
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval E2BIG - the output buffer is too small
+
+==============================================================================*/
+int METRICS_Format( Metrics *pMetrics, char *buf, size_t len )
+{
+    int result = EINVAL;
+    char text[METRICS_TEXT_SIZE];
+    size_t offset = 0;
+    size_t i;
+    int n;
+
+    if ( ( pMetrics != NULL ) &&
+         ( buf != NULL ) )
+    {
+        result = EOK;
+
+        for ( i = 0; ( i < METRICS_EXPORTED ) && ( result == EOK ); i++ )
+        {
+            result = FormatMetric( pMetrics, i, text, sizeof text );
+            if ( result == EOK )
+            {
+                n = snprintf( &buf[offset],
+                              len - offset,
+                              "%-10s %s\n",
+                              metricNames[i],
+                              text );
+                if ( ( n >= 0 ) && ( (size_t)n < len - offset ) )
+                {
+                    offset += (size_t)n;
+                }
+                else
+                {
+                    result = E2BIG;
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  METRICS_Free                                                              */
+/*!
+    Free the save metrics
+
+    @param[in,out]
+        pMetrics
+            pointer to the metrics to free
+
+==============================================================================*/
+void METRICS_Free( Metrics *pMetrics )
+{
+    if ( pMetrics != NULL )
+    {
+        free( pMetrics->handles );
+        pMetrics->handles = NULL;
+        pthread_mutex_destroy( &pMetrics->lock );
+    }
+}
+
+/*============================================================================*/
+/*  FormatMetric                                                              */
+/*!
+    Format a single metric as text
+
+    @param[in]
+        pMetrics
+            pointer to the metrics
+
+    @param[in]
+        idx
+            index of the metric in the exported metric names
+
+    @param[out]
+        buf
+            pointer to the output buffer
+
+    @param[in]
+        len
+            size of the output buffer
+
+    @retval EOK - success
+    @retval E2BIG - the output buffer is too small
+
+==============================================================================*/
+static int FormatMetric( Metrics *pMetrics,
+                         size_t idx,
+                         char *buf,
+                         size_t len )
+{
+    uint64_t counters[METRICS_COUNTERS];
+    MetricHistogram *pHistogram;
+    int n;
+
+    pthread_mutex_lock( &pMetrics->lock );
+
+    if ( idx < METRICS_COUNTERS )
+    {
+        counters[0] = pMetrics->saves;
+        counters[1] = pMetrics->failures;
+        counters[2] = pMetrics->skipped;
+        counters[3] = pMetrics->vars;
+        counters[4] = pMetrics->bytes;
+
+        n = snprintf( buf, len, "%" PRIu64, counters[idx] );
+    }
+    else
+    {
+        pHistogram = &pMetrics->phase[idx - METRICS_COUNTERS];
+        n = snprintf( buf,
+                      len,
+                      "count=%" PRIu64 " p50=%" PRIu64
+                      " p99=%" PRIu64 " max=%" PRIu64,
+                      pHistogram->count,
+                      Percentile( pHistogram, 50 ),
+                      Percentile( pHistogram, 99 ),
+                      pHistogram->max );
+    }
+
+    pthread_mutex_unlock( &pMetrics->lock );
+
+    return ( ( n >= 0 ) && ( (size_t)n < len ) ) ? EOK : E2BIG;
+}
+
+/*============================================================================*/
+/*  Percentile                                                                */
+/*!
+    Get a percentile of a histogram
+
+    The Percentile function finds the bucket holding the specified
+    percentile, and reports its upper limit, bounded by the longest
+    recorded duration.  The caller must hold the metrics lock.
+
+    @param[in]
+        pHistogram
+            pointer to the histogram
+
+    @param[in]
+        percent
+            percentile to get (0 to 100)
+
+    @retval the percentile duration (in microseconds)
+    @retval 0 if no durations have been recorded
+
+==============================================================================*/
+static uint64_t Percentile( MetricHistogram *pHistogram,
+                            unsigned int percent )
+{
+    uint64_t result = 0;
+    uint64_t rank;
+    uint64_t seen = 0;
+    size_t i;
+
+    if ( pHistogram->count > 0 )
+    {
+        /* rank of the percentile duration, counting from one */
+        rank = ( ( pHistogram->count * percent ) + 99 ) / 100;
+        if ( rank == 0 )
+        {
+            rank = 1;
+        }
+
+        for ( i = 0; i < METRICS_BUCKETS; i++ )
+        {
+            seen += pHistogram->counts[i];
+            if ( seen >= rank )
+            {
+                result = BucketLimit( i );
+                break;
+            }
+        }
+
+        if ( result > pHistogram->max )
+        {
+            result = pHistogram->max;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  BucketIndex                                                               */
+/*!
+    Get the histogram bucket of a duration
+
+    Durations below METRICS_SUB_BUCKETS have a bucket each.  Larger
+    durations are bucketed by their most significant bit, and the
+    three bits below it.
+
+    @param[in]
+        us
+            duration (in microseconds)
+
+    @retval index of the histogram bucket
+
+==============================================================================*/
+static size_t BucketIndex( uint64_t us )
+{
+    size_t idx = (size_t)us;
+    unsigned int shift;
+
+    if ( us >= METRICS_SUB_BUCKETS )
+    {
+        /* number of low bits below the sub-bucket bits */
+        shift = 63 - __builtin_clzll( us ) - 3;
+        idx = ( ( shift + 1 ) * METRICS_SUB_BUCKETS ) +
+              ( ( us >> shift ) & ( METRICS_SUB_BUCKETS - 1 ) );
+    }
+
+    return idx;
+}
+
+/*============================================================================*/
+/*  BucketLimit                                                               */
+/*!
+    Get the longest duration held by a histogram bucket
+
+    @param[in]
+        idx
+            index of the histogram bucket
+
+    @retval the longest duration (in microseconds) in the bucket
+
+==============================================================================*/
+static uint64_t BucketLimit( size_t idx )
+{
+    uint64_t limit = (uint64_t)idx;
+    unsigned int shift;
+
+    if ( idx >= METRICS_SUB_BUCKETS )
+    {
+        shift = ( idx / METRICS_SUB_BUCKETS ) - 1;
+        limit = ( (uint64_t)( METRICS_SUB_BUCKETS +
+                              ( idx % METRICS_SUB_BUCKETS ) ) << shift ) +
+                ( ( (uint64_t)1 << shift ) - 1 );
+    }
+
+    return limit;
+}
+
+/*! @}
+ * end of metrics group */
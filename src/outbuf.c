@@ -0,0 +1,648 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup outbuf Buffered Output Writer
+ * @brief Buffered output writer for the Save Service
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file outbuf.c
+
+    Buffered Output Writer
+
+    The Buffered Output Writer accumulates configuration output in a
+    large memory buffer and writes it to the output file descriptor
+    only when the buffer fills up, or when it is explicitly flushed.
+
+    When a write will not fit in the remaining buffer space, the buffered
+    data and the new data are written together with a single writev()
+    call, so data larger than the buffer is never copied.
+
+    The number of write system calls issued is therefore proportional
+    to the number of bytes written rather than to the number of
+    variables being saved.
+
+    A running hash of the output is maintained so the output can be
+    compared against previously committed output without reading it back.
+
+    Optionally, writeback of each block of written data to storage can
+    be started immediately with sync_file_range(), so that a subsequent
+    fdatasync() has less data to wait for.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/uio.h>
+#include <varserver/varserver.h>
+#include "hash.h"
+#include "outbuf.h"
+
+/*==============================================================================
+       Function declarations
+==============================================================================*/
+static int WriteVector( OutBuf *pOutBuf, struct iovec *iov, int iovcnt );
+static uint64_t TimeNowUs( void );
+
+/*==============================================================================
+       Function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  OUTBUF_Init                                                               */
+/*!
+    Initialize a buffered output writer
+
+    The OUTBUF_Init function allocates the output buffer.  The buffer
+    is retained across saves and is only released by OUTBUF_Free.
+
+    @param[in,out]
+        pOutBuf
+            pointer to the output writer to initialize
+
+    @param[in]
+        size
+            size of the output buffer (flush threshold) in bytes
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval ENOMEM - memory allocation failed
+
+==============================================================================*/
+int OUTBUF_Init( OutBuf *pOutBuf, size_t size )
+{
+    int result = EINVAL;
+
+    if ( pOutBuf != NULL )
+    {
+        memset( pOutBuf, 0, sizeof( OutBuf ) );
+        pOutBuf->fd = -1;
+
+        if ( size < OUTBUF_MIN_SIZE )
+        {
+            size = OUTBUF_MIN_SIZE;
+        }
+
+        pOutBuf->buf = malloc( size );
+        if ( pOutBuf->buf != NULL )
+        {
+            pOutBuf->size = size;
+            result = EOK;
+        }
+        else
+        {
+            result = ENOMEM;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  OUTBUF_Attach                                                             */
+/*!
+    Attach a buffered output writer to a file descriptor
+
+    The OUTBUF_Attach function discards any buffered data, clears the
+    error state, restarts the output hash, disables writeback, and
+    directs all subsequent output to the specified file descriptor.
+
+    @param[in,out]
+        pOutBuf
+            pointer to the output writer
+
+    @param[in]
+        fd
+            output file descriptor
+
+==============================================================================*/
+void OUTBUF_Attach( OutBuf *pOutBuf, int fd )
+{
+    if ( pOutBuf != NULL )
+    {
+        pOutBuf->fd = fd;
+        pOutBuf->len = 0;
+        pOutBuf->error = EOK;
+        pOutBuf->hash = HASH_INIT;
+        pOutBuf->count = 0;
+        pOutBuf->writeback = false;
+        pOutBuf->offset = 0;
+    }
+}
+
+/*============================================================================*/
+/*  OUTBUF_Write                                                              */
+/*!
+    Write data via the buffered output writer
+
+    The OUTBUF_Write function appends data to the output buffer.
+    If the data does not fit into the remaining buffer space, the
+    buffered data and the new data are written to the file descriptor
+    together using a single writev() call.
+
+    Once an error has occurred, all subsequent writes are discarded
+    and the error is returned until the writer is re-attached.
+
+    @param[in,out]
+        pOutBuf
+            pointer to the output writer
+
+    @param[in]
+        data
+            pointer to the data to write
+
+    @param[in]
+        len
+            number of bytes to write
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval other error from writev()
+
+==============================================================================*/
+int OUTBUF_Write( OutBuf *pOutBuf, const void *data, size_t len )
+{
+    int result = EINVAL;
+    struct iovec iov[2];
+
+    if ( ( pOutBuf != NULL ) &&
+         ( pOutBuf->buf != NULL ) &&
+         ( ( data != NULL ) || ( len == 0 ) ) )
+    {
+        result = pOutBuf->error;
+        if ( result == EOK )
+        {
+            pOutBuf->hash = HASH_Update( pOutBuf->hash, data, len );
+            pOutBuf->count += len;
+
+            if ( len <= pOutBuf->size - pOutBuf->len )
+            {
+                /* the data fits in the buffer */
+                memcpy( &pOutBuf->buf[pOutBuf->len], data, len );
+                pOutBuf->len += len;
+            }
+            else
+            {
+                /* write out the buffered data and the new data together */
+                iov[0].iov_base = pOutBuf->buf;
+                iov[0].iov_len = pOutBuf->len;
+                iov[1].iov_base = (void *)data;
+                iov[1].iov_len = len;
+
+                result = WriteVector( pOutBuf, iov, 2 );
+                pOutBuf->len = 0;
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  OUTBUF_Puts                                                               */
+/*!
+    Write a NUL terminated string via the buffered output writer
+
+    @param[in,out]
+        pOutBuf
+            pointer to the output writer
+
+    @param[in]
+        str
+            pointer to the NUL terminated string to write
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval other error from writev()
+
+==============================================================================*/
+int OUTBUF_Puts( OutBuf *pOutBuf, const char *str )
+{
+    int result = EINVAL;
+
+    if ( str != NULL )
+    {
+        result = OUTBUF_Write( pOutBuf, str, strlen( str ) );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  OUTBUF_Annotate                                                           */
+/*!
+    Write a NUL terminated string which is not part of the output hash
+
+    The OUTBUF_Annotate function writes a string, such as a marker
+    which differs on every save, without adding it to the running hash
+    or byte count of the output.  Output which differs only in its
+    annotations therefore compares as unchanged.
+
+    @param[in,out]
+        pOutBuf
+            pointer to the output writer
+
+    @param[in]
+        str
+            pointer to the NUL terminated string to write
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval other error from writev()
+
+==============================================================================*/
+int OUTBUF_Annotate( OutBuf *pOutBuf, const char *str )
+{
+    int result = EINVAL;
+    uint64_t hash;
+    uint64_t count;
+
+    if ( pOutBuf != NULL )
+    {
+        hash = pOutBuf->hash;
+        count = pOutBuf->count;
+
+        result = OUTBUF_Puts( pOutBuf, str );
+
+        pOutBuf->hash = hash;
+        pOutBuf->count = count;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  OUTBUF_Reserve                                                            */
+/*!
+    Reserve space in the output buffer
+
+    The OUTBUF_Reserve function returns a pointer to at least len bytes
+    of free space in the output buffer, writing out the buffered data
+    first if necessary.  Data can be formatted directly into the reserved
+    space, and is added to the output by OUTBUF_Commit.  The reserved
+    space is only valid until the next call to the output writer.
+
+    @param[in,out]
+        pOutBuf
+            pointer to the output writer
+
+    @param[in]
+        len
+            number of bytes to reserve
+
+    @retval pointer to the reserved space
+    @retval NULL if an output error has occurred, or the space
+            requested is larger than the output buffer
+
+==============================================================================*/
+char *OUTBUF_Reserve( OutBuf *pOutBuf, size_t len )
+{
+    char *p = NULL;
+
+    if ( ( pOutBuf != NULL ) &&
+         ( pOutBuf->buf != NULL ) &&
+         ( len <= pOutBuf->size ) )
+    {
+        if ( len > pOutBuf->size - pOutBuf->len )
+        {
+            (void)OUTBUF_Flush( pOutBuf );
+        }
+
+        if ( pOutBuf->error == EOK )
+        {
+            p = &pOutBuf->buf[pOutBuf->len];
+        }
+    }
+
+    return p;
+}
+
+/*============================================================================*/
+/*  OUTBUF_Commit                                                             */
+/*!
+    Add data formatted in reserved space to the output
+
+    The OUTBUF_Commit function adds the first len bytes of the space
+    returned by OUTBUF_Reserve to the output.
+
+    @param[in,out]
+        pOutBuf
+            pointer to the output writer
+
+    @param[in]
+        len
+            number of bytes to add.  This must not exceed the
+            number of bytes reserved
+
+==============================================================================*/
+void OUTBUF_Commit( OutBuf *pOutBuf, size_t len )
+{
+    if ( ( pOutBuf != NULL ) &&
+         ( len <= pOutBuf->size - pOutBuf->len ) )
+    {
+        pOutBuf->hash = HASH_Update( pOutBuf->hash,
+                                     &pOutBuf->buf[pOutBuf->len],
+                                     len );
+        pOutBuf->count += len;
+        pOutBuf->len += len;
+    }
+}
+
+/*============================================================================*/
+/*  OUTBUF_Flush                                                              */
+/*!
+    Flush the buffered output writer
+
+    The OUTBUF_Flush function writes any buffered data to the
+    file descriptor.
+
+    @param[in,out]
+        pOutBuf
+            pointer to the output writer
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval other error from writev(), or an earlier write error
+
+==============================================================================*/
+int OUTBUF_Flush( OutBuf *pOutBuf )
+{
+    int result = EINVAL;
+    struct iovec iov;
+
+    if ( pOutBuf != NULL )
+    {
+        result = pOutBuf->error;
+        if ( ( result == EOK ) &&
+             ( pOutBuf->len > 0 ) )
+        {
+            iov.iov_base = pOutBuf->buf;
+            iov.iov_len = pOutBuf->len;
+
+            result = WriteVector( pOutBuf, &iov, 1 );
+            pOutBuf->len = 0;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  OUTBUF_Consume                                                            */
+/*!
+    Remove buffered output which was written by the caller
+
+    The OUTBUF_Consume function accounts for buffered data which the
+    caller wrote to the file descriptor itself, for example with
+    io_uring, at the file offset of the next data.  Any data which
+    was not written stays buffered to be written by OUTBUF_Flush.
+
+    @param[in,out]
+        pOutBuf
+            pointer to the output writer
+
+    @param[in]
+        len
+            number of bytes written from the start of the buffer
+
+==============================================================================*/
+void OUTBUF_Consume( OutBuf *pOutBuf, size_t len )
+{
+    if ( ( pOutBuf != NULL ) &&
+         ( len <= pOutBuf->len ) )
+    {
+        memmove( pOutBuf->buf, &pOutBuf->buf[len], pOutBuf->len - len );
+        pOutBuf->len -= len;
+        pOutBuf->bytes += len;
+        pOutBuf->offset += len;
+    }
+}
+
+/*============================================================================*/
+/*  OUTBUF_Discard                                                            */
+/*!
+    Discard buffered output
+
+    The OUTBUF_Discard function discards any data held in the output
+    buffer which has not yet been written to the file descriptor.
+
+    @param[in,out]
+        pOutBuf
+            pointer to the output writer
+
+==============================================================================*/
+void OUTBUF_Discard( OutBuf *pOutBuf )
+{
+    if ( pOutBuf != NULL )
+    {
+        pOutBuf->len = 0;
+    }
+}
+
+/*============================================================================*/
+/*  OUTBUF_SetWriteback                                                       */
+/*!
+    Enable or disable immediate writeback
+
+    The OUTBUF_SetWriteback function controls whether writeback to storage
+    is started (but not waited for) as soon as each block of data is
+    written to the file descriptor.
+
+    @param[in,out]
+        pOutBuf
+            pointer to the output writer
+
+    @param[in]
+        enable
+            true to start writeback as data is written
+
+    @param[in]
+        offset
+            file offset at which the next data will be written
+
+==============================================================================*/
+void OUTBUF_SetWriteback( OutBuf *pOutBuf, bool enable, uint64_t offset )
+{
+    if ( pOutBuf != NULL )
+    {
+        pOutBuf->writeback = enable;
+        pOutBuf->offset = offset;
+    }
+}
+
+/*============================================================================*/
+/*  OUTBUF_Free                                                               */
+/*!
+    Release the resources held by a buffered output writer
+
+    The OUTBUF_Free function releases the output buffer.  Any buffered
+    data which has not been flushed is discarded.
+
+    @param[in,out]
+        pOutBuf
+            pointer to the output writer
+
+==============================================================================*/
+void OUTBUF_Free( OutBuf *pOutBuf )
+{
+    if ( pOutBuf != NULL )
+    {
+        free( pOutBuf->buf );
+        pOutBuf->buf = NULL;
+        pOutBuf->size = 0;
+        pOutBuf->len = 0;
+        pOutBuf->fd = -1;
+    }
+}
+
+/*============================================================================*/
+/*  WriteVector                                                               */
+/*!
+    Write an I/O vector to the output file descriptor
+
+    The WriteVector function writes all of the data described by the
+    I/O vector, re-issuing writev() as needed to handle partial writes
+    and interrupted system calls.  The first error is latched into the
+    output writer, and the time taken is added to the write time.
+
+    @param[in,out]
+        pOutBuf
+            pointer to the output writer
+
+    @param[in,out]
+        iov
+            pointer to the I/O vector.  The vector is modified as
+            data is written.
+
+    @param[in]
+        iovcnt
+            number of entries in the I/O vector
+
+    @retval EOK - success
+    @retval other error from writev()
+
+==============================================================================*/
+static int WriteVector( OutBuf *pOutBuf, struct iovec *iov, int iovcnt )
+{
+    int result = EOK;
+    uint64_t start = TimeNowUs();
+    ssize_t n;
+    size_t count;
+
+    while ( ( iovcnt > 0 ) && ( result == EOK ) )
+    {
+        /* skip over empty vector entries */
+        if ( iov->iov_len == 0 )
+        {
+            iov++;
+            iovcnt--;
+            continue;
+        }
+
+        n = writev( pOutBuf->fd, iov, iovcnt );
+        pOutBuf->syscalls++;
+
+        if ( n < 0 )
+        {
+            if ( errno != EINTR )
+            {
+                result = errno;
+            }
+        }
+        else
+        {
+            pOutBuf->bytes += (uint64_t)n;
+
+            if ( pOutBuf->writeback == true )
+            {
+                /* start writeback of the data just written */
+                (void)sync_file_range( pOutBuf->fd,
+                                       (off_t)pOutBuf->offset,
+                                       (off_t)n,
+                                       SYNC_FILE_RANGE_WRITE );
+                pOutBuf->syscalls++;
+            }
+
+            pOutBuf->offset += (uint64_t)n;
+
+            /* consume the written bytes from the I/O vector */
+            count = (size_t)n;
+            while ( ( iovcnt > 0 ) && ( count >= iov->iov_len ) )
+            {
+                count -= iov->iov_len;
+                iov++;
+                iovcnt--;
+            }
+
+            if ( iovcnt > 0 )
+            {
+                iov->iov_base = (char *)iov->iov_base + count;
+                iov->iov_len -= count;
+            }
+        }
+    }
+
+    pOutBuf->writeTimeUs += TimeNowUs() - start;
+
+    if ( result != EOK )
+    {
+        pOutBuf->error = result;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  TimeNowUs                                                                 */
+/*!
+    Get the current monotonic time
+
+    @retval the current monotonic time in microseconds
+
+==============================================================================*/
+static uint64_t TimeNowUs( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+
+    return ( (uint64_t)ts.tv_sec * 1000000 ) + ( ts.tv_nsec / 1000 );
+}
+
+/*! @}
+ * end of outbuf group */
@@ -0,0 +1,464 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup profile Save Profiles
+ * @brief Multiple trigger, output file, and filter profiles
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file profile.c
+
+    Save Profiles
+
+    A save profile associates a trigger variable with an output file
+    and an optional variable filter.  A single save service
+    instance can serve many profiles, each of which is saved
+    independently into its own output file, with its own journal and
+    committed file state.
+
+    Each profile is a separate SaveSvcState, initialized from the
+    settings of the service state given on the command line.  Profiles
+    are read from a profile file containing one profile per line:
+
+        <trigger variable> <output file> [<filter> ...]
+
+    Each filter is a variable name prefix, or a regex=, tags=, or flags=
+    specification (see filter.c).  A profile inherits the tags and flags
+    given on the command line.  Its own tags replace the inherited tags,
+    and its own flags are added to the inherited flags.
+    The tags and flags narrow the query shared by every profile, so all
+    of the profiles must have the same tags and flags.
+
+    Blank lines and lines starting with '#' are ignored.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <varserver/varserver.h>
+#include "savesvc.h"
+#include "profile.h"
+#include "shard.h"
+
+/*==============================================================================
+       Function declarations
+==============================================================================*/
+static int ParseProfile( SaveSvcState *pState, char *line );
+static SaveSvcState *NewProfile( SaveSvcState *pState,
+                                 const char *triggervar,
+                                 const char *filename );
+
+/*==============================================================================
+       Function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  PROFILE_Add                                                               */
+/*!
+    Add a save profile to a save service state
+
+    @param[in,out]
+        pState
+            pointer to the save service state
+
+    @param[in]
+        pProfile
+            pointer to the profile state to add.  This may be the
+            save service state itself.
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval E2BIG - too many profiles
+    @retval ENOMEM - memory allocation failed
+
+==============================================================================*/
+int PROFILE_Add( SaveSvcState *pState, SaveSvcState *pProfile )
+{
+    int result = EINVAL;
+    SaveSvcState **profiles;
+
+    if ( ( pState != NULL ) &&
+         ( pProfile != NULL ) )
+    {
+        if ( pState->nprofiles >= MAX_PROFILES )
+        {
+            result = E2BIG;
+        }
+        else
+        {
+            profiles = realloc( pState->profiles,
+                                ( pState->nprofiles + 1 ) *
+                                    sizeof( SaveSvcState * ) );
+            if ( profiles != NULL )
+            {
+                profiles[pState->nprofiles++] = pProfile;
+                pState->profiles = profiles;
+                result = EOK;
+            }
+            else
+            {
+                result = ENOMEM;
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  PROFILE_Load                                                              */
+/*!
+    Load save profiles from a profile file
+
+    The PROFILE_Load function reads the profile file and adds a profile
+    for each profile line.  The profiles inherit the settings of the
+    save service state.  Profiles which do not share the same tags and
+    flags are rejected.
+
+    @param[in,out]
+        pState
+            pointer to the save service state
+
+    @param[in]
+        filename
+            name of the profile file
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments, an invalid profile line, or
+                     profiles with different tags or flags
+    @retval ENOENT - the profile file contains no profiles
+    @retval E2BIG - too many profiles
+    @retval ENOMEM - memory allocation failed
+    @retval other error from fopen()
+
+==============================================================================*/
+int PROFILE_Load( SaveSvcState *pState, const char *filename )
+{
+    int result = EINVAL;
+    char line[BUFSIZ];
+    unsigned int lineno = 0;
+    FILE *fp;
+    size_t i;
+
+    if ( ( pState != NULL ) &&
+         ( filename != NULL ) )
+    {
+        fp = fopen( filename, "r" );
+        if ( fp != NULL )
+        {
+            result = EOK;
+
+            while ( ( result == EOK ) &&
+                    ( fgets( line, sizeof( line ), fp ) != NULL ) )
+            {
+                lineno++;
+
+                result = ParseProfile( pState, line );
+                if ( result != EOK )
+                {
+                    fprintf( stderr,
+                             "%s:%u: invalid profile: %s\n",
+                             filename,
+                             lineno,
+                             strerror( result ) );
+                }
+            }
+
+            if ( ( result == EOK ) &&
+                 ( pState->nprofiles == 0 ) )
+            {
+                result = ENOENT;
+            }
+
+            for ( i = 1; ( result == EOK ) && ( i < pState->nprofiles ); i++ )
+            {
+                if ( FILTER_SameQuery( &pState->profiles[0]->filter,
+                                       &pState->profiles[i]->filter ) == false )
+                {
+                    fprintf( stderr,
+                             "%s: profile %s has different tags or flags\n",
+                             filename,
+                             pState->profiles[i]->triggervar );
+                    result = EINVAL;
+                }
+            }
+
+            fclose( fp );
+        }
+        else
+        {
+            result = errno;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  PROFILE_Triggered                                                         */
+/*!
+    Find the profiles triggered by a variable
+
+    @param[in]
+        pState
+            pointer to the save service state
+
+    @param[in]
+        hVar
+            handle of the modified variable
+
+    @retval mask of the triggered profiles (bit n for profile n).  If the
+            state has no profiles, bit 0 is set if hVar is its own
+            trigger variable.
+
+==============================================================================*/
+uint64_t PROFILE_Triggered( SaveSvcState *pState, VAR_HANDLE hVar )
+{
+    uint64_t mask = 0;
+    size_t i;
+
+    if ( ( pState != NULL ) &&
+         ( hVar != VAR_INVALID ) )
+    {
+        if ( pState->nprofiles == 0 )
+        {
+            mask = ( pState->hTriggerVar == hVar ) ? 1 : 0;
+        }
+
+        for ( i = 0; i < pState->nprofiles; i++ )
+        {
+            if ( pState->profiles[i]->hTriggerVar == hVar )
+            {
+                mask |= (uint64_t)1 << i;
+            }
+        }
+    }
+
+    return mask;
+}
+
+/*============================================================================*/
+/*  PROFILE_Free                                                              */
+/*!
+    Release the save profiles
+
+    The PROFILE_Free function releases each profile's output buffer,
+    save arena, and saved variable table, along with the profile
+    itself.  A profile which is the save service state itself is left
+    for the caller to release.
+
+    @param[in,out]
+        pState
+            pointer to the save service state
+
+==============================================================================*/
+void PROFILE_Free( SaveSvcState *pState )
+{
+    SaveSvcState *pProfile;
+    size_t i;
+
+    if ( pState != NULL )
+    {
+        for ( i = 0; i < pState->nprofiles; i++ )
+        {
+            pProfile = pState->profiles[i];
+            if ( pProfile != pState )
+            {
+                SHARD_Free( pProfile );
+                HISTORY_Free( &pProfile->history );
+                OUTBUF_Free( &pProfile->out );
+                ARENA_Free( &pProfile->arena );
+                VARTAB_Free( &pProfile->saved );
+                free( pProfile->triggervar );
+                free( pProfile->filename );
+                FILTER_Free( &pProfile->filter );
+                free( pProfile );
+            }
+        }
+
+        free( pState->profiles );
+        pState->profiles = NULL;
+        pState->nprofiles = 0;
+    }
+}
+
+/*============================================================================*/
+/*  ParseProfile                                                              */
+/*!
+    Parse a profile line
+
+    @param[in,out]
+        pState
+            pointer to the save service state
+
+    @param[in,out]
+        line
+            pointer to the profile line.  This is modified by strtok_r
+
+    @retval EOK - a profile was added, or the line is blank or a comment
+    @retval EINVAL - the profile line is invalid
+    @retval E2BIG - too many profiles
+    @retval ENOMEM - memory allocation failed
+
+==============================================================================*/
+static int ParseProfile( SaveSvcState *pState, char *line )
+{
+    int result = EOK;
+    const char *delim = " \t\r\n";
+    SaveSvcState *pProfile;
+    char *triggervar;
+    char *filename;
+    char *filter;
+    char *save;
+
+    triggervar = strtok_r( line, delim, &save );
+    if ( ( triggervar != NULL ) &&
+         ( triggervar[0] != '#' ) )
+    {
+        filename = strtok_r( NULL, delim, &save );
+
+        if ( filename == NULL )
+        {
+            result = EINVAL;
+        }
+        else
+        {
+            pProfile = NewProfile( pState, triggervar, filename );
+            if ( pProfile != NULL )
+            {
+                filter = strtok_r( NULL, delim, &save );
+                while ( ( filter != NULL ) &&
+                        ( result == EOK ) )
+                {
+                    result = FILTER_Parse( &pProfile->filter, filter );
+                    filter = strtok_r( NULL, delim, &save );
+                }
+
+                if ( result == EOK )
+                {
+                    result = PROFILE_Add( pState, pProfile );
+                }
+
+                if ( result != EOK )
+                {
+                    free( pProfile->triggervar );
+                    free( pProfile->filename );
+                    FILTER_Free( &pProfile->filter );
+                    free( pProfile );
+                }
+            }
+            else
+            {
+                result = ENOMEM;
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  NewProfile                                                                */
+/*!
+    Create a profile state
+
+    The NewProfile function creates a profile state with the settings
+    of the save service state, and its own trigger variable and output
+    file.  The profile filter starts with the tags and flags of the
+    save service state filter.
+
+    @param[in]
+        pState
+            pointer to the save service state
+
+    @param[in]
+        triggervar
+            name of the profile trigger variable
+
+    @param[in]
+        filename
+            name of the profile output file
+
+    @retval pointer to the new profile state
+    @retval NULL if memory allocation failed
+
+==============================================================================*/
+static SaveSvcState *NewProfile( SaveSvcState *pState,
+                                 const char *triggervar,
+                                 const char *filename )
+{
+    SaveSvcState *pProfile;
+
+    pProfile = calloc( 1, sizeof( SaveSvcState ) );
+    if ( pProfile != NULL )
+    {
+        /* inherit the command line settings */
+        pProfile->hVarServer = pState->hVarServer;
+        pProfile->verbose = pState->verbose;
+        pProfile->fd = -1;
+        pProfile->donefd = -1;
+        pProfile->bufsize = pState->bufsize;
+        pProfile->journal = pState->journal;
+        pProfile->compactSize = pState->compactSize;
+        pProfile->compactRatio = pState->compactRatio;
+        pProfile->durability = pState->durability;
+        pProfile->format = pState->format;
+        pProfile->shardDepth = pState->shardDepth;
+        pProfile->shardWorkers = pState->shardWorkers;
+        pProfile->clearDirty = pState->clearDirty;
+        pProfile->consistent = pState->consistent;
+        pProfile->pMetrics = pState->pMetrics;
+
+        pProfile->triggervar = strdup( triggervar );
+        pProfile->filename = strdup( filename );
+
+        if ( ( pProfile->triggervar == NULL ) ||
+             ( pProfile->filename == NULL ) ||
+             ( FILTER_CopyQuery( &pProfile->filter,
+                                 &pState->filter ) != EOK ) )
+        {
+            free( pProfile->triggervar );
+            free( pProfile->filename );
+            FILTER_Free( &pProfile->filter );
+            free( pProfile );
+            pProfile = NULL;
+        }
+    }
+
+    return pProfile;
+}
+
+/*! @}
+ * end of profile group */
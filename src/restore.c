@@ -0,0 +1,1161 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup restore Configuration Restore
+ * @brief Restores variables from configuration files written by savesvc
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file restore.c
+
+    Configuration Restore
+
+    The Configuration Restore restores variables from the configuration
+    files written by the Save Service.  It is used by the saverestore
+    utility.
+
+    Each text file is mapped into memory and its "@config" header and
+    "name=value" and "[id]name=value" lines are parsed in place: the
+    line and value terminators are replaced with NUL characters in a
+    private copy-on-write mapping, so no line is copied.
+
+    Binary configuration files (savesvc -F binary) are also accepted.
+    Their values are already typed, so no values are parsed.
+
+    A shard manifest (savesvc -s) is restored by restoring each of the
+    shard files it lists, relative to the directory of the manifest.
+
+    A journal (savesvc -j) records the hash of the configuration file
+    it is replayed over.  A journal which does not match the file
+    restored before it was left behind by an interrupted compaction,
+    and is ignored.
+
+    Each variable name is resolved to a handle and type only once,
+    no matter how many files or lines refer to it.
+
+    Variables are set in batches.  If the restore is built with
+    SAVESVC_VAR_SETBATCH, for a variable server client library which
+    provides VAR_SetBatch, each batch is set with a single call,
+    otherwise the variables are set one at a time with VAR_Set.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <varserver/varserver.h>
+#include "hash.h"
+#include "snapshot.h"
+#include "savefmt.h"
+#include "shard.h"
+#include "restore.h"
+
+/*==============================================================================
+        Definitions
+==============================================================================*/
+
+/*! initial size of the handle cache (must be a power of 2) */
+#define RESTORE_CACHE_SIZE ( 1024 )
+
+/*==============================================================================
+       Function declarations
+==============================================================================*/
+static int RestoreFile( RestoreState *pState, const char *filename );
+static int RestoreText( RestoreState *pState, char *data, size_t size );
+static int RestoreBinary( RestoreState *pState, const char *filename );
+static int RestoreManifest( RestoreState *pState,
+                            const char *filename,
+                            char *data,
+                            size_t size );
+static int RestoreLine( RestoreState *pState, char *line, size_t len );
+static int RestoreValue( RestoreState *pState,
+                         char *name,
+                         VarObject *pVarObject,
+                         char *value );
+static RestoreHandle *Resolve( RestoreState *pState, char *name );
+static int GrowCache( RestoreState *pState );
+static int Queue( RestoreState *pState, VAR_HANDLE hVar, VarObject *pObj );
+static int Flush( RestoreState *pState );
+static bool IsStaleJournal( RestoreState *pState,
+                            const char *data,
+                            size_t size );
+static int HashText( const char *filename, uint64_t *hash );
+
+#ifdef SAVESVC_VAR_SETBATCH
+/* Batched variable update.  This is not yet part of the variable server
+   client library, so it is only used when the restore is built with
+   SAVESVC_VAR_SETBATCH.  It sets count variables from the hVars and
+   pVarObjects arrays, and returns EOK if all of them were set,
+   otherwise the error of the first variable which could not be set */
+int VAR_SetBatch( VARSERVER_HANDLE hVarServer,
+                  VAR_HANDLE *hVars,
+                  VarObject *pVarObjects,
+                  size_t count );
+#endif
+
+/*==============================================================================
+       Function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  RESTORE_Init                                                              */
+/*!
+    Initialize the restore state
+
+    The RESTORE_Init function allocates the handle cache and the batch
+    buffers of the restore state.  The batch size and verbose flag are
+    set by the caller before the state is initialized.  A batch size of
+    zero sets the variables one at a time.
+
+    @param[in,out]
+        pState
+            pointer to the restore state
+
+    @param[in]
+        hVarServer
+            handle to the variable server to restore the variables to
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval ENOMEM - memory allocation failed
+
+==============================================================================*/
+int RESTORE_Init( RestoreState *pState, VARSERVER_HANDLE hVarServer )
+{
+    int result = EINVAL;
+
+    if ( ( pState != NULL ) &&
+         ( hVarServer != NULL ) )
+    {
+        pState->hVarServer = hVarServer;
+
+        if ( pState->batchsize == 0 )
+        {
+            pState->batchsize = 1;
+        }
+
+        pState->handles = calloc( pState->batchsize, sizeof( VAR_HANDLE ) );
+        pState->values = calloc( pState->batchsize, sizeof( VarObject ) );
+        pState->cacheSize = RESTORE_CACHE_SIZE;
+        pState->cache = calloc( pState->cacheSize, sizeof( RestoreHandle ) );
+
+        result = ( ( pState->handles != NULL ) &&
+                   ( pState->values != NULL ) &&
+                   ( pState->cache != NULL ) ) ? EOK : ENOMEM;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  RESTORE_File                                                              */
+/*!
+    Restore the variables in a configuration file
+
+    The RESTORE_File function restores the variables in a text or
+    binary configuration file, journal, or shard manifest.  Files are
+    restored in order, so later values win, and a journal is checked
+    against the file restored before it.
+
+    Variables which cannot be restored are reported and counted in
+    the failed count of the restore state, and do not stop the restore.
+
+    @param[in,out]
+        pState
+            pointer to the restore state
+
+    @param[in]
+        filename
+            name of the configuration file
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval other error from reading or parsing the file
+
+==============================================================================*/
+int RESTORE_File( RestoreState *pState, const char *filename )
+{
+    int result = EINVAL;
+
+    if ( ( pState != NULL ) &&
+         ( pState->cache != NULL ) &&
+         ( filename != NULL ) )
+    {
+        result = RestoreFile( pState, filename );
+        pState->previous = filename;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  RESTORE_Free                                                              */
+/*!
+    Release the restore state
+
+    The RESTORE_Free function releases the handle cache and the batch
+    buffers of the restore state.
+
+    @param[in,out]
+        pState
+            pointer to the restore state
+
+==============================================================================*/
+void RESTORE_Free( RestoreState *pState )
+{
+    size_t i;
+
+    if ( pState != NULL )
+    {
+        if ( pState->cache != NULL )
+        {
+            for ( i = 0; i < pState->cacheSize; i++ )
+            {
+                free( pState->cache[i].name );
+            }
+        }
+
+        free( pState->cache );
+        free( pState->values );
+        free( pState->handles );
+
+        pState->cache = NULL;
+        pState->cacheSize = 0;
+        pState->cacheCount = 0;
+        pState->values = NULL;
+        pState->handles = NULL;
+        pState->pending = 0;
+    }
+}
+
+/*============================================================================*/
+/*  RestoreFile                                                               */
+/*!
+    Restore the variables in a configuration file
+
+    The RestoreFile function maps the configuration file into memory
+    and restores its variables.  Binary configuration files are
+    identified by their magic number, and shard manifests by their
+    "@manifest" header.
+
+    @param[in,out]
+        pState
+            pointer to the restore state
+
+    @param[in]
+        filename
+            name of the configuration file
+
+    @retval EOK - success
+    @retval other error from reading or parsing the file
+
+==============================================================================*/
+static int RestoreFile( RestoreState *pState, const char *filename )
+{
+    int result;
+    struct stat st;
+    void *data;
+    int fd;
+
+    fd = open( filename, O_RDONLY );
+    if ( fd == -1 )
+    {
+        result = errno;
+    }
+    else
+    {
+        if ( fstat( fd, &st ) == -1 )
+        {
+            result = errno;
+        }
+        else if ( st.st_size == 0 )
+        {
+            result = EOK;
+        }
+        else
+        {
+            /* a private writable mapping lets the lines be terminated in
+               place.  Only the pages which are modified are copied */
+            data = mmap( NULL,
+                         (size_t)st.st_size,
+                         PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE,
+                         fd,
+                         0 );
+            if ( data == MAP_FAILED )
+            {
+                result = errno;
+            }
+            else
+            {
+                if ( ( (size_t)st.st_size >= SAVEFMT_MIN_HEADER_SIZE ) &&
+                     ( memcmp( data,
+                               SAVEFMT_MAGIC,
+                               strlen( SAVEFMT_MAGIC ) ) == 0 ) )
+                {
+                    result = RestoreBinary( pState, filename );
+                }
+                else if ( ( (size_t)st.st_size >=
+                                sizeof( SHARD_MANIFEST_HEADER ) ) &&
+                          ( memcmp( data,
+                                    SHARD_MANIFEST_HEADER "\n",
+                                    sizeof( SHARD_MANIFEST_HEADER ) ) == 0 ) )
+                {
+                    result = RestoreManifest( pState,
+                                              filename,
+                                              data,
+                                              (size_t)st.st_size );
+                }
+                else if ( IsStaleJournal( pState,
+                                          data,
+                                          (size_t)st.st_size ) == true )
+                {
+                    if ( pState->verbose == true )
+                    {
+                        printf( "Ignoring stale journal %s\n", filename );
+                    }
+
+                    result = EOK;
+                }
+                else
+                {
+                    (void)madvise( data,
+                                   (size_t)st.st_size,
+                                   MADV_SEQUENTIAL );
+                    result = RestoreText( pState, data, (size_t)st.st_size );
+                }
+
+                munmap( data, (size_t)st.st_size );
+            }
+        }
+
+        close( fd );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  RestoreText                                                               */
+/*!
+    Restore the variables from a mapped text configuration file
+
+    @param[in,out]
+        pState
+            pointer to the restore state
+
+    @param[in,out]
+        data
+            pointer to the writable mapping of the file
+
+    @param[in]
+        size
+            size of the file
+
+    Variables which cannot be restored are reported and counted
+    individually, and do not stop the restore.
+
+    @retval EOK - success
+    @retval ENOMEM - memory allocation failed
+
+==============================================================================*/
+static int RestoreText( RestoreState *pState, char *data, size_t size )
+{
+    int result = EOK;
+    char *end = data + size;
+    char *line = data;
+    char *eol;
+    char *last;
+
+    while ( line < end )
+    {
+        eol = memchr( line, '\n', (size_t)( end - line ) );
+        if ( eol != NULL )
+        {
+            *eol = 0;
+            (void)RestoreLine( pState, line, (size_t)( eol - line ) );
+            line = eol + 1;
+        }
+        else
+        {
+            /* the last line is not terminated and there is no room
+               to terminate it in the mapping */
+            last = strndup( line, (size_t)( end - line ) );
+            if ( last != NULL )
+            {
+                (void)RestoreLine( pState, last, (size_t)( end - line ) );
+
+                /* the batch may refer to the line */
+                (void)Flush( pState );
+                free( last );
+            }
+            else
+            {
+                result = ENOMEM;
+            }
+
+            line = end;
+        }
+    }
+
+    /* the batch refers to the mapping */
+    (void)Flush( pState );
+
+    return result;
+}
+
+/*============================================================================*/
+/*  RestoreManifest                                                           */
+/*!
+    Restore the shard files listed in a mapped shard manifest
+
+    The RestoreManifest function restores each shard file listed in
+    the manifest.  The shard files are relative to the directory of
+    the manifest.  A shard file which cannot be restored does not stop
+    the other shard files being restored.
+
+    @param[in,out]
+        pState
+            pointer to the restore state
+
+    @param[in]
+        filename
+            name of the manifest file
+
+    @param[in,out]
+        data
+            pointer to the writable mapping of the manifest
+
+    @param[in]
+        size
+            size of the manifest
+
+    @retval EOK - success
+    @retval EINVAL - the manifest is listed by another manifest
+    @retval other error from the first shard file which could not
+            be restored
+
+==============================================================================*/
+static int RestoreManifest( RestoreState *pState,
+                            const char *filename,
+                            char *data,
+                            size_t size )
+{
+    int result = EOK;
+    const char *base = strrchr( filename, '/' );
+    int dirlen = ( base != NULL ) ? (int)( base - filename ) + 1 : 0;
+    char *end = data + size;
+    char *line = data;
+    char *eol;
+    char path[BUFSIZ];
+    int rc;
+
+    if ( pState->manifest == true )
+    {
+        fprintf( stderr, "Nested manifest: %s\n", filename );
+        result = EINVAL;
+    }
+    else
+    {
+        pState->manifest = true;
+
+        /* every manifest line is terminated */
+        while ( ( line < end ) &&
+                ( ( eol = memchr( line, '\n', (size_t)( end - line ) ) )
+                    != NULL ) )
+        {
+            *eol = 0;
+
+            if ( ( line[0] != '\0' ) &&
+                 ( line[0] != '#' ) &&
+                 ( line[0] != '@' ) )
+            {
+                if ( (size_t)snprintf( path,
+                                       sizeof path,
+                                       "%.*s%s",
+                                       dirlen,
+                                       filename,
+                                       line ) >= sizeof path )
+                {
+                    rc = ENAMETOOLONG;
+                }
+                else
+                {
+                    rc = RestoreFile( pState, path );
+                }
+
+                if ( rc != EOK )
+                {
+                    fprintf( stderr,
+                             "Cannot restore %s: %s\n",
+                             path,
+                             strerror( rc ) );
+                    if ( result == EOK )
+                    {
+                        result = rc;
+                    }
+                }
+            }
+
+            line = eol + 1;
+        }
+
+        pState->manifest = false;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  RestoreLine                                                               */
+/*!
+    Restore the variable in a configuration file line
+
+    The RestoreLine function parses a NUL terminated configuration file
+    line.  Empty lines, comments, and directives such as the "@config"
+    header are skipped.
+
+    @param[in,out]
+        pState
+            pointer to the restore state
+
+    @param[in,out]
+        line
+            pointer to the NUL terminated line.  The line is modified.
+
+    @param[in]
+        len
+            length of the line
+
+    @retval EOK - success
+    @retval EINVAL - the line is not a name=value pair
+    @retval other error from converting the value
+
+==============================================================================*/
+static int RestoreLine( RestoreState *pState, char *line, size_t len )
+{
+    int result = EOK;
+    VarObject obj;
+    char *value;
+
+    if ( ( len > 0 ) && ( line[len - 1] == '\r' ) )
+    {
+        line[--len] = 0;
+    }
+
+    if ( ( len == 0 ) ||
+         ( line[0] == '#' ) ||
+         ( line[0] == '@' ) )
+    {
+        /* nothing to restore */
+    }
+    else if ( ( value = memchr( line, '=', len ) ) == NULL )
+    {
+        fprintf( stderr, "Invalid line: %s\n", line );
+        pState->failed++;
+        result = EINVAL;
+    }
+    else
+    {
+        *value++ = 0;
+        memset( &obj, 0, sizeof obj );
+        result = RestoreValue( pState, line, &obj, value );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  RestoreBinary                                                             */
+/*!
+    Restore the variables from a binary configuration file
+
+    @param[in,out]
+        pState
+            pointer to the restore state
+
+    @param[in]
+        filename
+            name of the binary configuration file
+
+    Variables which cannot be restored are reported and counted
+    individually, and do not stop the restore.
+
+    @retval EOK - success
+    @retval ENOMEM - memory allocation failed
+    @retval other error from SAVEFMT_Load
+
+==============================================================================*/
+static int RestoreBinary( RestoreState *pState, const char *filename )
+{
+    int result;
+    char key[MAX_NAME_LEN + 16];
+    SnapshotRecord *pRecord;
+    Snapshot snapshot;
+    VarObject obj;
+    int n;
+
+    result = SNAPSHOT_Init( &snapshot, SNAPSHOT_DEFAULT_SIZE );
+    if ( result == EOK )
+    {
+        result = SAVEFMT_Load( filename, &snapshot );
+    }
+
+    if ( result == EOK )
+    {
+        pRecord = SNAPSHOT_First( &snapshot );
+        while ( pRecord != NULL )
+        {
+            if ( pRecord->instanceID == 0 )
+            {
+                n = snprintf( key,
+                              sizeof key,
+                              "%s",
+                              SNAPSHOT_Name( pRecord ) );
+            }
+            else
+            {
+                n = snprintf( key,
+                              sizeof key,
+                              "[%d]%s",
+                              pRecord->instanceID,
+                              SNAPSHOT_Name( pRecord ) );
+            }
+
+            obj.type = pRecord->type;
+            obj.len = pRecord->len;
+            obj.val = pRecord->val;
+            if ( ( pRecord->type == VARTYPE_STR ) ||
+                 ( pRecord->type == VARTYPE_BLOB ) )
+            {
+                obj.val.blob = SNAPSHOT_Data( pRecord );
+            }
+
+            if ( ( n > 0 ) && ( (size_t)n < sizeof key ) )
+            {
+                (void)RestoreValue( pState, key, &obj, NULL );
+            }
+
+            pRecord = SNAPSHOT_Next( &snapshot, pRecord );
+        }
+
+        /* the batch refers to the snapshot */
+        (void)Flush( pState );
+    }
+
+    SNAPSHOT_Free( &snapshot );
+
+    return result;
+}
+
+/*============================================================================*/
+/*  RestoreValue                                                              */
+/*!
+    Queue a variable value to be set
+
+    The RestoreValue function resolves the variable name, converts a
+    text value to the type of the variable, and queues the value in
+    the pending batch.
+
+    @param[in,out]
+        pState
+            pointer to the restore state
+
+    @param[in]
+        name
+            variable name, including any instance identifier prefix
+
+    @param[in,out]
+        pVarObject
+            pointer to the typed value, or the object to convert the
+            text value into
+
+    @param[in]
+        value
+            text value, or NULL if pVarObject already holds the value
+
+    @retval EOK - success
+    @retval ENOENT - the variable does not exist
+    @retval EINVAL - the value does not match the variable type
+    @retval other error from converting the value
+
+==============================================================================*/
+static int RestoreValue( RestoreState *pState,
+                         char *name,
+                         VarObject *pVarObject,
+                         char *value )
+{
+    int result = EOK;
+    RestoreHandle *pHandle;
+
+    pHandle = Resolve( pState, name );
+    if ( pHandle == NULL )
+    {
+        result = ENOMEM;
+    }
+    else if ( pHandle->hVar == VAR_INVALID )
+    {
+        result = ENOENT;
+    }
+    else if ( value == NULL )
+    {
+        result = ( pVarObject->type == pHandle->type ) ? EOK : EINVAL;
+    }
+    else if ( pHandle->type == VARTYPE_STR )
+    {
+        /* the value is used in place */
+        pVarObject->type = VARTYPE_STR;
+        pVarObject->val.str = value;
+        pVarObject->len = strlen( value ) + 1;
+    }
+    else
+    {
+        pVarObject->type = pHandle->type;
+        result = VAROBJECT_ValueFromString( value, pVarObject, 0 );
+    }
+
+    if ( result == EOK )
+    {
+        result = Queue( pState, pHandle->hVar, pVarObject );
+    }
+    else
+    {
+        fprintf( stderr,
+                 "Cannot restore %s: %s\n",
+                 name,
+                 strerror( result ) );
+        pState->failed++;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Resolve                                                                   */
+/*!
+    Resolve a variable name to a handle
+
+    The Resolve function looks up the variable name in the handle cache.
+    Names which are not in the cache are resolved with the variable server
+    and added to the cache, including names which do not exist.
+
+    @param[in,out]
+        pState
+            pointer to the restore state
+
+    @param[in]
+        name
+            variable name, including any instance identifier prefix
+
+    @retval pointer to the resolved handle
+    @retval NULL if memory allocation failed
+
+==============================================================================*/
+static RestoreHandle *Resolve( RestoreState *pState, char *name )
+{
+    RestoreHandle *pHandle = NULL;
+    uint64_t hash;
+    size_t mask;
+    size_t i;
+
+    /* keep the load factor below 3/4 */
+    if ( ( ( pState->cacheCount + 1 ) * 4 <= pState->cacheSize * 3 ) ||
+         ( GrowCache( pState ) == EOK ) )
+    {
+        hash = HASH_String( name );
+        if ( hash == 0 )
+        {
+            /* zero marks an unused entry */
+            hash = 1;
+        }
+
+        mask = pState->cacheSize - 1;
+        i = (size_t)hash & mask;
+        while ( ( pState->cache[i].hash != 0 ) &&
+                ( ( pState->cache[i].hash != hash ) ||
+                  ( strcmp( pState->cache[i].name, name ) != 0 ) ) )
+        {
+            i = ( i + 1 ) & mask;
+        }
+
+        pHandle = &pState->cache[i];
+        if ( pHandle->hash == 0 )
+        {
+            /* resolve a new name with the variable server */
+            pHandle->name = strdup( name );
+            if ( pHandle->name != NULL )
+            {
+                pHandle->hash = hash;
+                pHandle->type = VARTYPE_INVALID;
+                pHandle->hVar = VAR_FindByName( pState->hVarServer, name );
+                if ( ( pHandle->hVar != VAR_INVALID ) &&
+                     ( VAR_GetType( pState->hVarServer,
+                                    pHandle->hVar,
+                                    &pHandle->type ) != EOK ) )
+                {
+                    pHandle->hVar = VAR_INVALID;
+                }
+
+                pState->cacheCount++;
+                pState->lookups++;
+            }
+            else
+            {
+                pHandle = NULL;
+            }
+        }
+    }
+
+    return pHandle;
+}
+
+/*============================================================================*/
+/*  GrowCache                                                                 */
+/*!
+    Double the size of the handle cache
+
+    @param[in,out]
+        pState
+            pointer to the restore state
+
+    @retval EOK - success
+    @retval ENOMEM - memory allocation failed
+
+==============================================================================*/
+static int GrowCache( RestoreState *pState )
+{
+    int result = ENOMEM;
+    RestoreHandle *cache;
+    size_t size = pState->cacheSize * 2;
+    size_t i;
+    size_t j;
+
+    cache = calloc( size, sizeof( RestoreHandle ) );
+    if ( cache != NULL )
+    {
+        for ( i = 0; i < pState->cacheSize; i++ )
+        {
+            if ( pState->cache[i].hash != 0 )
+            {
+                j = (size_t)pState->cache[i].hash & ( size - 1 );
+                while ( cache[j].hash != 0 )
+                {
+                    j = ( j + 1 ) & ( size - 1 );
+                }
+
+                cache[j] = pState->cache[i];
+            }
+        }
+
+        free( pState->cache );
+        pState->cache = cache;
+        pState->cacheSize = size;
+        result = EOK;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Queue                                                                     */
+/*!
+    Add a variable value to the pending batch
+
+    The batch is set when it is full.  String and blob values are
+    referenced rather than copied, so the batch must be flushed
+    before the memory they refer to is released.
+
+    @param[in,out]
+        pState
+            pointer to the restore state
+
+    @param[in]
+        hVar
+            handle of the variable to set
+
+    @param[in]
+        pObj
+            pointer to the value to set
+
+    @retval EOK - success
+    @retval EIO - one or more variables could not be set
+
+==============================================================================*/
+static int Queue( RestoreState *pState, VAR_HANDLE hVar, VarObject *pObj )
+{
+    int result = EOK;
+
+    pState->handles[pState->pending] = hVar;
+    pState->values[pState->pending] = *pObj;
+    pState->pending++;
+
+    if ( pState->pending == pState->batchsize )
+    {
+        result = Flush( pState );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Flush                                                                     */
+/*!
+    Set the variables in the pending batch
+
+    @param[in,out]
+        pState
+            pointer to the restore state
+
+    @retval EOK - success
+    @retval EIO - one or more variables could not be set
+
+==============================================================================*/
+static int Flush( RestoreState *pState )
+{
+    int result = EOK;
+    int rc = ENOTSUP;
+    size_t i;
+
+    if ( pState->pending > 0 )
+    {
+#ifdef SAVESVC_VAR_SETBATCH
+        rc = VAR_SetBatch( pState->hVarServer,
+                           pState->handles,
+                           pState->values,
+                           pState->pending );
+        pState->calls++;
+#endif
+
+        if ( rc == EOK )
+        {
+            pState->set += pState->pending;
+        }
+        else
+        {
+            /* set the variables individually.  After a batch failure
+               this also finds out which variables failed */
+            for ( i = 0; i < pState->pending; i++ )
+            {
+                pState->calls++;
+                if ( VAR_Set( pState->hVarServer,
+                              pState->handles[i],
+                              &pState->values[i] ) == EOK )
+                {
+                    pState->set++;
+                }
+                else
+                {
+                    pState->failed++;
+                    result = EIO;
+                }
+            }
+        }
+
+        pState->pending = 0;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  IsStaleJournal                                                            */
+/*!
+    Determine if a mapped text file is a stale journal
+
+    The IsStaleJournal function checks the configuration file hash in
+    a journal header against the hash of the file restored before it.
+    A text file without a journal header, or a journal restored on its
+    own, is never stale.
+
+    @param[in]
+        pState
+            pointer to the restore state
+
+    @param[in]
+        data
+            pointer to the mapping of the file
+
+    @param[in]
+        size
+            size of the file
+
+    @retval true - the journal does not match the file restored before it
+    @retval false - the file is not a stale journal
+
+==============================================================================*/
+static bool IsStaleJournal( RestoreState *pState,
+                            const char *data,
+                            size_t size )
+{
+    bool result = false;
+    size_t start = sizeof( CONFIG_TITLE ) - 1;
+    size_t len = start + sizeof( JOURNAL_BASE_COMMENT ) - 1;
+    char text[17];
+    uint64_t base;
+    uint64_t hash;
+    uint64_t filesize;
+    uint64_t generation;
+    char *end;
+    int rc;
+
+    if ( ( pState->previous != NULL ) &&
+         ( pState->manifest == false ) &&
+         ( size > len + sizeof( text ) ) &&
+         ( memcmp( data, CONFIG_TITLE, start ) == 0 ) &&
+         ( memcmp( &data[start],
+                   JOURNAL_BASE_COMMENT,
+                   sizeof( JOURNAL_BASE_COMMENT ) - 1 ) == 0 ) )
+    {
+        /* the mapping is not terminated, so copy the hash out of it */
+        memcpy( text, &data[len], sizeof( text ) - 1 );
+        text[sizeof( text ) - 1] = '\0';
+        base = strtoull( text, &end, 16 );
+
+        rc = SAVEFMT_HashFile( pState->previous,
+                               &hash,
+                               &filesize,
+                               &generation );
+        if ( rc == EBADMSG )
+        {
+            rc = HashText( pState->previous, &hash );
+        }
+
+        result = ( *end == '\0' ) &&
+                 ( rc == EOK ) &&
+                 ( hash != base );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  HashText                                                                  */
+/*!
+    Calculate the output hash of a text configuration file
+
+    The HashText function calculates the hash of a text configuration
+    file in the same way as the Save Service, leaving any generation
+    marker out of the hash.
+
+    @param[in]
+        filename
+            name of the text configuration file
+
+    @param[out]
+        hash
+            pointer to the location to store the hash
+
+    @retval EOK - success
+    @retval other error from open(), fstat() or mmap()
+
+==============================================================================*/
+static int HashText( const char *filename, uint64_t *hash )
+{
+    int result = EOK;
+    size_t start = sizeof( CONFIG_TITLE ) - 1;
+    size_t marker = sizeof( GENERATION_COMMENT ) - 1;
+    struct stat st;
+    const char *data;
+    const char *eol;
+    size_t skip = 0;
+    size_t len;
+    void *p;
+    int fd;
+
+    *hash = HASH_INIT;
+
+    fd = open( filename, O_RDONLY );
+    if ( fd == -1 )
+    {
+        result = errno;
+    }
+    else
+    {
+        if ( fstat( fd, &st ) == -1 )
+        {
+            result = errno;
+        }
+        else if ( st.st_size > 0 )
+        {
+            len = (size_t)st.st_size;
+            p = mmap( NULL, len, PROT_READ, MAP_PRIVATE, fd, 0 );
+            if ( p == MAP_FAILED )
+            {
+                result = errno;
+            }
+            else
+            {
+                data = p;
+
+                /* find the generation marker following the title */
+                if ( ( len > start + marker ) &&
+                     ( memcmp( data, CONFIG_TITLE, start ) == 0 ) &&
+                     ( memcmp( &data[start],
+                               GENERATION_COMMENT,
+                               marker ) == 0 ) )
+                {
+                    eol = memchr( &data[start], '\n', len - start );
+                    if ( eol != NULL )
+                    {
+                        skip = (size_t)( eol - data ) + 1;
+                    }
+                }
+
+                if ( skip > 0 )
+                {
+                    *hash = HASH_Update( *hash, data, start );
+                    *hash = HASH_Update( *hash, &data[skip], len - skip );
+                }
+                else
+                {
+                    *hash = HASH_Update( *hash, data, len );
+                }
+
+                munmap( p, len );
+            }
+        }
+
+        close( fd );
+    }
+
+    return result;
+}
+
+/*! @}
+ * end of restore group */
@@ -0,0 +1,3356 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup saveconfig Save Configuration
+ * @brief Configuration file output for the Save Service
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file saveconfig.c
+
+    Save Configuration
+
+    The Save Configuration functions capture a snapshot of the dirty
+    variables and write the snapshot out to the configuration file
+    (or journal) in a format which is compatible with the loadconfig
+    utility.
+
+    These functions make up the save pipeline and are shared by the
+    Save Service and the save benchmark.
+
+    The durability mode selects how the output is synced to storage
+    before and after it is committed.  The time spent syncing is
+    recorded in the save statistics.
+
+    Each capture takes a generation marker before any variable is read,
+    so every captured value is at or after the marker.  In consistent
+    mode the marker is recorded in the configuration file header, and
+    a variable modified after the marker is always captured again by
+    a following save.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <varserver/varserver.h>
+#include <varserver/varquery.h>
+#include "savesvc.h"
+#include "hash.h"
+#include "varfmt.h"
+#include "savefmt.h"
+#include "profile.h"
+#include "shard.h"
+
+/*==============================================================================
+       Function declarations
+==============================================================================*/
+static bool NeedCompaction( SaveSvcState *pState );
+static Snapshot *FullSnapshot( SaveSvcState *pState, Snapshot *pSnapshot );
+static bool HasNames( SaveSvcState *pState );
+static bool IsSelected( void *arg, const char *name );
+static bool IsCovered( SaveSvcState *pState,
+                       const char *name,
+                       uint64_t profiles );
+static bool SameValue( SnapshotRecord *pRecord, SnapshotRecord *pCurrent );
+static int AppendJournal( SaveSvcState *pState, Snapshot *pSnapshot );
+static int RemoveJournal( SaveSvcState *pState );
+static int ReadJournalBase( const char *filename, uint64_t *base );
+static int WriteVar( SaveSvcState *pState, SnapshotRecord *pRecord );
+static bool HasChanges( SaveSvcState *pState, Snapshot *pSnapshot );
+static int ValueToString( SaveSvcState *pState, VarObject *pVarObject );
+static bool IsUnchanged( SaveSvcState *pState );
+static int LinkConfig( SaveSvcState *pState );
+static int SyncData( SaveSvcState *pState, int fd );
+static int SyncDir( SaveSvcState *pState, const char *filename );
+static uint64_t TimeNowUs( void );
+static void AddOutput( SaveSvcState *pState,
+                       uint64_t start,
+                       uint64_t writeTimeUs,
+                       uint64_t bytes );
+static int CommitRing( SaveSvcState *pState, int *pDone );
+static int LastStep( SaveSvcState *pState,
+                     int32_t *res,
+                     size_t len,
+                     int *pResult );
+static bool DeferOutput( SaveSvcState *pState );
+static void ResetArena( SaveSvcState *pState );
+static int WriteHeader( SaveSvcState *pState, Snapshot *pSnapshot );
+static size_t FindGeneration( const char *buf,
+                              size_t len,
+                              uint64_t *generation );
+
+/*==============================================================================
+       Definitions
+==============================================================================*/
+
+/*! size of the buffer for a generation marker comment */
+#define GENERATION_TEXT_SIZE ( 64 )
+
+/*! size of the buffer for a journal header */
+#define JOURNAL_HEADER_SIZE ( 64 )
+
+/*! commit steps completed by an io_uring commit chain.  Each step's
+    result is reported with the step as its tag */
+#define COMMIT_NONE ( 0 )
+#define COMMIT_WRITTEN ( 1 )
+#define COMMIT_SYNCED ( 2 )
+#define COMMIT_LINKED ( 3 )
+#define COMMIT_RENAMED ( 4 )
+#define COMMIT_STEPS ( 5 )
+
+/*==============================================================================
+      File Scoped Variables
+==============================================================================*/
+
+/*! durability mode names, indexed by Durability */
+static const char *durabilityNames[] =
+{
+    "none",
+    "fdatasync",
+    "dirsync",
+    "range"
+};
+
+/*! configuration file format names, indexed by SaveFormat */
+static const char *formatNames[] =
+{
+    "text",
+    "binary"
+};
+
+/*==============================================================================
+       Function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  CaptureDirtyVars                                                          */
+/*!
+    Capture a snapshot of the dirty variables
+
+    The CaptureDirtyVars function queries the variable server for all
+    of the dirty variables and captures them into the specified snapshot.
+    Variables are retrieved in batches where the variable server
+    supports it.
+
+    The query is narrowed by the tags and flags of the profile filters,
+    and by the variable names of a single profile filter.  If every
+    profile selects variables by name, the variables which are not
+    selected by any profile are then removed from the snapshot.
+
+    The snapshot is stamped with a new generation marker before any
+    variable is read.  A tracked variable modified from then on is
+    stamped with the marker in the dirty set, so it is not cleared
+    by ClearDirty once the snapshot is committed.
+
+    @param[in,out]
+        pState
+            pointer to the SaveSvc state
+
+    @param[in,out]
+        pSnapshot
+            pointer to the snapshot to capture into
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval ENOMEM - memory allocation failed
+
+==============================================================================*/
+int CaptureDirtyVars( SaveSvcState *pState, Snapshot *pSnapshot )
+{
+    int result = EINVAL;
+    SaveSvcState *pFirst;
+    VarQuery query;
+    uint64_t start;
+
+    if ( ( pState != NULL ) &&
+         ( pSnapshot != NULL ) )
+    {
+        start = TimeNowUs();
+
+        pSnapshot->generation = ++pState->generation;
+        pState->dirty.generation = pSnapshot->generation;
+
+        if ( pState->track == true )
+        {
+            result = DIRTYSET_Capture( &pState->dirty,
+                                       pSnapshot,
+                                       pState->hVarServer );
+        }
+        else
+        {
+            memset( &query, 0, sizeof( VarQuery ) );
+
+            query.type = QUERY_FLAGS;
+            query.flags = VARFLAG_DIRTY;
+
+            /* the profiles share their tags and flags (see PROFILE_Load) */
+            pFirst = ( pState->nprofiles > 0 ) ? pState->profiles[0]
+                                               : pState;
+            FILTER_Query( &pFirst->filter,
+                          &query,
+                          ( pState->nprofiles <= 1 ) );
+
+            result = SNAPSHOT_Capture( pSnapshot,
+                                       pState->hVarServer,
+                                       &query,
+                                       pState->batchsize );
+            if ( ( result == EOK ) &&
+                 ( HasNames( pState ) == true ) )
+            {
+                SNAPSHOT_Select( pSnapshot, IsSelected, pState );
+            }
+        }
+
+        if ( pState->pMetrics != NULL )
+        {
+            METRICS_Phase( pState->pMetrics,
+                           METRIC_QUERY,
+                           TimeNowUs() - start );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  InitTracking                                                              */
+/*!
+    Start tracking changes to the persistent variables
+
+    The InitTracking function requests a modification notification for
+    every non-volatile variable and registers it in the dirty set.
+    Variables which are already dirty are marked as modified.  The
+    notification is requested before the flags are checked so a change
+    made in between cannot be missed.  Only the variables selected by
+    the profile filters are tracked.
+
+    Once tracking is initialized, CaptureDirtyVars retrieves only the
+    variables in the dirty set instead of querying the variable server
+    for them on every save.
+
+    @param[in,out]
+        pState
+            pointer to the SaveSvc state
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval ENOMEM - memory allocation failed
+
+==============================================================================*/
+int InitTracking( SaveSvcState *pState )
+{
+    int result = EINVAL;
+    SaveSvcState *pFirst;
+    VarQuery query;
+    VarObject obj;
+    char buf[BUFSIZ];
+    uint32_t flags;
+    int rc;
+
+    if ( pState != NULL )
+    {
+        result = EOK;
+
+        memset( &query, 0, sizeof( VarQuery ) );
+
+        pFirst = ( pState->nprofiles > 0 ) ? pState->profiles[0] : pState;
+        FILTER_Query( &pFirst->filter, &query, ( pState->nprofiles <= 1 ) );
+
+        obj.val.str = buf;
+        obj.len = sizeof( buf );
+
+        rc = VAR_GetFirst( pState->hVarServer, &query, &obj );
+        while ( ( rc == EOK ) || ( rc == E2BIG ) )
+        {
+            if ( ( PROFILE_Triggered( pState, query.hVar ) == 0 ) &&
+                 ( IsSelected( pState, query.name ) == true ) &&
+                 ( VAR_GetFlags( pState->hVarServer,
+                                 query.hVar,
+                                 &flags ) == EOK ) &&
+                 ( ( flags & VARFLAG_VOLATILE ) == 0 ) )
+            {
+                result = DIRTYSET_Register( &pState->dirty,
+                                            query.hVar,
+                                            query.instanceID,
+                                            query.name );
+                if ( result != EOK )
+                {
+                    break;
+                }
+
+                rc = VAR_Notify( pState->hVarServer,
+                                 query.hVar,
+                                 NOTIFY_MODIFIED );
+                if ( rc != EOK )
+                {
+                    fprintf( stderr,
+                             "cannot track %s: %s\n",
+                             query.name,
+                             strerror( rc ) );
+                }
+
+                if ( ( VAR_GetFlags( pState->hVarServer,
+                                     query.hVar,
+                                     &flags ) != EOK ) ||
+                     ( ( flags & VARFLAG_DIRTY ) != 0 ) ||
+                     ( rc != EOK ) )
+                {
+                    /* capture variables which are dirty, or cannot be
+                       tracked, on every save */
+                    result = DIRTYSET_Mark( &pState->dirty, query.hVar );
+                    if ( result != EOK )
+                    {
+                        break;
+                    }
+                }
+            }
+
+            obj.val.str = buf;
+            obj.len = sizeof( buf );
+
+            rc = VAR_GetNext( pState->hVarServer, &query, &obj );
+        }
+
+        if ( pState->verbose == true )
+        {
+            printf( "Tracking %zu variables (%zu dirty)\n",
+                    pState->dirty.count,
+                    pState->dirty.dirty );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  ReconcileTracking                                                         */
+/*!
+    Reconcile the dirty set with the dirty flags of the variables
+
+    The ReconcileTracking function queries the variable server for the
+    dirty variables and marks each tracked one in the dirty set.  This
+    recovers modifications whose MODIFIED signal was dropped, for
+    example when the queued signals reach RLIMIT_SIGPENDING.
+
+    It is run before every save which re-writes the whole configuration
+    file, and periodically.  A dropped modification is still missing
+    from the journal appends made before the next reconciliation, and
+    is lost if the service stops in between without a final save.
+    With the writer thread, a compaction caused by the save in progress
+    is only known once that save completes, so it is covered by the
+    next reconciliation instead.
+
+    @param[in,out]
+        pState
+            pointer to the SaveSvc state
+
+    @param[out]
+        pMarked
+            pointer to the number of variables which were not already
+            marked as modified, or NULL
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval ENOMEM - memory allocation failed
+
+==============================================================================*/
+int ReconcileTracking( SaveSvcState *pState, size_t *pMarked )
+{
+    int result = EINVAL;
+    SaveSvcState *pFirst;
+    VarQuery query;
+    VarObject obj;
+    char buf[BUFSIZ];
+    size_t dirty;
+    int rc;
+
+    if ( pState != NULL )
+    {
+        result = EOK;
+        dirty = pState->dirty.dirty;
+
+        memset( &query, 0, sizeof( VarQuery ) );
+
+        query.type = QUERY_FLAGS;
+        query.flags = VARFLAG_DIRTY;
+
+        /* the profiles share their tags and flags (see PROFILE_Load) */
+        pFirst = ( pState->nprofiles > 0 ) ? pState->profiles[0] : pState;
+        FILTER_Query( &pFirst->filter, &query, ( pState->nprofiles <= 1 ) );
+
+        obj.val.str = buf;
+        obj.len = sizeof( buf );
+
+        rc = VAR_GetFirst( pState->hVarServer, &query, &obj );
+        while ( ( rc == EOK ) || ( rc == E2BIG ) )
+        {
+            if ( ( PROFILE_Triggered( pState, query.hVar ) == 0 ) &&
+                 ( IsSelected( pState, query.name ) == true ) )
+            {
+                /* variables which are not tracked are ignored */
+                rc = DIRTYSET_Mark( &pState->dirty, query.hVar );
+                if ( rc == ENOMEM )
+                {
+                    result = rc;
+                    break;
+                }
+            }
+
+            obj.val.str = buf;
+            obj.len = sizeof( buf );
+
+            rc = VAR_GetNext( pState->hVarServer, &query, &obj );
+        }
+
+        if ( pMarked != NULL )
+        {
+            *pMarked = pState->dirty.dirty - dirty;
+        }
+
+        if ( ( pState->verbose == true ) &&
+             ( pState->dirty.dirty != dirty ) )
+        {
+            printf( "Reconciled %zu modified variables\n",
+                    pState->dirty.dirty - dirty );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  HasDirtyVars                                                              */
+/*!
+    Check whether any variable needs to be saved
+
+    The HasDirtyVars function queries the variable server for the dirty
+    variables and stops at the first one which is selected for saving.
+    It lets an automatic save without modification tracking be skipped
+    without capturing a snapshot of the variables.
+
+    @param[in]
+        pState
+            pointer to the SaveSvc state
+
+    @retval true - at least one selected variable is dirty
+    @retval false - no selected variable is dirty
+
+==============================================================================*/
+bool HasDirtyVars( SaveSvcState *pState )
+{
+    SaveSvcState *pFirst;
+    VarQuery query;
+    VarObject obj;
+    char buf[BUFSIZ];
+    bool dirty = false;
+    int rc;
+
+    if ( pState != NULL )
+    {
+        memset( &query, 0, sizeof( VarQuery ) );
+
+        query.type = QUERY_FLAGS;
+        query.flags = VARFLAG_DIRTY;
+
+        /* the profiles share their tags and flags (see PROFILE_Load) */
+        pFirst = ( pState->nprofiles > 0 ) ? pState->profiles[0] : pState;
+        FILTER_Query( &pFirst->filter, &query, ( pState->nprofiles <= 1 ) );
+
+        obj.val.str = buf;
+        obj.len = sizeof( buf );
+
+        rc = VAR_GetFirst( pState->hVarServer, &query, &obj );
+        while ( ( ( rc == EOK ) || ( rc == E2BIG ) ) && ( dirty == false ) )
+        {
+            if ( ( PROFILE_Triggered( pState, query.hVar ) == 0 ) &&
+                 ( IsSelected( pState, query.name ) == true ) )
+            {
+                dirty = true;
+            }
+            else
+            {
+                obj.val.str = buf;
+                obj.len = sizeof( buf );
+
+                rc = VAR_GetNext( pState->hVarServer, &query, &obj );
+            }
+        }
+    }
+
+    return dirty;
+}
+
+/*============================================================================*/
+/*  SaveConfig                                                                */
+/*!
+    Save the dirty variables
+
+    The SaveConfig function writes out the dirty variables.  By default
+    the entire configuration file is re-written.
+
+    In journal mode, only the variables which have changed since the
+    last save are appended to the journal file.  The configuration file
+    is re-written (compacted) on the first save, after any failure, and
+    whenever the journal exceeds its compaction thresholds.  The journal
+    can be replayed by loading it after the configuration file.
+
+    The journal header records the hash of the configuration file it
+    was started against.  The journal is only removed once a compacted
+    configuration file has been committed, and a journal left behind
+    by a failure in between does not match the compacted file, so it
+    is ignored instead of being replayed over it.
+
+    If a re-written configuration file would be identical to the
+    committed configuration file, it is discarded instead of committed.
+
+    If the output is sharded, each shard is saved to its own file and
+    the output file is a manifest listing the shard files.
+
+    If dirty flags are cleared once the variables are committed, the
+    snapshot only holds the variables modified since the previous save.
+    They are added to the save history, and a re-written configuration
+    file holds every variable in the save history.
+
+    The time spent in each phase of the save, and the variables and
+    bytes written, are measured and recorded in the save metrics.
+
+    @param[in,out]
+        pState
+            pointer to the SaveSvc state
+
+    @param[in]
+        pSnapshot
+            pointer to the snapshot of the dirty variables
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval other error from the save
+
+==============================================================================*/
+int SaveConfig( SaveSvcState *pState, Snapshot *pSnapshot )
+{
+    int result = EINVAL;
+    char stats[STATS_TEXT_SIZE];
+    Snapshot *pFull;
+    uint64_t skipped = 0;
+    uint64_t start = 0;
+
+    if ( pState != NULL )
+    {
+        /* start measuring the save */
+        memset( &pState->sample, 0, sizeof( MetricSample ) );
+        skipped = pState->stats.skipped;
+        start = TimeNowUs();
+    }
+
+    if ( ( pState != NULL ) &&
+         ( pState->shards != NULL ) )
+    {
+        pFull = FullSnapshot( pState, pSnapshot );
+        result = ( pFull != NULL ) ? SHARD_Save( pState, pFull ) : ENOMEM;
+    }
+    else if ( pState != NULL )
+    {
+        if ( ( pState->journal == true ) &&
+             ( pState->synced == true ) &&
+             ( NeedCompaction( pState ) == false ) )
+        {
+            if ( pState->verbose == true )
+            {
+                printf("Appending changed variables to journal\n");
+            }
+
+            result = AppendJournal( pState, pSnapshot );
+            if ( ( result == EOK ) &&
+                 ( pState->clearDirty == true ) )
+            {
+                result = HISTORY_Update( &pState->history,
+                                         pSnapshot,
+                                         &pState->filter );
+            }
+        }
+        else
+        {
+            if ( pState->verbose == true )
+            {
+                printf("Saving all dirty variables\n");
+            }
+
+            /* a full save refreshes the saved variable table */
+            VARTAB_Clear( &pState->saved );
+            pState->synced = pState->journal;
+            pState->delta = false;
+
+            /* Create the variable configuration file */
+            pFull = FullSnapshot( pState, pSnapshot );
+            result = ( pFull != NULL ) ? InitConfig( pState ) : ENOMEM;
+            if ( result == EOK )
+            {
+                result = WriteConfig( pState, pFull );
+
+                if ( ( result == EOK ) &&
+                     ( pState->unchanged == true ) )
+                {
+                    /* the configuration file is already up to date */
+                    if ( pState->verbose == true )
+                    {
+                        printf( "Configuration unchanged\n" );
+                    }
+
+                    DiscardConfig( pState );
+                    pState->stats.skipped++;
+                }
+                else if ( result == EOK )
+                {
+                    result = FinalizeConfig( pState );
+                    if ( result == EOK )
+                    {
+                        /* record the content of the committed file */
+                        pState->committedHash = pState->out.hash;
+                        pState->committedSize = pState->out.count;
+                        pState->baseSize = pState->out.count;
+                        pState->committed = true;
+                    }
+                    else
+                    {
+                        DiscardConfig( pState );
+                    }
+
+                    if ( ( result == EOK ) &&
+                         ( pState->journal == true ) )
+                    {
+                        /* the journal has been compacted into the
+                           committed configuration file */
+                        result = RemoveJournal( pState );
+                    }
+                }
+                else
+                {
+                    DiscardConfig( pState );
+                }
+            }
+        }
+
+        pState->stats.saves++;
+
+        if ( result != EOK )
+        {
+            pState->stats.failures++;
+
+            /* force a full save next time */
+            pState->synced = false;
+        }
+
+        if ( ( pState->verbose == true ) &&
+             ( FormatStats( pState, stats, sizeof( stats ) ) == EOK ) )
+        {
+            printf( "%s\n", stats );
+        }
+    }
+
+    if ( ( pState != NULL ) &&
+         ( pState->pMetrics != NULL ) )
+    {
+        METRICS_Add( &pState->sample, METRIC_SAVE, TimeNowUs() - start );
+        METRICS_Record( pState->pMetrics,
+                        &pState->sample,
+                        result,
+                        ( pState->stats.skipped != skipped ) );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  FullSnapshot                                                              */
+/*!
+    Get the snapshot of all of the variables to be saved
+
+    The FullSnapshot function gets the snapshot to write to a re-written
+    configuration file.  This is the captured snapshot itself, unless
+    dirty flags are cleared once the variables are committed, when the
+    captured variables are added to the save history and the snapshot
+    is built from the save history.
+
+    @param[in,out]
+        pState
+            pointer to the SaveSvc state
+
+    @param[in]
+        pSnapshot
+            pointer to the snapshot of the dirty variables
+
+    @retval pointer to the snapshot of all of the variables to save
+    @retval NULL if memory allocation failed
+
+==============================================================================*/
+static Snapshot *FullSnapshot( SaveSvcState *pState, Snapshot *pSnapshot )
+{
+    Snapshot *pFull = pSnapshot;
+
+    if ( pState->clearDirty == true )
+    {
+        pFull = NULL;
+
+        if ( HISTORY_Update( &pState->history,
+                             pSnapshot,
+                             &pState->filter ) == EOK )
+        {
+            pFull = HISTORY_Build( &pState->history );
+        }
+
+        if ( pFull != NULL )
+        {
+            pFull->generation = pSnapshot->generation;
+        }
+    }
+
+    return pFull;
+}
+
+/*============================================================================*/
+/*  InitHistory                                                               */
+/*!
+    Initialize the save history
+
+    The InitHistory function seeds the save history with the variables
+    of the committed configuration file and its journal, so the
+    variables whose dirty flags were cleared by an earlier run are
+    still saved.
+
+    @param[in,out]
+        pState
+            pointer to the SaveSvc state
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval ENOMEM - memory allocation failed
+    @retval other error from reading the committed files
+
+==============================================================================*/
+int InitHistory( SaveSvcState *pState )
+{
+    int result = EINVAL;
+
+    if ( pState != NULL )
+    {
+        result = HISTORY_Init( &pState->history, HISTORY_DEFAULT_SIZE );
+        if ( result == EOK )
+        {
+            result = HISTORY_Load( &pState->history, pState->filename );
+        }
+
+        if ( ( result == EOK ) &&
+             ( pState->journal == true ) )
+        {
+            result = HISTORY_Load( &pState->history, pState->journalfile );
+        }
+
+        if ( ( result == EOK ) &&
+             ( pState->verbose == true ) )
+        {
+            printf( "Save history has %zu variables\n",
+                    pState->history.count );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  ClearDirty                                                                */
+/*!
+    Clear the dirty flags of committed variables
+
+    The ClearDirty function clears the dirty flag of each variable in
+    the snapshot which has been committed by every profile which saves
+    it, so the next save only captures the variables modified since.
+    A variable which is not saved by any profile is left dirty.
+
+    The dirty flag is cleared before the variable is read back, and is
+    set again if the value no longer matches the snapshot.  A variable
+    modified after it was captured is therefore still saved by the
+    next save, whether it was modified before or after its flag was
+    cleared.
+
+    If modified variables are tracked, each committed variable is also
+    removed from the dirty set unless it has been modified since the
+    generation marker of the snapshot, so the next capture only reads
+    the variables modified after the marker.
+
+    The values are read back into a snapshot held in the SaveSvc state,
+    so after the first save no memory is allocated unless a value is
+    larger than any before it.  This snapshot is not taken from the
+    save arena, which belongs to the writer thread.
+
+    This interacts with the variable server, so it must be called on
+    the main thread.
+
+    @param[in,out]
+        pState
+            pointer to the SaveSvc state
+
+    @param[in]
+        pSnapshot
+            pointer to the committed snapshot
+
+    @param[in]
+        profiles
+            profiles (one bit per profile) which committed the snapshot
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval ENOMEM - memory allocation failed
+    @retval other error from the first dirty flag which could not
+            be cleared
+
+==============================================================================*/
+int ClearDirty( SaveSvcState *pState, Snapshot *pSnapshot, uint64_t profiles )
+{
+    int result = EINVAL;
+    SnapshotRecord *pRecord;
+    SnapshotRecord *pCurrent;
+    Snapshot *pCurrentSnapshot;
+    size_t cleared = 0;
+    char *name;
+    int rc;
+
+    if ( ( pState != NULL ) &&
+         ( pSnapshot != NULL ) )
+    {
+        pCurrentSnapshot = &pState->readback;
+        result = ( pCurrentSnapshot->buf == NULL )
+                    ? SNAPSHOT_Init( pCurrentSnapshot, BUFSIZ )
+                    : EOK;
+    }
+
+    if ( result == EOK )
+    {
+        pRecord = SNAPSHOT_First( pSnapshot );
+        while ( pRecord != NULL )
+        {
+            name = SNAPSHOT_Name( pRecord );
+
+            if ( ( pRecord->hVar != VAR_INVALID ) &&
+                 ( IsCovered( pState, name, profiles ) == true ) )
+            {
+                if ( pState->track == true )
+                {
+                    (void)DIRTYSET_Clear( &pState->dirty,
+                                          pRecord->hVar,
+                                          pSnapshot->generation );
+                }
+
+                rc = VAR_ClearFlags( pState->hVarServer,
+                                     pRecord->hVar,
+                                     VARFLAG_DIRTY );
+                if ( rc == EOK )
+                {
+                    /* read back the value to catch a modification
+                       made since the variable was captured */
+                    SNAPSHOT_Reset( pCurrentSnapshot );
+                    rc = SNAPSHOT_Get( pCurrentSnapshot,
+                                       pState->hVarServer,
+                                       pRecord->hVar,
+                                       pRecord->instanceID,
+                                       name );
+                    pCurrent = SNAPSHOT_First( pCurrentSnapshot );
+                    if ( ( rc != EOK ) ||
+                         ( pCurrent == NULL ) ||
+                         ( SameValue( pRecord, pCurrent ) == false ) )
+                    {
+                        rc = VAR_SetFlags( pState->hVarServer,
+                                           pRecord->hVar,
+                                           VARFLAG_DIRTY );
+                    }
+                    else
+                    {
+                        cleared++;
+                    }
+                }
+
+                if ( ( rc != EOK ) &&
+                     ( result == EOK ) )
+                {
+                    fprintf( stderr,
+                             "cannot clear dirty flag of %s: %s\n",
+                             name,
+                             strerror( rc ) );
+                    result = rc;
+                }
+            }
+
+            pRecord = SNAPSHOT_Next( pSnapshot, pRecord );
+        }
+
+        if ( pState->track == true )
+        {
+            DIRTYSET_Compact( &pState->dirty );
+        }
+
+        if ( pState->verbose == true )
+        {
+            printf( "Cleared %zu dirty flags\n", cleared );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  HasNames                                                                  */
+/*!
+    Determine if every profile selects its variables by name
+
+    @param[in]
+        pState
+            pointer to the SaveSvc state
+
+    @retval true - every profile filter selects variables by name
+    @retval false - at least one profile saves variables of any name
+
+==============================================================================*/
+static bool HasNames( SaveSvcState *pState )
+{
+    SaveSvcState *pProfile;
+    bool result = true;
+    size_t n;
+    size_t i;
+
+    /* a state without profiles is its own profile */
+    n = ( pState->nprofiles > 0 ) ? pState->nprofiles : 1;
+
+    for ( i = 0; ( i < n ) && ( result == true ); i++ )
+    {
+        pProfile = ( pState->nprofiles > 0 ) ? pState->profiles[i] : pState;
+        result = FILTER_HasNames( &pProfile->filter );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  IsSelected                                                                */
+/*!
+    Determine if a variable is saved by any profile
+
+    @param[in]
+        arg
+            pointer to the SaveSvc state
+
+    @param[in]
+        name
+            name of the variable
+
+    @retval true - the variable is selected by at least one profile
+    @retval false - the variable is not selected by any profile
+
+==============================================================================*/
+static bool IsSelected( void *arg, const char *name )
+{
+    SaveSvcState *pState = (SaveSvcState *)arg;
+    SaveSvcState *pProfile;
+    bool result = false;
+    size_t n;
+    size_t i;
+
+    /* a state without profiles is its own profile */
+    n = ( pState->nprofiles > 0 ) ? pState->nprofiles : 1;
+
+    for ( i = 0; ( i < n ) && ( result == false ); i++ )
+    {
+        pProfile = ( pState->nprofiles > 0 ) ? pState->profiles[i] : pState;
+        result = FILTER_Match( &pProfile->filter, name );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  IsCovered                                                                 */
+/*!
+    Determine if a variable has been committed by every profile saving it
+
+    @param[in]
+        pState
+            pointer to the SaveSvc state
+
+    @param[in]
+        name
+            name of the variable
+
+    @param[in]
+        profiles
+            profiles (one bit per profile) which committed the variable
+
+    @retval true - the variable is saved by at least one profile, and
+            every profile which saves it has committed it
+    @retval false - the variable is not saved, or a profile which saves
+            it has not committed it
+
+==============================================================================*/
+static bool IsCovered( SaveSvcState *pState,
+                       const char *name,
+                       uint64_t profiles )
+{
+    SaveSvcState *pProfile;
+    bool saved = false;
+    bool covered = true;
+    size_t n;
+    size_t i;
+
+    /* a state without profiles is its own profile */
+    n = ( pState->nprofiles > 0 ) ? pState->nprofiles : 1;
+
+    for ( i = 0; ( i < n ) && ( covered == true ); i++ )
+    {
+        pProfile = ( pState->nprofiles > 0 ) ? pState->profiles[i] : pState;
+
+        if ( FILTER_Match( &pProfile->filter, name ) == true )
+        {
+            saved = true;
+            covered = ( ( profiles & ( (uint64_t)1 << i ) ) != 0 );
+        }
+    }
+
+    return ( saved == true ) && ( covered == true );
+}
+
+/*============================================================================*/
+/*  SameValue                                                                 */
+/*!
+    Compare the values of two records of a variable
+
+    @param[in]
+        pRecord
+            pointer to the first record
+
+    @param[in]
+        pCurrent
+            pointer to the second record
+
+    @retval true - the records have the same type and value
+    @retval false - the records differ
+
+==============================================================================*/
+static bool SameValue( SnapshotRecord *pRecord, SnapshotRecord *pCurrent )
+{
+    bool result = false;
+
+    if ( pRecord->type == pCurrent->type )
+    {
+        switch( pRecord->type )
+        {
+            case VARTYPE_UINT16:
+                result = ( pRecord->val.ui == pCurrent->val.ui );
+                break;
+
+            case VARTYPE_INT16:
+                result = ( pRecord->val.i == pCurrent->val.i );
+                break;
+
+            case VARTYPE_UINT32:
+                result = ( pRecord->val.ul == pCurrent->val.ul );
+                break;
+
+            case VARTYPE_INT32:
+                result = ( pRecord->val.l == pCurrent->val.l );
+                break;
+
+            case VARTYPE_UINT64:
+                result = ( pRecord->val.ull == pCurrent->val.ull );
+                break;
+
+            case VARTYPE_INT64:
+                result = ( pRecord->val.ll == pCurrent->val.ll );
+                break;
+
+            case VARTYPE_FLOAT:
+                result = ( memcmp( &pRecord->val.f,
+                                   &pCurrent->val.f,
+                                   sizeof( float ) ) == 0 );
+                break;
+
+            case VARTYPE_STR:
+            case VARTYPE_BLOB:
+                result = ( pRecord->len == pCurrent->len ) &&
+                         ( memcmp( SNAPSHOT_Data( pRecord ),
+                                   SNAPSHOT_Data( pCurrent ),
+                                   pRecord->len ) == 0 );
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  InitJournal                                                               */
+/*!
+    Initialize journal mode
+
+    The InitJournal function creates the journal file name and allocates
+    the table of saved variable values.
+
+    A journal left behind by a compaction which was interrupted after
+    the configuration file was committed does not match the committed
+    configuration file, so it is removed.  The hash of the committed
+    configuration file must already have been read with HashConfig.
+
+    @param[in,out]
+        pState
+            pointer to the SaveSvc state
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval E2BIG - the journal file name is too long
+    @retval ENOMEM - memory allocation failed
+
+==============================================================================*/
+int InitJournal( SaveSvcState *pState )
+{
+    int result = EINVAL;
+    struct stat st;
+    uint64_t base;
+    int n;
+
+    if ( ( pState != NULL ) &&
+         ( pState->filename != NULL ) )
+    {
+        n = snprintf( pState->journalfile,
+                      sizeof pState->journalfile,
+                      "%s.journal",
+                      pState->filename );
+        if ( ( n > 0 ) && ( (size_t)n < sizeof pState->journalfile ) )
+        {
+            result = VARTAB_Init( &pState->saved, VARTAB_DEFAULT_SIZE );
+        }
+        else
+        {
+            result = E2BIG;
+        }
+
+        if ( ( result == EOK ) &&
+             ( pState->committed == true ) &&
+             ( ReadJournalBase( pState->journalfile, &base ) == EOK ) &&
+             ( base != pState->committedHash ) )
+        {
+            if ( pState->verbose == true )
+            {
+                printf( "Removing stale journal %s\n", pState->journalfile );
+            }
+
+            /* if it cannot be removed, it is removed by the first save */
+            (void)RemoveJournal( pState );
+        }
+
+        if ( ( result == EOK ) &&
+             ( stat( pState->journalfile, &st ) == 0 ) )
+        {
+            /* the journal must be compacted before the configuration
+               file can be considered unchanged */
+            pState->journalSize = (uint64_t)st.st_size;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  ReadJournalBase                                                           */
+/*!
+    Read the configuration file hash from a journal header
+
+    @param[in]
+        filename
+            name of the journal file
+
+    @param[out]
+        base
+            pointer to the location to store the hash of the configuration
+            file the journal is replayed over
+
+    @retval EOK - success
+    @retval ENOENT - the journal does not exist
+    @retval EBADMSG - the journal header has no configuration file hash
+    @retval other error from open() or read()
+
+==============================================================================*/
+static int ReadJournalBase( const char *filename, uint64_t *base )
+{
+    int result;
+    char header[JOURNAL_HEADER_SIZE];
+    size_t start = sizeof( CONFIG_TITLE ) - 1;
+    size_t len = start + sizeof( JOURNAL_BASE_COMMENT ) - 1;
+    ssize_t n;
+    char *end;
+    int fd;
+
+    fd = open( filename, O_RDONLY );
+    if ( fd == -1 )
+    {
+        result = errno;
+    }
+    else
+    {
+        do
+        {
+            n = read( fd, header, sizeof( header ) - 1 );
+        } while ( ( n == -1 ) && ( errno == EINTR ) );
+
+        if ( n == -1 )
+        {
+            result = errno;
+        }
+        else
+        {
+            header[n] = '\0';
+            result = EBADMSG;
+
+            if ( ( (size_t)n > len ) &&
+                 ( memcmp( header, CONFIG_TITLE, start ) == 0 ) &&
+                 ( memcmp( &header[start],
+                           JOURNAL_BASE_COMMENT,
+                           sizeof( JOURNAL_BASE_COMMENT ) - 1 ) == 0 ) )
+            {
+                *base = strtoull( &header[len], &end, 16 );
+                if ( *end == '\n' )
+                {
+                    result = EOK;
+                }
+            }
+        }
+
+        close( fd );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  RemoveJournal                                                             */
+/*!
+    Remove the journal
+
+    The RemoveJournal function removes the journal once its variables
+    are held in the committed configuration file.  If the journal cannot
+    be removed, nothing more is appended to it until a later compaction
+    has removed it, since its header names the previous configuration
+    file.
+
+    @param[in,out]
+        pState
+            pointer to the SaveSvc state
+
+    @retval EOK - success
+    @retval other error from unlink()
+
+==============================================================================*/
+static int RemoveJournal( SaveSvcState *pState )
+{
+    int result = EOK;
+
+    if ( ( unlink( pState->journalfile ) == 0 ) ||
+         ( errno == ENOENT ) )
+    {
+        pState->journalSize = 0;
+    }
+    else
+    {
+        result = errno;
+        fprintf( stderr,
+                 "Cannot remove journal %s: %s\n",
+                 pState->journalfile,
+                 strerror( result ) );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  NeedCompaction                                                            */
+/*!
+    Determine if the journal needs to be compacted
+
+    The NeedCompaction function checks the size of the journal against
+    the absolute size threshold and the size ratio threshold relative
+    to the configuration file.
+
+    @param[in]
+        pState
+            pointer to the SaveSvc state
+
+    @retval true - the journal should be compacted
+    @retval false - the journal should be appended to
+
+==============================================================================*/
+static bool NeedCompaction( SaveSvcState *pState )
+{
+    bool result = false;
+
+    if ( pState != NULL )
+    {
+        if ( pState->journalSize >= pState->compactSize )
+        {
+            result = true;
+        }
+        else if ( ( pState->journalSize * 100 ) >=
+                  ( pState->baseSize * pState->compactRatio ) )
+        {
+            /* only compact on ratio once the journal has content */
+            result = ( pState->journalSize > 0 );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  FullSaveDue                                                               */
+/*!
+    Check whether the next save re-writes the whole configuration file
+
+    The FullSaveDue function checks whether the next save of a profile
+    re-writes (or compacts) its whole configuration file, rather than
+    appending to its journal.  This is the case for every save without a
+    journal, and for the first save, a save after a failure, and a save
+    which finds a compaction threshold exceeded in journal mode.
+
+    @param[in]
+        pState
+            pointer to the SaveSvc state of the profile
+
+    @retval true - the next save re-writes the whole configuration file
+    @retval false - the next save appends to the journal
+
+==============================================================================*/
+bool FullSaveDue( SaveSvcState *pState )
+{
+    bool result = true;
+
+    if ( ( pState != NULL ) &&
+         ( pState->shards == NULL ) &&
+         ( pState->journal == true ) &&
+         ( pState->synced == true ) )
+    {
+        result = NeedCompaction( pState );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  AppendJournal                                                             */
+/*!
+    Append changed variables to the journal
+
+    The AppendJournal function appends the dirty variables whose values
+    have changed since the last save to the journal file.  The journal
+    is synced according to the durability mode.  If the append
+    fails, the journal is truncated back to its previous size.  If no
+    variable has changed, the journal is not opened or created and
+    the save is counted as skipped.
+
+    In consistent mode, the appended variables are followed by the
+    generation marker of the snapshot they were captured in.
+
+    @param[in,out]
+        pState
+            pointer to the SaveSvc state
+
+    @param[in]
+        pSnapshot
+            pointer to the snapshot of the dirty variables
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval other error from open() or writev()
+
+==============================================================================*/
+static int AppendJournal( SaveSvcState *pState, Snapshot *pSnapshot )
+{
+    int result = EINVAL;
+    char header[JOURNAL_HEADER_SIZE];
+    char marker[GENERATION_TEXT_SIZE];
+    struct stat st;
+    uint64_t bytes;
+    uint64_t writeTimeUs;
+    uint64_t start;
+    int fd;
+
+    if ( ( pState != NULL ) &&
+         ( HasChanges( pState, pSnapshot ) == false ) )
+    {
+        /* there is nothing to append */
+        pState->count = 0;
+        pState->stats.skipped++;
+        result = EOK;
+
+        if ( pState->verbose == true )
+        {
+            printf( "No changed variables to append to %s\n",
+                    pState->journalfile );
+        }
+    }
+    else if ( pState != NULL )
+    {
+        fd = open( pState->journalfile,
+                   O_CREAT | O_WRONLY | O_APPEND,
+                   0644 );
+        if ( fd == -1 )
+        {
+            result = errno;
+        }
+        else if ( fstat( fd, &st ) == -1 )
+        {
+            result = errno;
+            close( fd );
+        }
+        else
+        {
+            OUTBUF_Attach( &pState->out, fd );
+            OUTBUF_SetWriteback( &pState->out,
+                                 ( pState->durability == DURABILITY_RANGE ),
+                                 (uint64_t)st.st_size );
+            bytes = pState->out.bytes;
+            writeTimeUs = pState->out.writeTimeUs;
+            start = TimeNowUs();
+
+            result = EOK;
+            if ( st.st_size == 0 )
+            {
+                /* write the header into a new journal, identifying the
+                   configuration file it is replayed over */
+                snprintf( header,
+                          sizeof header,
+                          CONFIG_TITLE JOURNAL_BASE_COMMENT "%016" PRIx64
+                          "\n\n",
+                          pState->committedHash );
+                result = OUTBUF_Puts( &pState->out, header );
+            }
+
+            if ( result == EOK )
+            {
+                pState->delta = true;
+                result = WriteConfigVars( pState, pSnapshot );
+                pState->delta = false;
+                pState->sample.vars += pState->count;
+            }
+
+            if ( ( result == EOK ) &&
+                 ( pState->consistent == true ) &&
+                 ( pState->count > 0 ) )
+            {
+                /* mark the appended variables with their generation */
+                snprintf( marker,
+                          sizeof marker,
+                          GENERATION_COMMENT "%" PRIu64 "\n",
+                          pSnapshot->generation );
+                result = OUTBUF_Puts( &pState->out, marker );
+            }
+
+            if ( result == EOK )
+            {
+                result = OUTBUF_Flush( &pState->out );
+            }
+            else
+            {
+                /* the incomplete output is not appended */
+                OUTBUF_Discard( &pState->out );
+            }
+
+            AddOutput( pState, start, writeTimeUs, bytes );
+
+            if ( result == EOK )
+            {
+                result = SyncData( pState, fd );
+            }
+
+            if ( ( result == EOK ) && ( st.st_size == 0 ) )
+            {
+                /* make sure a new journal is in its directory */
+                result = SyncDir( pState, pState->journalfile );
+            }
+
+            if ( result == EOK )
+            {
+                pState->journalSize = (uint64_t)st.st_size +
+                                      ( pState->out.bytes - bytes );
+                if ( pState->verbose == true )
+                {
+                    printf( "Appended %zu variables to %s\n",
+                            pState->count,
+                            pState->journalfile );
+                }
+            }
+            else
+            {
+                fprintf( stderr,
+                         "Journal output failed: %s\n",
+                         strerror( result ) );
+
+                /* remove any partially appended output */
+                if ( ftruncate( fd, st.st_size ) == -1 )
+                {
+                    fprintf( stderr,
+                             "Cannot truncate journal: %s\n",
+                             strerror( errno ) );
+                }
+            }
+
+            close( fd );
+        }
+
+        ResetArena( pState );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  InitConfig                                                                */
+/*!
+    Initialize the configuration file
+
+    The InitConfig function creates and opens a new temporary file
+    for writing the dirty configuration data into.
+
+    Where the file system supports it, the temporary file is created
+    as an anonymous O_TMPFILE inode in the directory of the configuration
+    file.  It has no name until it is committed by FinalizeConfig, so
+    no stale temporary file is left behind if the save is interrupted.
+    Otherwise a named temporary file is created.
+
+    if the file is successfully created, pState->fd is a handle to
+    the configuration file which was opened for writing
+
+    @param[in,out]
+        pState
+            pointer to the SaveSvc state which contains the config file name
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval other error from open()
+
+==============================================================================*/
+int InitConfig( SaveSvcState *pState )
+{
+    int result = EINVAL;
+    char dir[BUFSIZ];
+    int n;
+
+    if ( ( pState != NULL ) &&
+         ( pState->filename != NULL ) )
+    {
+        /* create the temporary file name */
+        n = snprintf( pState->tmpfile,
+                      sizeof pState->tmpfile,
+                      "%s.tmp",
+                      pState->filename );
+        if ( ( n > 0 ) &&
+             ( (size_t)n < sizeof pState->tmpfile ) )
+        {
+            pState->anonymous = false;
+            pState->named = false;
+
+            if ( pState->noTmpfile == false )
+            {
+                /* create an anonymous file in the output directory */
+                strcpy( dir, pState->tmpfile );
+                pState->fd = open( dirname( dir ),
+                                   O_TMPFILE | O_WRONLY,
+                                   0644 );
+                if ( pState->fd != -1 )
+                {
+                    pState->anonymous = true;
+                    result = EOK;
+                }
+                else if ( ( errno == EOPNOTSUPP ) ||
+                          ( errno == EISDIR ) ||
+                          ( errno == EINVAL ) )
+                {
+                    /* O_TMPFILE is not supported here: stop trying */
+                    pState->noTmpfile = true;
+                }
+                else
+                {
+                    result = errno;
+                }
+            }
+
+            if ( pState->noTmpfile == true )
+            {
+                /* remove any previous file which may be left around */
+                (void)unlink( pState->tmpfile );
+
+                /* open the output file for creation/writing */
+                pState->fd = open( pState->tmpfile,
+                                   O_CREAT | O_TRUNC | O_WRONLY,
+                                   0644 );
+                result = ( pState->fd != -1 ) ? EOK : errno;
+                pState->named = ( result == EOK );
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  WriteConfig                                                               */
+/*!
+    Write data to the configuration file
+
+    The WriteConfig function iterates through all of the dirty configuration
+    variables and writes them to the configuration file as var=value pairs.
+
+    All output is accumulated in the buffered output writer and written
+    to the configuration file in large blocks.  The output is synced
+    according to the durability mode.  The configuration file remains
+    open until it is committed by FinalizeConfig or discarded by
+    DiscardConfig.
+
+    @param[in,out]
+        pState
+            pointer to the SaveSvc state which contains the config
+            file descriptor
+
+    @param[in]
+        pSnapshot
+            pointer to the snapshot of the dirty variables
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval other error from WriteConfigVars() or writev()
+
+==============================================================================*/
+int WriteConfig( SaveSvcState *pState, Snapshot *pSnapshot )
+{
+    int result = EINVAL;
+    uint64_t bytes;
+    uint64_t writeTimeUs;
+    uint64_t start;
+
+    if ( ( pState != NULL ) &&
+         ( pState->fd != -1 ) )
+    {
+        bytes = pState->out.bytes;
+        writeTimeUs = pState->out.writeTimeUs;
+        start = TimeNowUs();
+
+        /* direct the buffered output to the configuration file */
+        OUTBUF_Attach( &pState->out, pState->fd );
+        OUTBUF_SetWriteback( &pState->out,
+                             ( pState->durability == DURABILITY_RANGE ),
+                             0 );
+
+        /* write the file header */
+        result = WriteHeader( pState, pSnapshot );
+
+        if ( result != EOK )
+        {
+            fprintf( stderr, "Header output failed\n" );
+        }
+        else
+        {
+            /* output all dirty variables */
+            result = WriteConfigVars( pState, pSnapshot );
+            if ( result != EOK )
+            {
+                /* the incomplete output will not be committed */
+                OUTBUF_Discard( &pState->out );
+                pState->unchanged = false;
+            }
+            else
+            {
+                /* check if the output matches the committed file */
+                pState->unchanged = IsUnchanged( pState );
+                if ( pState->unchanged == true )
+                {
+                    /* the output will not be committed */
+                    OUTBUF_Discard( &pState->out );
+                }
+                else
+                {
+                    pState->sample.vars += pState->count;
+                }
+
+                /* write out any remaining buffered output, unless it is
+                   written by the io_uring commit chain */
+                result = ( DeferOutput( pState ) == true )
+                            ? pState->out.error
+                            : OUTBUF_Flush( &pState->out );
+            }
+
+            AddOutput( pState, start, writeTimeUs, bytes );
+            if ( result != EOK )
+            {
+                fprintf( stderr,
+                         "Output failed: %s\n",
+                         strerror( result ) );
+            }
+            else if ( pState->unchanged == false )
+            {
+                if ( pState->format == FORMAT_BINARY )
+                {
+                    /* complete the binary file header */
+                    result = SAVEFMT_End( &pState->binary, pState->fd );
+                }
+
+                if ( ( result == EOK ) &&
+                     ( pState->pRing == NULL ) )
+                {
+                    /* make sure the output is on storage before it
+                       is committed */
+                    result = SyncData( pState, pState->fd );
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  WriteConfigVars                                                           */
+/*!
+    Write dirty variables to the configuration file
+
+    The WriteConfigVars function iterates through all of the dirty configuration
+    variables in the snapshot and writes them to the configuration file
+    as var=value pairs, or as binary records in the binary format.
+    If the state has a profile filter, only the variables whose names
+    are selected by the filter are written.
+
+    A variable which cannot be written is reported and the remaining
+    variables are still written, but the first error is returned so
+    the incomplete output is not committed.
+
+    @param[in,out]
+        pState
+            pointer to the SaveSvc state which contains the config
+            file descriptor
+
+    @param[in]
+        pSnapshot
+            pointer to the snapshot of the dirty variables
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval other error from writing the first failed variable
+
+==============================================================================*/
+int WriteConfigVars( SaveSvcState *pState, Snapshot *pSnapshot )
+{
+    int result = EINVAL;
+    SnapshotRecord *pRecord;
+    int rc;
+
+    if ( ( pState != NULL ) &&
+         ( pSnapshot != NULL ) )
+    {
+        result = EOK;
+
+        pState->count = 0;
+
+        pRecord = SNAPSHOT_First( pSnapshot );
+        while ( pRecord != NULL )
+        {
+            if ( FILTER_Match( &pState->filter,
+                               SNAPSHOT_Name( pRecord ) ) == false )
+            {
+                /* not selected by the profile filter */
+                rc = EOK;
+            }
+            else if ( pState->format == FORMAT_BINARY )
+            {
+                rc = SAVEFMT_Write( &pState->binary, pRecord );
+                if ( rc == EOK )
+                {
+                    pState->count++;
+                }
+            }
+            else
+            {
+                rc = WriteVar( pState, pRecord );
+            }
+
+            if ( rc != EOK )
+            {
+                printf( "cannot save %s: rc=%s\n",
+                        SNAPSHOT_Name( pRecord ),
+                        strerror( rc ) );
+
+                if ( result == EOK )
+                {
+                    result = rc;
+                }
+            }
+
+            pRecord = SNAPSHOT_Next( pSnapshot, pRecord );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  WriteVar                                                                  */
+/*!
+    Write a variable to the configuration file as a var=value pair
+
+    The WriteVar function writes the variable key and value to the
+    output buffer.  Numeric values are formatted directly into the
+    output buffer by the type specialized value formatters.  Other
+    values are converted with VAROBJECT_ToString.
+
+    Every variable is interned in the saved variable table, where its
+    "[id]name=" key text is formatted once and written with a single
+    copy on each save.  In journal mode the table also tracks the saved
+    value, and unchanged variables are not written to the journal.
+    A variable without a handle is not interned, so its key is
+    formatted on each save, in the save arena if the name is too long
+    for the key buffer.
+
+    @param[in,out]
+        pState
+            pointer to the SaveSvc state
+
+    @param[in]
+        pRecord
+            pointer to the snapshot record of the variable
+
+    @retval EOK - success
+    @retval ENOMEM - memory allocation failed
+    @retval other error from ValueToString()
+
+==============================================================================*/
+static int WriteVar( SaveSvcState *pState, SnapshotRecord *pRecord )
+{
+    char keybuf[MAX_NAME_LEN + 16];
+    VarTabEntry *pEntry;
+    VarObject obj;
+    char *key;
+    char *value = NULL;
+    char *p = NULL;
+    bool changed = true;
+    size_t keylen;
+    size_t len = 0;
+    int rc = EOK;
+
+    /* get the interned variable key */
+    pEntry = VARTAB_Intern( &pState->saved,
+                            pRecord->hVar,
+                            pRecord->instanceID,
+                            SNAPSHOT_Name( pRecord ),
+                            pRecord->namelen );
+    if ( pEntry != NULL )
+    {
+        key = pEntry->text;
+        keylen = pEntry->keylen;
+    }
+    else if ( pRecord->instanceID != 0 )
+    {
+        /* build the key of a variable without a handle */
+        key = ( pRecord->namelen <= MAX_NAME_LEN )
+                ? keybuf
+                : ARENA_Alloc( &pState->arena,
+                               pRecord->namelen + sizeof keybuf );
+        keylen = 0;
+        if ( key != NULL )
+        {
+            key[0] = '[';
+            keylen = 1 + VARFMT_Unsigned( &key[1], pRecord->instanceID );
+            key[keylen++] = ']';
+            memcpy( &key[keylen],
+                    SNAPSHOT_Name( pRecord ),
+                    pRecord->namelen );
+            keylen += pRecord->namelen;
+            key[keylen] = '=';
+        }
+        else
+        {
+            rc = ENOMEM;
+        }
+    }
+    else
+    {
+        key = SNAPSHOT_Name( pRecord );
+        keylen = pRecord->namelen;
+    }
+
+    if ( rc != EOK )
+    {
+        /* there is no key to write the value with */
+    }
+    else if ( pRecord->type == VARTYPE_STR )
+    {
+        /* we already have a string value in the snapshot */
+        value = SNAPSHOT_Data( pRecord );
+        len = strlen( value );
+    }
+    else
+    {
+        /* format a numeric value in place after the key and '=' */
+        p = OUTBUF_Reserve( &pState->out, keylen + VARFMT_MAX_LEN + 2 );
+        if ( p != NULL )
+        {
+            len = VARFMT_Value( &p[keylen + 1],
+                                pRecord->type,
+                                &pRecord->val );
+            value = ( len > 0 ) ? &p[keylen + 1] : NULL;
+        }
+
+        if ( value == NULL )
+        {
+            /* convert other objects to strings */
+            p = NULL;
+            obj.type = pRecord->type;
+            obj.len = pRecord->len;
+            obj.val = pRecord->val;
+            if ( pRecord->type == VARTYPE_BLOB )
+            {
+                obj.val.blob = SNAPSHOT_Data( pRecord );
+            }
+
+            rc = ValueToString( pState, &obj );
+            value = pState->valbuf;
+            len = ( rc == EOK ) ? strlen( value ) : 0;
+        }
+    }
+
+    if ( ( rc == EOK ) && ( keylen > 0 ) )
+    {
+        if ( ( pState->journal == true ) &&
+             ( pEntry != NULL ) )
+        {
+            /* track the saved value to detect changes.  This may move
+               the key text */
+            changed = VARTAB_Update( &pState->saved, pEntry, value, len );
+            key = pEntry->text;
+        }
+        else if ( ( pState->journal == true ) &&
+                  ( pRecord->hVar != VAR_INVALID ) )
+        {
+            /* cannot track: treat the variable as changed */
+            pState->synced = false;
+        }
+
+        if ( ( pState->delta == false ) || ( changed == true ) )
+        {
+            if ( p != NULL )
+            {
+                /* complete the var=value pair around the value */
+                memcpy( p, key, keylen );
+                p[keylen] = '=';
+                p[keylen + 1 + len] = '\n';
+                OUTBUF_Commit( &pState->out, keylen + len + 2 );
+            }
+            else if ( key != SNAPSHOT_Name( pRecord ) )
+            {
+                /* write the var=value pair to the output buffer.  The
+                   key text is followed by its '=' */
+                OUTBUF_Write( &pState->out, key, keylen + 1 );
+                OUTBUF_Write( &pState->out, value, len );
+                OUTBUF_Write( &pState->out, "\n", 1 );
+            }
+            else
+            {
+                /* write the var=value pair to the output buffer */
+                OUTBUF_Write( &pState->out, key, keylen );
+                OUTBUF_Write( &pState->out, "=", 1 );
+                OUTBUF_Write( &pState->out, value, len );
+                OUTBUF_Write( &pState->out, "\n", 1 );
+            }
+
+            pState->count++;
+        }
+    }
+
+    return rc;
+}
+
+/*============================================================================*/
+/*  HasChanges                                                                */
+/*!
+    Check whether any variable has changed since it was last saved
+
+    The HasChanges function checks the variables selected by the profile
+    filter against their saved values without recording them, and stops
+    at the first changed variable.  It lets a journal append with
+    nothing to write return before the journal is opened.
+
+    A variable which is not tracked in the saved variable table, or
+    whose value is not formatted by the value formatters, is reported
+    as changed and is checked again when it is written.
+
+    @param[in,out]
+        pState
+            pointer to the SaveSvc state
+
+    @param[in]
+        pSnapshot
+            pointer to the snapshot of the dirty variables
+
+    @retval true - at least one variable may have changed
+    @retval false - no variable has changed
+
+==============================================================================*/
+static bool HasChanges( SaveSvcState *pState, Snapshot *pSnapshot )
+{
+    SnapshotRecord *pRecord;
+    VarTabEntry *pEntry;
+    char buf[VARFMT_MAX_LEN];
+    const char *value;
+    size_t len;
+    bool changed = false;
+
+    if ( pSnapshot == NULL )
+    {
+        changed = true;
+    }
+    else
+    {
+        pRecord = SNAPSHOT_First( pSnapshot );
+        while ( ( pRecord != NULL ) && ( changed == false ) )
+        {
+            if ( FILTER_Match( &pState->filter,
+                               SNAPSHOT_Name( pRecord ) ) == true )
+            {
+                pEntry = VARTAB_Intern( &pState->saved,
+                                        pRecord->hVar,
+                                        pRecord->instanceID,
+                                        SNAPSHOT_Name( pRecord ),
+                                        pRecord->namelen );
+                if ( pRecord->type == VARTYPE_STR )
+                {
+                    value = SNAPSHOT_Data( pRecord );
+                    len = strlen( value );
+                }
+                else
+                {
+                    len = VARFMT_Value( buf, pRecord->type, &pRecord->val );
+                    value = ( len > 0 ) ? buf : NULL;
+                }
+
+                changed = VARTAB_Changed( &pState->saved,
+                                          pEntry,
+                                          value,
+                                          len );
+            }
+
+            pRecord = SNAPSHOT_Next( pSnapshot, pRecord );
+        }
+    }
+
+    return changed;
+}
+
+/*============================================================================*/
+/*  ValueToString                                                             */
+/*!
+    Convert a value to text in the value text buffer
+
+    The ValueToString function converts a value with VAROBJECT_ToString
+    into the value text buffer.  If the text does not fit, a buffer of
+    twice the size is allocated from the save arena and the conversion
+    retried, up to MAX_VALUE_TEXT_SIZE.  The buffer is retained for the
+    subsequent conversions of the save.
+
+    @param[in,out]
+        pState
+            pointer to the SaveSvc state which contains the value
+            text buffer
+
+    @param[in]
+        pVarObject
+            pointer to the value to convert
+
+    @retval EOK - success
+    @retval ENOMEM - memory allocation failed
+    @retval E2BIG - the text is larger than MAX_VALUE_TEXT_SIZE
+    @retval other error from VAROBJECT_ToString()
+
+==============================================================================*/
+static int ValueToString( SaveSvcState *pState, VarObject *pVarObject )
+{
+    int result = E2BIG;
+    size_t size;
+    char *p;
+
+    if ( pState->valbuf != NULL )
+    {
+        result = VAROBJECT_ToString( pVarObject,
+                                     pState->valbuf,
+                                     pState->valbufSize );
+    }
+
+    while ( ( result == E2BIG ) &&
+            ( pState->valbufSize < MAX_VALUE_TEXT_SIZE ) )
+    {
+        size = ( pState->valbufSize > 0 ) ? pState->valbufSize * 2 : BUFSIZ;
+        p = ARENA_Alloc( &pState->arena, size );
+        if ( p != NULL )
+        {
+            pState->valbuf = p;
+            pState->valbufSize = size;
+            result = VAROBJECT_ToString( pVarObject,
+                                         pState->valbuf,
+                                         pState->valbufSize );
+        }
+        else
+        {
+            result = ENOMEM;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  FinalizeConfig                                                            */
+/*!
+    Finalize the configuration file
+
+    The FinalizeConfig function moves the configuration data written
+    to the temporary file into the final configuration file via a
+    rename operation.  This ensures that there is never a time when
+    the configuration file does not exist (except for on first startup
+    when no configuration data has been saved)
+
+    An anonymous temporary file is first given the temporary file name
+    with linkat(), since linkat() cannot replace an existing file.
+
+    Depending on the durability mode, the directory containing the
+    configuration file is synced after the rename.
+
+    With io_uring, the output still held in the output buffer is written,
+    synced, linked and renamed by a single linked chain.  Any step the
+    chain did not complete, for example after a short write, is then
+    completed with synchronous system calls.
+
+    The temporary file descriptor is closed, and the working memory
+    of the save is released to the save arena.
+
+    @param[in]
+        pState
+            pointer to the SaveSvc state which contains the name of the
+            configuration file.
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval other error from write(), fdatasync(), linkat(), rename()
+            or fsync()
+
+==============================================================================*/
+int FinalizeConfig( SaveSvcState *pState )
+{
+    int result = EINVAL;
+    int done = COMMIT_NONE;
+    uint64_t start;
+    int rc;
+
+    if ( ( pState != NULL ) &&
+         ( pState->filename != NULL ) )
+    {
+        result = EOK;
+        start = TimeNowUs();
+
+        if ( pState->pRing != NULL )
+        {
+            result = CommitRing( pState, &done );
+            if ( done >= COMMIT_LINKED )
+            {
+                pState->named = true;
+            }
+
+            if ( ( result == EOK ) &&
+                 ( done < COMMIT_WRITTEN ) )
+            {
+                result = OUTBUF_Flush( &pState->out );
+            }
+
+            if ( ( result == EOK ) &&
+                 ( done < COMMIT_SYNCED ) )
+            {
+                result = SyncData( pState, pState->fd );
+            }
+        }
+
+        if ( ( result == EOK ) &&
+             ( pState->anonymous == true ) &&
+             ( done < COMMIT_LINKED ) )
+        {
+            result = LinkConfig( pState );
+        }
+
+        if ( ( result == EOK ) &&
+             ( done < COMMIT_RENAMED ) )
+        {
+            rc = rename( pState->tmpfile, pState->filename );
+            result = ( rc == 0 ) ? EOK : errno;
+        }
+
+        if ( result == EOK )
+        {
+            /* the temporary file name has been renamed */
+            pState->named = false;
+        }
+
+        METRICS_Add( &pState->sample, METRIC_RENAME, TimeNowUs() - start );
+
+        if ( pState->fd != -1 )
+        {
+            close( pState->fd );
+            pState->fd = -1;
+        }
+
+        if ( result == EOK )
+        {
+            /* make sure the rename is on storage */
+            result = SyncDir( pState, pState->filename );
+        }
+
+        ResetArena( pState );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  CommitRing                                                                */
+/*!
+    Commit the configuration file with an io_uring chain
+
+    The CommitRing function submits the write of the buffered output,
+    the fdatasync, the linkat of an anonymous temporary file, and the
+    rename over the configuration file as one linked chain, and waits
+    for it to complete.
+
+    A step which is cancelled, for example after a short write or when
+    the temporary file name is already in use, is left for the caller
+    to complete synchronously.  A ring which cannot be used leaves every
+    step to the caller.
+
+    @param[in,out]
+        pState
+            pointer to the SaveSvc state
+
+    @param[out]
+        pDone
+            pointer to the location to store the last step completed
+
+    @retval EOK - success
+    @retval other error from the first step which failed
+
+==============================================================================*/
+static int CommitRing( SaveSvcState *pState, int *pDone )
+{
+    int result;
+    int32_t res[COMMIT_STEPS];
+    OutBuf *pOut = &pState->out;
+    char path[64];
+    size_t len = pOut->len;
+    int done = COMMIT_NONE;
+    bool sync = ( pState->durability != DURABILITY_NONE );
+    bool link = pState->anonymous;
+
+    result = pOut->error;
+    if ( ( result == EOK ) &&
+         ( len > 0 ) )
+    {
+        result = URING_Write( pState->pRing,
+                              pState->fd,
+                              pOut->buf,
+                              len,
+                              pOut->offset,
+                              pState->ringBuf,
+                              COMMIT_WRITTEN );
+    }
+
+    if ( ( result == EOK ) &&
+         ( sync == true ) )
+    {
+        result = URING_Fdatasync( pState->pRing, pState->fd, COMMIT_SYNCED );
+    }
+
+    if ( ( result == EOK ) &&
+         ( link == true ) )
+    {
+        snprintf( path, sizeof path, "/proc/self/fd/%d", pState->fd );
+        result = URING_LinkAt( pState->pRing,
+                               path,
+                               pState->tmpfile,
+                               AT_SYMLINK_FOLLOW,
+                               COMMIT_LINKED );
+    }
+
+    if ( result == EOK )
+    {
+        result = URING_RenameAt( pState->pRing,
+                                 pState->tmpfile,
+                                 pState->filename,
+                                 COMMIT_RENAMED );
+    }
+
+    if ( result == EOK )
+    {
+        result = URING_Run( pState->pRing, res, COMMIT_STEPS );
+        if ( result == EOK )
+        {
+            done = LastStep( pState, res, len, &result );
+        }
+    }
+    else if ( pOut->error == EOK )
+    {
+        /* the chain cannot be queued, so commit synchronously */
+        URING_Discard( pState->pRing );
+        result = EOK;
+    }
+
+    *pDone = done;
+
+    return result;
+}
+
+/*============================================================================*/
+/*  LastStep                                                                  */
+/*!
+    Get the last step completed by an io_uring commit chain
+
+    The LastStep function accounts for the output written by the chain,
+    and finds the last step of the chain which completed.  A step which
+    was not part of the chain completes with the step before it.
+
+    @param[in,out]
+        pState
+            pointer to the SaveSvc state
+
+    @param[in,out]
+        res
+            result of each step, indexed by step
+
+    @param[in]
+        len
+            number of bytes the chain was to write
+
+    @param[out]
+        pResult
+            pointer to the location to store the error of the first step
+            which failed.  A step which was cancelled, or which found the
+            temporary file name in use, is not an error, since it can be
+            completed synchronously
+
+    @retval the last step completed
+
+==============================================================================*/
+static int LastStep( SaveSvcState *pState,
+                     int32_t *res,
+                     size_t len,
+                     int *pResult )
+{
+    int done = COMMIT_NONE;
+    int step;
+
+    if ( len == 0 )
+    {
+        /* there was nothing to write */
+        res[COMMIT_WRITTEN] = 0;
+    }
+    else if ( res[COMMIT_WRITTEN] >= 0 )
+    {
+        /* account for the output written by the chain */
+        OUTBUF_Consume( &pState->out, (size_t)res[COMMIT_WRITTEN] );
+        if ( (size_t)res[COMMIT_WRITTEN] < len )
+        {
+            /* a short write cancels the rest of the chain.  The chain
+               wrote at an explicit offset which did not move the file
+               position, so move it past the written data before the
+               rest of the output is written with writev() */
+            res[COMMIT_WRITTEN] = -ECANCELED;
+            if ( lseek( pState->fd,
+                        (off_t)pState->out.offset,
+                        SEEK_SET ) == (off_t)-1 )
+            {
+                res[COMMIT_WRITTEN] = -errno;
+            }
+        }
+    }
+
+    if ( pState->durability == DURABILITY_NONE )
+    {
+        res[COMMIT_SYNCED] = res[COMMIT_WRITTEN];
+    }
+    else if ( res[COMMIT_SYNCED] == 0 )
+    {
+        pState->stats.syncs++;
+    }
+
+    if ( pState->anonymous == false )
+    {
+        res[COMMIT_LINKED] = res[COMMIT_SYNCED];
+    }
+
+    for ( step = COMMIT_WRITTEN;
+          ( step <= COMMIT_RENAMED ) && ( res[step] >= 0 );
+          step++ )
+    {
+        done = step;
+    }
+
+    if ( ( step <= COMMIT_RENAMED ) &&
+         ( res[step] != -ECANCELED ) &&
+         ( res[step] != -EEXIST ) )
+    {
+        *pResult = -res[step];
+    }
+
+    return done;
+}
+
+/*============================================================================*/
+/*  DeferOutput                                                               */
+/*!
+    Determine if the buffered output is written by the commit chain
+
+    The final output of a text file is left in the output buffer, to
+    be written by the io_uring commit chain.  The output of a binary
+    file is flushed before its header is written at the start of the
+    file, so the header cannot be overwritten by the buffered output.
+
+    @param[in]
+        pState
+            pointer to the SaveSvc state
+
+    @retval true - the buffered output is written by the commit chain
+    @retval false - the buffered output is flushed now
+
+==============================================================================*/
+static bool DeferOutput( SaveSvcState *pState )
+{
+    return ( pState->pRing != NULL ) &&
+           ( pState->unchanged == false ) &&
+           ( pState->format == FORMAT_TEXT );
+}
+
+/*============================================================================*/
+/*  ResetArena                                                                */
+/*!
+    Release the working memory of a save
+
+    The ResetArena function resets the save arena once the output
+    of a save is committed or discarded.  The value text buffer is
+    allocated from the arena, so it is released too.
+
+    @param[in,out]
+        pState
+            pointer to the SaveSvc state
+
+==============================================================================*/
+static void ResetArena( SaveSvcState *pState )
+{
+    ARENA_Reset( &pState->arena );
+    pState->valbuf = NULL;
+    pState->valbufSize = 0;
+}
+
+/*============================================================================*/
+/*  WriteHeader                                                               */
+/*!
+    Write the configuration file header
+
+    The WriteHeader function writes the header of a text or binary
+    configuration file.  In consistent mode the header records the
+    generation marker of the snapshot.  The marker is not part of the
+    output hash, so output which differs only in its marker is still
+    detected as unchanged.
+
+    @param[in,out]
+        pState
+            pointer to the SaveSvc state
+
+    @param[in]
+        pSnapshot
+            pointer to the snapshot being written
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval other error from the buffered output
+
+==============================================================================*/
+static int WriteHeader( SaveSvcState *pState, Snapshot *pSnapshot )
+{
+    int result = EINVAL;
+    char marker[GENERATION_TEXT_SIZE];
+
+    if ( pState->format == FORMAT_BINARY )
+    {
+        result = SAVEFMT_Begin( &pState->binary, &pState->out );
+        if ( ( result == EOK ) &&
+             ( pState->consistent == true ) &&
+             ( pSnapshot != NULL ) )
+        {
+            /* the generation is filled in by SAVEFMT_End */
+            pState->binary.generation = pSnapshot->generation;
+        }
+    }
+    else
+    {
+        result = OUTBUF_Puts( &pState->out, CONFIG_TITLE );
+        if ( ( result == EOK ) &&
+             ( pState->consistent == true ) &&
+             ( pSnapshot != NULL ) )
+        {
+            snprintf( marker,
+                      sizeof marker,
+                      GENERATION_COMMENT "%" PRIu64 "\n",
+                      pSnapshot->generation );
+            result = OUTBUF_Annotate( &pState->out, marker );
+        }
+
+        if ( result == EOK )
+        {
+            result = OUTBUF_Puts( &pState->out, "\n" );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  FindGeneration                                                            */
+/*!
+    Find the generation marker in the start of a text configuration file
+
+    @param[in]
+        buf
+            pointer to the start of the file
+
+    @param[in]
+        len
+            number of bytes of the file in the buffer
+
+    @param[out]
+        generation
+            pointer to the location to store the generation marker
+
+    @retval offset of the end of the generation marker line, or zero
+            if the file does not start with a generation marker
+
+==============================================================================*/
+static size_t FindGeneration( const char *buf,
+                              size_t len,
+                              uint64_t *generation )
+{
+    size_t start = sizeof( CONFIG_TITLE ) - 1;
+    size_t offset = 0;
+    const char *eol;
+
+    if ( ( len > start + sizeof( GENERATION_COMMENT ) - 1 ) &&
+         ( memcmp( buf, CONFIG_TITLE, start ) == 0 ) &&
+         ( memcmp( &buf[start],
+                   GENERATION_COMMENT,
+                   sizeof( GENERATION_COMMENT ) - 1 ) == 0 ) )
+    {
+        eol = memchr( &buf[start], '\n', len - start );
+        if ( eol != NULL )
+        {
+            *generation = strtoull( &buf[start +
+                                         sizeof( GENERATION_COMMENT ) - 1],
+                                    NULL,
+                                    10 );
+            offset = (size_t)( eol - buf ) + 1;
+        }
+    }
+
+    return offset;
+}
+
+/*============================================================================*/
+/*  SaveText                                                                  */
+/*!
+    Save a text file
+
+    The SaveText function replaces the output file with the specified
+    text, using the same temporary file, durability, and commit steps as
+    a configuration file save.  The file is not rewritten if the text
+    matches the committed file.
+
+    @param[in,out]
+        pState
+            pointer to the SaveSvc state which contains the output file name
+
+    @param[in]
+        text
+            NUL terminated text to save
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval other error from the file creation, output, or commit
+
+==============================================================================*/
+int SaveText( SaveSvcState *pState, const char *text )
+{
+    int result = EINVAL;
+    uint64_t bytes;
+    uint64_t writeTimeUs;
+    uint64_t start;
+
+    if ( ( pState != NULL ) &&
+         ( text != NULL ) )
+    {
+        result = InitConfig( pState );
+        if ( result == EOK )
+        {
+            bytes = pState->out.bytes;
+            writeTimeUs = pState->out.writeTimeUs;
+            start = TimeNowUs();
+
+            OUTBUF_Attach( &pState->out, pState->fd );
+
+            result = OUTBUF_Puts( &pState->out, text );
+            if ( result == EOK )
+            {
+                /* check if the output matches the committed file */
+                pState->unchanged = IsUnchanged( pState );
+                if ( pState->unchanged == true )
+                {
+                    OUTBUF_Discard( &pState->out );
+                }
+
+                result = ( DeferOutput( pState ) == true )
+                            ? pState->out.error
+                            : OUTBUF_Flush( &pState->out );
+            }
+
+            AddOutput( pState, start, writeTimeUs, bytes );
+
+            if ( ( result == EOK ) &&
+                 ( pState->unchanged == false ) )
+            {
+                if ( pState->pRing == NULL )
+                {
+                    result = SyncData( pState, pState->fd );
+                }
+
+                if ( result == EOK )
+                {
+                    result = FinalizeConfig( pState );
+                }
+
+                if ( result == EOK )
+                {
+                    /* record the content of the committed file */
+                    pState->committedHash = pState->out.hash;
+                    pState->committedSize = pState->out.count;
+                    pState->committed = true;
+                }
+            }
+
+            if ( ( result != EOK ) ||
+                 ( pState->unchanged == true ) )
+            {
+                DiscardConfig( pState );
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  DiscardConfig                                                             */
+/*!
+    Discard the configuration file
+
+    The DiscardConfig function closes the temporary file (if it is still
+    open) and removes it without committing it.  An anonymous temporary
+    file which was never linked is released when it is closed.  The
+    working memory of the save is released to the save arena.
+
+    @param[in]
+        pState
+            pointer to the SaveSvc state
+
+==============================================================================*/
+void DiscardConfig( SaveSvcState *pState )
+{
+    if ( pState != NULL )
+    {
+        if ( pState->fd != -1 )
+        {
+            close( pState->fd );
+            pState->fd = -1;
+        }
+
+        /* remove the named file, including one linked before a
+           failed commit.  An anonymous file which was never linked
+           has no name to remove */
+        if ( pState->named == true )
+        {
+            (void)unlink( pState->tmpfile );
+            pState->named = false;
+        }
+
+        ResetArena( pState );
+    }
+}
+
+/*============================================================================*/
+/*  LinkConfig                                                                */
+/*!
+    Link the anonymous temporary file into the file system
+
+    The LinkConfig function gives the anonymous temporary file the
+    temporary file name so it can be renamed over the configuration file.
+    A temporary file left behind by an interrupted commit is replaced.
+
+    @param[in]
+        pState
+            pointer to the SaveSvc state
+
+    @retval EOK - success
+    @retval other error from linkat()
+
+==============================================================================*/
+static int LinkConfig( SaveSvcState *pState )
+{
+    int result = EOK;
+    char path[64];
+    int rc;
+
+    snprintf( path, sizeof path, "/proc/self/fd/%d", pState->fd );
+
+    rc = linkat( AT_FDCWD,
+                 path,
+                 AT_FDCWD,
+                 pState->tmpfile,
+                 AT_SYMLINK_FOLLOW );
+    if ( ( rc == -1 ) && ( errno == EEXIST ) )
+    {
+        /* remove the leftover and try again */
+        (void)unlink( pState->tmpfile );
+        rc = linkat( AT_FDCWD,
+                     path,
+                     AT_FDCWD,
+                     pState->tmpfile,
+                     AT_SYMLINK_FOLLOW );
+    }
+
+    if ( rc == -1 )
+    {
+        result = errno;
+    }
+    else
+    {
+        pState->named = true;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  IsUnchanged                                                               */
+/*!
+    Determine if the output matches the committed configuration file
+
+    The IsUnchanged function compares the hash and size of the output
+    written since the output buffer was attached with the hash and
+    size of the committed configuration file.
+
+    In journal mode the output is only considered unchanged if the
+    journal is empty, since the journal would otherwise be replayed
+    over the configuration file.
+
+    @param[in]
+        pState
+            pointer to the SaveSvc state
+
+    @retval true - the output matches the committed configuration file
+    @retval false - the output differs from the committed configuration file
+
+==============================================================================*/
+static bool IsUnchanged( SaveSvcState *pState )
+{
+    bool result = false;
+
+    if ( ( pState != NULL ) &&
+         ( pState->committed == true ) &&
+         ( pState->out.error == EOK ) &&
+         ( pState->out.hash == pState->committedHash ) &&
+         ( pState->out.count == pState->committedSize ) )
+    {
+        result = ( pState->journal == false ) ||
+                 ( pState->journalSize == 0 );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  HashFile                                                                  */
+/*!
+    Calculate the hash of a file
+
+    The HashFile function calculates the hash and size of the content
+    of the specified file, using the same hash as the output buffer.
+    A generation marker at the start of a configuration file is not
+    part of the output hash, so it is left out of the hash and size,
+    and returned separately.
+
+    @param[in]
+        filename
+            name of the file to hash
+
+    @param[out]
+        hash
+            pointer to the location to store the hash
+
+    @param[out]
+        size
+            pointer to the location to store the file size
+
+    @param[out]
+        generation
+            pointer to the location to store the generation marker,
+            or zero if the file has no generation marker
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval other error from open() or read()
+
+==============================================================================*/
+int HashFile( const char *filename,
+              uint64_t *hash,
+              uint64_t *size,
+              uint64_t *generation )
+{
+    int result = EINVAL;
+    char buf[BUFSIZ];
+    size_t start = sizeof( CONFIG_TITLE ) - 1;
+    size_t skip;
+    bool first = true;
+    ssize_t n;
+    int fd;
+
+    if ( ( filename != NULL ) &&
+         ( hash != NULL ) &&
+         ( size != NULL ) &&
+         ( generation != NULL ) )
+    {
+        *hash = HASH_INIT;
+        *size = 0;
+        *generation = 0;
+
+        fd = open( filename, O_RDONLY );
+        if ( fd != -1 )
+        {
+            result = EOK;
+
+            while ( ( n = read( fd, buf, sizeof buf ) ) != 0 )
+            {
+                if ( n > 0 )
+                {
+                    /* leave the generation marker out of the hash */
+                    skip = ( first == true )
+                            ? FindGeneration( buf, (size_t)n, generation )
+                            : 0;
+                    if ( skip > 0 )
+                    {
+                        *hash = HASH_Update( *hash, buf, start );
+                        *hash = HASH_Update( *hash,
+                                             &buf[skip],
+                                             (size_t)n - skip );
+                        *size += (uint64_t)( (size_t)n - ( skip - start ) );
+                    }
+                    else
+                    {
+                        *hash = HASH_Update( *hash, buf, (size_t)n );
+                        *size += (uint64_t)n;
+                    }
+
+                    first = false;
+                }
+                else if ( errno != EINTR )
+                {
+                    result = errno;
+                    break;
+                }
+            }
+
+            close( fd );
+        }
+        else
+        {
+            result = errno;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  ParseDurability                                                           */
+/*!
+    Parse a durability mode name
+
+    The ParseDurability function converts a durability mode name
+    (none, fdatasync, dirsync, or range) to a durability mode.
+
+    @param[in]
+        name
+            name of the durability mode
+
+    @param[out]
+        pDurability
+            pointer to the location to store the durability mode
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments or unknown durability mode
+
+==============================================================================*/
+int ParseDurability( const char *name, Durability *pDurability )
+{
+    int result = EINVAL;
+    size_t n = sizeof durabilityNames / sizeof durabilityNames[0];
+    size_t i;
+
+    if ( ( name != NULL ) &&
+         ( pDurability != NULL ) )
+    {
+        for ( i = 0; i < n; i++ )
+        {
+            if ( strcmp( name, durabilityNames[i] ) == 0 )
+            {
+                *pDurability = (Durability)i;
+                result = EOK;
+                break;
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  ParseFormat                                                               */
+/*!
+    Parse a configuration file format name
+
+    The ParseFormat function converts a configuration file format name
+    (text or binary) to a configuration file format.
+
+    @param[in]
+        name
+            name of the configuration file format
+
+    @param[out]
+        pFormat
+            pointer to the location to store the configuration file format
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments or unknown format
+
+==============================================================================*/
+int ParseFormat( const char *name, SaveFormat *pFormat )
+{
+    int result = EINVAL;
+    size_t n = sizeof formatNames / sizeof formatNames[0];
+    size_t i;
+
+    if ( ( name != NULL ) &&
+         ( pFormat != NULL ) )
+    {
+        for ( i = 0; i < n; i++ )
+        {
+            if ( strcmp( name, formatNames[i] ) == 0 )
+            {
+                *pFormat = (SaveFormat)i;
+                result = EOK;
+                break;
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  HashConfig                                                                */
+/*!
+    Get the hash of the committed configuration file
+
+    The HashConfig function calculates the output hash and size of the
+    committed configuration file, so that identical output is not
+    re-committed.  If there is no valid committed configuration file
+    in the current format, the next output is always committed.
+
+    The generation of the state is advanced to the generation marker
+    of the committed configuration file, so generation markers keep
+    increasing across restarts.  The committed configuration file is
+    the base file of the journal compaction ratio.
+
+    @param[in,out]
+        pState
+            pointer to the SaveSvc state
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval other error from HashFile() or SAVEFMT_HashFile()
+
+==============================================================================*/
+int HashConfig( SaveSvcState *pState )
+{
+    int result = EINVAL;
+    uint64_t generation = 0;
+
+    if ( pState != NULL )
+    {
+        if ( pState->format == FORMAT_BINARY )
+        {
+            result = SAVEFMT_HashFile( pState->filename,
+                                       &pState->committedHash,
+                                       &pState->committedSize,
+                                       &generation );
+        }
+        else
+        {
+            result = HashFile( pState->filename,
+                               &pState->committedHash,
+                               &pState->committedSize,
+                               &generation );
+        }
+
+        pState->committed = ( result == EOK );
+        if ( pState->committed == true )
+        {
+            pState->baseSize = pState->committedSize;
+        }
+
+        /* continue the generations from the committed file */
+        if ( ( result == EOK ) &&
+             ( generation > pState->generation ) )
+        {
+            pState->generation = generation;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  FormatStats                                                               */
+/*!
+    Format the save statistics
+
+    The FormatStats function formats the save statistics as a single
+    line of name=value pairs.  The statistics include the number of
+    variables and bytes held in the saved variable table, and the size,
+    peak usage, and heap allocations of the save arena.
+
+    @param[in]
+        pState
+            pointer to the SaveSvc state
+
+    @param[out]
+        buf
+            pointer to the output buffer
+
+    @param[in]
+        len
+            size of the output buffer
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval E2BIG - the output buffer is too small
+
+==============================================================================*/
+int FormatStats( SaveSvcState *pState, char *buf, size_t len )
+{
+    int result = EINVAL;
+    int n;
+
+    if ( ( pState != NULL ) &&
+         ( buf != NULL ) )
+    {
+        n = snprintf( buf,
+                      len,
+                      "saves=%" PRIu64 " failures=%" PRIu64
+                      " skipped=%" PRIu64 " syncs=%" PRIu64
+                      " sync_us=%" PRIu64 " sync_max_us=%" PRIu64
+                      " dirsyncs=%" PRIu64 " dirsync_us=%" PRIu64
+                      " vartab_vars=%zu vartab_bytes=%zu"
+                      " arena_bytes=%zu arena_peak=%zu"
+                      " arena_allocs=%" PRIu64,
+                      pState->stats.saves,
+                      pState->stats.failures,
+                      pState->stats.skipped,
+                      pState->stats.syncs,
+                      pState->stats.syncTimeUs,
+                      pState->stats.syncMaxUs,
+                      pState->stats.dirSyncs,
+                      pState->stats.dirSyncTimeUs,
+                      pState->saved.count,
+                      VARTAB_Memory( &pState->saved ),
+                      pState->arena.size,
+                      pState->arena.peak,
+                      pState->arena.heapAllocs );
+
+        result = ( ( n >= 0 ) && ( (size_t)n < len ) ) ? EOK : E2BIG;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  SyncData                                                                  */
+/*!
+    Sync output data to storage
+
+    The SyncData function syncs the data written to the specified file
+    descriptor according to the durability mode, and records the time
+    taken in the save statistics and the save sample.
+
+    In range mode, writeback was started as the data was written, so
+    this waits for it to complete before the final fdatasync.
+
+    @param[in,out]
+        pState
+            pointer to the SaveSvc state
+
+    @param[in]
+        fd
+            output file descriptor
+
+    @retval EOK - success
+    @retval other error from sync_file_range() or fdatasync()
+
+==============================================================================*/
+static int SyncData( SaveSvcState *pState, int fd )
+{
+    int result = EOK;
+    uint64_t start;
+    uint64_t elapsed;
+
+    if ( pState->durability != DURABILITY_NONE )
+    {
+        start = TimeNowUs();
+
+        if ( pState->durability == DURABILITY_RANGE )
+        {
+            if ( sync_file_range( fd,
+                                  0,
+                                  0,
+                                  SYNC_FILE_RANGE_WAIT_BEFORE |
+                                  SYNC_FILE_RANGE_WRITE |
+                                  SYNC_FILE_RANGE_WAIT_AFTER ) == -1 )
+            {
+                result = errno;
+            }
+        }
+
+        if ( ( result == EOK ) &&
+             ( fdatasync( fd ) == -1 ) )
+        {
+            result = errno;
+        }
+
+        elapsed = TimeNowUs() - start;
+        METRICS_Add( &pState->sample, METRIC_FSYNC, elapsed );
+
+        pState->stats.syncs++;
+        pState->stats.syncTimeUs += elapsed;
+        if ( elapsed > pState->stats.syncMaxUs )
+        {
+            pState->stats.syncMaxUs = elapsed;
+        }
+
+        if ( result != EOK )
+        {
+            fprintf( stderr, "Sync failed: %s\n", strerror( result ) );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  SyncDir                                                                   */
+/*!
+    Sync a directory to storage
+
+    The SyncDir function syncs the directory containing the specified
+    file if required by the durability mode, and records the time
+    taken in the save statistics and the save sample.
+
+    @param[in,out]
+        pState
+            pointer to the SaveSvc state
+
+    @param[in]
+        filename
+            name of a file in the directory to sync
+
+    @retval EOK - success
+    @retval E2BIG - the file name is too long
+    @retval other error from open() or fsync()
+
+==============================================================================*/
+static int SyncDir( SaveSvcState *pState, const char *filename )
+{
+    int result = EOK;
+    char path[BUFSIZ];
+    uint64_t start;
+    uint64_t elapsed;
+    int fd;
+
+    if ( ( pState->durability == DURABILITY_DIRSYNC ) ||
+         ( pState->durability == DURABILITY_RANGE ) )
+    {
+        start = TimeNowUs();
+
+        if ( strlen( filename ) < sizeof path )
+        {
+            strcpy( path, filename );
+
+            fd = open( dirname( path ), O_RDONLY | O_DIRECTORY );
+            if ( fd != -1 )
+            {
+                if ( fsync( fd ) == -1 )
+                {
+                    result = errno;
+                }
+
+                close( fd );
+            }
+            else
+            {
+                result = errno;
+            }
+        }
+        else
+        {
+            result = E2BIG;
+        }
+
+        elapsed = TimeNowUs() - start;
+        METRICS_Add( &pState->sample, METRIC_RENAME, elapsed );
+
+        pState->stats.dirSyncs++;
+        pState->stats.dirSyncTimeUs += elapsed;
+
+        if ( result != EOK )
+        {
+            fprintf( stderr,
+                     "Directory sync failed: %s\n",
+                     strerror( result ) );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  TimeNowUs                                                                 */
+/*!
+    Get the current monotonic time
+
+    @retval the current monotonic time in microseconds
+
+==============================================================================*/
+static uint64_t TimeNowUs( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+
+    return ( (uint64_t)ts.tv_sec * 1000000 ) + ( ts.tv_nsec / 1000 );
+}
+
+/*============================================================================*/
+/*  AddOutput                                                                 */
+/*!
+    Add the time and size of an output to the current save sample
+
+    The AddOutput function splits the time taken since the output was
+    started into the time spent in write system calls, and the time
+    spent formatting the output.
+
+    @param[in,out]
+        pState
+            pointer to the SaveSvc state
+
+    @param[in]
+        start
+            time the output was started (in microseconds)
+
+    @param[in]
+        writeTimeUs
+            write time of the output writer when the output was started
+
+    @param[in]
+        bytes
+            bytes written by the output writer when the output was started
+
+==============================================================================*/
+static void AddOutput( SaveSvcState *pState,
+                       uint64_t start,
+                       uint64_t writeTimeUs,
+                       uint64_t bytes )
+{
+    uint64_t elapsed = TimeNowUs() - start;
+    uint64_t written = pState->out.writeTimeUs - writeTimeUs;
+
+    METRICS_Add( &pState->sample,
+                 METRIC_FORMAT,
+                 ( elapsed > written ) ? elapsed - written : 0 );
+    METRICS_Add( &pState->sample, METRIC_WRITE, written );
+
+    pState->sample.bytes += pState->out.bytes - bytes;
+}
+
+/*! @}
+ * end of saveconfig group */
@@ -0,0 +1,299 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup savecvt Configuration Converter
+ * @brief Binary to text configuration file converter
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file savecvt.c
+
+    Configuration Converter
+
+    The Configuration Converter converts a binary configuration file
+    written by the Save Service (savesvc -F binary) into the text
+    configuration format used by the loadconfig utility.
+
+    The text output is identical to the output the Save Service would
+    have written for the same variables in its text format.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <varserver/varserver.h>
+#include "savesvc.h"
+
+/*==============================================================================
+       Function declarations
+==============================================================================*/
+static void usage( char *cmdname );
+static int ProcessOptions( int argC,
+                           char *argV[],
+                           SaveSvcState *pState,
+                           char **ppInput );
+static int Convert( SaveSvcState *pState, Snapshot *pSnapshot );
+
+/*==============================================================================
+       Function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  main                                                                      */
+/*!
+    Main entry point for the savecvt application
+
+    @param[in]
+        argc
+            number of arguments on the command line
+            (including the command itself)
+
+    @param[in]
+        argv
+            array of pointers to the command line arguments
+
+    @retval 0 - the configuration was converted
+    @retval 1 - the configuration could not be converted
+
+==============================================================================*/
+int main(int argC, char *argV[])
+{
+    SaveSvcState state;
+    Snapshot snapshot;
+    char *input = NULL;
+    int result = EINVAL;
+
+    memset( &state, 0, sizeof state );
+    memset( &snapshot, 0, sizeof snapshot );
+    state.fd = -1;
+    state.format = FORMAT_TEXT;
+    state.bufsize = OUTBUF_DEFAULT_SIZE;
+
+    ProcessOptions( argC, argV, &state, &input );
+
+    if ( input == NULL )
+    {
+        usage( argV[0] );
+    }
+    else if ( ( OUTBUF_Init( &state.out, state.bufsize ) != EOK ) ||
+              ( SNAPSHOT_Init( &snapshot, SNAPSHOT_DEFAULT_SIZE ) != EOK ) )
+    {
+        fprintf( stderr, "Cannot allocate conversion buffers\n" );
+    }
+    else
+    {
+        result = SAVEFMT_Load( input, &snapshot );
+        if ( result != EOK )
+        {
+            fprintf( stderr,
+                     "Cannot load %s: %s\n",
+                     input,
+                     strerror( result ) );
+        }
+        else
+        {
+            result = Convert( &state, &snapshot );
+            if ( result != EOK )
+            {
+                fprintf( stderr,
+                         "Cannot convert %s: %s\n",
+                         input,
+                         strerror( result ) );
+            }
+        }
+    }
+
+    OUTBUF_Free( &state.out );
+    ARENA_Free( &state.arena );
+    SNAPSHOT_Free( &snapshot );
+
+    return ( result == EOK ) ? 0 : 1;
+}
+
+/*============================================================================*/
+/*  Convert                                                                   */
+/*!
+    Write the loaded variables in the text configuration format
+
+    The Convert function writes the variables in the snapshot to the
+    output file, or to the standard output if no output file was
+    specified.  An output file is committed atomically in the same way
+    as the Save Service commits its configuration file.
+
+    @param[in,out]
+        pState
+            pointer to the conversion state
+
+    @param[in]
+        pSnapshot
+            pointer to the snapshot of the loaded variables
+
+    @retval EOK - success
+    @retval other error from writing the output
+
+==============================================================================*/
+static int Convert( SaveSvcState *pState, Snapshot *pSnapshot )
+{
+    int result;
+
+    if ( pState->filename == NULL )
+    {
+        /* write to the standard output */
+        pState->durability = DURABILITY_NONE;
+        pState->fd = STDOUT_FILENO;
+        result = WriteConfig( pState, pSnapshot );
+        pState->fd = -1;
+    }
+    else
+    {
+        pState->durability = DURABILITY_DIRSYNC;
+        result = InitConfig( pState );
+        if ( result == EOK )
+        {
+            result = WriteConfig( pState, pSnapshot );
+            if ( result == EOK )
+            {
+                result = FinalizeConfig( pState );
+            }
+
+            if ( result != EOK )
+            {
+                DiscardConfig( pState );
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  usage                                                                     */
+/*!
+    Display the savecvt utility usage
+
+    The usage function dumps the application usage message
+    to stderr.
+
+    @param[in]
+       cmdname
+            pointer to the invoked command name
+
+    @return none
+
+==============================================================================*/
+static void usage( char *cmdname )
+{
+    if( cmdname != NULL )
+    {
+        fprintf(stderr,
+                "usage: %s [-o filename] [-h] binaryfile\n"
+                " [-o filename] : text output file name "
+                "(default: standard output)\n"
+                " [-h] : display this help\n",
+                cmdname );
+    }
+}
+
+/*============================================================================*/
+/*  ProcessOptions                                                            */
+/*!
+    Process the command line options
+
+    The ProcessOptions function processes the command line options and
+    populates the conversion state
+
+    @param[in]
+        argC
+            number of arguments
+            (including the command itself)
+
+    @param[in]
+        argv
+            array of pointers to the command line arguments
+
+    @param[in]
+        pState
+            pointer to the conversion state
+
+    @param[out]
+        ppInput
+            pointer to the location to store the input file name
+
+    @return none
+
+==============================================================================*/
+static int ProcessOptions( int argC,
+                           char *argV[],
+                           SaveSvcState *pState,
+                           char **ppInput )
+{
+    int c;
+    const char *options = "ho:";
+
+    if( ( pState != NULL ) &&
+        ( argV != NULL ) &&
+        ( ppInput != NULL ) )
+    {
+        while( ( c = getopt( argC, argV, options ) ) != -1 )
+        {
+            switch( c )
+            {
+                case 'o':
+                    pState->filename = optarg;
+                    break;
+
+                case 'h':
+                    usage( argV[0] );
+                    break;
+
+                default:
+                    break;
+
+            }
+        }
+
+        if ( optind < argC )
+        {
+            *ppInput = argV[optind];
+        }
+    }
+
+    return 0;
+}
+
+/*! @}
+ * end of savecvt group */
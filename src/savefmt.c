@@ -0,0 +1,811 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup savefmt Binary Configuration Format
+ * @brief Binary configuration file format for the Save Service
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file savefmt.c
+
+    Binary Configuration Format
+
+    The Binary Configuration Format stores each variable as a typed
+    value with a length prefixed name and its instance identifier,
+    so no values need to be converted to or from text when the
+    configuration is saved or restored.
+
+    The file starts with a header containing a magic number, a format
+    version, a byte order marker, the record count, a checksum of the
+    record data, and the generation marker of the saved snapshot.  The
+    header is written with a zero count, length, checksum, and
+    generation, and is completed by SAVEFMT_End once all of the records
+    have been written.  Files written before the generation marker was
+    added to the header are still read.
+
+    A binary configuration file can be loaded back into a snapshot
+    with SAVEFMT_Load, for example to convert it into the text format
+    used by the loadconfig utility.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <varserver/varserver.h>
+#include "hash.h"
+#include "savefmt.h"
+
+/*==============================================================================
+       Function declarations
+==============================================================================*/
+static int EncodeType( SnapshotRecord *pRecord,
+                       SaveFmtType *pType,
+                       const void **data,
+                       size_t *len );
+static int DecodeType( SaveFmtType type, VarType *pType, size_t *len );
+static int MapFile( const char *filename, void **pData, size_t *pSize );
+static int CheckHeader( const SaveFmtHeader *pHeader, size_t size );
+static void InitHeader( SaveFmtHeader *pHeader );
+static uint64_t GetGeneration( const SaveFmtHeader *pHeader );
+
+/*==============================================================================
+       Function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  SAVEFMT_Begin                                                             */
+/*!
+    Begin writing a binary configuration file
+
+    The SAVEFMT_Begin function resets the writer and writes an
+    incomplete file header to the buffered output.  The generation
+    marker of the writer can be set once it has been reset.
+
+    @param[in,out]
+        pWriter
+            pointer to the binary configuration writer
+
+    @param[in]
+        pOut
+            pointer to the buffered output to write to
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval other error from the buffered output
+
+==============================================================================*/
+int SAVEFMT_Begin( SaveFmtWriter *pWriter, OutBuf *pOut )
+{
+    int result = EINVAL;
+    SaveFmtHeader header;
+
+    if ( ( pWriter != NULL ) &&
+         ( pOut != NULL ) )
+    {
+        pWriter->pOut = pOut;
+        pWriter->count = 0;
+        pWriter->length = 0;
+        pWriter->checksum = HASH_INIT;
+        pWriter->generation = 0;
+
+        InitHeader( &header );
+        result = OUTBUF_Write( pOut, &header, sizeof header );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  SAVEFMT_Write                                                             */
+/*!
+    Write a variable to a binary configuration file
+
+    The SAVEFMT_Write function writes the record header, name, and value
+    of a snapshot record to the buffered output.
+
+    @param[in,out]
+        pWriter
+            pointer to the binary configuration writer
+
+    @param[in]
+        pRecord
+            pointer to the snapshot record to write
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval ENOTSUP - unsupported variable type
+    @retval E2BIG - the name or value is too long
+    @retval other error from the buffered output
+
+==============================================================================*/
+int SAVEFMT_Write( SaveFmtWriter *pWriter, SnapshotRecord *pRecord )
+{
+    int result = EINVAL;
+    SaveFmtRecord record;
+    SaveFmtType type;
+    const void *data;
+    const char *name;
+    size_t len;
+
+    if ( ( pWriter != NULL ) &&
+         ( pWriter->pOut != NULL ) &&
+         ( pRecord != NULL ) )
+    {
+        result = EncodeType( pRecord, &type, &data, &len );
+        if ( ( result == EOK ) &&
+             ( ( pRecord->namelen > UINT16_MAX ) ||
+               ( len > UINT32_MAX ) ) )
+        {
+            result = E2BIG;
+        }
+
+        if ( result == EOK )
+        {
+            name = SNAPSHOT_Name( pRecord );
+
+            memset( &record, 0, sizeof record );
+            record.type = (uint8_t)type;
+            record.namelen = (uint16_t)pRecord->namelen;
+            record.instanceID = pRecord->instanceID;
+            record.len = (uint32_t)len;
+
+            OUTBUF_Write( pWriter->pOut, &record, sizeof record );
+            OUTBUF_Write( pWriter->pOut, name, record.namelen );
+            result = OUTBUF_Write( pWriter->pOut, data, len );
+
+            pWriter->checksum = HASH_Update( pWriter->checksum,
+                                             &record,
+                                             sizeof record );
+            pWriter->checksum = HASH_Update( pWriter->checksum,
+                                             name,
+                                             record.namelen );
+            pWriter->checksum = HASH_Update( pWriter->checksum, data, len );
+
+            pWriter->length += sizeof record + record.namelen + len;
+            pWriter->count++;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  SAVEFMT_End                                                               */
+/*!
+    Complete a binary configuration file
+
+    The SAVEFMT_End function writes the completed file header over the
+    incomplete header at the start of the file.  It must be called after
+    the buffered output has been flushed.
+
+    @param[in]
+        pWriter
+            pointer to the binary configuration writer
+
+    @param[in]
+        fd
+            file descriptor of the binary configuration file
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval other error from pwrite()
+
+==============================================================================*/
+int SAVEFMT_End( SaveFmtWriter *pWriter, int fd )
+{
+    int result = EINVAL;
+    SaveFmtHeader header;
+    char *p = (char *)&header;
+    size_t offset = 0;
+    ssize_t n;
+
+    if ( ( pWriter != NULL ) &&
+         ( fd != -1 ) )
+    {
+        InitHeader( &header );
+        header.count = pWriter->count;
+        header.length = pWriter->length;
+        header.checksum = pWriter->checksum;
+        header.generation = pWriter->generation;
+
+        result = EOK;
+        while ( offset < sizeof header )
+        {
+            n = pwrite( fd, &p[offset], sizeof header - offset, offset );
+            if ( n > 0 )
+            {
+                offset += (size_t)n;
+            }
+            else if ( ( n == -1 ) && ( errno == EINTR ) )
+            {
+                continue;
+            }
+            else
+            {
+                result = ( n == -1 ) ? errno : EIO;
+                break;
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  SAVEFMT_Load                                                              */
+/*!
+    Load a binary configuration file into a snapshot
+
+    The SAVEFMT_Load function validates the header and checksum of a
+    binary configuration file and appends each of its variables to
+    the specified snapshot.  The variable handles in the snapshot
+    are set to VAR_INVALID.
+
+    @param[in]
+        filename
+            name of the binary configuration file
+
+    @param[in,out]
+        pSnapshot
+            pointer to the snapshot to load the variables into
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval EBADMSG - the file is not a valid binary configuration file
+    @retval ENOTSUP - unsupported file format version or value type
+    @retval other error from reading the file or adding to the snapshot
+
+==============================================================================*/
+int SAVEFMT_Load( const char *filename, Snapshot *pSnapshot )
+{
+    int result = EINVAL;
+    const SaveFmtHeader *pHeader;
+    SaveFmtRecord record;
+    char name[MAX_NAME_LEN + 1];
+    VarObject obj;
+    const char *p;
+    size_t offset;
+    size_t size;
+    size_t len;
+    uint32_t i;
+    void *data;
+
+    if ( ( filename != NULL ) &&
+         ( pSnapshot != NULL ) )
+    {
+        result = MapFile( filename, &data, &size );
+        if ( result == EOK )
+        {
+            p = data;
+            pHeader = data;
+
+            result = CheckHeader( pHeader, size );
+            offset = ( result == EOK ) ? pHeader->headerSize : size;
+
+            for ( i = 0; ( result == EOK ) && ( i < pHeader->count ); i++ )
+            {
+                if ( size - offset < sizeof record )
+                {
+                    result = EBADMSG;
+                    break;
+                }
+
+                /* records are not aligned */
+                memcpy( &record, &p[offset], sizeof record );
+                offset += sizeof record;
+
+                result = DecodeType( record.type, &obj.type, &len );
+                if ( result != EOK )
+                {
+                    break;
+                }
+
+                if ( ( record.namelen > MAX_NAME_LEN ) ||
+                     ( size - offset < (size_t)record.namelen + record.len ) ||
+                     ( ( len != 0 ) && ( record.len != len ) ) )
+                {
+                    result = EBADMSG;
+                    break;
+                }
+
+                memcpy( name, &p[offset], record.namelen );
+                name[record.namelen] = 0;
+                offset += record.namelen;
+
+                memset( &obj.val, 0, sizeof obj.val );
+                obj.len = record.len;
+                if ( obj.type == VARTYPE_STR )
+                {
+                    /* strings are stored with their NUL terminator */
+                    if ( ( record.len == 0 ) ||
+                         ( p[offset + record.len - 1] != 0 ) )
+                    {
+                        result = EBADMSG;
+                        break;
+                    }
+
+                    obj.val.str = (char *)&p[offset];
+                }
+                else if ( obj.type == VARTYPE_BLOB )
+                {
+                    obj.val.blob = (void *)&p[offset];
+                }
+                else
+                {
+                    memcpy( &obj.val, &p[offset], record.len );
+                }
+
+                offset += record.len;
+
+                result = SNAPSHOT_Add( pSnapshot,
+                                       VAR_INVALID,
+                                       record.instanceID,
+                                       name,
+                                       &obj );
+            }
+
+            if ( ( result == EOK ) && ( offset != size ) )
+            {
+                /* trailing data after the last record */
+                result = EBADMSG;
+            }
+
+            munmap( data, size );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  SAVEFMT_HashFile                                                          */
+/*!
+    Calculate the output hash of a binary configuration file
+
+    The SAVEFMT_HashFile function calculates the hash of a binary
+    configuration file as it was written to the buffered output,
+    ie with the incomplete file header written by SAVEFMT_Begin.
+    This can be compared against the output hash of a new binary
+    configuration file to detect unchanged output.  The generation
+    marker is not part of the hash.
+
+    @param[in]
+        filename
+            name of the binary configuration file
+
+    @param[out]
+        hash
+            pointer to the location to store the hash
+
+    @param[out]
+        size
+            pointer to the location to store the file size
+
+    @param[out]
+        generation
+            pointer to the location to store the generation marker
+            of the file
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval EBADMSG - the file is not a valid binary configuration file
+    @retval other error from reading the file
+
+==============================================================================*/
+int SAVEFMT_HashFile( const char *filename,
+                      uint64_t *hash,
+                      uint64_t *size,
+                      uint64_t *generation )
+{
+    int result = EINVAL;
+    const SaveFmtHeader *pHeader;
+    SaveFmtHeader header;
+    const char *p;
+    size_t len;
+    void *data;
+
+    if ( ( filename != NULL ) &&
+         ( hash != NULL ) &&
+         ( size != NULL ) &&
+         ( generation != NULL ) )
+    {
+        result = MapFile( filename, &data, &len );
+        if ( result == EOK )
+        {
+            result = CheckHeader( data, len );
+            if ( result == EOK )
+            {
+                p = data;
+                pHeader = data;
+
+                /* a file with an older header does not match any
+                   new output */
+                InitHeader( &header );
+                *hash = HASH_Update( HASH_INIT, &header, sizeof header );
+                *hash = HASH_Update( *hash,
+                                     &p[pHeader->headerSize],
+                                     len - pHeader->headerSize );
+                *size = len;
+                *generation = GetGeneration( pHeader );
+            }
+
+            munmap( data, len );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  EncodeType                                                                */
+/*!
+    Get the binary type and value of a snapshot record
+
+    @param[in]
+        pRecord
+            pointer to the snapshot record
+
+    @param[out]
+        pType
+            pointer to the location to store the binary value type
+
+    @param[out]
+        data
+            pointer to the location to store a pointer to the value
+
+    @param[out]
+        len
+            pointer to the location to store the value length
+
+    @retval EOK - success
+    @retval ENOTSUP - unsupported variable type
+
+==============================================================================*/
+static int EncodeType( SnapshotRecord *pRecord,
+                       SaveFmtType *pType,
+                       const void **data,
+                       size_t *len )
+{
+    int result = EOK;
+
+    /* numeric values are stored from the start of the value union */
+    *data = &pRecord->val;
+
+    switch( pRecord->type )
+    {
+        case VARTYPE_UINT16:
+            *pType = SAVEFMT_TYPE_UINT16;
+            *len = sizeof pRecord->val.ui;
+            break;
+
+        case VARTYPE_INT16:
+            *pType = SAVEFMT_TYPE_INT16;
+            *len = sizeof pRecord->val.i;
+            break;
+
+        case VARTYPE_UINT32:
+            *pType = SAVEFMT_TYPE_UINT32;
+            *len = sizeof pRecord->val.ul;
+            break;
+
+        case VARTYPE_INT32:
+            *pType = SAVEFMT_TYPE_INT32;
+            *len = sizeof pRecord->val.l;
+            break;
+
+        case VARTYPE_UINT64:
+            *pType = SAVEFMT_TYPE_UINT64;
+            *len = sizeof pRecord->val.ull;
+            break;
+
+        case VARTYPE_INT64:
+            *pType = SAVEFMT_TYPE_INT64;
+            *len = sizeof pRecord->val.ll;
+            break;
+
+        case VARTYPE_FLOAT:
+            *pType = SAVEFMT_TYPE_FLOAT;
+            *len = sizeof pRecord->val.f;
+            break;
+
+        case VARTYPE_STR:
+            *pType = SAVEFMT_TYPE_STR;
+            *data = SNAPSHOT_Data( pRecord );
+            *len = pRecord->len;
+            break;
+
+        case VARTYPE_BLOB:
+            *pType = SAVEFMT_TYPE_BLOB;
+            *data = SNAPSHOT_Data( pRecord );
+            *len = pRecord->len;
+            break;
+
+        default:
+            result = ENOTSUP;
+            break;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  DecodeType                                                                */
+/*!
+    Get the variable type of a binary value type
+
+    @param[in]
+        type
+            binary value type
+
+    @param[out]
+        pType
+            pointer to the location to store the variable type
+
+    @param[out]
+        len
+            pointer to the location to store the fixed value length,
+            or zero for variable length values
+
+    @retval EOK - success
+    @retval ENOTSUP - unsupported value type
+
+==============================================================================*/
+static int DecodeType( SaveFmtType type, VarType *pType, size_t *len )
+{
+    int result = EOK;
+
+    switch( type )
+    {
+        case SAVEFMT_TYPE_UINT16:
+            *pType = VARTYPE_UINT16;
+            *len = sizeof( uint16_t );
+            break;
+
+        case SAVEFMT_TYPE_INT16:
+            *pType = VARTYPE_INT16;
+            *len = sizeof( int16_t );
+            break;
+
+        case SAVEFMT_TYPE_UINT32:
+            *pType = VARTYPE_UINT32;
+            *len = sizeof( uint32_t );
+            break;
+
+        case SAVEFMT_TYPE_INT32:
+            *pType = VARTYPE_INT32;
+            *len = sizeof( int32_t );
+            break;
+
+        case SAVEFMT_TYPE_UINT64:
+            *pType = VARTYPE_UINT64;
+            *len = sizeof( uint64_t );
+            break;
+
+        case SAVEFMT_TYPE_INT64:
+            *pType = VARTYPE_INT64;
+            *len = sizeof( int64_t );
+            break;
+
+        case SAVEFMT_TYPE_FLOAT:
+            *pType = VARTYPE_FLOAT;
+            *len = sizeof( float );
+            break;
+
+        case SAVEFMT_TYPE_STR:
+            *pType = VARTYPE_STR;
+            *len = 0;
+            break;
+
+        case SAVEFMT_TYPE_BLOB:
+            *pType = VARTYPE_BLOB;
+            *len = 0;
+            break;
+
+        default:
+            result = ENOTSUP;
+            break;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  MapFile                                                                   */
+/*!
+    Map a file into memory for reading
+
+    @param[in]
+        filename
+            name of the file to map
+
+    @param[out]
+        pData
+            pointer to the location to store the mapping address
+
+    @param[out]
+        pSize
+            pointer to the location to store the file size
+
+    @retval EOK - success
+    @retval EBADMSG - the file is too small to be a binary configuration
+    @retval other error from open(), fstat(), or mmap()
+
+==============================================================================*/
+static int MapFile( const char *filename, void **pData, size_t *pSize )
+{
+    int result;
+    struct stat st;
+    void *data;
+    int fd;
+
+    fd = open( filename, O_RDONLY );
+    if ( fd == -1 )
+    {
+        result = errno;
+    }
+    else
+    {
+        if ( fstat( fd, &st ) == -1 )
+        {
+            result = errno;
+        }
+        else if ( (size_t)st.st_size < SAVEFMT_MIN_HEADER_SIZE )
+        {
+            result = EBADMSG;
+        }
+        else
+        {
+            data = mmap( NULL,
+                         (size_t)st.st_size,
+                         PROT_READ,
+                         MAP_PRIVATE,
+                         fd,
+                         0 );
+            if ( data != MAP_FAILED )
+            {
+                *pData = data;
+                *pSize = (size_t)st.st_size;
+                result = EOK;
+            }
+            else
+            {
+                result = errno;
+            }
+        }
+
+        close( fd );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  CheckHeader                                                               */
+/*!
+    Validate a binary configuration file
+
+    The CheckHeader function validates the file header, and the length
+    and checksum of the record data which follows it.
+
+    @param[in]
+        pHeader
+            pointer to the start of the mapped file
+
+    @param[in]
+        size
+            size of the mapped file
+
+    @retval EOK - the file is valid
+    @retval EBADMSG - the file is not a valid binary configuration file
+    @retval ENOTSUP - unsupported file format version
+
+==============================================================================*/
+static int CheckHeader( const SaveFmtHeader *pHeader, size_t size )
+{
+    int result = EBADMSG;
+    const char *p = (const char *)pHeader;
+
+    if ( ( memcmp( pHeader->magic,
+                   SAVEFMT_MAGIC,
+                   sizeof pHeader->magic ) == 0 ) &&
+         ( pHeader->byteOrder == SAVEFMT_BYTE_ORDER ) &&
+         ( pHeader->headerSize >= SAVEFMT_MIN_HEADER_SIZE ) &&
+         ( pHeader->headerSize <= size ) &&
+         ( pHeader->length == size - pHeader->headerSize ) )
+    {
+        if ( pHeader->version != SAVEFMT_VERSION )
+        {
+            result = ENOTSUP;
+        }
+        else if ( HASH_Update( HASH_INIT,
+                               &p[pHeader->headerSize],
+                               pHeader->length ) == pHeader->checksum )
+        {
+            result = EOK;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  InitHeader                                                                */
+/*!
+    Initialize an incomplete binary configuration file header
+
+    @param[out]
+        pHeader
+            pointer to the header to initialize
+
+==============================================================================*/
+static void InitHeader( SaveFmtHeader *pHeader )
+{
+    memset( pHeader, 0, sizeof( SaveFmtHeader ) );
+    memcpy( pHeader->magic, SAVEFMT_MAGIC, sizeof pHeader->magic );
+    pHeader->version = SAVEFMT_VERSION;
+    pHeader->headerSize = sizeof( SaveFmtHeader );
+    pHeader->byteOrder = SAVEFMT_BYTE_ORDER;
+}
+
+/*============================================================================*/
+/*  GetGeneration                                                             */
+/*!
+    Get the generation marker from a validated file header
+
+    @param[in]
+        pHeader
+            pointer to the validated file header
+
+    @retval generation marker of the file, or zero if its header
+            predates the generation marker
+
+==============================================================================*/
+static uint64_t GetGeneration( const SaveFmtHeader *pHeader )
+{
+    uint64_t generation = 0;
+
+    if ( pHeader->headerSize >= sizeof( SaveFmtHeader ) )
+    {
+        generation = pHeader->generation;
+    }
+
+    return generation;
+}
+
+/*! @}
+ * end of savefmt group */
@@ -0,0 +1,281 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup saverestore Save Restore Utility
+ * @brief Restores variables from configuration files written by savesvc
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file saverestore.c
+
+    Save Restore Utility
+
+    The Save Restore Utility restores variables from one or more
+    configuration files written by the Save Service, for example the
+    configuration file followed by its journal.
+
+    Text and binary configuration files, journals, and shard manifests
+    are accepted.  See restore.c for how each file is restored.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <time.h>
+#include <varserver/varserver.h>
+#include "restore.h"
+
+/*==============================================================================
+       Function declarations
+==============================================================================*/
+static void usage( char *cmdname );
+static int ProcessOptions( int argC,
+                           char *argV[],
+                           RestoreState *pState );
+static uint64_t TimeNowUs( void );
+
+/*==============================================================================
+       Function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  main                                                                      */
+/*!
+    Main entry point for the saverestore application
+
+    @param[in]
+        argc
+            number of arguments on the command line
+            (including the command itself)
+
+    @param[in]
+        argv
+            array of pointers to the command line arguments
+
+    @retval 0 - all variables were restored
+    @retval 1 - one or more variables could not be restored
+
+==============================================================================*/
+int main(int argC, char *argV[])
+{
+    RestoreState state;
+    VARSERVER_HANDLE hVarServer = NULL;
+    int result = EINVAL;
+    uint64_t start;
+    int rc;
+    int i;
+
+    memset( &state, 0, sizeof state );
+    state.batchsize = RESTORE_DEFAULT_BATCH_SIZE;
+
+    i = ProcessOptions( argC, argV, &state );
+    if ( i >= argC )
+    {
+        usage( argV[0] );
+    }
+    else
+    {
+        hVarServer = VARSERVER_Open();
+        if ( hVarServer == NULL )
+        {
+            fprintf( stderr, "Cannot open variable server\n" );
+        }
+        else if ( RESTORE_Init( &state, hVarServer ) != EOK )
+        {
+            fprintf( stderr, "Cannot allocate restore buffers\n" );
+        }
+        else
+        {
+            start = TimeNowUs();
+
+            /* restore the files in order so later values win */
+            result = EOK;
+            for ( ; i < argC; i++ )
+            {
+                rc = RESTORE_File( &state, argV[i] );
+                if ( rc != EOK )
+                {
+                    fprintf( stderr,
+                             "Cannot restore %s: %s\n",
+                             argV[i],
+                             strerror( rc ) );
+                    result = rc;
+                }
+            }
+
+            if ( state.failed != 0 )
+            {
+                result = EIO;
+            }
+
+            if ( state.verbose == true )
+            {
+                printf( "set=%" PRIu64 " failed=%" PRIu64
+                        " lookups=%" PRIu64 " calls=%" PRIu64
+                        " elapsed_us=%" PRIu64 "\n",
+                        state.set,
+                        state.failed,
+                        state.lookups,
+                        state.calls,
+                        TimeNowUs() - start );
+            }
+        }
+
+        RESTORE_Free( &state );
+
+        if ( hVarServer != NULL )
+        {
+            (void)VARSERVER_Close( hVarServer );
+        }
+    }
+
+    return ( result == EOK ) ? 0 : 1;
+}
+
+/*============================================================================*/
+/*  usage                                                                     */
+/*!
+    Display the saverestore utility usage
+
+    The usage function dumps the application usage message
+    to stderr.
+
+    @param[in]
+       cmdname
+            pointer to the invoked command name
+
+    @return none
+
+==============================================================================*/
+static void usage( char *cmdname )
+{
+    if( cmdname != NULL )
+    {
+        fprintf(stderr,
+                "usage: %s [-b count] [-v] [-h] file [file...]\n"
+                " [-b count] : number of variables set per batch\n"
+                " [-h] : display this help\n"
+                " [-v] : verbose output\n"
+                " file : text or binary configuration file, or shard "
+                "manifest.  Files are\n"
+                "        restored in order, eg the configuration file "
+                "followed by its journal\n",
+                cmdname );
+    }
+}
+
+/*============================================================================*/
+/*  ProcessOptions                                                            */
+/*!
+    Process the command line options
+
+    The ProcessOptions function processes the command line options and
+    populates the restore state
+
+    @param[in]
+        argC
+            number of arguments
+            (including the command itself)
+
+    @param[in]
+        argv
+            array of pointers to the command line arguments
+
+    @param[in]
+        pState
+            pointer to the restore state
+
+    @return index of the first file name argument
+
+==============================================================================*/
+static int ProcessOptions( int argC,
+                           char *argV[],
+                           RestoreState *pState )
+{
+    int c;
+    const char *options = "hvb:";
+
+    if( ( pState != NULL ) &&
+        ( argV != NULL ) )
+    {
+        while( ( c = getopt( argC, argV, options ) ) != -1 )
+        {
+            switch( c )
+            {
+                case 'v':
+                    pState->verbose = true;
+                    break;
+
+                case 'b':
+                    pState->batchsize = strtoul( optarg, NULL, 0 );
+                    break;
+
+                case 'h':
+                    usage( argV[0] );
+                    break;
+
+                default:
+                    break;
+
+            }
+        }
+    }
+
+    return optind;
+}
+
+/*============================================================================*/
+/*  TimeNowUs                                                                 */
+/*!
+    Get the current monotonic time in microseconds
+
+    @retval monotonic time in microseconds
+
+==============================================================================*/
+static uint64_t TimeNowUs( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+
+    return ( (uint64_t)ts.tv_sec * 1000000 ) +
+           ( (uint64_t)ts.tv_nsec / 1000 );
+}
+
+/*! @}
+ * end of saverestore group */
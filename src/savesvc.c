@@ -53,7 +53,9 @@ SOFTWARE.
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <ctype.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <string.h>
 #include <unistd.h>
 #include <stdbool.h>
@@ -62,36 +64,91 @@ SOFTWARE.
 #include <syslog.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <time.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#include <sys/epoll.h>
+#include <sys/time.h>
 #include <varserver/varserver.h>
 #include <varserver/varquery.h>
+#include "savesvc.h"
+#include "control.h"
+#include "profile.h"
+#include "shard.h"
 
 /*==============================================================================
        Type Definitions
 ==============================================================================*/
-typedef struct _savesvcState
+
+/*! control connection waiting for a save to complete */
+typedef struct _controlWaiter
 {
-    /*! handle to the variable server */
-    VARSERVER_HANDLE hVarServer;
+    /*! control connection descriptor */
+    int fd;
 
-    /*! output file name */
-    char *filename;
+    /*! sequence number of the save request being waited for */
+    uint64_t seq;
 
-    /*! trigger variable name */
-    char *triggervar;
+} ControlWaiter;
 
-    /*! handle to the trigger variable */
-    VAR_HANDLE hTriggerVar;
+/*! save service event loop state */
+typedef struct _svcLoop
+{
+    /*! pointer to the SaveSvc state */
+    SaveSvcState *pState;
 
-    /*! verbose output flag */
-    bool verbose;
+    /*! epoll instance */
+    int epfd;
 
-    /*! output file descriptor */
-    int fd;
+    /*! variable server signal descriptor */
+    int sigfd;
+
+    /*! termination signal descriptor */
+    int shutdownfd;
+
+    /*! debounce timer descriptor */
+    int debouncefd;
+
+    /*! automatic save timer descriptor, or -1 if disabled */
+    int autosavefd;
+
+    /*! dirty set reconciliation timer descriptor, or -1 if disabled */
+    int reconcilefd;
+
+    /*! listening control socket, or -1 if disabled */
+    int ctlfd;
+
+    /*! indicates the event loop is running */
+    bool running;
+
+    /*! indicates a save is pending */
+    bool pending;
+
+    /*! profiles (one bit per profile) with a pending save */
+    uint64_t due;
+
+    /*! indicates a tracked variable was modified since the last save */
+    bool changed;
+
+    /*! time of the first pending trigger (in milliseconds) */
+    uint64_t first;
+
+    /*! time of the most recent trigger (in milliseconds) */
+    uint64_t last;
+
+    /*! number of pending triggers */
+    unsigned int triggers;
 
-    /*! temporary output file name */
-    char tmpfile[BUFSIZ];
+    /*! control connections waiting for a save to complete */
+    ControlWaiter waiters[CONTROL_MAX_WAITERS];
 
-} SaveSvcState;
+    /*! number of control connections waiting for a save to complete */
+    size_t nwaiters;
+
+} SvcLoop;
 
 /*==============================================================================
        Function declarations
@@ -99,14 +156,55 @@ typedef struct _savesvcState
 static void usage( char *cmdname );
 static void SetupTerminationHandler( void );
 static void TerminationHandler( int signum, siginfo_t *info, void *ptr );
+static void ShutdownTimeoutHandler( int signum );
 static int ProcessOptions( int argC,
                            char *argV[],
                            SaveSvcState *pState );
+static int ParseNumber( int option,
+                        const char *text,
+                        unsigned long max,
+                        unsigned long *pValue );
 static int RunSvc( SaveSvcState *pState );
-static int InitConfig( SaveSvcState *pState );
-static int WriteConfig( SaveSvcState *pState );
-static int WriteConfigVars( SaveSvcState *pState );
-static int FinalizeConfig( SaveSvcState *pState );
+static int StartTracking( SaveSvcState *pState );
+static int StartMetrics( SaveSvcState *pState );
+static int StartRing( SaveSvcState *pState );
+static int InitProfiles( SaveSvcState *pState );
+static int InitProfile( SaveSvcState *pState, size_t idx );
+static int OpenLoop( SaveSvcState *pState, SvcLoop *pLoop );
+static void CloseLoop( SvcLoop *pLoop );
+static int AddEvent( int epfd, int fd );
+static void HandleVarSignal( SvcLoop *pLoop );
+static void HandleAutosave( SvcLoop *pLoop );
+static void HandleReconcile( SvcLoop *pLoop );
+static int HandleShutdown( SvcLoop *pLoop );
+static void Trigger( SvcLoop *pLoop, uint64_t profiles );
+static int Save( SvcLoop *pLoop, uint64_t profiles );
+static void HandleSaveDone( SvcLoop *pLoop );
+static void HandleConnect( SvcLoop *pLoop );
+static void HandleControl( SvcLoop *pLoop, int fd );
+static void ReplyResult( int fd, int result );
+static void ReplyStats( SaveSvcState *pState, int fd );
+static int OpenShutdownfd( void );
+static int OpenTimerfd( unsigned int intervalMs );
+static int ArmTimer( int fd, uint64_t deadline );
+static uint64_t ReadCounter( int fd );
+static int ShutdownSave( SaveSvcState *pState );
+static int WaitPipelineIdle( SaveSvcState *pState, unsigned int timeoutMs );
+static uint64_t GetSaveDeadline( SaveSvcState *pState,
+                                 uint64_t first,
+                                 uint64_t last );
+static uint64_t TimeNowMs( void );
+static int InitPipeline( SaveSvcState *pState );
+static int RequestSave( SaveSvcState *pState, uint64_t profiles );
+static bool IsFullSave( SaveSvcState *pState, uint64_t profiles );
+static int SaveProfiles( SaveSvcState *pState,
+                         Snapshot *pSnapshot,
+                         uint64_t profiles,
+                         uint64_t *saved );
+static void ReleaseCommitted( SaveSvcState *pState );
+static void StopPipeline( SaveSvcState *pState );
+static void PublishStats( SaveSvcState *pState );
+static void *WriterThread( void *arg );
 
 /*==============================================================================
        Definitions
@@ -118,6 +216,29 @@ static int FinalizeConfig( SaveSvcState *pState );
 /*! default trigger variable */
 #define DEFAULT_TRIGGER_VARIABLE "/sys/config/save"
 
+/*! default maximum save latency (in milliseconds) when debouncing */
+#define DEFAULT_MAX_LATENCY_MS ( 1000 )
+
+/*! default interval (in milliseconds) between reconciliations of the
+    dirty set with the dirty flags of the variables */
+#define DEFAULT_RECONCILE_MS ( 60000 )
+
+/*! largest buffer, batch or journal size (in bytes) accepted as an option */
+#define MAX_SIZE_OPTION ( 1024UL * 1024UL * 1024UL )
+
+/*! largest journal to output file size ratio (in percent) accepted as
+    an option */
+#define MAX_COMPACT_RATIO ( 10000 )
+
+/*! default time limit (in milliseconds) for the final save on shutdown */
+#define DEFAULT_SHUTDOWN_MS ( 5000 )
+
+/*! exit status when the final save exceeds the shutdown time limit */
+#define SHUTDOWN_TIMEOUT_STATUS ( 2 )
+
+/*! maximum number of events handled per wakeup */
+#define MAX_EVENTS ( 16 )
+
 /*==============================================================================
       File Scoped Variables
 ==============================================================================*/
@@ -143,13 +264,14 @@ SaveSvcState *pState;
         argv
             array of pointers to the command line arguments
 
-    @return none
+    @retval 0 - success
+    @retval 1 - invalid command line options
 
 ==============================================================================*/
 int main(int argC, char *argV[])
 {
-    VAR_HANDLE hVar;
-    int rc;
+    int status = 0;
+    int i;
 
     pState = NULL;
 
@@ -163,8 +285,31 @@ int main(int argC, char *argV[])
         /* set the default trigger variable */
         pState->triggervar = DEFAULT_TRIGGER_VARIABLE;
 
-        /* clear the file descriptor */
+        /* clear the file descriptors */
         pState->fd = -1;
+        pState->donefd = -1;
+
+        /* set the default output buffer size */
+        pState->bufsize = OUTBUF_DEFAULT_SIZE;
+
+        /* set the default journal compaction thresholds */
+        pState->compactSize = DEFAULT_COMPACT_SIZE;
+        pState->compactRatio = DEFAULT_COMPACT_RATIO;
+
+        /* set the default variable retrieval batch size */
+        pState->batchsize = SNAPSHOT_DEFAULT_BATCH_SIZE;
+
+        /* set the default maximum save latency */
+        pState->maxLatencyMs = DEFAULT_MAX_LATENCY_MS;
+
+        /* set the default dirty set reconciliation interval */
+        pState->reconcileMs = DEFAULT_RECONCILE_MS;
+
+        /* set the default shutdown save time limit */
+        pState->shutdownMs = DEFAULT_SHUTDOWN_MS;
+
+        /* set the default number of shard worker threads */
+        pState->shardWorkers = DEFAULT_SHARD_WORKERS;
 
         /* get a handle to the variable server for transition events */
         pState->hVarServer = VARSERVER_Open();
@@ -175,45 +320,83 @@ int main(int argC, char *argV[])
             SetupTerminationHandler();
 
             /* Process Options */
-            ProcessOptions( argC, argV, pState );
+            if ( ProcessOptions( argC, argV, pState ) != EOK )
+            {
+                usage( argV[0] );
+                status = 1;
+            }
+            else if ( ( pState->metricsPrefix != NULL ) &&
+                      ( StartMetrics( pState ) != EOK ) )
+            {
+                fprintf( stderr, "Cannot export metrics\n" );
+            }
+            else if ( ( ( pState->profilefile != NULL ) &&
+                   ( PROFILE_Load( pState, pState->profilefile ) != EOK ) ) ||
+                 ( ( pState->profilefile == NULL ) &&
+                   ( PROFILE_Add( pState, pState ) != EOK ) ) )
+            {
+                fprintf( stderr, "Cannot load save profiles\n" );
+            }
+            else if ( InitPipeline( pState ) != EOK )
+            {
+                fprintf( stderr, "Cannot initialize save pipeline\n" );
+            }
+            else if ( InitProfiles( pState ) != EOK )
+            {
+                fprintf( stderr, "Cannot initialize save profiles\n" );
+            }
+            else if ( ( pState->ringDepth > 0 ) &&
+                      ( StartRing( pState ) != EOK ) )
+            {
+                fprintf( stderr, "Cannot initialize io_uring\n" );
+            }
+            else if ( ( pState->track == true ) &&
+                      ( StartTracking( pState ) != EOK ) )
+            {
+                fprintf( stderr, "Cannot initialize change tracking\n" );
+            }
+            else
+            {
+                /* run the service */
+                RunSvc( pState );
+            }
 
-            if ( pState->triggervar != NULL )
+            /* the writer thread must exit before its state is released */
+            StopPipeline( pState );
+
+            /* release the profiles, output shards, save history, metrics,
+               io_uring instance, output buffer, save arena, saved variable table,
+               dirty set, filter, snapshot buffers and read-back snapshot */
+            PROFILE_Free( pState );
+            SHARD_Free( pState );
+            HISTORY_Free( &pState->history );
+            if ( pState->pMetrics != NULL )
             {
-                /* get a handle to the trigger variable */
-                hVar = VAR_FindByName( pState->hVarServer, pState->triggervar );
-                if ( hVar != VAR_INVALID )
-                {
-                    pState->hTriggerVar = hVar;
+                METRICS_Free( pState->pMetrics );
+            }
 
-                    /* request MODIFIED notification from the varserver
-                       for the trigger variable */
-                    rc = VAR_Notify( pState->hVarServer,
-                                     pState->hTriggerVar,
-                                     NOTIFY_MODIFIED );
-                    if ( rc == EOK )
-                    {
-                        /* run the service */
-                        RunSvc( pState );
-                    }
-                    else
-                    {
-                        fprintf( stderr,
-                                 "notification request failed for %s\n",
-                                 pState->triggervar );
-                    }
-                }
-                else
-                {
-                    fprintf( stderr,
-                             "Cannot find trigger variable: %s\n",
-                             pState->triggervar );
-                }
+            if ( pState->pRing != NULL )
+            {
+                URING_Free( pState->pRing );
             }
-            else
+
+            OUTBUF_Free( &pState->out );
+            ARENA_Free( &pState->arena );
+            VARTAB_Free( &pState->saved );
+            DIRTYSET_Free( &pState->dirty );
+            FILTER_Free( &pState->filter );
+            if ( pState->donefd != -1 )
             {
-                fprintf( stderr, "No trigger variable specified\n");
+                close( pState->donefd );
             }
 
+            for ( i = 0; i < SNAPSHOT_BUFFERS; i++ )
+            {
+                SNAPSHOT_Free( &pState->snapshot[i] );
+            }
+
+            SNAPSHOT_Free( &pState->readback );
+
             /* close the variable server */
             if ( VARSERVER_Close( pState->hVarServer ) == EOK )
             {
@@ -228,7 +411,7 @@ int main(int argC, char *argV[])
         free( pState );
     }
 
-    return 0;
+    return status;
 }
 
 /*============================================================================*/
@@ -251,9 +434,57 @@ static void usage( char *cmdname )
     if( cmdname != NULL )
     {
         fprintf(stderr,
-                "usage: %s [-f name] [-t varname] [-v] [-h]\n"
+                "usage: %s [-f name] [-t varname] [-b size] [-j] [-J size] "
+                "[-R percent] [-d ms] [-m ms] [-w] [-B size] [-S mode] "
+                "[-F format] [-T] [-r ms] [-a ms] [-k ms] [-c path] [-P file] [-s depth] "
+                "[-n workers] [-C] [-G] [-M prefix] [-U depth] [-g] [-p filter] "
+                "[-v] [-h]\n"
                 " [-f filename] : output file name\n"
                 " [-t triggervar] : trigger variable name\n"
+                " [-b size] : output buffer size (flush threshold) in bytes\n"
+                " [-j] : append changed variables to a journal\n"
+                " [-J size] : journal size which triggers a compaction\n"
+                " [-R percent] : journal to output file size ratio which "
+                "triggers a compaction\n"
+                " [-d ms] : debounce window for coalescing save triggers\n"
+                " [-m ms] : maximum save latency when debouncing\n"
+                " [-w] : write files on a dedicated writer thread\n"
+                " [-B size] : variable retrieval batch size in bytes "
+                "(0 to disable)\n"
+                " [-S mode] : durability mode: "
+                "none, fdatasync, dirsync, or range\n"
+                " [-F format] : output file format: text or binary "
+                "(binary files are converted for loadconfig with savecvt)\n"
+                " [-T] : track modified variables instead of querying "
+                "for dirty variables on each save\n"
+                " [-r ms] : interval for reconciling tracked variables with "
+                "their dirty flags, which are also reconciled before each "
+                "full save (0 to disable the interval)\n"
+                " [-a ms] : automatic save interval (0 to disable)\n"
+                " [-k ms] : time limit for the final save on shutdown "
+                "(0 to disable)\n"
+                " [-c path] : control socket path (commands: save, stats)\n"
+                " [-P file] : save profile file with lines of: "
+                "triggervar filename [filter ...]\n"
+                " [-s depth] : shard the output into one file per variable "
+                "name prefix of depth components, listed in a manifest\n"
+                " [-n workers] : number of shard worker threads\n"
+                " [-C] : clear the dirty flags of committed variables, "
+                "so each save only captures recent changes\n"
+                " [-G] : consistent snapshots: record the generation marker "
+                "of each save in the output header, and capture every "
+                "variable modified after it on the next save (implies -C)\n"
+                " [-M prefix] : export save metrics as the variables "
+                "prefix/saves, failures, skipped, vars, bytes, query, "
+                "format, write, fsync, rename, and save\n"
+                " [-U depth] : commit the output on the writer thread with "
+                "an io_uring queue of depth entries (requires -w; default 0 "
+                "for synchronous system calls)\n"
+                " [-g] : register the output buffers with io_uring\n"
+                " [-p filter] : save only the variables selected by a "
+                "name prefix, or by regex=pattern, tags=tags, or "
+                "flags=flags (repeatable; profiles only inherit the tags "
+                "and flags)\n"
                 " [-h] : display this help\n"
                 " [-v] : verbose output\n",
                 cmdname );
@@ -281,15 +512,18 @@ static void usage( char *cmdname )
         pState
             pointer to the vars state
 
-    @return none
+    @retval EOK - success
+    @retval EINVAL - an option is invalid
 
 ==============================================================================*/
 static int ProcessOptions( int argC,
                            char *argV[],
                            SaveSvcState *pState )
 {
+    int result = EOK;
+    unsigned long value;
     int c;
-    const char *options = "hvt:f:";
+    const char *options = "hvt:f:b:jJ:R:d:m:wB:S:F:Tr:a:k:c:P:s:n:CGM:U:gp:";
 
     if( ( pState != NULL ) &&
         ( argV != NULL ) )
@@ -310,282 +544,1902 @@ static int ProcessOptions( int argC,
                     pState->filename = optarg;
                     break;
 
-                case 'h':
-                    usage( argV[0] );
+                case 'b':
+                    if ( ParseNumber( c,
+                                      optarg,
+                                      MAX_SIZE_OPTION,
+                                      &value ) == EOK )
+                    {
+                        pState->bufsize = value;
+                    }
+                    else
+                    {
+                        result = EINVAL;
+                    }
                     break;
 
-                default:
+                case 'j':
+                    pState->journal = true;
                     break;
 
-            }
-        }
-    }
+                case 'J':
+                    if ( ParseNumber( c,
+                                      optarg,
+                                      MAX_SIZE_OPTION,
+                                      &value ) == EOK )
+                    {
+                        pState->compactSize = value;
+                    }
+                    else
+                    {
+                        result = EINVAL;
+                    }
+                    break;
 
-    return 0;
-}
+                case 'R':
+                    if ( ParseNumber( c,
+                                      optarg,
+                                      MAX_COMPACT_RATIO,
+                                      &value ) == EOK )
+                    {
+                        pState->compactRatio = value;
+                    }
+                    else
+                    {
+                        result = EINVAL;
+                    }
+                    break;
 
-/*============================================================================*/
-/*  RunSvc                                                                    */
-/*!
-    Run the save service
+                case 'd':
+                    if ( ParseNumber( c, optarg, UINT_MAX, &value ) == EOK )
+                    {
+                        pState->debounceMs = value;
+                    }
+                    else
+                    {
+                        result = EINVAL;
+                    }
+                    break;
 
-    The RunSvc function waits for a MODIFIED signal on the trigger
-    variable and writes out the configuration file containing all of
-    the dirty variables
+                case 'm':
+                    if ( ParseNumber( c, optarg, UINT_MAX, &value ) == EOK )
+                    {
+                        pState->maxLatencyMs = value;
+                    }
+                    else
+                    {
+                        result = EINVAL;
+                    }
+                    break;
 
-    Under normal circumstances this function will not return
+                case 'w':
+                    pState->pipeline = true;
+                    break;
 
-    @param[in]
-        pState
-            pointer to the SaveSvc state
+                case 'B':
+                    if ( ParseNumber( c,
+                                      optarg,
+                                      MAX_SIZE_OPTION,
+                                      &value ) == EOK )
+                    {
+                        pState->batchsize = value;
+                    }
+                    else
+                    {
+                        result = EINVAL;
+                    }
+                    break;
 
-    @retval EOK - success
-    @retval EINVAL - invalid arguments
+                case 'S':
+                    if ( ParseDurability( optarg,
+                                          &pState->durability ) != EOK )
+                    {
+                        fprintf( stderr,
+                                 "Invalid durability mode: %s\n",
+                                 optarg );
+                        result = EINVAL;
+                    }
+                    break;
 
-==============================================================================*/
-static int RunSvc( SaveSvcState *pState )
-{
-    int result = EINVAL;
-    int sig;
-    int fd;
-    int sigval;
+                case 'F':
+                    if ( ParseFormat( optarg, &pState->format ) != EOK )
+                    {
+                        fprintf( stderr,
+                                 "Invalid output format: %s\n",
+                                 optarg );
+                        result = EINVAL;
+                    }
+                    break;
 
-    if ( pState != NULL )
-    {
-        result = EOK;
+                case 'T':
+                    pState->track = true;
+                    break;
 
-        /* set up the signal file descriptor to receive notifications */
-        fd = VARSERVER_Signalfd( 0 );
+                case 'r':
+                    if ( ParseNumber( c, optarg, UINT_MAX, &value ) == EOK )
+                    {
+                        pState->reconcileMs = value;
+                    }
+                    else
+                    {
+                        result = EINVAL;
+                    }
+                    break;
 
-        while ( 1 )
-        {
-            /* wait for a signal */
-            sig = VARSERVER_WaitSignalfd( fd, &sigval );
+                case 'a':
+                    if ( ParseNumber( c, optarg, UINT_MAX, &value ) == EOK )
+                    {
+                        pState->autosaveMs = value;
+                    }
+                    else
+                    {
+                        result = EINVAL;
+                    }
+                    break;
 
-            if ( ( sig == SIG_VAR_MODIFIED ) &&
-                 ( pState->hTriggerVar == (VAR_HANDLE)sigval ) )
-            {
-                if ( pState->verbose == true )
-                {
-                    printf("Saving all dirty variables\n");
-                }
+                case 'k':
+                    if ( ParseNumber( c, optarg, UINT_MAX, &value ) == EOK )
+                    {
+                        pState->shutdownMs = value;
+                    }
+                    else
+                    {
+                        result = EINVAL;
+                    }
+                    break;
 
-                /* Create the variable configuration file */
-                result = InitConfig( pState );
-                if ( result == EOK )
-                {
-                    result = WriteConfig( pState );
-                    if ( result == EOK )
+                case 'c':
+                    pState->ctlpath = optarg;
+                    break;
+
+                case 'P':
+                    pState->profilefile = optarg;
+                    break;
+
+                case 's':
+                    if ( ParseNumber( c,
+                                      optarg,
+                                      SHARD_MAX_DEPTH,
+                                      &value ) == EOK )
                     {
-                        result = FinalizeConfig( pState );
+                        pState->shardDepth = value;
                     }
-                }
+                    else
+                    {
+                        result = EINVAL;
+                    }
+                    break;
 
-                if ( result != EOK )
-                {
-                    fprintf( stderr,
-                             "Failed to create configuration file: %s\n",
-                             pState->filename );
-                }
-            }
-        }
-    }
+                case 'n':
+                    if ( ParseNumber( c,
+                                      optarg,
+                                      SHARD_MAX_WORKERS,
+                                      &value ) == EOK )
+                    {
+                        pState->shardWorkers = value;
+                    }
+                    else
+                    {
+                        result = EINVAL;
+                    }
+                    break;
 
-    return result;
-}
+                case 'C':
+                    pState->clearDirty = true;
+                    break;
 
-/*============================================================================*/
-/*  InitConfig                                                                */
-/*!
-    Initialize the configuration file
+                case 'G':
+                    pState->consistent = true;
+                    pState->clearDirty = true;
+                    break;
 
-    The InitConfig function creates and opens a new temporary file
-    for writing the dirty configuration data into.
+                case 'M':
+                    pState->metricsPrefix = optarg;
+                    break;
 
-    if the file is successfully created, pState->fd is a handle to
-    the configuration file which was opened for writing
+                case 'U':
+                    if ( ParseNumber( c,
+                                      optarg,
+                                      URING_MAX_DEPTH,
+                                      &value ) == EOK )
+                    {
+                        pState->ringDepth = value;
+                    }
+                    else
+                    {
+                        result = EINVAL;
+                    }
+                    break;
 
-    @param[in,out]
-        pState
-            pointer to the SaveSvc state which contains the config file name
+                case 'g':
+                    pState->ringFixed = true;
+                    break;
 
-    @retval EOK - success
-    @retval EINVAL - invalid arguments
-    @retval other error from open()
+                case 'p':
+                    if ( FILTER_Parse( &pState->filter, optarg ) != EOK )
+                    {
+                        fprintf( stderr, "Invalid filter: %s\n", optarg );
+                        result = EINVAL;
+                    }
+                    break;
 
-==============================================================================*/
-static int InitConfig( SaveSvcState *pState )
-{
-    int result = EINVAL;
-    int n;
-    int rc;
+                case 'h':
+                    usage( argV[0] );
+                    break;
 
-    if ( ( pState != NULL ) &&
-         ( pState->filename != NULL ) )
-    {
-        /* create the temporary file name */
-        n = snprintf( pState->tmpfile,
-                      sizeof pState->tmpfile,
-                      "%s.%s",
-                      pState->filename,
-                      ".tmp" );
-        if ( n > 0 )
-        {
-            if ( (size_t)n < sizeof pState->tmpfile )
-            {
-                /* remove any previous file which may be left around */
-                rc = unlink( pState->tmpfile );
-                if ( rc == -1 )
-                {
-                    result = rc;
-                }
+                default:
+                    break;
 
-                /* open the output file for creation/writing */
-                pState->fd = open( pState->tmpfile, O_CREAT | O_WRONLY, 0644 );
-                if ( pState->fd == -1 )
-                {
-                    /* an error occurred */
-                    result = errno;
-                }
-                else
-                {
-                    /* file was opened ok */
-                    result = EOK;
-                }
             }
         }
+
+        if ( ( pState->format == FORMAT_BINARY ) &&
+             ( pState->journal == true ) )
+        {
+            /* journal entries are var=value text */
+            fprintf( stderr, "Journal is not supported in binary format\n" );
+            pState->journal = false;
+        }
+
+        if ( ( pState->shardDepth > 0 ) &&
+             ( pState->journal == true ) )
+        {
+            /* shards are always saved as complete files */
+            fprintf( stderr, "Journal is not supported with shards\n" );
+            pState->journal = false;
+        }
     }
 
     return result;
 }
 
 /*============================================================================*/
-/*  WriteConfig                                                               */
+/*  ParseNumber                                                               */
 /*!
-    Write data to the configuration file
+    Parse a numeric option
 
-    The WriteConfig function iterates through all of the dirty configuration
-    variables and writes them to the configuration file as var=value pairs.
+    The ParseNumber function converts the text of a numeric option to
+    an unsigned number.  The whole text must be a decimal, octal or
+    hexadecimal number no larger than the maximum, otherwise the option
+    is reported as invalid.
 
-    @param[in,out]
-        pState
-            pointer to the SaveSvc state which contains the config
-            file descriptor
+    @param[in]
+        option
+            option character, for the error message
+
+    @param[in]
+        text
+            option text to convert
+
+    @param[in]
+        max
+            largest value accepted
+
+    @param[out]
+        pValue
+            pointer to the location to store the value
 
     @retval EOK - success
-    @retval EINVAL - invalid arguments
-    @retval other error from open()
+    @retval EINVAL - the text is not a number
+    @retval ERANGE - the number is larger than the maximum
 
 ==============================================================================*/
-static int WriteConfig( SaveSvcState *pState )
+static int ParseNumber( int option,
+                        const char *text,
+                        unsigned long max,
+                        unsigned long *pValue )
 {
     int result = EINVAL;
-    char *config = "@config User Settings\n\n";
-    ssize_t n;
-    ssize_t len;
+    unsigned long value;
+    char *end = NULL;
 
-    if ( ( pState != NULL ) &&
-         ( pState->fd != -1 ) )
+    if ( ( text != NULL ) &&
+         ( pValue != NULL ) &&
+         ( isdigit( (unsigned char)text[0] ) != 0 ) )
     {
-        /* write the file header */
-        len = strlen(config);
-        n = write( pState->fd, config, len );
-        if ( n != len )
+        errno = 0;
+        value = strtoul( text, &end, 0 );
+        if ( ( end == text ) || ( *end != '\0' ) )
         {
-            fprintf( stderr, "Header output failed\n" );
+            result = EINVAL;
+        }
+        else if ( ( errno == ERANGE ) || ( value > max ) )
+        {
+            result = ERANGE;
         }
         else
         {
-            /* output all dirty variables */
-            result = WriteConfigVars( pState );
+            *pValue = value;
+            result = EOK;
         }
+    }
 
-        /* close the output file */
-        close( pState->fd );
-        pState->fd = -1;
+    if ( result == EINVAL )
+    {
+        fprintf( stderr, "Invalid value for -%c: %s\n", option, text );
+    }
+    else if ( result == ERANGE )
+    {
+        fprintf( stderr,
+                 "Value for -%c is out of range (0 to %lu): %s\n",
+                 option,
+                 max,
+                 text );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  RunSvc                                                                    */
+/*!
+    Run the save service
+
+    The RunSvc function waits for a MODIFIED signal on the trigger
+    variable and writes out the configuration file containing all of
+    the dirty variables
+
+    All of the event sources are multiplexed on a single epoll instance:
+    the variable server signal descriptor, the shutdown signal descriptor,
+    the debounce and automatic save timers, the writer thread completion
+    event, and the control socket and its connections.
+
+    If change tracking is enabled, MODIFIED signals for other variables
+    add those variables to the dirty set.  The dirty set is reconciled
+    with the dirty flags of the variables on a periodic timer, to
+    recover from dropped signals.
+
+    If a debounce window is configured, the save is deferred until no
+    further triggers have been received for the duration of the debounce
+    window, so a burst of triggers is coalesced into a single save.
+    The save is never deferred by more than the maximum latency after
+    the first pending trigger.
+
+    If an automatic save interval is configured, expiry of the interval
+    acts as a save trigger.  With change tracking, the automatic save is
+    skipped if no tracked variable has been modified since the last save.
+    Otherwise an unchanged configuration is detected and discarded by
+    SaveConfig.
+
+    On SIGTERM or SIGINT, a final save is performed within the shutdown
+    time limit and the function returns.
+
+    @param[in]
+        pState
+            pointer to the SaveSvc state
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval other error from setting up the event sources
+
+==============================================================================*/
+static int RunSvc( SaveSvcState *pState )
+{
+    int result = EINVAL;
+    SvcLoop loop;
+    struct epoll_event events[MAX_EVENTS];
+    int n;
+    int fd;
+    int i;
+
+    if ( pState != NULL )
+    {
+        result = OpenLoop( pState, &loop );
+
+        while ( loop.running == true )
+        {
+            /* wait for events */
+            n = epoll_wait( loop.epfd, events, MAX_EVENTS, -1 );
+
+            for ( i = 0; ( i < n ) && ( loop.running == true ); i++ )
+            {
+                fd = events[i].data.fd;
+
+                if ( fd == loop.sigfd )
+                {
+                    HandleVarSignal( &loop );
+                }
+                else if ( fd == loop.debouncefd )
+                {
+                    (void)ReadCounter( fd );
+                    (void)Save( &loop, loop.due );
+                }
+                else if ( fd == loop.autosavefd )
+                {
+                    HandleAutosave( &loop );
+                }
+                else if ( fd == loop.reconcilefd )
+                {
+                    HandleReconcile( &loop );
+                }
+                else if ( fd == pState->donefd )
+                {
+                    HandleSaveDone( &loop );
+                }
+                else if ( fd == loop.shutdownfd )
+                {
+                    result = HandleShutdown( &loop );
+                }
+                else if ( fd == loop.ctlfd )
+                {
+                    HandleConnect( &loop );
+                }
+                else
+                {
+                    HandleControl( &loop, fd );
+                }
+            }
+        }
+
+        CloseLoop( &loop );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  OpenLoop                                                                  */
+/*!
+    Set up the event sources of the save service
+
+    The OpenLoop function creates the epoll instance and registers
+    each of the event sources with it.  The loop is left not running
+    if any of the event sources cannot be set up.
+
+    @param[in]
+        pState
+            pointer to the SaveSvc state
+
+    @param[out]
+        pLoop
+            pointer to the event loop state to initialize
+
+    @retval EOK - success
+    @retval other error from setting up the event sources
+
+==============================================================================*/
+static int OpenLoop( SaveSvcState *pState, SvcLoop *pLoop )
+{
+    int result = EOK;
+
+    memset( pLoop, 0, sizeof( SvcLoop ) );
+    pLoop->pState = pState;
+
+    /* set up the signal file descriptor to receive notifications */
+    pLoop->sigfd = VARSERVER_Signalfd( 0 );
+
+    /* set up the termination signal descriptor, the timers, and the
+       control socket */
+    pLoop->shutdownfd = OpenShutdownfd();
+    pLoop->debouncefd = OpenTimerfd( 0 );
+    pLoop->autosavefd = ( pState->autosaveMs > 0 )
+                        ? OpenTimerfd( pState->autosaveMs )
+                        : -1;
+    pLoop->reconcilefd = ( ( pState->track == true ) &&
+                           ( pState->reconcileMs > 0 ) )
+                         ? OpenTimerfd( pState->reconcileMs )
+                         : -1;
+    pLoop->ctlfd = ( pState->ctlpath != NULL )
+                   ? CONTROL_Listen( pState->ctlpath )
+                   : -1;
+
+    pLoop->epfd = epoll_create1( EPOLL_CLOEXEC );
+
+    if ( ( pLoop->sigfd == -1 ) ||
+         ( pLoop->shutdownfd == -1 ) ||
+         ( pLoop->debouncefd == -1 ) ||
+         ( ( pState->autosaveMs > 0 ) && ( pLoop->autosavefd == -1 ) ) ||
+         ( ( pState->track == true ) &&
+           ( pState->reconcileMs > 0 ) &&
+           ( pLoop->reconcilefd == -1 ) ) ||
+         ( ( pState->ctlpath != NULL ) && ( pLoop->ctlfd == -1 ) ) ||
+         ( pLoop->epfd == -1 ) ||
+         ( AddEvent( pLoop->epfd, pLoop->sigfd ) != EOK ) ||
+         ( AddEvent( pLoop->epfd, pLoop->shutdownfd ) != EOK ) ||
+         ( AddEvent( pLoop->epfd, pLoop->debouncefd ) != EOK ) ||
+         ( AddEvent( pLoop->epfd, pLoop->autosavefd ) != EOK ) ||
+         ( AddEvent( pLoop->epfd, pLoop->reconcilefd ) != EOK ) ||
+         ( AddEvent( pLoop->epfd, pState->donefd ) != EOK ) ||
+         ( AddEvent( pLoop->epfd, pLoop->ctlfd ) != EOK ) )
+    {
+        result = errno;
+        fprintf( stderr, "Cannot set up event loop: %s\n", strerror( result ) );
+    }
+    else
+    {
+        pLoop->running = true;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  CloseLoop                                                                 */
+/*!
+    Release the event sources of the save service
+
+    Control connections still waiting for a save to complete are told
+    the service is shutting down.
+
+    @param[in,out]
+        pLoop
+            pointer to the event loop state
+
+==============================================================================*/
+static void CloseLoop( SvcLoop *pLoop )
+{
+    size_t i;
+
+    for ( i = 0; i < pLoop->nwaiters; i++ )
+    {
+        (void)CONTROL_Reply( pLoop->waiters[i].fd, "error shutdown" );
+        close( pLoop->waiters[i].fd );
+    }
+
+    pLoop->nwaiters = 0;
+
+    if ( pLoop->epfd != -1 )
+    {
+        close( pLoop->epfd );
+    }
+
+    if ( pLoop->ctlfd != -1 )
+    {
+        close( pLoop->ctlfd );
+        (void)unlink( pLoop->pState->ctlpath );
+    }
+
+    if ( pLoop->autosavefd != -1 )
+    {
+        close( pLoop->autosavefd );
+    }
+
+    if ( pLoop->reconcilefd != -1 )
+    {
+        close( pLoop->reconcilefd );
+    }
+
+    if ( pLoop->debouncefd != -1 )
+    {
+        close( pLoop->debouncefd );
+    }
+
+    if ( pLoop->shutdownfd != -1 )
+    {
+        close( pLoop->shutdownfd );
+    }
+}
+
+/*============================================================================*/
+/*  AddEvent                                                                  */
+/*!
+    Register a file descriptor with the epoll instance
+
+    @param[in]
+        epfd
+            epoll instance
+
+    @param[in]
+        fd
+            file descriptor to wait for input on, or -1 for a disabled
+            event source, which is ignored
+
+    @retval EOK - success
+    @retval other error from epoll_ctl()
+
+==============================================================================*/
+static int AddEvent( int epfd, int fd )
+{
+    int result = EOK;
+    struct epoll_event ev;
+
+    if ( fd != -1 )
+    {
+        memset( &ev, 0, sizeof( ev ) );
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+
+        if ( epoll_ctl( epfd, EPOLL_CTL_ADD, fd, &ev ) != 0 )
+        {
+            result = errno;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  HandleVarSignal                                                           */
+/*!
+    Handle a signal from the variable server
+
+    A MODIFIED signal for a trigger variable triggers a save of the
+    profiles which use it.  Any other MODIFIED signal is for a tracked
+    variable, which is added to the dirty set.  A PRINT signal is a
+    request to read an exported metric.
+
+    @param[in,out]
+        pLoop
+            pointer to the event loop state
+
+==============================================================================*/
+static void HandleVarSignal( SvcLoop *pLoop )
+{
+    SaveSvcState *pState = pLoop->pState;
+    uint64_t profiles;
+    int32_t sigval;
+    int sig;
+
+    sig = VARSERVER_WaitSignalfd( pLoop->sigfd, &sigval );
+    if ( sig == SIG_VAR_MODIFIED )
+    {
+        profiles = PROFILE_Triggered( pState, (VAR_HANDLE)sigval );
+        if ( profiles != 0 )
+        {
+            Trigger( pLoop, profiles );
+        }
+        else if ( ( pState->track == true ) &&
+                  ( DIRTYSET_Mark( &pState->dirty,
+                                   (VAR_HANDLE)sigval ) == EOK ) )
+        {
+            /* a tracked variable has been modified */
+            pLoop->changed = true;
+        }
+    }
+    else if ( sig == SIG_VAR_PRINT )
+    {
+        (void)METRICS_Print( pState->pMetrics, pState->hVarServer, sigval );
+    }
+}
+
+/*============================================================================*/
+/*  HandleAutosave                                                            */
+/*!
+    Handle expiry of the automatic save timer
+
+    The automatic save is skipped if nothing has changed: with
+    modification tracking if no tracked variable was modified, and
+    otherwise if the variable server has no dirty variable to save.
+
+    @param[in,out]
+        pLoop
+            pointer to the event loop state
+
+==============================================================================*/
+static void HandleAutosave( SvcLoop *pLoop )
+{
+    SaveSvcState *pState = pLoop->pState;
+
+    if ( ( ReadCounter( pLoop->autosavefd ) > 0 ) &&
+         ( pLoop->pending == false ) &&
+         ( ( pState->track == true ) ? ( pLoop->changed == true )
+                                     : ( HasDirtyVars( pState ) == true ) ) )
+    {
+        if ( pState->verbose == true )
+        {
+            printf( "Automatic save\n" );
+        }
+
+        /* the timer acts as a save trigger for all of the profiles */
+        Trigger( pLoop, PROFILE_ALL( pState->nprofiles ) );
+    }
+}
+
+/*============================================================================*/
+/*  HandleReconcile                                                           */
+/*!
+    Handle expiry of the dirty set reconciliation timer
+
+    Tracked variables whose modification was missed are marked in the
+    dirty set, and count as a change for the automatic and final saves.
+
+    @param[in,out]
+        pLoop
+            pointer to the event loop state
+
+==============================================================================*/
+static void HandleReconcile( SvcLoop *pLoop )
+{
+    size_t marked = 0;
+
+    if ( ( ReadCounter( pLoop->reconcilefd ) > 0 ) &&
+         ( ReconcileTracking( pLoop->pState, &marked ) == EOK ) &&
+         ( marked > 0 ) )
+    {
+        pLoop->changed = true;
+    }
+}
+
+/*============================================================================*/
+/*  HandleShutdown                                                            */
+/*!
+    Handle a termination signal
+
+    The HandleShutdown function performs the final save, if one is
+    needed, and stops the event loop.
+
+    @param[in,out]
+        pLoop
+            pointer to the event loop state
+
+    @retval EOK - success
+    @retval other error from the final save
+
+==============================================================================*/
+static int HandleShutdown( SvcLoop *pLoop )
+{
+    SaveSvcState *pState = pLoop->pState;
+    struct signalfd_siginfo info;
+    int result = EOK;
+
+    if ( read( pLoop->shutdownfd, &info, sizeof( info ) ) == sizeof( info ) )
+    {
+        syslog( LOG_INFO, "savesvc shutting down\n" );
+
+        if ( ( pState->shutdownMs > 0 ) &&
+             ( ( pLoop->pending == true ) ||
+               ( pState->track == false ) ||
+               ( pLoop->changed == true ) ) )
+        {
+            result = ShutdownSave( pState );
+        }
+
+        pLoop->running = false;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Trigger                                                                   */
+/*!
+    Trigger a save
+
+    The Trigger function records a save trigger, and either saves
+    immediately or (re)arms the debounce timer for the save deadline.
+    The debounce window is shared by all of the profiles, so profiles
+    triggered within it are saved together from a single snapshot.
+
+    @param[in,out]
+        pLoop
+            pointer to the event loop state
+
+    @param[in]
+        profiles
+            triggered profiles (one bit per profile)
+
+==============================================================================*/
+static void Trigger( SvcLoop *pLoop, uint64_t profiles )
+{
+    uint64_t deadline;
+
+    pLoop->due |= profiles;
+
+    pLoop->last = TimeNowMs();
+    if ( pLoop->pending == false )
+    {
+        pLoop->first = pLoop->last;
+        pLoop->pending = true;
+    }
+
+    pLoop->triggers++;
+
+    deadline = GetSaveDeadline( pLoop->pState, pLoop->first, pLoop->last );
+    if ( deadline <= pLoop->last )
+    {
+        (void)Save( pLoop, pLoop->due );
+    }
+    else
+    {
+        (void)ArmTimer( pLoop->debouncefd, deadline );
+    }
+}
+
+/*============================================================================*/
+/*  Save                                                                      */
+/*!
+    Save the dirty variables
+
+    The Save function cancels any pending debounced save, and requests
+    a save of the dirty variables for the specified profiles along with
+    any profiles with a pending save.
+
+    @param[in,out]
+        pLoop
+            pointer to the event loop state
+
+    @param[in]
+        profiles
+            profiles to save (one bit per profile)
+
+    @retval EOK - success
+    @retval other error from the save request
+
+==============================================================================*/
+static int Save( SvcLoop *pLoop, uint64_t profiles )
+{
+    SaveSvcState *pState = pLoop->pState;
+
+    profiles |= pLoop->due;
+
+    if ( ( pState->verbose == true ) && ( pLoop->triggers > 1 ) )
+    {
+        printf( "Coalesced %u save triggers\n", pLoop->triggers );
+    }
+
+    pLoop->pending = false;
+    pLoop->changed = false;
+    pLoop->triggers = 0;
+    pLoop->due = 0;
+    (void)ArmTimer( pLoop->debouncefd, 0 );
+
+    /* save the dirty variables */
+    return RequestSave( pState, profiles );
+}
+
+/*============================================================================*/
+/*  HandleSaveDone                                                            */
+/*!
+    Handle completion of a save by the writer thread
+
+    The HandleSaveDone function clears the dirty flags of a committed
+    snapshot, and replies to each control connection waiting for a save
+    request which has now been completed.  A save request superseded by
+    a later one is completed with it.
+
+    @param[in,out]
+        pLoop
+            pointer to the event loop state
+
+==============================================================================*/
+static void HandleSaveDone( SvcLoop *pLoop )
+{
+    SaveSvcState *pState = pLoop->pState;
+    uint64_t seq;
+    int rc;
+    size_t i = 0;
+
+    (void)ReadCounter( pState->donefd );
+
+    ReleaseCommitted( pState );
+
+    pthread_mutex_lock( &pState->lock );
+    seq = pState->completedSeq;
+    rc = pState->completedResult;
+    pthread_mutex_unlock( &pState->lock );
+
+    while ( i < pLoop->nwaiters )
+    {
+        if ( pLoop->waiters[i].seq <= seq )
+        {
+            ReplyResult( pLoop->waiters[i].fd, rc );
+            close( pLoop->waiters[i].fd );
+            pLoop->waiters[i] = pLoop->waiters[--pLoop->nwaiters];
+        }
+        else
+        {
+            i++;
+        }
+    }
+}
+
+/*============================================================================*/
+/*  HandleConnect                                                             */
+/*!
+    Accept connections on the control socket
+
+    @param[in,out]
+        pLoop
+            pointer to the event loop state
+
+==============================================================================*/
+static void HandleConnect( SvcLoop *pLoop )
+{
+    int fd;
+
+    while ( ( fd = CONTROL_Accept( pLoop->ctlfd ) ) != -1 )
+    {
+        if ( AddEvent( pLoop->epfd, fd ) != EOK )
+        {
+            close( fd );
+        }
+    }
+}
+
+/*============================================================================*/
+/*  HandleControl                                                             */
+/*!
+    Handle a command on a control connection
+
+    The following commands are supported:
+
+        save  - save the dirty variables now, and reply "ok" once the
+                configuration has been committed
+        stats - reply with the save statistics of each profile
+
+    Unless it is waiting for a save to complete, the connection is
+    closed after the reply.
+
+    With the writer thread, the statistics are modified while a save is
+    in progress, so the copy published by the writer thread after its
+    last save is sent instead.
+
+    @param[in,out]
+        pLoop
+            pointer to the event loop state
+
+    @param[in]
+        fd
+            control connection descriptor
+
+==============================================================================*/
+static void HandleControl( SvcLoop *pLoop, int fd )
+{
+    SaveSvcState *pState = pLoop->pState;
+    char cmd[CONTROL_MAX_COMMAND];
+    bool waiting = false;
+    int rc;
+
+    rc = CONTROL_Read( fd, cmd, sizeof( cmd ) );
+    if ( rc != EAGAIN )
+    {
+        (void)epoll_ctl( pLoop->epfd, EPOLL_CTL_DEL, fd, NULL );
+
+        if ( rc != EOK )
+        {
+            /* the connection was closed */
+        }
+        else if ( strcmp( cmd, "save" ) == 0 )
+        {
+            if ( ( pState->pipeline == true ) &&
+                 ( pLoop->nwaiters == CONTROL_MAX_WAITERS ) )
+            {
+                (void)CONTROL_Reply( fd, "error busy" );
+            }
+            else
+            {
+                rc = Save( pLoop, PROFILE_ALL( pState->nprofiles ) );
+                if ( ( rc == EOK ) && ( pState->pipeline == true ) )
+                {
+                    /* reply when the writer thread has committed it */
+                    pLoop->waiters[pLoop->nwaiters].fd = fd;
+                    pLoop->waiters[pLoop->nwaiters].seq = pState->requestSeq;
+                    pLoop->nwaiters++;
+                    waiting = true;
+                }
+                else
+                {
+                    ReplyResult( fd, rc );
+                }
+            }
+        }
+        else if ( strcmp( cmd, "stats" ) == 0 )
+        {
+            ReplyStats( pState, fd );
+        }
+        else
+        {
+            (void)CONTROL_Reply( fd, "error unknown command" );
+        }
+
+        if ( waiting == false )
+        {
+            close( fd );
+        }
+    }
+}
+
+/*============================================================================*/
+/*  ReplyResult                                                               */
+/*!
+    Reply with the result of a save on a control connection
+
+    @param[in]
+        fd
+            control connection descriptor
+
+    @param[in]
+        result
+            result of the save
+
+==============================================================================*/
+static void ReplyResult( int fd, int result )
+{
+    char reply[CONTROL_MAX_COMMAND];
+
+    if ( result == EOK )
+    {
+        (void)CONTROL_Reply( fd, "ok" );
+    }
+    else
+    {
+        snprintf( reply, sizeof( reply ), "error %s", strerror( result ) );
+        (void)CONTROL_Reply( fd, reply );
+    }
+}
+
+/*============================================================================*/
+/*  ReplyStats                                                                */
+/*!
+    Reply with the save statistics on a control connection
+
+    One line is sent for each profile.  When there are several profiles,
+    each line is prefixed with the profile output file name.
+
+    With the writer thread, the statistics are modified while a save is
+    in progress, so the copy published by the writer thread after its
+    last save is sent instead.
+
+    @param[in]
+        pState
+            pointer to the SaveSvc state
+
+    @param[in]
+        fd
+            control connection descriptor
+
+==============================================================================*/
+static void ReplyStats( SaveSvcState *pState, int fd )
+{
+    char stats[STATS_TEXT_SIZE];
+    char reply[BUFSIZ];
+    SaveSvcState *pProfile;
+    int result;
+    size_t i;
+
+    for ( i = 0; i < pState->nprofiles; i++ )
+    {
+        pProfile = pState->profiles[i];
+
+        if ( pState->pipeline == true )
+        {
+            pthread_mutex_lock( &pState->lock );
+            memcpy( stats, pProfile->statsText, sizeof( stats ) );
+            pthread_mutex_unlock( &pState->lock );
+            result = ( stats[0] != '\0' ) ? EOK : ENOENT;
+        }
+        else
+        {
+            result = FormatStats( pProfile, stats, sizeof( stats ) );
+        }
+
+        if ( result == EOK )
+        {
+            if ( pState->nprofiles > 1 )
+            {
+                snprintf( reply,
+                          sizeof( reply ),
+                          "%s: %s",
+                          pProfile->filename,
+                          stats );
+                (void)CONTROL_Reply( fd, reply );
+            }
+            else
+            {
+                (void)CONTROL_Reply( fd, stats );
+            }
+        }
+    }
+}
+
+/*============================================================================*/
+/*  OpenShutdownfd                                                            */
+/*!
+    Open a signal file descriptor for the termination signals
+
+    The OpenShutdownfd function blocks SIGTERM and SIGINT in the calling
+    thread so they are no longer handled by the TerminationHandler,
+    and returns a signal file descriptor which receives them instead.
+
+    @retval signal file descriptor
+    @retval -1 on failure (errno is set)
+
+==============================================================================*/
+static int OpenShutdownfd( void )
+{
+    sigset_t mask;
+    int fd = -1;
+
+    sigemptyset( &mask );
+    sigaddset( &mask, SIGTERM );
+    sigaddset( &mask, SIGINT );
+
+    if ( pthread_sigmask( SIG_BLOCK, &mask, NULL ) == 0 )
+    {
+        fd = signalfd( -1, &mask, SFD_NONBLOCK | SFD_CLOEXEC );
+    }
+
+    return fd;
+}
+
+/*============================================================================*/
+/*  OpenTimerfd                                                               */
+/*!
+    Open a timer file descriptor
+
+    @param[in]
+        intervalMs
+            interval (in milliseconds) of a periodic timer, or zero for
+            a timer which is armed later with ArmTimer
+
+    @retval timer file descriptor
+    @retval -1 on failure (errno is set)
+
+==============================================================================*/
+static int OpenTimerfd( unsigned int intervalMs )
+{
+    struct itimerspec its;
+    int fd;
+
+    fd = timerfd_create( CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC );
+    if ( ( fd != -1 ) &&
+         ( intervalMs > 0 ) )
+    {
+        its.it_interval.tv_sec = intervalMs / 1000;
+        its.it_interval.tv_nsec = ( intervalMs % 1000 ) * 1000000L;
+        its.it_value = its.it_interval;
+
+        if ( timerfd_settime( fd, 0, &its, NULL ) != 0 )
+        {
+            close( fd );
+            fd = -1;
+        }
+    }
+
+    return fd;
+}
+
+/*============================================================================*/
+/*  ArmTimer                                                                  */
+/*!
+    Arm a one-shot timer
+
+    @param[in]
+        fd
+            timer file descriptor
+
+    @param[in]
+        deadline
+            monotonic time (in milliseconds) at which the timer expires,
+            or zero to disarm the timer
+
+    @retval EOK - success
+    @retval other error from timerfd_settime()
+
+==============================================================================*/
+static int ArmTimer( int fd, uint64_t deadline )
+{
+    struct itimerspec its;
+
+    memset( &its, 0, sizeof( its ) );
+    its.it_value.tv_sec = deadline / 1000;
+    its.it_value.tv_nsec = ( deadline % 1000 ) * 1000000L;
+
+    return ( timerfd_settime( fd, TFD_TIMER_ABSTIME, &its, NULL ) == 0 )
+           ? EOK
+           : errno;
+}
+
+/*============================================================================*/
+/*  ReadCounter                                                               */
+/*!
+    Read and reset the counter of a timer or event file descriptor
+
+    @param[in]
+        fd
+            timer or event file descriptor
+
+    @retval the counter value, or zero if the counter was not set
+
+==============================================================================*/
+static uint64_t ReadCounter( int fd )
+{
+    uint64_t count = 0;
+
+    if ( read( fd, &count, sizeof( count ) ) != sizeof( count ) )
+    {
+        count = 0;
+    }
+
+    return count;
+}
+
+/*============================================================================*/
+/*  ShutdownSave                                                              */
+/*!
+    Perform the final save on shutdown
+
+    The ShutdownSave function saves the dirty variables and waits for
+    the writer thread (if any) to commit them.  If the save does not
+    complete within the shutdown time limit, the process exits
+    immediately with SHUTDOWN_TIMEOUT_STATUS.  An incomplete save never
+    replaces the committed configuration file.
+
+    The writer thread is waited for with a deadline.  Without the
+    writer thread the save runs on this thread, so it is bounded by
+    SIGALRM instead, whose handler only calls _exit().
+
+    @param[in,out]
+        pState
+            pointer to the SaveSvc state
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval other error from the save
+
+==============================================================================*/
+static int ShutdownSave( SaveSvcState *pState )
+{
+    int result = EINVAL;
+    struct itimerval itv;
+    uint64_t start;
+    uint64_t elapsed;
+
+    if ( pState != NULL )
+    {
+        start = TimeNowMs();
+
+        if ( pState->pipeline == false )
+        {
+            memset( &itv, 0, sizeof( itv ) );
+            itv.it_value.tv_sec = pState->shutdownMs / 1000;
+            itv.it_value.tv_usec = ( pState->shutdownMs % 1000 ) * 1000L;
+            setitimer( ITIMER_REAL, &itv, NULL );
+        }
+
+        result = RequestSave( pState, PROFILE_ALL( pState->nprofiles ) );
+
+        /* the snapshot capture counts against the time limit */
+        elapsed = TimeNowMs() - start;
+        elapsed = ( elapsed < pState->shutdownMs )
+                    ? elapsed
+                    : pState->shutdownMs - 1;
+
+        if ( ( result == EOK ) &&
+             ( WaitPipelineIdle( pState,
+                                 pState->shutdownMs - elapsed ) == ETIMEDOUT ) )
+        {
+            /* the writer thread is still using the state, so it
+               cannot be released */
+            syslog( LOG_ERR, "savesvc final save timed out\n" );
+            VARSERVER_Close( pState->hVarServer );
+            _exit( SHUTDOWN_TIMEOUT_STATUS );
+        }
+
+        if ( pState->pipeline == false )
+        {
+            /* cancel the time limit */
+            memset( &itv, 0, sizeof( itv ) );
+            setitimer( ITIMER_REAL, &itv, NULL );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  StartTracking                                                             */
+/*!
+    Start tracking modified variables
+
+    The StartTracking function allocates the dirty set and requests
+    MODIFIED notifications for each persistent variable
+
+    @param[in]
+        pState
+            pointer to the SaveSvc state
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval ENOMEM - memory allocation failed
+
+==============================================================================*/
+static int StartTracking( SaveSvcState *pState )
+{
+    int result = EINVAL;
+
+    if ( pState != NULL )
+    {
+        result = DIRTYSET_Init( &pState->dirty, DIRTYSET_DEFAULT_SIZE );
+        if ( result == EOK )
+        {
+            result = InitTracking( pState );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  StartMetrics                                                              */
+/*!
+    Start measuring the saves and export the save metrics
+
+    The StartMetrics function initializes the save metrics shared by
+    all of the profiles, and requests PRINT notifications for the
+    metric variables under the metrics prefix.
+
+    @param[in]
+        pState
+            pointer to the SaveSvc state
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval ENOENT - none of the metric variables were found
+    @retval other error from the initialization
+
+==============================================================================*/
+static int StartMetrics( SaveSvcState *pState )
+{
+    int result = EINVAL;
+
+    if ( pState != NULL )
+    {
+        result = METRICS_Init( &pState->metrics );
+        if ( result == EOK )
+        {
+            pState->pMetrics = &pState->metrics;
+
+            result = METRICS_Export( pState->pMetrics,
+                                     pState->hVarServer,
+                                     pState->metricsPrefix );
+            if ( result == ENOENT )
+            {
+                fprintf( stderr,
+                         "No metric variables found under %s\n",
+                         pState->metricsPrefix );
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  StartRing                                                                 */
+/*!
+    Start committing the output with io_uring
+
+    The StartRing function sets up the io_uring instance shared by all
+    of the profiles, and optionally registers the profile output buffers
+    with it.  The profiles are saved by one thread at a time, so they
+    can share the ring.  Output shards are saved in parallel, so they
+    commit with synchronous system calls.
+
+    A commit waits for its io_uring chain to complete, so the ring is
+    only used by the writer thread, where the wait does not hold up the
+    event loop.  Without the writer thread, or if io_uring is not
+    available, the profiles keep committing with synchronous system
+    calls.  If the buffers cannot be registered, the writes are not
+    made from registered buffers.
+
+    @param[in]
+        pState
+            pointer to the SaveSvc state
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval ENOMEM - memory allocation failed
+
+==============================================================================*/
+static int StartRing( SaveSvcState *pState )
+{
+    int result = EINVAL;
+    struct iovec *iov;
+    size_t i;
+    int rc;
+
+    if ( pState != NULL )
+    {
+        result = EOK;
+
+        if ( pState->pipeline == false )
+        {
+            fprintf( stderr,
+                     "io_uring commits require the writer thread (-w): "
+                     "using synchronous commits\n" );
+        }
+        else
+        {
+            rc = URING_Init( &pState->ring, pState->ringDepth );
+            if ( rc != EOK )
+            {
+                fprintf( stderr,
+                         "io_uring unavailable (%s): "
+                         "using synchronous commits\n",
+                         strerror( rc ) );
+            }
+            else
+            {
+                pState->pRing = &pState->ring;
+                for ( i = 0; i < pState->nprofiles; i++ )
+                {
+                    pState->profiles[i]->pRing = pState->pRing;
+                }
+            }
+        }
+    }
+
+    if ( ( pState != NULL ) &&
+         ( pState->pRing != NULL ) &&
+         ( pState->ringFixed == true ) )
+    {
+        iov = calloc( pState->nprofiles, sizeof( struct iovec ) );
+        if ( iov != NULL )
+        {
+            for ( i = 0; i < pState->nprofiles; i++ )
+            {
+                iov[i].iov_base = pState->profiles[i]->out.buf;
+                iov[i].iov_len = pState->profiles[i]->out.size;
+            }
+
+            rc = URING_RegisterBuffers( pState->pRing,
+                                        iov,
+                                        pState->nprofiles );
+            if ( rc == EOK )
+            {
+                for ( i = 0; i < pState->nprofiles; i++ )
+                {
+                    pState->profiles[i]->ringBuf = i + 1;
+                }
+            }
+            else
+            {
+                fprintf( stderr,
+                         "Cannot register io_uring buffers: %s\n",
+                         strerror( rc ) );
+            }
+
+            free( iov );
+        }
+        else
+        {
+            result = ENOMEM;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  InitProfiles                                                              */
+/*!
+    Initialize the save profiles
+
+    @param[in,out]
+        pState
+            pointer to the SaveSvc state
+
+    @retval EOK - success
+    @retval other error from the first profile which could not be
+            initialized
+
+==============================================================================*/
+static int InitProfiles( SaveSvcState *pState )
+{
+    int result = EOK;
+    size_t i;
+
+    for ( i = 0; ( i < pState->nprofiles ) && ( result == EOK ); i++ )
+    {
+        result = InitProfile( pState, i );
+
+        /* captures continue from the latest committed generation */
+        if ( pState->profiles[i]->generation > pState->generation )
+        {
+            pState->generation = pState->profiles[i]->generation;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  InitProfile                                                               */
+/*!
+    Initialize a save profile
+
+    The InitProfile function allocates the profile output buffer,
+    gets the hash of its committed configuration, initializes its journal
+    or output shards and its save history, and requests MODIFIED
+    notifications for its trigger variable.  A trigger variable shared
+    with an earlier profile is only registered once.
+
+    @param[in,out]
+        pState
+            pointer to the SaveSvc state
+
+    @param[in]
+        idx
+            index of the profile to initialize
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval ENOENT - the trigger variable was not found
+    @retval other error from the initialization
+
+==============================================================================*/
+static int InitProfile( SaveSvcState *pState, size_t idx )
+{
+    SaveSvcState *pProfile = pState->profiles[idx];
+    int result = EINVAL;
+    bool notified = false;
+    size_t i;
+
+    if ( pProfile->triggervar == NULL )
+    {
+        fprintf( stderr, "No trigger variable specified\n");
+    }
+    else
+    {
+        /* allocate the output buffer */
+        result = OUTBUF_Init( &pProfile->out, pProfile->bufsize );
+        if ( result == EOK )
+        {
+            /* get the hash of the committed configuration.  This is
+               also used to find a stale journal */
+            (void)HashConfig( pProfile );
+        }
+
+        if ( result != EOK )
+        {
+            fprintf( stderr, "Cannot allocate output buffer\n" );
+        }
+        else if ( pProfile->journal == true )
+        {
+            result = InitJournal( pProfile );
+            if ( result != EOK )
+            {
+                fprintf( stderr, "Cannot initialize journal\n" );
+            }
+        }
+        else if ( pProfile->shardDepth > 0 )
+        {
+            result = SHARD_Init( pProfile );
+            if ( result != EOK )
+            {
+                fprintf( stderr, "Cannot initialize output shards\n" );
+            }
+        }
+
+        if ( ( result == EOK ) &&
+             ( pProfile->clearDirty == true ) )
+        {
+            result = InitHistory( pProfile );
+            if ( result != EOK )
+            {
+                fprintf( stderr, "Cannot load the save history\n" );
+            }
+        }
+    }
+
+    if ( result == EOK )
+    {
+        /* get a handle to the trigger variable */
+        pProfile->hTriggerVar = VAR_FindByName( pProfile->hVarServer,
+                                                pProfile->triggervar );
+        if ( pProfile->hTriggerVar == VAR_INVALID )
+        {
+            result = ENOENT;
+            fprintf( stderr,
+                     "Cannot find trigger variable: %s\n",
+                     pProfile->triggervar );
+        }
+        else
+        {
+            /* check if an earlier profile has the same trigger */
+            for ( i = 0; ( i < idx ) && ( notified == false ); i++ )
+            {
+                notified = ( pState->profiles[i]->hTriggerVar ==
+                             pProfile->hTriggerVar );
+            }
+
+            if ( notified == false )
+            {
+                /* request MODIFIED notification from the varserver
+                   for the trigger variable */
+                result = VAR_Notify( pProfile->hVarServer,
+                                     pProfile->hTriggerVar,
+                                     NOTIFY_MODIFIED );
+            }
+
+            if ( result != EOK )
+            {
+                fprintf( stderr,
+                         "notification request failed for %s\n",
+                         pProfile->triggervar );
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  GetSaveDeadline                                                           */
+/*!
+    Get the time at which a pending save must be performed
+
+    The GetSaveDeadline function calculates the time at which a pending
+    save must be performed.  This is the end of the debounce window
+    following the most recent trigger, bounded by the maximum latency
+    following the first pending trigger.
+
+    @param[in]
+        pState
+            pointer to the SaveSvc state
+
+    @param[in]
+        first
+            time of the first pending trigger (in milliseconds)
+
+    @param[in]
+        last
+            time of the most recent trigger (in milliseconds)
+
+    @retval time of the save deadline (in milliseconds)
+
+==============================================================================*/
+static uint64_t GetSaveDeadline( SaveSvcState *pState,
+                                 uint64_t first,
+                                 uint64_t last )
+{
+    uint64_t deadline = last;
+
+    if ( pState != NULL )
+    {
+        deadline = last + pState->debounceMs;
+        if ( deadline > first + pState->maxLatencyMs )
+        {
+            deadline = first + pState->maxLatencyMs;
+        }
+    }
+
+    return deadline;
+}
+
+/*============================================================================*/
+/*  TimeNowMs                                                                 */
+/*!
+    Get the current monotonic time
+
+    @retval the current monotonic time in milliseconds
+
+==============================================================================*/
+static uint64_t TimeNowMs( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+
+    return ( (uint64_t)ts.tv_sec * 1000 ) + ( ts.tv_nsec / 1000000 );
+}
+
+/*============================================================================*/
+/*  InitPipeline                                                              */
+/*!
+    Initialize the save pipeline
+
+    The InitPipeline function allocates the snapshot buffers and,
+    if a dedicated writer thread was requested, starts the writer thread.
+
+    @param[in,out]
+        pState
+            pointer to the SaveSvc state
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval ENOMEM - memory allocation failed
+    @retval other error from pthread_create()
+
+==============================================================================*/
+static int InitPipeline( SaveSvcState *pState )
+{
+    int result = EINVAL;
+    pthread_condattr_t attr;
+    sigset_t mask;
+    sigset_t oldmask;
+    int i;
+
+    if ( pState != NULL )
+    {
+        result = EOK;
+
+        if ( pState->pipeline == true )
+        {
+            /* these are destroyed by StopPipeline.  The idle condition
+               is waited on with a monotonic deadline */
+            pthread_condattr_init( &attr );
+            pthread_condattr_setclock( &attr, CLOCK_MONOTONIC );
+            pthread_mutex_init( &pState->lock, NULL );
+            pthread_cond_init( &pState->ready, NULL );
+            pthread_cond_init( &pState->idle, &attr );
+            pthread_condattr_destroy( &attr );
+        }
+
+        for ( i = 0; ( i < SNAPSHOT_BUFFERS ) && ( result == EOK ); i++ )
+        {
+            result = SNAPSHOT_Init( &pState->snapshot[i],
+                                    SNAPSHOT_DEFAULT_SIZE );
+            pState->snapBufState[i] = SNAPBUF_FREE;
+        }
 
-        result = EOK;
+        if ( ( result == EOK ) &&
+             ( pState->pipeline == true ) )
+        {
+            pState->donefd = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+            result = ( pState->donefd != -1 ) ? EOK : errno;
+        }
+
+        if ( ( result == EOK ) &&
+             ( pState->pipeline == true ) )
+        {
+            PublishStats( pState );
+
+            /* the writer thread inherits a mask which blocks every
+               signal, so the varserver notification signals are never
+               delivered to it, even before it has started */
+            sigfillset( &mask );
+            pthread_sigmask( SIG_SETMASK, &mask, &oldmask );
+
+            result = pthread_create( &pState->writer,
+                                     NULL,
+                                     WriterThread,
+                                     pState );
+            pState->writerStarted = ( result == EOK );
+
+            pthread_sigmask( SIG_SETMASK, &oldmask, NULL );
+        }
     }
 
     return result;
 }
 
 /*============================================================================*/
-/*  WriteConfigVars                                                           */
+/*  RequestSave                                                               */
 /*!
-    Write dirty variables to the configuration file
+    Request a save of the dirty variables
+
+    The RequestSave function captures a snapshot of the dirty variables
+    from the variable server, and then writes the snapshot out.
 
-    The WriteConfigVars function iterates through all of the dirty configuration
-    variables and writes them to the configuration file as var=value pairs.
+    A single snapshot is shared by all of the profiles being saved.
+
+    When the dedicated writer thread is enabled, the snapshot is handed
+    to the writer thread instead.  Two snapshot buffers are used so a new
+    snapshot can be captured while the writer thread is still committing
+    the previous one.  A snapshot which is still waiting for the writer
+    thread is superseded by the new snapshot, and its save request is
+    completed along with the new one.  A snapshot which could not be
+    captured is still passed to the writer thread, which completes its
+    save request, and any request it superseded, with the error.
 
     @param[in,out]
         pState
-            pointer to the SaveSvc state which contains the config
-            file descriptor
+            pointer to the SaveSvc state
+
+    @param[in]
+        profiles
+            profiles to save (one bit per profile)
 
     @retval EOK - success
     @retval EINVAL - invalid arguments
+    @retval other error from the snapshot or the save
 
 ==============================================================================*/
-static int WriteConfigVars( SaveSvcState *pState )
+static int RequestSave( SaveSvcState *pState, uint64_t profiles )
 {
     int result = EINVAL;
-    char buf[BUFSIZ];
-    VarQuery query;
-    VarObject obj;
-    int rc;
+    uint64_t saved = 0;
+    bool full = false;
+    int idx = -1;
+    int i;
 
     if ( pState != NULL )
     {
-        memset( &query, 0, sizeof( VarQuery ) );
-
-        query.type = QUERY_FLAGS;
-        query.flags = VARFLAG_DIRTY;
-
-        obj.val.str = buf;
-        obj.len = sizeof buf;
-
-        result = VAR_GetFirst( pState->hVarServer, &query, &obj );
-        while ( result == EOK )
+        if ( pState->pipeline == false )
         {
-            if ( obj.type == VARTYPE_STR )
+            if ( ( pState->track == true ) &&
+                 ( IsFullSave( pState, profiles ) == true ) )
+            {
+                /* recover dropped modifications before a full save */
+                (void)ReconcileTracking( pState, NULL );
+            }
+
+            result = CaptureDirtyVars( pState, &pState->snapshot[0] );
+            if ( result == EOK )
             {
-                /* we already have a string object on the buffer */
-                rc = EOK;
+                result = SaveProfiles( pState,
+                                       &pState->snapshot[0],
+                                       profiles,
+                                       &saved );
+                if ( ( pState->clearDirty == true ) &&
+                     ( saved != 0 ) )
+                {
+                    (void)ClearDirty( pState, &pState->snapshot[0], saved );
+                }
             }
             else
             {
-                /* convert non-string object to string */
-                rc = VAROBJECT_ToString( &obj, buf, sizeof buf);
+                fprintf( stderr,
+                         "Cannot capture dirty variables: %s\n",
+                         strerror( result ) );
             }
 
-            if ( rc == EOK )
+            pState->completedSeq = ++pState->requestSeq;
+            pState->completedResult = result;
+        }
+        else
+        {
+            /* free a committed snapshot buffer */
+            ReleaseCommitted( pState );
+
+            /* select a snapshot buffer, preferring one which is waiting
+               for the writer thread, since it is superseded */
+            pthread_mutex_lock( &pState->lock );
+
+            for ( i = 0; i < SNAPSHOT_BUFFERS; i++ )
             {
-                if ( query.instanceID == 0 )
+                if ( pState->snapBufState[i] == SNAPBUF_READY )
                 {
-                    dprintf( pState->fd,
-                             "%s=%s\n",
-                             query.name,
-                             buf );
+                    idx = i;
+                    break;
                 }
-                else
+
+                if ( ( idx == -1 ) &&
+                     ( pState->snapBufState[i] == SNAPBUF_FREE ) )
                 {
-                    dprintf( pState->fd,
-                             "[%d]%s=%s\n",
-                             query.instanceID,
-                             query.name,
-                             buf );
+                    idx = i;
                 }
             }
-            else
+
+            if ( idx != -1 )
+            {
+                /* a superseded snapshot's profiles are saved with the
+                   new snapshot */
+                if ( pState->snapBufState[idx] == SNAPBUF_FREE )
+                {
+                    pState->snapProfiles[idx] = 0;
+                }
+
+                pState->snapBufState[idx] = SNAPBUF_FILLING;
+                pState->snapSeq[idx] = ++pState->requestSeq;
+                pState->snapProfiles[idx] |= profiles;
+                full = IsFullSave( pState, pState->snapProfiles[idx] );
+            }
+
+            pthread_mutex_unlock( &pState->lock );
+
+            if ( ( full == true ) &&
+                 ( pState->track == true ) )
             {
-                printf("cannot save %s: rc=%s\n", query.name, strerror(rc) );
+                /* recover dropped modifications before a full save */
+                (void)ReconcileTracking( pState, NULL );
             }
 
-            obj.val.str = buf;
-            obj.len = sizeof buf;
+            if ( idx != -1 )
+            {
+                result = CaptureDirtyVars( pState, &pState->snapshot[idx] );
+                if ( result != EOK )
+                {
+                    fprintf( stderr,
+                             "Cannot capture dirty variables: %s\n",
+                             strerror( result ) );
+                }
 
-            result = VAR_GetNext( pState->hVarServer, &query, &obj );
+                /* pass the snapshot to the writer thread, even if it
+                   failed, so the writer thread completes its save request
+                   in order with the others */
+                pthread_mutex_lock( &pState->lock );
+                pState->snapBufState[idx] = SNAPBUF_READY;
+                pState->snapResult[idx] = result;
+                pthread_cond_signal( &pState->ready );
+                pthread_mutex_unlock( &pState->lock );
+            }
+            else
+            {
+                result = EBUSY;
+            }
         }
     }
 
@@ -593,41 +2447,425 @@ static int WriteConfigVars( SaveSvcState *pState )
 }
 
 /*============================================================================*/
-/*  FinalizeConfig                                                            */
+/*  IsFullSave                                                                */
 /*!
-    Finalize the configuration file
+    Check whether a save re-writes a whole configuration file
 
-    The FinalizeConfig function moves the configuration data written
-    to the temporary file into the final configuration file via a
-    rename operation.  This ensures that there is never a time when
-    the configuration file does not exist (except for on first startup
-    when no configuration data has been saved)
+    The IsFullSave function checks whether the next save of any of the
+    specified profiles re-writes its whole configuration file.  With the
+    writer thread, which owns the profile state during a save, the
+    state published after its last save is used, and the pipeline lock
+    must be held.
+
+    @param[in]
+        pState
+            pointer to the SaveSvc state
 
     @param[in]
+        profiles
+            profiles (one bit per profile) to be saved
+
+    @retval true - a profile's whole configuration file is re-written
+    @retval false - every profile appends to its journal
+
+==============================================================================*/
+static bool IsFullSave( SaveSvcState *pState, uint64_t profiles )
+{
+    SaveSvcState *pProfile;
+    bool result = false;
+    size_t i;
+
+    for ( i = 0; ( i < pState->nprofiles ) && ( result == false ); i++ )
+    {
+        pProfile = pState->profiles[i];
+
+        if ( ( profiles & ( (uint64_t)1 << i ) ) != 0 )
+        {
+            result = ( pState->pipeline == true ) ? pProfile->fullSave
+                                                  : FullSaveDue( pProfile );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  SaveProfiles                                                              */
+/*!
+    Save profiles from a snapshot
+
+    @param[in,out]
         pState
-            pointer to the SaveSvc state which contains the name of the
-            configuration file.
+            pointer to the SaveSvc state
+
+    @param[in]
+        pSnapshot
+            pointer to the snapshot of the dirty variables
+
+    @param[in]
+        profiles
+            profiles to save (one bit per profile)
+
+    @param[out]
+        saved
+            profiles which were saved (one bit per profile)
 
     @retval EOK - success
-    @retval EINVAL - invalid arguments
-    @retval other error from rename()
+    @retval other error from the first profile which failed to save
 
 ==============================================================================*/
-static int FinalizeConfig( SaveSvcState *pState )
+static int SaveProfiles( SaveSvcState *pState,
+                         Snapshot *pSnapshot,
+                         uint64_t profiles,
+                         uint64_t *saved )
 {
-    int result = EINVAL;
+    int result = EOK;
+    SaveSvcState *pProfile;
+    size_t i;
     int rc;
 
+    *saved = 0;
+
+    for ( i = 0; i < pState->nprofiles; i++ )
+    {
+        if ( ( profiles & ( (uint64_t)1 << i ) ) != 0 )
+        {
+            pProfile = pState->profiles[i];
+
+            rc = SaveConfig( pProfile, pSnapshot );
+            if ( rc == EOK )
+            {
+                *saved |= ( (uint64_t)1 << i );
+            }
+            else
+            {
+                fprintf( stderr,
+                         "Failed to create configuration file: %s\n",
+                         pProfile->filename );
+
+                if ( result == EOK )
+                {
+                    result = rc;
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  WaitPipelineIdle                                                          */
+/*!
+    Wait for the writer thread to release all of the snapshot buffers
+
+    Committed snapshot buffers are released by clearing the dirty flags
+    of their variables.
+
+    @param[in]
+        pState
+            pointer to the SaveSvc state
+
+    @param[in]
+        timeoutMs
+            maximum time to wait (in milliseconds), or zero to wait
+            without a time limit
+
+    @retval EOK - the snapshot buffers are all free
+    @retval ETIMEDOUT - the writer thread is still busy
+
+==============================================================================*/
+static int WaitPipelineIdle( SaveSvcState *pState, unsigned int timeoutMs )
+{
+    int result = EOK;
+    struct timespec deadline;
+    bool busy = true;
+    bool committed;
+    int i;
+
     if ( ( pState != NULL ) &&
-         ( pState->filename != NULL ) )
+         ( pState->pipeline == true ) )
     {
-        rc = rename( pState->tmpfile, pState->filename );
-        result = ( rc == 0 ) ? EOK : errno;
+        clock_gettime( CLOCK_MONOTONIC, &deadline );
+        deadline.tv_sec += timeoutMs / 1000;
+        deadline.tv_nsec += ( timeoutMs % 1000 ) * 1000000L;
+        if ( deadline.tv_nsec >= 1000000000L )
+        {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+
+        pthread_mutex_lock( &pState->lock );
+
+        while ( ( busy == true ) &&
+                ( result == EOK ) )
+        {
+            busy = false;
+            committed = false;
+            for ( i = 0; i < SNAPSHOT_BUFFERS; i++ )
+            {
+                if ( pState->snapBufState[i] == SNAPBUF_COMMITTED )
+                {
+                    committed = true;
+                }
+                else if ( pState->snapBufState[i] != SNAPBUF_FREE )
+                {
+                    busy = true;
+                }
+            }
+
+            if ( committed == true )
+            {
+                pthread_mutex_unlock( &pState->lock );
+                ReleaseCommitted( pState );
+                pthread_mutex_lock( &pState->lock );
+                busy = true;
+            }
+            else if ( ( busy == true ) &&
+                      ( timeoutMs == 0 ) )
+            {
+                pthread_cond_wait( &pState->idle, &pState->lock );
+            }
+            else if ( busy == true )
+            {
+                result = pthread_cond_timedwait( &pState->idle,
+                                                 &pState->lock,
+                                                 &deadline );
+            }
+        }
+
+        pthread_mutex_unlock( &pState->lock );
     }
 
     return result;
 }
 
+/*============================================================================*/
+/*  StopPipeline                                                              */
+/*!
+    Stop the save pipeline
+
+    The StopPipeline function tells the writer thread to exit, waits
+    for it to finish any snapshot it is writing, and then destroys the
+    pipeline mutex and conditions.  Snapshots which are still waiting
+    for the writer thread are not written.
+
+    @param[in,out]
+        pState
+            pointer to the SaveSvc state
+
+==============================================================================*/
+static void StopPipeline( SaveSvcState *pState )
+{
+    if ( ( pState != NULL ) &&
+         ( pState->pipeline == true ) )
+    {
+        if ( pState->writerStarted == true )
+        {
+            pthread_mutex_lock( &pState->lock );
+            pState->stop = true;
+            pthread_cond_broadcast( &pState->ready );
+            pthread_mutex_unlock( &pState->lock );
+
+            pthread_join( pState->writer, NULL );
+            pState->writerStarted = false;
+        }
+
+        pthread_cond_destroy( &pState->idle );
+        pthread_cond_destroy( &pState->ready );
+        pthread_mutex_destroy( &pState->lock );
+    }
+}
+
+/*============================================================================*/
+/*  PublishStats                                                              */
+/*!
+    Publish the save statistics of each profile
+
+    The PublishStats function formats the save statistics of each
+    profile into its statistics text, for the main thread to reply to
+    the stats command, and records whether its next save re-writes its
+    whole configuration file.  It is called by the writer thread, which owns
+    the statistics, with the pipeline lock held, or before the writer
+    thread is started.
+
+    @param[in,out]
+        pState
+            pointer to the SaveSvc state
+
+==============================================================================*/
+static void PublishStats( SaveSvcState *pState )
+{
+    SaveSvcState *pProfile;
+    size_t i;
+
+    for ( i = 0; i < pState->nprofiles; i++ )
+    {
+        pProfile = pState->profiles[i];
+
+        if ( FormatStats( pProfile,
+                          pProfile->statsText,
+                          sizeof( pProfile->statsText ) ) != EOK )
+        {
+            pProfile->statsText[0] = '\0';
+        }
+
+        pProfile->fullSave = FullSaveDue( pProfile );
+    }
+}
+
+/*============================================================================*/
+/*  ReleaseCommitted                                                          */
+/*!
+    Release the committed snapshot buffers
+
+    The ReleaseCommitted function clears the dirty flags of the variables
+    in each snapshot buffer committed by the writer thread, and frees the
+    snapshot buffer.  The writer thread does not interact with the
+    variable server, so this is performed by the main thread.
+
+    @param[in]
+        pState
+            pointer to the SaveSvc state
+
+==============================================================================*/
+static void ReleaseCommitted( SaveSvcState *pState )
+{
+    uint64_t saved = 0;
+    int idx;
+    int i;
+
+    do
+    {
+        idx = -1;
+
+        pthread_mutex_lock( &pState->lock );
+        for ( i = 0; i < SNAPSHOT_BUFFERS; i++ )
+        {
+            if ( pState->snapBufState[i] == SNAPBUF_COMMITTED )
+            {
+                idx = i;
+                saved = pState->snapSaved[i];
+                break;
+            }
+        }
+        pthread_mutex_unlock( &pState->lock );
+
+        if ( idx != -1 )
+        {
+            (void)ClearDirty( pState, &pState->snapshot[idx], saved );
+
+            pthread_mutex_lock( &pState->lock );
+            pState->snapBufState[idx] = SNAPBUF_FREE;
+            pthread_cond_broadcast( &pState->idle );
+            pthread_mutex_unlock( &pState->lock );
+        }
+    } while ( idx != -1 );
+}
+
+/*============================================================================*/
+/*  WriterThread                                                              */
+/*!
+    Writer thread
+
+    The WriterThread function waits for snapshots to become ready and
+    writes them out, until it is stopped by StopPipeline.  It does not
+    interact with the variable server.  All signals are blocked so they
+    are always received by the main thread.
+
+    @param[in]
+        arg
+            pointer to the SaveSvc state
+
+    @retval NULL
+
+==============================================================================*/
+static void *WriterThread( void *arg )
+{
+    SaveSvcState *pState = (SaveSvcState *)arg;
+    sigset_t mask;
+    uint64_t profiles = 0;
+    uint64_t saved;
+    int idx;
+    int i;
+    int rc;
+
+    sigfillset( &mask );
+    pthread_sigmask( SIG_BLOCK, &mask, NULL );
+
+    pthread_mutex_lock( &pState->lock );
+
+    while ( pState->stop == false )
+    {
+        /* wait for a snapshot to be ready */
+        idx = -1;
+        while ( ( idx == -1 ) &&
+                ( pState->stop == false ) )
+        {
+            for ( i = 0; i < SNAPSHOT_BUFFERS; i++ )
+            {
+                if ( pState->snapBufState[i] == SNAPBUF_READY )
+                {
+                    idx = i;
+                    profiles = pState->snapProfiles[i];
+                    pState->snapBufState[i] = SNAPBUF_WRITING;
+                    break;
+                }
+            }
+
+            if ( idx == -1 )
+            {
+                pthread_cond_wait( &pState->ready, &pState->lock );
+            }
+        }
+
+        if ( idx == -1 )
+        {
+            /* stopped */
+            break;
+        }
+
+        pthread_mutex_unlock( &pState->lock );
+
+        /* write out the snapshot, unless it could not be captured */
+        rc = pState->snapResult[idx];
+        saved = 0;
+        if ( rc == EOK )
+        {
+            rc = SaveProfiles( pState,
+                               &pState->snapshot[idx],
+                               profiles,
+                               &saved );
+        }
+
+        /* release the snapshot buffer and complete its save request.
+           The dirty flags of a committed snapshot are cleared by the
+           main thread before the snapshot buffer is freed */
+        pthread_mutex_lock( &pState->lock );
+        if ( ( pState->clearDirty == true ) &&
+             ( saved != 0 ) )
+        {
+            pState->snapBufState[idx] = SNAPBUF_COMMITTED;
+            pState->snapSaved[idx] = saved;
+        }
+        else
+        {
+            pState->snapBufState[idx] = SNAPBUF_FREE;
+        }
+        pState->completedSeq = pState->snapSeq[idx];
+        pState->completedResult = rc;
+        PublishStats( pState );
+        pthread_cond_broadcast( &pState->idle );
+
+        /* wake up the main thread */
+        (void)eventfd_write( pState->donefd, 1 );
+    }
+
+    pthread_mutex_unlock( &pState->lock );
+
+    return NULL;
+}
+
 /*============================================================================*/
 /*  SetupTerminationHandler                                                   */
 /*!
@@ -635,12 +2873,13 @@ static int FinalizeConfig( SaveSvcState *pState )
 
     The SetupTerminationHandler function registers a termination handler
     function with the kernel in case of an abnormal termination of this
-    process.
+    process, and a handler for the shutdown save time limit.
 
 ==============================================================================*/
 static void SetupTerminationHandler( void )
 {
     static struct sigaction sigact;
+    static struct sigaction alarmact;
 
     memset( &sigact, 0, sizeof(sigact) );
 
@@ -650,6 +2889,12 @@ static void SetupTerminationHandler( void )
     sigaction( SIGTERM, &sigact, NULL );
     sigaction( SIGINT, &sigact, NULL );
 
+    memset( &alarmact, 0, sizeof(alarmact) );
+
+    alarmact.sa_handler = ShutdownTimeoutHandler;
+
+    sigaction( SIGALRM, &alarmact, NULL );
+
 }
 
 /*============================================================================*/
@@ -701,4 +2946,26 @@ static void TerminationHandler( int signum, siginfo_t *info, void *ptr )
     exit( 1 );
 }
 
+/*============================================================================*/
+/*  ShutdownTimeoutHandler                                                    */
+/*!
+    Shutdown time limit handler
+
+    The ShutdownTimeoutHandler function is invoked by SIGALRM when the
+    final save on shutdown exceeds its time limit.  The state may still
+    be in use by the interrupted save, so the process exits immediately
+    without releasing it.
+
+@param[in]
+    signum
+        The signal which caused the timeout (unused)
+
+==============================================================================*/
+static void ShutdownTimeoutHandler( int signum )
+{
+    (void)signum;
+
+    _exit( SHUTDOWN_TIMEOUT_STATUS );
+}
+
 
@@ -0,0 +1,1078 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup shard Output Shards
+ * @brief Namespace sharded output files for the Save Service
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file shard.c
+
+    Output Shards
+
+    The Output Shards split a profile's output into one file per
+    variable name prefix, so a change to one part of the namespace
+    only rewrites the file holding that part.  The shard of a variable
+    is selected by the first few components of its name, for example
+    /sys/net/eth0/mtu is in the /sys/net shard when sharding by two
+    name components.
+
+    On each save the snapshot is partitioned into per-shard snapshots
+    and the shards are serialized in parallel on a small worker pool.
+    Each shard is saved as a complete configuration file, so it is
+    committed atomically.  A shard whose variables are the same as in
+    its last committed save is not serialized at all, and a shard
+    whose serialized content is unchanged is not committed.
+
+    The profile output file becomes a manifest which lists the shard
+    files (relative to the manifest directory), so a restore can load
+    every shard.  Shard files which are no longer listed are removed
+    once the new manifest has been committed.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <unistd.h>
+#include <varserver/varserver.h>
+#include "savesvc.h"
+#include "hash.h"
+#include "snapshot.h"
+#include "workpool.h"
+#include "shard.h"
+
+/*==============================================================================
+       Function declarations
+==============================================================================*/
+static size_t KeyLength( const char *name, unsigned int depth );
+static Shard *FindShard( SaveSvcState *pState,
+                         const char *name,
+                         size_t keylen );
+static int CompareKey( Shard *pShard, const char *key, size_t keylen );
+static Shard *NewShard( SaveSvcState *pState, const char *key, size_t keylen );
+static char *ShardFileName( SaveSvcState *pState,
+                            const char *key,
+                            size_t keylen );
+static void FreeShard( Shard *pShard );
+static void SaveShard( void *arg, size_t idx );
+static uint64_t HashSnapshot( Snapshot *pSnapshot );
+static void AddShardStats( SaveSvcState *pState, Shard *pShard );
+static int BuildManifest( SaveSvcState *pState );
+static int CommitManifest( SaveSvcState *pState );
+static void RemoveUnlisted( SaveSvcState *pState, char *listed );
+static const char *BaseName( const char *filename );
+static char *ReadManifest( const char *filename );
+
+/*==============================================================================
+       Function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  SHARD_Init                                                                */
+/*!
+    Initialize the output shards of a save profile
+
+    The SHARD_Init function starts the shard worker pool and reads the
+    committed manifest, so shard files which are no longer needed can
+    be removed by the next save.  The shards themselves are created as
+    variables are saved into them.
+
+    @param[in,out]
+        pState
+            pointer to the save profile state
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval ENOMEM - memory allocation failed
+    @retval other error from WORKPOOL_Init()
+
+==============================================================================*/
+int SHARD_Init( SaveSvcState *pState )
+{
+    int result = EINVAL;
+    ShardSet *pSet;
+
+    if ( ( pState != NULL ) &&
+         ( pState->filename != NULL ) &&
+         ( pState->shards == NULL ) )
+    {
+        pSet = calloc( 1, sizeof( ShardSet ) );
+        if ( pSet != NULL )
+        {
+            result = WORKPOOL_Init( &pSet->pool, pState->shardWorkers );
+            if ( result == EOK )
+            {
+                pSet->listed = ReadManifest( pState->filename );
+                pState->shards = pSet;
+            }
+            else
+            {
+                free( pSet );
+            }
+        }
+        else
+        {
+            result = ENOMEM;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  SHARD_Save                                                                */
+/*!
+    Save a snapshot to the output shards
+
+    The SHARD_Save function partitions the snapshot into the output
+    shards, serializes the shards on the worker pool, and commits the
+    manifest if the set of shard files has changed.
+
+    A shard with no variables in the snapshot is dropped from the
+    manifest and its file is removed.
+
+    @param[in,out]
+        pState
+            pointer to the save profile state
+
+    @param[in]
+        pSnapshot
+            pointer to the snapshot of the dirty variables
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval ENOMEM - memory allocation failed
+    @retval other error from the first shard which could not be saved,
+            or from the manifest commit
+
+==============================================================================*/
+int SHARD_Save( SaveSvcState *pState, Snapshot *pSnapshot )
+{
+    int result = EINVAL;
+    ShardSet *pSet;
+    SnapshotRecord *pRecord;
+    Shard *pShard;
+    char *name;
+    size_t written = 0;
+    bool changed;
+    size_t i;
+
+    if ( ( pState != NULL ) &&
+         ( pState->shards != NULL ) &&
+         ( pSnapshot != NULL ) )
+    {
+        pSet = pState->shards;
+        result = EOK;
+
+        for ( i = 0; i < pSet->count; i++ )
+        {
+            SNAPSHOT_Reset( &pSet->shards[i]->snapshot );
+        }
+
+        /* partition the snapshot by variable name prefix */
+        pRecord = SNAPSHOT_First( pSnapshot );
+        while ( ( pRecord != NULL ) &&
+                ( result == EOK ) )
+        {
+            name = SNAPSHOT_Name( pRecord );
+
+            if ( FILTER_Match( &pState->filter, name ) == true )
+            {
+                pShard = FindShard( pState,
+                                    name,
+                                    KeyLength( name, pState->shardDepth ) );
+                result = ( pShard != NULL )
+                            ? SNAPSHOT_Copy( &pShard->snapshot, pRecord )
+                            : ENOMEM;
+            }
+
+            pRecord = SNAPSHOT_Next( pSnapshot, pRecord );
+        }
+
+        for ( i = 0; i < pSet->count; i++ )
+        {
+            pSet->shards[i]->snapshot.generation = pSnapshot->generation;
+        }
+
+        if ( result == EOK )
+        {
+            /* serialize the shards in parallel */
+            result = WORKPOOL_Run( &pSet->pool, SaveShard, pSet, pSet->count );
+        }
+
+        for ( i = 0; i < pSet->count; i++ )
+        {
+            pShard = pSet->shards[i];
+            if ( pShard->result != EOK )
+            {
+                fprintf( stderr,
+                         "Cannot save %s: %s\n",
+                         pShard->state.filename,
+                         strerror( pShard->result ) );
+                if ( result == EOK )
+                {
+                    result = pShard->result;
+                }
+            }
+            else if ( ( pShard->snapshot.count > 0 ) &&
+                      ( pShard->state.unchanged == false ) )
+            {
+                written++;
+            }
+
+            AddShardStats( pState, pShard );
+        }
+
+        changed = ( written > 0 );
+
+        if ( result == EOK )
+        {
+            /* list the shard files in the manifest */
+            result = BuildManifest( pState );
+        }
+
+        if ( result == EOK )
+        {
+            result = CommitManifest( pState );
+            if ( result != EOK )
+            {
+                fprintf( stderr,
+                         "Cannot save manifest %s: %s\n",
+                         pState->filename,
+                         strerror( result ) );
+            }
+            else if ( pState->unchanged == false )
+            {
+                changed = true;
+            }
+        }
+
+        pState->stats.saves++;
+        if ( result != EOK )
+        {
+            pState->stats.failures++;
+        }
+        else if ( changed == false )
+        {
+            pState->stats.skipped++;
+        }
+
+        if ( pState->verbose == true )
+        {
+            printf( "Saved %zu of %zu shards\n", written, pSet->count );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  SHARD_Free                                                                */
+/*!
+    Release the output shards of a save profile
+
+    @param[in,out]
+        pState
+            pointer to the save profile state
+
+    @return none
+
+==============================================================================*/
+void SHARD_Free( SaveSvcState *pState )
+{
+    ShardSet *pSet;
+    size_t i;
+
+    if ( ( pState != NULL ) &&
+         ( pState->shards != NULL ) )
+    {
+        pSet = pState->shards;
+
+        WORKPOOL_Free( &pSet->pool );
+
+        for ( i = 0; i < pSet->count; i++ )
+        {
+            FreeShard( pSet->shards[i] );
+        }
+
+        free( pSet->shards );
+        free( pSet->text );
+        free( pSet->listed );
+        free( pSet );
+
+        pState->shards = NULL;
+    }
+}
+
+/*============================================================================*/
+/*  KeyLength                                                                 */
+/*!
+    Get the length of the shard key of a variable name
+
+    The KeyLength function gets the length of the leading name
+    components which select the shard of a variable.  The last name
+    component is never part of the key, so /sys/name is in the /sys
+    shard even when sharding by two name components.
+
+    @param[in]
+        name
+            variable name
+
+    @param[in]
+        depth
+            number of leading name components in the shard key
+
+    @retval length of the shard key
+
+==============================================================================*/
+static size_t KeyLength( const char *name, unsigned int depth )
+{
+    size_t len = 0;
+    unsigned int n = 0;
+    size_t i;
+
+    for ( i = 1; ( name[0] != '\0' ) && ( name[i] != '\0' ) && ( n < depth );
+          i++ )
+    {
+        if ( name[i] == '/' )
+        {
+            len = i;
+            n++;
+        }
+    }
+
+    return len;
+}
+
+/*============================================================================*/
+/*  FindShard                                                                 */
+/*!
+    Find the shard for a shard key
+
+    The FindShard function finds the shard with the specified key,
+    creating it if it does not yet exist.  Snapshots are usually in
+    name order, so the most recently selected shard is checked first.
+
+    @param[in,out]
+        pState
+            pointer to the save profile state
+
+    @param[in]
+        name
+            variable name starting with the shard key
+
+    @param[in]
+        keylen
+            length of the shard key
+
+    @retval pointer to the shard
+    @retval NULL if memory allocation failed
+
+==============================================================================*/
+static Shard *FindShard( SaveSvcState *pState,
+                         const char *name,
+                         size_t keylen )
+{
+    ShardSet *pSet = pState->shards;
+    Shard *pShard = pSet->last;
+    Shard **shards;
+    size_t lo = 0;
+    size_t hi = pSet->count;
+    size_t mid;
+    int rc;
+
+    if ( ( pShard == NULL ) ||
+         ( CompareKey( pShard, name, keylen ) != 0 ) )
+    {
+        pShard = NULL;
+
+        /* binary search the sorted shards */
+        while ( ( lo < hi ) && ( pShard == NULL ) )
+        {
+            mid = lo + ( hi - lo ) / 2;
+            rc = CompareKey( pSet->shards[mid], name, keylen );
+            if ( rc < 0 )
+            {
+                lo = mid + 1;
+            }
+            else if ( rc > 0 )
+            {
+                hi = mid;
+            }
+            else
+            {
+                pShard = pSet->shards[mid];
+            }
+        }
+
+        if ( pShard == NULL )
+        {
+            shards = realloc( pSet->shards,
+                              ( pSet->count + 1 ) * sizeof( Shard * ) );
+            if ( shards != NULL )
+            {
+                pSet->shards = shards;
+
+                pShard = NewShard( pState, name, keylen );
+                if ( pShard != NULL )
+                {
+                    /* insert the new shard in key order */
+                    memmove( &shards[lo + 1],
+                             &shards[lo],
+                             ( pSet->count - lo ) * sizeof( Shard * ) );
+                    shards[lo] = pShard;
+                    pSet->count++;
+                }
+            }
+        }
+
+        pSet->last = pShard;
+    }
+
+    return pShard;
+}
+
+/*============================================================================*/
+/*  CompareKey                                                                */
+/*!
+    Compare a shard key with the key of a shard
+
+    @param[in]
+        pShard
+            pointer to the shard
+
+    @param[in]
+        key
+            shard key (not NUL terminated)
+
+    @param[in]
+        keylen
+            length of the shard key
+
+    @retval <0 - the shard key orders before the key
+    @retval 0 - the shard key matches the key
+    @retval >0 - the shard key orders after the key
+
+==============================================================================*/
+static int CompareKey( Shard *pShard, const char *key, size_t keylen )
+{
+    size_t len;
+    int rc;
+
+    len = ( pShard->keylen < keylen ) ? pShard->keylen : keylen;
+
+    rc = memcmp( pShard->key, key, len );
+    if ( rc == 0 )
+    {
+        rc = ( pShard->keylen < keylen ) ? -1
+           : ( pShard->keylen > keylen ) ? 1
+           : 0;
+    }
+
+    return rc;
+}
+
+/*============================================================================*/
+/*  NewShard                                                                  */
+/*!
+    Create an output shard
+
+    The NewShard function creates a shard with the output settings of
+    the save profile, and gets the hash of its committed shard file.
+    Shards are always saved as complete files, so the journal is not
+    used.
+
+    @param[in]
+        pState
+            pointer to the save profile state
+
+    @param[in]
+        key
+            shard key (not NUL terminated)
+
+    @param[in]
+        keylen
+            length of the shard key
+
+    @retval pointer to the new shard
+    @retval NULL if memory allocation failed
+
+==============================================================================*/
+static Shard *NewShard( SaveSvcState *pState, const char *key, size_t keylen )
+{
+    Shard *pShard;
+    SaveSvcState *pShardState;
+
+    pShard = calloc( 1, sizeof( Shard ) );
+    if ( pShard != NULL )
+    {
+        pShard->keylen = keylen;
+        pShard->key = strndup( key, keylen );
+
+        /* inherit the profile output settings */
+        pShardState = &pShard->state;
+        pShardState->hVarServer = pState->hVarServer;
+        pShardState->fd = -1;
+        pShardState->donefd = -1;
+        pShardState->bufsize = pState->bufsize;
+        pShardState->durability = pState->durability;
+        pShardState->format = pState->format;
+        pShardState->consistent = pState->consistent;
+        pShardState->filename = ShardFileName( pState, key, keylen );
+
+        if ( ( pShard->key == NULL ) ||
+             ( pShardState->filename == NULL ) ||
+             ( OUTBUF_Init( &pShardState->out,
+                            pShardState->bufsize ) != EOK ) ||
+             ( SNAPSHOT_Init( &pShard->snapshot,
+                              SHARD_SNAPSHOT_SIZE ) != EOK ) )
+        {
+            FreeShard( pShard );
+            pShard = NULL;
+        }
+        else
+        {
+            /* get the hash of the committed shard file */
+            (void)HashConfig( pShardState );
+        }
+    }
+
+    return pShard;
+}
+
+/*============================================================================*/
+/*  ShardFileName                                                             */
+/*!
+    Create the file name of a shard
+
+    The ShardFileName function creates the shard file name from the
+    profile output file name and the shard key, with each character
+    of the key which is not a letter or digit replaced by an
+    underscore, for example usersettings.cfg-sys_net for the /sys/net
+    shard.  A numeric suffix is added if another shard already has
+    the same file name.
+
+    @param[in]
+        pState
+            pointer to the save profile state
+
+    @param[in]
+        key
+            shard key (not NUL terminated)
+
+    @param[in]
+        keylen
+            length of the shard key
+
+    @retval pointer to the allocated shard file name
+    @retval NULL if memory allocation failed
+
+==============================================================================*/
+static char *ShardFileName( SaveSvcState *pState,
+                            const char *key,
+                            size_t keylen )
+{
+    ShardSet *pSet = pState->shards;
+    char *filename;
+    size_t size;
+    size_t len;
+    size_t base;
+    size_t i;
+    size_t j;
+    unsigned int suffix = 0;
+
+    /* skip the leading separator */
+    if ( ( keylen > 0 ) && ( key[0] == '/' ) )
+    {
+        key++;
+        keylen--;
+    }
+
+    size = strlen( pState->filename ) + keylen + 32;
+    filename = malloc( size );
+    if ( filename != NULL )
+    {
+        len = (size_t)snprintf( filename, size, "%s-", pState->filename );
+
+        if ( keylen == 0 )
+        {
+            len += (size_t)snprintf( &filename[len], size - len, "root" );
+        }
+
+        for ( i = 0; i < keylen; i++ )
+        {
+            filename[len++] = isalnum( (unsigned char)key[i] ) ? key[i] : '_';
+        }
+
+        filename[len] = '\0';
+        base = len;
+
+        /* make the shard file name unique */
+        j = 0;
+        while ( j < pSet->count )
+        {
+            if ( strcmp( pSet->shards[j]->state.filename, filename ) == 0 )
+            {
+                snprintf( &filename[base], size - base, "-%u", ++suffix );
+                j = 0;
+            }
+            else
+            {
+                j++;
+            }
+        }
+    }
+
+    return filename;
+}
+
+/*============================================================================*/
+/*  FreeShard                                                                 */
+/*!
+    Release an output shard
+
+    @param[in]
+        pShard
+            pointer to the shard
+
+    @return none
+
+==============================================================================*/
+static void FreeShard( Shard *pShard )
+{
+    if ( pShard != NULL )
+    {
+        OUTBUF_Free( &pShard->state.out );
+        ARENA_Free( &pShard->state.arena );
+        VARTAB_Free( &pShard->state.saved );
+        SNAPSHOT_Free( &pShard->snapshot );
+        free( pShard->state.filename );
+        free( pShard->key );
+        free( pShard );
+    }
+}
+
+/*============================================================================*/
+/*  SaveShard                                                                 */
+/*!
+    Save an output shard
+
+    The SaveShard function is the work pool work item which saves a
+    single shard.  A shard is not saved if its variables are the same
+    as in its last committed save.  A shard without any variables is
+    not saved either, and is marked as uncommitted since its file will
+    be removed.
+
+    @param[in]
+        arg
+            pointer to the shard set
+
+    @param[in]
+        idx
+            index of the shard to save
+
+    @return none
+
+==============================================================================*/
+static void SaveShard( void *arg, size_t idx )
+{
+    ShardSet *pSet = (ShardSet *)arg;
+    Shard *pShard = pSet->shards[idx];
+    uint64_t hash;
+
+    pShard->result = EOK;
+
+    if ( pShard->snapshot.count > 0 )
+    {
+        hash = HashSnapshot( &pShard->snapshot );
+        if ( ( pShard->hashed == true ) &&
+             ( pShard->hash == hash ) &&
+             ( pShard->state.committed == true ) )
+        {
+            /* the committed shard file is up to date */
+            pShard->state.unchanged = true;
+        }
+        else
+        {
+            pShard->result = SaveConfig( &pShard->state, &pShard->snapshot );
+            pShard->hash = hash;
+            pShard->hashed = ( pShard->result == EOK );
+        }
+    }
+    else
+    {
+        pShard->state.committed = false;
+        pShard->hashed = false;
+    }
+}
+
+/*============================================================================*/
+/*  HashSnapshot                                                              */
+/*!
+    Hash the variables of a snapshot
+
+    The HashSnapshot function hashes the instance identifier, type,
+    name, and value of each variable in a snapshot.
+
+    @param[in]
+        pSnapshot
+            pointer to the snapshot
+
+    @retval hash of the snapshot variables
+
+==============================================================================*/
+static uint64_t HashSnapshot( Snapshot *pSnapshot )
+{
+    uint64_t hash = HASH_INIT;
+    SnapshotRecord *pRecord;
+
+    pRecord = SNAPSHOT_First( pSnapshot );
+    while ( pRecord != NULL )
+    {
+        hash = HASH_Update( hash,
+                            &pRecord->instanceID,
+                            sizeof( pRecord->instanceID ) );
+        hash = HASH_Update( hash, &pRecord->type, sizeof( pRecord->type ) );
+        hash = HASH_Update( hash,
+                            SNAPSHOT_Name( pRecord ),
+                            pRecord->namelen + 1 );
+
+        if ( ( pRecord->type == VARTYPE_STR ) ||
+             ( pRecord->type == VARTYPE_BLOB ) )
+        {
+            hash = HASH_Update( hash,
+                                SNAPSHOT_Data( pRecord ),
+                                pRecord->len );
+        }
+        else
+        {
+            hash = HASH_Update( hash, &pRecord->val, sizeof( VarData ) );
+        }
+
+        pRecord = SNAPSHOT_Next( pSnapshot, pRecord );
+    }
+
+    return hash;
+}
+
+/*============================================================================*/
+/*  AddShardStats                                                             */
+/*!
+    Add the sync statistics of a shard to the save profile
+
+    The AddShardStats function moves the sync statistics, the output
+    totals and the save sample of a shard save into the save profile.
+    The save counts are kept by the profile itself, since one profile
+    save saves many shards.
+
+    @param[in,out]
+        pState
+            pointer to the save profile state
+
+    @param[in,out]
+        pShard
+            pointer to the shard
+
+    @return none
+
+==============================================================================*/
+static void AddShardStats( SaveSvcState *pState, Shard *pShard )
+{
+    SaveSvcStats *pStats = &pShard->state.stats;
+    MetricSample *pSample = &pShard->state.sample;
+    size_t i;
+
+    pState->stats.syncs += pStats->syncs;
+    pState->stats.syncTimeUs += pStats->syncTimeUs;
+    pState->stats.dirSyncs += pStats->dirSyncs;
+    pState->stats.dirSyncTimeUs += pStats->dirSyncTimeUs;
+    if ( pStats->syncMaxUs > pState->stats.syncMaxUs )
+    {
+        pState->stats.syncMaxUs = pStats->syncMaxUs;
+    }
+
+    memset( pStats, 0, sizeof( SaveSvcStats ) );
+
+    /* the bytes and write system calls of the shard output */
+    pState->out.bytes += pShard->state.out.bytes;
+    pState->out.syscalls += pShard->state.out.syscalls;
+    pShard->state.out.bytes = 0;
+    pShard->state.out.syscalls = 0;
+
+    /* the time spent in each phase is the total across the shards */
+    for ( i = 0; i < METRIC_PHASES; i++ )
+    {
+        if ( ( pSample->phases & ( 1U << i ) ) != 0 )
+        {
+            METRICS_Add( &pState->sample, (MetricPhase)i, pSample->us[i] );
+        }
+    }
+
+    pState->sample.vars += pSample->vars;
+    pState->sample.bytes += pSample->bytes;
+
+    memset( pSample, 0, sizeof( MetricSample ) );
+}
+
+/*============================================================================*/
+/*  BuildManifest                                                             */
+/*!
+    Build the manifest text
+
+    The BuildManifest function lists the file of each shard with
+    variables in the current save, relative to the manifest directory.
+
+    @param[in,out]
+        pState
+            pointer to the save profile state
+
+    @retval EOK - success
+    @retval ENOMEM - memory allocation failed
+
+==============================================================================*/
+static int BuildManifest( SaveSvcState *pState )
+{
+    int result = EOK;
+    ShardSet *pSet = pState->shards;
+    const char *filename;
+    size_t size = sizeof( SHARD_MANIFEST_HEADER "\n" );
+    size_t len;
+    size_t i;
+    char *text;
+
+    for ( i = 0; i < pSet->count; i++ )
+    {
+        size += strlen( BaseName( pSet->shards[i]->state.filename ) ) + 1;
+    }
+
+    if ( size > pSet->textSize )
+    {
+        text = realloc( pSet->text, size );
+        if ( text != NULL )
+        {
+            pSet->text = text;
+            pSet->textSize = size;
+        }
+        else
+        {
+            result = ENOMEM;
+        }
+    }
+
+    if ( result == EOK )
+    {
+        len = (size_t)sprintf( pSet->text, "%s\n", SHARD_MANIFEST_HEADER );
+
+        for ( i = 0; i < pSet->count; i++ )
+        {
+            if ( pSet->shards[i]->snapshot.count > 0 )
+            {
+                filename = BaseName( pSet->shards[i]->state.filename );
+                len += (size_t)sprintf( &pSet->text[len], "%s\n", filename );
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  CommitManifest                                                            */
+/*!
+    Commit the manifest
+
+    The CommitManifest function saves the manifest to the profile
+    output file, unless it is unchanged.  Once a changed manifest is
+    committed, the shard files which are no longer listed are removed.
+
+    @param[in,out]
+        pState
+            pointer to the save profile state
+
+    @retval EOK - success
+    @retval ENOMEM - memory allocation failed
+    @retval other error from SaveText()
+
+==============================================================================*/
+static int CommitManifest( SaveSvcState *pState )
+{
+    int result;
+    ShardSet *pSet = pState->shards;
+    char *listed;
+
+    result = SaveText( pState, pSet->text );
+    if ( ( result == EOK ) &&
+         ( pState->unchanged == false ) )
+    {
+        listed = pSet->listed;
+
+        pSet->listed = strdup( pSet->text );
+        if ( pSet->listed == NULL )
+        {
+            result = ENOMEM;
+        }
+
+        if ( listed != NULL )
+        {
+            RemoveUnlisted( pState, listed );
+            free( listed );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  RemoveUnlisted                                                            */
+/*!
+    Remove shard files which are no longer listed in the manifest
+
+    The RemoveUnlisted function removes each file of the previously
+    committed manifest which is not in the current manifest.
+
+    @param[in]
+        pState
+            pointer to the save profile state
+
+    @param[in,out]
+        listed
+            previously committed manifest text.  This is modified by
+            strtok_r
+
+    @return none
+
+==============================================================================*/
+static void RemoveUnlisted( SaveSvcState *pState, char *listed )
+{
+    ShardSet *pSet = pState->shards;
+    const char *base = BaseName( pState->filename );
+    size_t dirlen = (size_t)( base - pState->filename );
+    char path[BUFSIZ];
+    char *filename;
+    char *save;
+    char *p;
+    size_t len;
+    bool found;
+
+    filename = strtok_r( listed, "\n", &save );
+    while ( filename != NULL )
+    {
+        /* look for the file in the current manifest */
+        len = strlen( filename );
+        found = ( filename[0] == '@' );
+        p = strstr( pSet->text, filename );
+        while ( ( found == false ) && ( p != NULL ) )
+        {
+            found = ( p[-1] == '\n' ) && ( p[len] == '\n' );
+            p = strstr( &p[len], filename );
+        }
+
+        if ( ( found == false ) &&
+             ( strchr( filename, '/' ) == NULL ) &&
+             ( (size_t)snprintf( path,
+                                 sizeof path,
+                                 "%.*s%s",
+                                 (int)dirlen,
+                                 pState->filename,
+                                 filename ) < sizeof path ) )
+        {
+            (void)unlink( path );
+        }
+
+        filename = strtok_r( NULL, "\n", &save );
+    }
+}
+
+/*============================================================================*/
+/*  BaseName                                                                  */
+/*!
+    Get the file name without its directory
+
+    @param[in]
+        filename
+            file name
+
+    @retval pointer to the last component of the file name
+
+==============================================================================*/
+static const char *BaseName( const char *filename )
+{
+    const char *base = strrchr( filename, '/' );
+
+    return ( base != NULL ) ? base + 1 : filename;
+}
+
+/*============================================================================*/
+/*  ReadManifest                                                              */
+/*!
+    Read a committed manifest
+
+    @param[in]
+        filename
+            manifest file name
+
+    @retval pointer to the allocated manifest text
+    @retval NULL if there is no manifest, or it could not be read
+
+==============================================================================*/
+static char *ReadManifest( const char *filename )
+{
+    FILE *fp;
+    char *text = NULL;
+    size_t size = 0;
+    ssize_t n;
+
+    fp = fopen( filename, "r" );
+    if ( fp != NULL )
+    {
+        n = getdelim( &text, &size, '\0', fp );
+        if ( ( n <= 0 ) ||
+             ( strncmp( text,
+                        SHARD_MANIFEST_HEADER "\n",
+                        sizeof( SHARD_MANIFEST_HEADER ) ) != 0 ) )
+        {
+            free( text );
+            text = NULL;
+        }
+
+        fclose( fp );
+    }
+
+    return text;
+}
+
+/*! @}
+ * end of shard group */
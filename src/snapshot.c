@@ -0,0 +1,983 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup snapshot Variable Snapshot
+ * @brief Snapshot of dirty variables for the Save Service
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file snapshot.c
+
+    Variable Snapshot
+
+    A Variable Snapshot captures the name, instance identifier, type
+    and value of a set of variables into a single contiguous buffer
+    of variable length records.
+
+    Capturing a snapshot is the only part of a save which requires
+    interaction with the variable server.  Formatting and writing the
+    snapshot can then proceed independently of the variable server.
+
+    The snapshot buffer grows as required and is retained for re-use
+    by subsequent snapshots.
+
+    If the service is built with SAVESVC_VAR_GETBATCH, for a variable
+    server client library which provides the batched retrieval call
+    VAR_GetBatch, many variables are retrieved per call directly into
+    the snapshot buffer.  Otherwise the snapshot is captured one
+    variable per call using VAR_GetFirst and VAR_GetNext.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdalign.h>
+#include <string.h>
+#include <errno.h>
+#include <varserver/varserver.h>
+#include <varserver/varquery.h>
+#include "snapshot.h"
+
+/*==============================================================================
+       Definitions
+==============================================================================*/
+
+/*! initial size of the value buffer for iterated retrieval */
+#define SNAPSHOT_VALUE_SIZE ( BUFSIZ )
+
+/*! number of attempts to retrieve a value which is growing */
+#define SNAPSHOT_VALUE_RETRIES ( 3 )
+
+/*! round a record size up to the record alignment */
+#define SNAPSHOT_ALIGN(x) \
+    ( ( (x) + alignof( SnapshotRecord ) - 1 ) & \
+      ~( alignof( SnapshotRecord ) - 1 ) )
+
+/*==============================================================================
+       Function declarations
+==============================================================================*/
+#ifdef SAVESVC_VAR_GETBATCH
+static int CaptureBatched( Snapshot *pSnapshot,
+                           VARSERVER_HANDLE hVarServer,
+                           VarQuery *pQuery,
+                           size_t batchsize );
+#endif
+static int CaptureIterated( Snapshot *pSnapshot,
+                            VARSERVER_HANDLE hVarServer,
+                            VarQuery *pQuery );
+static int GetLargeValue( Snapshot *pSnapshot,
+                          VARSERVER_HANDLE hVarServer,
+                          VAR_HANDLE hVar,
+                          VarObject *pVarObject );
+static int GrowValue( Snapshot *pSnapshot, size_t len );
+static size_t RecordSize( SnapshotRecord *pRecord );
+static int Reserve( Snapshot *pSnapshot, size_t len );
+
+/*==============================================================================
+       Function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  SNAPSHOT_Init                                                             */
+/*!
+    Initialize a snapshot
+
+    @param[in,out]
+        pSnapshot
+            pointer to the snapshot to initialize
+
+    @param[in]
+        size
+            initial size of the snapshot buffer
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval ENOMEM - memory allocation failed
+
+==============================================================================*/
+int SNAPSHOT_Init( Snapshot *pSnapshot, size_t size )
+{
+    int result = EINVAL;
+
+    if ( pSnapshot != NULL )
+    {
+        memset( pSnapshot, 0, sizeof( Snapshot ) );
+        result = Reserve( pSnapshot, size );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  SNAPSHOT_Reset                                                            */
+/*!
+    Remove all records from a snapshot
+
+    The SNAPSHOT_Reset function removes all of the records from the
+    snapshot but retains the snapshot buffer for re-use.
+
+    @param[in,out]
+        pSnapshot
+            pointer to the snapshot
+
+==============================================================================*/
+void SNAPSHOT_Reset( Snapshot *pSnapshot )
+{
+    if ( pSnapshot != NULL )
+    {
+        pSnapshot->len = 0;
+        pSnapshot->count = 0;
+    }
+}
+
+/*============================================================================*/
+/*  SNAPSHOT_Add                                                              */
+/*!
+    Add a variable to a snapshot
+
+    The SNAPSHOT_Add function appends a record containing the specified
+    variable to the snapshot.
+
+    @param[in,out]
+        pSnapshot
+            pointer to the snapshot
+
+    @param[in]
+        hVar
+            handle of the variable
+
+    @param[in]
+        instanceID
+            instance identifier of the variable
+
+    @param[in]
+        name
+            name of the variable
+
+    @param[in]
+        pVarObject
+            pointer to the variable value
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval ENOMEM - memory allocation failed
+
+==============================================================================*/
+int SNAPSHOT_Add( Snapshot *pSnapshot,
+                  VAR_HANDLE hVar,
+                  uint32_t instanceID,
+                  const char *name,
+                  VarObject *pVarObject )
+{
+    int result = EINVAL;
+    SnapshotRecord *pRecord;
+    const void *data = NULL;
+    size_t namelen;
+    size_t len = 0;
+    size_t size;
+
+    if ( ( pSnapshot != NULL ) &&
+         ( name != NULL ) &&
+         ( pVarObject != NULL ) )
+    {
+        if ( pVarObject->type == VARTYPE_STR )
+        {
+            data = pVarObject->val.str;
+            len = ( data != NULL ) ? strlen( data ) + 1 : 0;
+        }
+        else if ( pVarObject->type == VARTYPE_BLOB )
+        {
+            data = pVarObject->val.blob;
+            len = ( data != NULL ) ? pVarObject->len : 0;
+        }
+
+        namelen = strlen( name );
+        size = SNAPSHOT_RecordSize( namelen, len );
+
+        result = Reserve( pSnapshot, pSnapshot->len + size );
+        if ( result == EOK )
+        {
+            pRecord = (SnapshotRecord *)&pSnapshot->buf[pSnapshot->len];
+            pRecord->hVar = hVar;
+            pRecord->instanceID = instanceID;
+            pRecord->type = pVarObject->type;
+            pRecord->namelen = namelen;
+            pRecord->len = len;
+
+            if ( data != NULL )
+            {
+                memset( &pRecord->val, 0, sizeof( VarData ) );
+                memcpy( SNAPSHOT_Data( pRecord ), data, len );
+            }
+            else
+            {
+                pRecord->val = pVarObject->val;
+            }
+
+            memcpy( SNAPSHOT_Name( pRecord ), name, namelen + 1 );
+
+            pSnapshot->len += size;
+            pSnapshot->count++;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  SNAPSHOT_Copy                                                             */
+/*!
+    Copy a record into a snapshot
+
+    The SNAPSHOT_Copy function appends a copy of a record from another
+    snapshot.
+
+    @param[in,out]
+        pSnapshot
+            pointer to the snapshot to copy the record into
+
+    @param[in]
+        pRecord
+            pointer to the record to copy
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval ENOMEM - memory allocation failed
+
+==============================================================================*/
+int SNAPSHOT_Copy( Snapshot *pSnapshot, SnapshotRecord *pRecord )
+{
+    int result = EINVAL;
+    size_t size;
+
+    if ( ( pSnapshot != NULL ) &&
+         ( pRecord != NULL ) )
+    {
+        size = RecordSize( pRecord );
+
+        result = Reserve( pSnapshot, pSnapshot->len + size );
+        if ( result == EOK )
+        {
+            memcpy( &pSnapshot->buf[pSnapshot->len], pRecord, size );
+            pSnapshot->len += size;
+            pSnapshot->count++;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  SNAPSHOT_Get                                                              */
+/*!
+    Retrieve a variable by handle and add it to a snapshot
+
+    The SNAPSHOT_Get function retrieves the value of a single variable
+    into the snapshot value buffer, growing the buffer for large values,
+    and adds it to the snapshot.
+
+    @param[in,out]
+        pSnapshot
+            pointer to the snapshot
+
+    @param[in]
+        hVarServer
+            handle to the variable server
+
+    @param[in]
+        hVar
+            handle of the variable
+
+    @param[in]
+        instanceID
+            instance identifier of the variable
+
+    @param[in]
+        name
+            name of the variable
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval ENOMEM - memory allocation failed
+    @retval other error from VAR_Get
+
+==============================================================================*/
+int SNAPSHOT_Get( Snapshot *pSnapshot,
+                  VARSERVER_HANDLE hVarServer,
+                  VAR_HANDLE hVar,
+                  uint32_t instanceID,
+                  const char *name )
+{
+    int result = EINVAL;
+    VarObject obj;
+
+    if ( ( pSnapshot != NULL ) &&
+         ( name != NULL ) )
+    {
+        result = GrowValue( pSnapshot, SNAPSHOT_VALUE_SIZE );
+        if ( result == EOK )
+        {
+            obj.val.str = pSnapshot->value;
+            obj.len = pSnapshot->valueSize;
+
+            result = VAR_Get( hVarServer, hVar, &obj );
+            if ( result == E2BIG )
+            {
+                result = GetLargeValue( pSnapshot, hVarServer, hVar, &obj );
+            }
+        }
+
+        if ( result == EOK )
+        {
+            result = SNAPSHOT_Add( pSnapshot, hVar, instanceID, name, &obj );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  SNAPSHOT_Capture                                                          */
+/*!
+    Capture a snapshot of variables from the variable server
+
+    The SNAPSHOT_Capture function replaces the content of the snapshot
+    with all of the variables selected by the specified query.
+
+    If a batch size is specified and the service is built with
+    SAVESVC_VAR_GETBATCH, the variables are retrieved in batches using
+    VAR_GetBatch.
+    VAR_GetBatch writes as many complete, aligned records (in the
+    SnapshotRecord layout) as fit into the supplied buffer, continuing
+    from the position held in the query, and updates *len to the number
+    of bytes written and *count to the number of records written.
+    It returns ENOENT when no more variables remain, or E2BIG with
+    *len set to the required size when the next record does not fit
+    into the buffer.
+
+    Otherwise the variables are retrieved one at a time.
+
+    @param[in,out]
+        pSnapshot
+            pointer to the snapshot
+
+    @param[in]
+        hVarServer
+            handle to the variable server
+
+    @param[in]
+        pQuery
+            pointer to the variable query
+
+    @param[in]
+        batchsize
+            minimum space (in bytes) offered to each batched retrieval,
+            or zero to retrieve variables one at a time
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval ENOMEM - memory allocation failed
+    @retval other error from VAR_GetBatch
+
+==============================================================================*/
+int SNAPSHOT_Capture( Snapshot *pSnapshot,
+                      VARSERVER_HANDLE hVarServer,
+                      VarQuery *pQuery,
+                      size_t batchsize )
+{
+    int result = EINVAL;
+
+    if ( ( pSnapshot != NULL ) &&
+         ( pQuery != NULL ) )
+    {
+        SNAPSHOT_Reset( pSnapshot );
+
+#ifdef SAVESVC_VAR_GETBATCH
+        if ( batchsize > 0 )
+        {
+            result = CaptureBatched( pSnapshot,
+                                     hVarServer,
+                                     pQuery,
+                                     batchsize );
+        }
+        else
+#else
+        (void)batchsize;
+#endif
+        {
+            result = CaptureIterated( pSnapshot, hVarServer, pQuery );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  SNAPSHOT_Select                                                           */
+/*!
+    Remove the records which are not selected from a snapshot
+
+    The SNAPSHOT_Select function calls the selection function with the
+    name of each record, and compacts the snapshot buffer in place so
+    it only holds the selected records, in their original order.
+
+    @param[in,out]
+        pSnapshot
+            pointer to the snapshot
+
+    @param[in]
+        selectFn
+            function returning true for each record to keep
+
+    @param[in]
+        arg
+            argument passed to the selection function
+
+    @retval number of records removed from the snapshot
+
+==============================================================================*/
+size_t SNAPSHOT_Select( Snapshot *pSnapshot,
+                        SnapshotSelectFn selectFn,
+                        void *arg )
+{
+    SnapshotRecord *pRecord;
+    size_t removed = 0;
+    size_t offset = 0;
+    size_t len = 0;
+    size_t size;
+
+    if ( ( pSnapshot != NULL ) &&
+         ( selectFn != NULL ) )
+    {
+        while ( offset < pSnapshot->len )
+        {
+            pRecord = (SnapshotRecord *)&pSnapshot->buf[offset];
+            size = RecordSize( pRecord );
+
+            if ( selectFn( arg, SNAPSHOT_Name( pRecord ) ) == true )
+            {
+                if ( len != offset )
+                {
+                    memmove( &pSnapshot->buf[len], pRecord, size );
+                }
+
+                len += size;
+            }
+            else
+            {
+                removed++;
+            }
+
+            offset += size;
+        }
+
+        pSnapshot->len = len;
+        pSnapshot->count -= removed;
+    }
+
+    return removed;
+}
+
+/*============================================================================*/
+/*  SNAPSHOT_RecordSize                                                       */
+/*!
+    Calculate the size of a snapshot record
+
+    @param[in]
+        namelen
+            length of the variable name (excluding the NUL terminator)
+
+    @param[in]
+        len
+            length of the string or blob value data
+
+    @retval size of the record including its name, data, and padding
+
+==============================================================================*/
+size_t SNAPSHOT_RecordSize( size_t namelen, size_t len )
+{
+    return SNAPSHOT_ALIGN( sizeof( SnapshotRecord ) + namelen + 1 + len );
+}
+
+/*============================================================================*/
+/*  SNAPSHOT_First                                                            */
+/*!
+    Get the first record of a snapshot
+
+    @param[in]
+        pSnapshot
+            pointer to the snapshot
+
+    @retval pointer to the first record
+    @retval NULL if the snapshot is empty
+
+==============================================================================*/
+SnapshotRecord *SNAPSHOT_First( Snapshot *pSnapshot )
+{
+    SnapshotRecord *pRecord = NULL;
+
+    if ( ( pSnapshot != NULL ) &&
+         ( pSnapshot->len > 0 ) )
+    {
+        pRecord = (SnapshotRecord *)pSnapshot->buf;
+    }
+
+    return pRecord;
+}
+
+/*============================================================================*/
+/*  SNAPSHOT_Next                                                             */
+/*!
+    Get the next record of a snapshot
+
+    @param[in]
+        pSnapshot
+            pointer to the snapshot
+
+    @param[in]
+        pRecord
+            pointer to the current record
+
+    @retval pointer to the next record
+    @retval NULL if there are no more records
+
+==============================================================================*/
+SnapshotRecord *SNAPSHOT_Next( Snapshot *pSnapshot, SnapshotRecord *pRecord )
+{
+    SnapshotRecord *pNext = NULL;
+    size_t offset;
+
+    if ( ( pSnapshot != NULL ) &&
+         ( pRecord != NULL ) )
+    {
+        offset = (size_t)( (char *)pRecord - pSnapshot->buf ) +
+                 RecordSize( pRecord );
+        if ( offset < pSnapshot->len )
+        {
+            pNext = (SnapshotRecord *)&pSnapshot->buf[offset];
+        }
+    }
+
+    return pNext;
+}
+
+/*============================================================================*/
+/*  SNAPSHOT_Name                                                             */
+/*!
+    Get the variable name from a snapshot record
+
+    @param[in]
+        pRecord
+            pointer to the snapshot record
+
+    @retval pointer to the NUL terminated variable name
+
+==============================================================================*/
+char *SNAPSHOT_Name( SnapshotRecord *pRecord )
+{
+    return (char *)( pRecord + 1 );
+}
+
+/*============================================================================*/
+/*  SNAPSHOT_Data                                                             */
+/*!
+    Get the value data from a snapshot record
+
+    The SNAPSHOT_Data function gets a pointer to the value data of a
+    string or blob variable.  String data is NUL terminated.
+
+    @param[in]
+        pRecord
+            pointer to the snapshot record
+
+    @retval pointer to the value data
+
+==============================================================================*/
+void *SNAPSHOT_Data( SnapshotRecord *pRecord )
+{
+    return (char *)( pRecord + 1 ) + pRecord->namelen + 1;
+}
+
+/*============================================================================*/
+/*  SNAPSHOT_Free                                                             */
+/*!
+    Release the resources held by a snapshot
+
+    @param[in,out]
+        pSnapshot
+            pointer to the snapshot
+
+==============================================================================*/
+void SNAPSHOT_Free( Snapshot *pSnapshot )
+{
+    if ( pSnapshot != NULL )
+    {
+        free( pSnapshot->buf );
+        free( pSnapshot->value );
+        memset( pSnapshot, 0, sizeof( Snapshot ) );
+    }
+}
+
+#ifdef SAVESVC_VAR_GETBATCH
+/*============================================================================*/
+/*  CaptureBatched                                                            */
+/*!
+    Capture a snapshot using batched retrieval
+
+    The CaptureBatched function retrieves the variables selected by
+    the query in batches directly into the snapshot buffer.  Each
+    retrieval is offered all of the remaining space in the snapshot
+    buffer, which is grown to at least the batch size beforehand.
+
+    @param[in,out]
+        pSnapshot
+            pointer to the snapshot
+
+    @param[in]
+        hVarServer
+            handle to the variable server
+
+    @param[in]
+        pQuery
+            pointer to the variable query
+
+    @param[in]
+        batchsize
+            minimum space (in bytes) offered to each batched retrieval
+
+    @retval EOK - success
+    @retval ENOMEM - memory allocation failed
+    @retval other error from VAR_GetBatch
+
+==============================================================================*/
+static int CaptureBatched( Snapshot *pSnapshot,
+                           VARSERVER_HANDLE hVarServer,
+                           VarQuery *pQuery,
+                           size_t batchsize )
+{
+    int result = EOK;
+    size_t count;
+    size_t len;
+
+    while ( result == EOK )
+    {
+        result = Reserve( pSnapshot, pSnapshot->len + batchsize );
+        if ( result == EOK )
+        {
+            len = pSnapshot->size - pSnapshot->len;
+            count = 0;
+
+            result = VAR_GetBatch( hVarServer,
+                                   pQuery,
+                                   &pSnapshot->buf[pSnapshot->len],
+                                   &len,
+                                   &count );
+            if ( result == EOK )
+            {
+                pSnapshot->len += len;
+                pSnapshot->count += count;
+            }
+            else if ( ( result == E2BIG ) && ( len > batchsize ) )
+            {
+                /* retry with room for the next record */
+                batchsize = len;
+                result = EOK;
+            }
+        }
+    }
+
+    return ( result == ENOENT ) ? EOK : result;
+}
+
+#endif
+
+/*============================================================================*/
+/*  CaptureIterated                                                           */
+/*!
+    Capture a snapshot one variable at a time
+
+    The CaptureIterated function retrieves the variables selected by
+    the query using VAR_GetFirst and VAR_GetNext.
+
+    Values are retrieved into the snapshot value buffer.  A value which
+    does not fit is retrieved again by handle once the buffer has been
+    grown to fit it, so large values are not dropped.
+
+    @param[in,out]
+        pSnapshot
+            pointer to the snapshot
+
+    @param[in]
+        hVarServer
+            handle to the variable server
+
+    @param[in]
+        pQuery
+            pointer to the variable query
+
+    @retval EOK - success
+    @retval ENOMEM - memory allocation failed
+
+==============================================================================*/
+static int CaptureIterated( Snapshot *pSnapshot,
+                            VARSERVER_HANDLE hVarServer,
+                            VarQuery *pQuery )
+{
+    int result;
+    VarObject obj;
+    int rc;
+
+    result = GrowValue( pSnapshot, SNAPSHOT_VALUE_SIZE );
+    if ( result == EOK )
+    {
+        obj.val.str = pSnapshot->value;
+        obj.len = pSnapshot->valueSize;
+
+        rc = VAR_GetFirst( hVarServer, pQuery, &obj );
+        while ( ( rc == EOK ) || ( rc == E2BIG ) )
+        {
+            if ( rc == E2BIG )
+            {
+                rc = GetLargeValue( pSnapshot, hVarServer, pQuery->hVar, &obj );
+            }
+
+            if ( rc == EOK )
+            {
+                result = SNAPSHOT_Add( pSnapshot,
+                                       pQuery->hVar,
+                                       pQuery->instanceID,
+                                       pQuery->name,
+                                       &obj );
+                if ( result != EOK )
+                {
+                    break;
+                }
+            }
+            else
+            {
+                fprintf( stderr,
+                         "cannot capture %s: %s\n",
+                         pQuery->name,
+                         strerror( rc ) );
+            }
+
+            obj.val.str = pSnapshot->value;
+            obj.len = pSnapshot->valueSize;
+
+            rc = VAR_GetNext( hVarServer, pQuery, &obj );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  GetLargeValue                                                             */
+/*!
+    Retrieve a value which did not fit in the snapshot value buffer
+
+    The GetLargeValue function grows the snapshot value buffer to fit
+    the current length of the variable, and retrieves the variable
+    by handle.  The value may grow between the two calls, so this is
+    retried a few times.
+
+    @param[in,out]
+        pSnapshot
+            pointer to the snapshot
+
+    @param[in]
+        hVarServer
+            handle to the variable server
+
+    @param[in]
+        hVar
+            handle of the variable to retrieve
+
+    @param[out]
+        pVarObject
+            pointer to the object to retrieve the value into
+
+    @retval EOK - success
+    @retval ENOMEM - memory allocation failed
+    @retval E2BIG - the value kept growing
+    @retval other error from VAR_GetLength or VAR_Get
+
+==============================================================================*/
+static int GetLargeValue( Snapshot *pSnapshot,
+                          VARSERVER_HANDLE hVarServer,
+                          VAR_HANDLE hVar,
+                          VarObject *pVarObject )
+{
+    int result = E2BIG;
+    size_t len;
+    int retries;
+
+    for ( retries = 0;
+          ( result == E2BIG ) && ( retries < SNAPSHOT_VALUE_RETRIES );
+          retries++ )
+    {
+        result = VAR_GetLength( hVarServer, hVar, &len );
+        if ( result == EOK )
+        {
+            /* allow for a string NUL terminator */
+            result = GrowValue( pSnapshot, len + 1 );
+        }
+
+        if ( result == EOK )
+        {
+            pVarObject->val.str = pSnapshot->value;
+            pVarObject->len = pSnapshot->valueSize;
+            result = VAR_Get( hVarServer, hVar, pVarObject );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  GrowValue                                                                 */
+/*!
+    Grow the snapshot value buffer
+
+    The GrowValue function makes sure the value buffer can hold at
+    least the specified number of bytes.  The buffer is retained, and
+    grows in powers of two, so it is rarely reallocated.
+
+    @param[in,out]
+        pSnapshot
+            pointer to the snapshot
+
+    @param[in]
+        len
+            number of bytes required
+
+    @retval EOK - success
+    @retval ENOMEM - memory allocation failed
+
+==============================================================================*/
+static int GrowValue( Snapshot *pSnapshot, size_t len )
+{
+    int result = EOK;
+    size_t size = ( pSnapshot->valueSize > 0 ) ? pSnapshot->valueSize
+                                               : SNAPSHOT_VALUE_SIZE;
+    char *p;
+
+    if ( len > pSnapshot->valueSize )
+    {
+        while ( size < len )
+        {
+            size *= 2;
+        }
+
+        p = realloc( pSnapshot->value, size );
+        if ( p != NULL )
+        {
+            pSnapshot->value = p;
+            pSnapshot->valueSize = size;
+        }
+        else
+        {
+            result = ENOMEM;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  RecordSize                                                                */
+/*!
+    Get the size of a snapshot record
+
+    @param[in]
+        pRecord
+            pointer to the snapshot record
+
+    @retval size of the record including its name, data, and padding
+
+==============================================================================*/
+static size_t RecordSize( SnapshotRecord *pRecord )
+{
+    return SNAPSHOT_RecordSize( pRecord->namelen, pRecord->len );
+}
+
+/*============================================================================*/
+/*  Reserve                                                                   */
+/*!
+    Ensure the snapshot buffer is large enough
+
+    The Reserve function grows the snapshot buffer (by doubling) until
+    it can hold at least the specified number of bytes.
+
+    @param[in,out]
+        pSnapshot
+            pointer to the snapshot
+
+    @param[in]
+        len
+            required size of the snapshot buffer
+
+    @retval EOK - success
+    @retval ENOMEM - memory allocation failed
+
+==============================================================================*/
+static int Reserve( Snapshot *pSnapshot, size_t len )
+{
+    int result = EOK;
+    size_t size;
+    char *buf;
+
+    if ( len > pSnapshot->size )
+    {
+        size = ( pSnapshot->size > 0 ) ? pSnapshot->size : 1024;
+        while ( size < len )
+        {
+            size *= 2;
+        }
+
+        buf = realloc( pSnapshot->buf, size );
+        if ( buf != NULL )
+        {
+            pSnapshot->buf = buf;
+            pSnapshot->size = size;
+        }
+        else
+        {
+            result = ENOMEM;
+        }
+    }
+
+    return result;
+}
+
+/*! @}
+ * end of snapshot group */
@@ -0,0 +1,859 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup uring io_uring Submission
+ * @brief Minimal io_uring interface for the Save Service commit path
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file uring.c
+
+    io_uring Submission
+
+    The io_uring Submission module provides the small part of io_uring
+    used by the Save Service: writes (optionally from registered
+    buffers), fdatasync, linkat and renameat, submitted as a linked
+    chain so each operation only starts once the previous one has
+    succeeded.  A whole commit is then submitted and waited for with a
+    single io_uring_enter() system call.
+
+    The ring is set up with the raw system calls, so no additional
+    library is required.  If the kernel does not support io_uring, or
+    does not support the required operations, URING_Init fails and the
+    caller falls back to its synchronous system calls.
+
+    A ring is used by one thread at a time.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <varserver/varserver.h>
+#include "uring.h"
+
+/*==============================================================================
+        Definitions
+==============================================================================*/
+
+/*! number of operations to probe for support */
+#define URING_PROBE_OPS ( 256 )
+
+/*==============================================================================
+       Function declarations
+==============================================================================*/
+static int Probe( URing *pRing );
+static bool Supported( struct io_uring_probe *pProbe, unsigned int op );
+static struct io_uring_sqe *GetEntry( URing *pRing );
+static unsigned int Reap( URing *pRing, int32_t *results, unsigned int count );
+
+/*==============================================================================
+       Function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  URING_Init                                                                */
+/*!
+    Set up an io_uring instance
+
+    The URING_Init function creates the ring, maps its submission and
+    completion queues, and checks that the write, fdatasync and renameat
+    operations are supported.
+
+    @param[in,out]
+        pRing
+            pointer to the ring to set up
+
+    @param[in]
+        depth
+            submission queue depth.  This is raised to URING_MIN_DEPTH
+            so a commit chain always fits
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval ENOTSUP - a required operation is not supported
+    @retval other error from io_uring_setup() or mmap()
+
+==============================================================================*/
+int URING_Init( URing *pRing, unsigned int depth )
+{
+    int result = EINVAL;
+    struct io_uring_params params;
+    uint8_t *sq;
+    uint8_t *cq;
+
+    if ( pRing != NULL )
+    {
+        memset( pRing, 0, sizeof( URing ) );
+        memset( &params, 0, sizeof( params ) );
+
+        if ( depth < URING_MIN_DEPTH )
+        {
+            depth = URING_MIN_DEPTH;
+        }
+
+        pRing->fd = (int)syscall( __NR_io_uring_setup, depth, &params );
+        result = ( pRing->fd != -1 ) ? EOK : errno;
+    }
+
+    if ( result == EOK )
+    {
+        pRing->entries = params.sq_entries;
+        pRing->sqRingSize = params.sq_off.array +
+                            ( params.sq_entries * sizeof( unsigned int ) );
+        pRing->cqRingSize = params.cq_off.cqes +
+                            ( params.cq_entries *
+                              sizeof( struct io_uring_cqe ) );
+
+        if ( ( params.features & IORING_FEAT_SINGLE_MMAP ) != 0 )
+        {
+            /* the queues share a single mapping */
+            if ( pRing->cqRingSize > pRing->sqRingSize )
+            {
+                pRing->sqRingSize = pRing->cqRingSize;
+            }
+
+            pRing->cqRingSize = pRing->sqRingSize;
+        }
+
+        pRing->sqRing = mmap( NULL,
+                              pRing->sqRingSize,
+                              PROT_READ | PROT_WRITE,
+                              MAP_SHARED | MAP_POPULATE,
+                              pRing->fd,
+                              IORING_OFF_SQ_RING );
+        if ( pRing->sqRing == MAP_FAILED )
+        {
+            pRing->sqRing = NULL;
+            result = errno;
+        }
+        else if ( ( params.features & IORING_FEAT_SINGLE_MMAP ) != 0 )
+        {
+            pRing->cqRing = pRing->sqRing;
+        }
+        else
+        {
+            pRing->cqRing = mmap( NULL,
+                                  pRing->cqRingSize,
+                                  PROT_READ | PROT_WRITE,
+                                  MAP_SHARED | MAP_POPULATE,
+                                  pRing->fd,
+                                  IORING_OFF_CQ_RING );
+            if ( pRing->cqRing == MAP_FAILED )
+            {
+                pRing->cqRing = NULL;
+                result = errno;
+            }
+        }
+    }
+
+    if ( result == EOK )
+    {
+        pRing->sqesSize = params.sq_entries * sizeof( struct io_uring_sqe );
+        pRing->sqes = mmap( NULL,
+                            pRing->sqesSize,
+                            PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE,
+                            pRing->fd,
+                            IORING_OFF_SQES );
+        if ( pRing->sqes == MAP_FAILED )
+        {
+            pRing->sqes = NULL;
+            result = errno;
+        }
+    }
+
+    if ( result == EOK )
+    {
+        sq = (uint8_t *)pRing->sqRing;
+        pRing->sqHead = (unsigned int *)( sq + params.sq_off.head );
+        pRing->sqTail = (unsigned int *)( sq + params.sq_off.tail );
+        pRing->sqMask = *(unsigned int *)( sq + params.sq_off.ring_mask );
+        pRing->sqArray = (unsigned int *)( sq + params.sq_off.array );
+
+        cq = (uint8_t *)pRing->cqRing;
+        pRing->cqHead = (unsigned int *)( cq + params.cq_off.head );
+        pRing->cqTail = (unsigned int *)( cq + params.cq_off.tail );
+        pRing->cqMask = *(unsigned int *)( cq + params.cq_off.ring_mask );
+        pRing->cqes = (struct io_uring_cqe *)( cq + params.cq_off.cqes );
+
+        result = Probe( pRing );
+    }
+
+    if ( ( result != EOK ) &&
+         ( pRing != NULL ) )
+    {
+        URING_Free( pRing );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  URING_RegisterBuffers                                                     */
+/*!
+    Register buffers with the ring
+
+    Writes from a registered buffer avoid mapping the buffer pages into
+    the kernel on every write.  The buffers must stay allocated until the
+    ring is freed.
+
+    @param[in,out]
+        pRing
+            pointer to the ring
+
+    @param[in]
+        iov
+            pointer to the buffers to register
+
+    @param[in]
+        count
+            number of buffers to register
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval other error from io_uring_register()
+
+==============================================================================*/
+int URING_RegisterBuffers( URing *pRing,
+                           const struct iovec *iov,
+                           unsigned int count )
+{
+    int result = EINVAL;
+    long rc;
+
+    if ( ( pRing != NULL ) &&
+         ( pRing->fd != -1 ) &&
+         ( iov != NULL ) &&
+         ( count > 0 ) )
+    {
+        rc = syscall( __NR_io_uring_register,
+                      pRing->fd,
+                      IORING_REGISTER_BUFFERS,
+                      iov,
+                      count );
+        if ( rc == 0 )
+        {
+            pRing->nbufs = count;
+            result = EOK;
+        }
+        else
+        {
+            result = errno;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  URING_Write                                                               */
+/*!
+    Queue a write
+
+    @param[in,out]
+        pRing
+            pointer to the ring
+
+    @param[in]
+        fd
+            file descriptor to write to
+
+    @param[in]
+        buf
+            pointer to the data to write
+
+    @param[in]
+        len
+            number of bytes to write
+
+    @param[in]
+        offset
+            file offset to write at
+
+    @param[in]
+        bufIndex
+            index of the registered buffer holding the data plus one,
+            or zero if the data is not in a registered buffer
+
+    @param[in]
+        tag
+            tag identifying the result of the write
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval EBUSY - the submission queue is full
+
+==============================================================================*/
+int URING_Write( URing *pRing,
+                 int fd,
+                 const void *buf,
+                 size_t len,
+                 uint64_t offset,
+                 unsigned int bufIndex,
+                 uint64_t tag )
+{
+    int result = EINVAL;
+    struct io_uring_sqe *sqe;
+
+    if ( ( pRing != NULL ) &&
+         ( buf != NULL ) &&
+         ( len <= UINT32_MAX ) &&
+         ( bufIndex <= pRing->nbufs ) )
+    {
+        sqe = GetEntry( pRing );
+        if ( sqe != NULL )
+        {
+            sqe->opcode = ( bufIndex > 0 ) ? IORING_OP_WRITE_FIXED
+                                           : IORING_OP_WRITE;
+            sqe->fd = fd;
+            sqe->addr = (uint64_t)(uintptr_t)buf;
+            sqe->len = (uint32_t)len;
+            sqe->off = offset;
+            sqe->buf_index = ( bufIndex > 0 ) ? (uint16_t)( bufIndex - 1 ) : 0;
+            sqe->user_data = tag;
+            result = EOK;
+        }
+        else
+        {
+            result = EBUSY;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  URING_Fdatasync                                                           */
+/*!
+    Queue an fdatasync
+
+    @param[in,out]
+        pRing
+            pointer to the ring
+
+    @param[in]
+        fd
+            file descriptor to sync
+
+    @param[in]
+        tag
+            tag identifying the result of the sync
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval EBUSY - the submission queue is full
+
+==============================================================================*/
+int URING_Fdatasync( URing *pRing, int fd, uint64_t tag )
+{
+    int result = EINVAL;
+    struct io_uring_sqe *sqe;
+
+    if ( pRing != NULL )
+    {
+        sqe = GetEntry( pRing );
+        if ( sqe != NULL )
+        {
+            sqe->opcode = IORING_OP_FSYNC;
+            sqe->fd = fd;
+            sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+            sqe->user_data = tag;
+            result = EOK;
+        }
+        else
+        {
+            result = EBUSY;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  URING_LinkAt                                                              */
+/*!
+    Queue a linkat
+
+    The paths are relative to the current directory, and must stay
+    valid until the operation completes.
+
+    @param[in,out]
+        pRing
+            pointer to the ring
+
+    @param[in]
+        oldpath
+            path of the existing file
+
+    @param[in]
+        newpath
+            path of the new link
+
+    @param[in]
+        flags
+            linkat() flags
+
+    @param[in]
+        tag
+            tag identifying the result of the link
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval ENOTSUP - linkat is not supported
+    @retval EBUSY - the submission queue is full
+
+==============================================================================*/
+int URING_LinkAt( URing *pRing,
+                  const char *oldpath,
+                  const char *newpath,
+                  int flags,
+                  uint64_t tag )
+{
+    int result = EINVAL;
+    struct io_uring_sqe *sqe;
+
+    if ( ( pRing != NULL ) &&
+         ( oldpath != NULL ) &&
+         ( newpath != NULL ) )
+    {
+        result = ( pRing->linkat == true ) ? EOK : ENOTSUP;
+    }
+
+    if ( result == EOK )
+    {
+        sqe = GetEntry( pRing );
+        if ( sqe != NULL )
+        {
+            sqe->opcode = IORING_OP_LINKAT;
+            sqe->fd = AT_FDCWD;
+            sqe->addr = (uint64_t)(uintptr_t)oldpath;
+            sqe->len = (uint32_t)AT_FDCWD;
+            sqe->addr2 = (uint64_t)(uintptr_t)newpath;
+            sqe->hardlink_flags = (uint32_t)flags;
+            sqe->user_data = tag;
+        }
+        else
+        {
+            result = EBUSY;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  URING_RenameAt                                                            */
+/*!
+    Queue a renameat
+
+    The paths are relative to the current directory, and must stay
+    valid until the operation completes.
+
+    @param[in,out]
+        pRing
+            pointer to the ring
+
+    @param[in]
+        oldpath
+            path of the file to rename
+
+    @param[in]
+        newpath
+            new path of the file
+
+    @param[in]
+        tag
+            tag identifying the result of the rename
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval EBUSY - the submission queue is full
+
+==============================================================================*/
+int URING_RenameAt( URing *pRing,
+                    const char *oldpath,
+                    const char *newpath,
+                    uint64_t tag )
+{
+    int result = EINVAL;
+    struct io_uring_sqe *sqe;
+
+    if ( ( pRing != NULL ) &&
+         ( oldpath != NULL ) &&
+         ( newpath != NULL ) )
+    {
+        sqe = GetEntry( pRing );
+        if ( sqe != NULL )
+        {
+            sqe->opcode = IORING_OP_RENAMEAT;
+            sqe->fd = AT_FDCWD;
+            sqe->addr = (uint64_t)(uintptr_t)oldpath;
+            sqe->len = (uint32_t)AT_FDCWD;
+            sqe->addr2 = (uint64_t)(uintptr_t)newpath;
+            sqe->user_data = tag;
+            result = EOK;
+        }
+        else
+        {
+            result = EBUSY;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  URING_Run                                                                 */
+/*!
+    Submit the queued operations as a linked chain and wait for them
+
+    The URING_Run function links each queued operation to the next, so
+    an operation which fails, or a write which is short, cancels the
+    rest of the chain with ECANCELED.  The operations are submitted
+    and waited for together.
+
+    The result of each operation (a byte count or a negated error) is
+    stored in the results array at the index given by its tag.
+    Operations whose tags are outside the array are not reported.
+
+    If the ring fails, it is left unusable, since operations may still
+    be in progress, and every subsequent call fails with the same error.
+
+    @param[in,out]
+        pRing
+            pointer to the ring
+
+    @param[out]
+        results
+            array to store the result of each operation, indexed by tag
+
+    @param[in]
+        count
+            number of entries in the results array
+
+    @retval EOK - all of the operations have completed
+    @retval EINVAL - invalid arguments
+    @retval other error from io_uring_enter()
+
+==============================================================================*/
+int URING_Run( URing *pRing, int32_t *results, unsigned int count )
+{
+    int result = EINVAL;
+    unsigned int tail;
+    unsigned int submitted = 0;
+    unsigned int reaped = 0;
+    unsigned int n;
+    unsigned int i;
+    long rc;
+
+    if ( ( pRing != NULL ) &&
+         ( results != NULL ) )
+    {
+        result = pRing->error;
+    }
+
+    if ( result == EOK )
+    {
+        n = pRing->queued;
+        pRing->queued = 0;
+
+        for ( i = 0; i < count; i++ )
+        {
+            results[i] = -ECANCELED;
+        }
+
+        /* link each entry to the next one */
+        tail = *pRing->sqTail;
+        for ( i = 1; i < n; i++ )
+        {
+            pRing->sqes[( tail + i - 1 ) & pRing->sqMask].flags |=
+                                                            IOSQE_IO_LINK;
+        }
+
+        /* publish the entries to the kernel */
+        __atomic_store_n( pRing->sqTail, tail + n, __ATOMIC_RELEASE );
+
+        while ( ( reaped < n ) && ( result == EOK ) )
+        {
+            rc = syscall( __NR_io_uring_enter,
+                          pRing->fd,
+                          n - submitted,
+                          1,
+                          IORING_ENTER_GETEVENTS,
+                          NULL,
+                          0 );
+            if ( rc >= 0 )
+            {
+                submitted += (unsigned int)rc;
+                reaped += Reap( pRing, results, count );
+            }
+            else if ( errno != EINTR )
+            {
+                result = errno;
+                pRing->error = result;
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  URING_Discard                                                             */
+/*!
+    Discard the queued operations
+
+    The URING_Discard function drops the operations queued since the
+    last URING_Run, for example when a chain cannot be completely queued.
+
+    @param[in,out]
+        pRing
+            pointer to the ring
+
+==============================================================================*/
+void URING_Discard( URing *pRing )
+{
+    if ( pRing != NULL )
+    {
+        pRing->queued = 0;
+    }
+}
+
+/*============================================================================*/
+/*  URING_Free                                                                */
+/*!
+    Release an io_uring instance
+
+    @param[in,out]
+        pRing
+            pointer to the ring
+
+==============================================================================*/
+void URING_Free( URing *pRing )
+{
+    if ( pRing != NULL )
+    {
+        if ( pRing->sqes != NULL )
+        {
+            munmap( pRing->sqes, pRing->sqesSize );
+        }
+
+        if ( ( pRing->cqRing != NULL ) &&
+             ( pRing->cqRing != pRing->sqRing ) )
+        {
+            munmap( pRing->cqRing, pRing->cqRingSize );
+        }
+
+        if ( pRing->sqRing != NULL )
+        {
+            munmap( pRing->sqRing, pRing->sqRingSize );
+        }
+
+        if ( pRing->fd >= 0 )
+        {
+            close( pRing->fd );
+        }
+
+        memset( pRing, 0, sizeof( URing ) );
+        pRing->fd = -1;
+    }
+}
+
+/*============================================================================*/
+/*  Probe                                                                     */
+/*!
+    Check the operations supported by the ring
+
+    @param[in,out]
+        pRing
+            pointer to the ring
+
+    @retval EOK - the required operations are supported
+    @retval ENOMEM - memory allocation failed
+    @retval ENOTSUP - a required operation is not supported
+    @retval other error from io_uring_register()
+
+==============================================================================*/
+static int Probe( URing *pRing )
+{
+    int result = ENOMEM;
+    struct io_uring_probe *pProbe;
+    size_t size;
+
+    size = sizeof( struct io_uring_probe ) +
+           ( URING_PROBE_OPS * sizeof( struct io_uring_probe_op ) );
+
+    pProbe = calloc( 1, size );
+    if ( pProbe != NULL )
+    {
+        if ( syscall( __NR_io_uring_register,
+                      pRing->fd,
+                      IORING_REGISTER_PROBE,
+                      pProbe,
+                      URING_PROBE_OPS ) == 0 )
+        {
+            result = ( Supported( pProbe, IORING_OP_WRITE ) &&
+                       Supported( pProbe, IORING_OP_WRITE_FIXED ) &&
+                       Supported( pProbe, IORING_OP_FSYNC ) &&
+                       Supported( pProbe, IORING_OP_RENAMEAT ) ) ? EOK
+                                                                 : ENOTSUP;
+            pRing->linkat = Supported( pProbe, IORING_OP_LINKAT );
+        }
+        else
+        {
+            result = errno;
+        }
+
+        free( pProbe );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Supported                                                                 */
+/*!
+    Determine if an operation is supported
+
+    @param[in]
+        pProbe
+            pointer to the probe results
+
+    @param[in]
+        op
+            operation code
+
+    @retval true - the operation is supported
+    @retval false - the operation is not supported
+
+==============================================================================*/
+static bool Supported( struct io_uring_probe *pProbe, unsigned int op )
+{
+    return ( op <= pProbe->last_op ) &&
+           ( op < URING_PROBE_OPS ) &&
+           ( ( pProbe->ops[op].flags & IO_URING_OP_SUPPORTED ) != 0 );
+}
+
+/*============================================================================*/
+/*  GetEntry                                                                  */
+/*!
+    Get the next free submission queue entry
+
+    @param[in,out]
+        pRing
+            pointer to the ring
+
+    @retval pointer to the cleared submission queue entry
+    @retval NULL if the submission queue is full or the ring is unusable
+
+==============================================================================*/
+static struct io_uring_sqe *GetEntry( URing *pRing )
+{
+    struct io_uring_sqe *sqe = NULL;
+    unsigned int head;
+    unsigned int tail;
+    unsigned int idx;
+
+    head = __atomic_load_n( pRing->sqHead, __ATOMIC_ACQUIRE );
+    tail = *pRing->sqTail + pRing->queued;
+
+    if ( ( pRing->error == EOK ) &&
+         ( tail - head < pRing->entries ) )
+    {
+        idx = tail & pRing->sqMask;
+        sqe = &pRing->sqes[idx];
+        memset( sqe, 0, sizeof( struct io_uring_sqe ) );
+        pRing->sqArray[idx] = idx;
+        pRing->queued++;
+    }
+
+    return sqe;
+}
+
+/*============================================================================*/
+/*  Reap                                                                      */
+/*!
+    Reap the available completions
+
+    @param[in,out]
+        pRing
+            pointer to the ring
+
+    @param[out]
+        results
+            array to store the result of each operation, indexed by tag
+
+    @param[in]
+        count
+            number of entries in the results array
+
+    @retval number of completions reaped
+
+==============================================================================*/
+static unsigned int Reap( URing *pRing, int32_t *results, unsigned int count )
+{
+    struct io_uring_cqe *cqe;
+    unsigned int head;
+    unsigned int tail;
+    unsigned int n = 0;
+
+    head = *pRing->cqHead;
+    tail = __atomic_load_n( pRing->cqTail, __ATOMIC_ACQUIRE );
+
+    while ( head != tail )
+    {
+        cqe = &pRing->cqes[head & pRing->cqMask];
+        if ( cqe->user_data < count )
+        {
+            results[cqe->user_data] = cqe->res;
+        }
+
+        head++;
+        n++;
+    }
+
+    __atomic_store_n( pRing->cqHead, head, __ATOMIC_RELEASE );
+
+    return n;
+}
+
+/*! @}
+ * end of uring group */
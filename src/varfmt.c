@@ -0,0 +1,370 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup varfmt Value Formatters
+ * @brief Type specialized variable value formatters for the Save Service
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file varfmt.c
+
+    Value Formatters
+
+    The Value Formatters convert numeric variable values to text
+    directly into a caller supplied buffer, without a format string.
+    Their output is identical to that of VAROBJECT_ToString, so the
+    configuration file is unchanged.
+
+    Integers are converted two digits at a time using a digit pair
+    table, after the number of digits has been calculated up front
+    so the digits can be written in place.
+
+    Floats are formatted as "%f" would format them, ie correctly rounded
+    to six decimal places.  The float is scaled by 10^6 in double
+    precision, which is exact for any float, and rounded to the nearest
+    integer with ties to even, then written as an integer part and a
+    six digit fraction.  Values too large to scale into 64 bits, and
+    infinities and NaNs, are left to the generic formatter.
+
+    The formatted values are not NUL terminated.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <varserver/varserver.h>
+#include "varfmt.h"
+
+/*==============================================================================
+       Definitions
+==============================================================================*/
+
+/*! largest float magnitude formatted by VARFMT_Float */
+#define VARFMT_FLOAT_LIMIT ( 1e12f )
+
+/*! float fraction scale: six decimal places */
+#define VARFMT_FLOAT_SCALE ( 1000000 )
+
+/*==============================================================================
+       Function declarations
+==============================================================================*/
+static size_t CountDigits( uint64_t val );
+
+/*==============================================================================
+      File Scoped Variables
+==============================================================================*/
+
+/*! two digit decimal strings for 00 to 99 */
+static const char digitPairs[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+/*! powers of 10 which fit in 64 bits */
+static const uint64_t powers10[] =
+{
+    1ULL,
+    10ULL,
+    100ULL,
+    1000ULL,
+    10000ULL,
+    100000ULL,
+    1000000ULL,
+    10000000ULL,
+    100000000ULL,
+    1000000000ULL,
+    10000000000ULL,
+    100000000000ULL,
+    1000000000000ULL,
+    10000000000000ULL,
+    100000000000000ULL,
+    1000000000000000ULL,
+    10000000000000000ULL,
+    100000000000000000ULL,
+    1000000000000000000ULL,
+    10000000000000000000ULL
+};
+
+/*==============================================================================
+       Function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  VARFMT_Unsigned                                                           */
+/*!
+    Format an unsigned integer
+
+    The VARFMT_Unsigned function writes the decimal representation
+    of an unsigned integer, as "%" PRIu64 would.
+
+    @param[in]
+        buf
+            pointer to the output buffer, which must have space
+            for at least 20 characters
+
+    @param[in]
+        val
+            value to format
+
+    @retval number of characters written
+
+==============================================================================*/
+size_t VARFMT_Unsigned( char *buf, uint64_t val )
+{
+    size_t n = CountDigits( val );
+    char *p = &buf[n];
+    size_t idx;
+
+    /* write the digits from the end, two at a time */
+    while ( val >= 100 )
+    {
+        idx = (size_t)( val % 100 ) * 2;
+        val /= 100;
+        p -= 2;
+        memcpy( p, &digitPairs[idx], 2 );
+    }
+
+    if ( val >= 10 )
+    {
+        memcpy( p - 2, &digitPairs[val * 2], 2 );
+    }
+    else
+    {
+        p[-1] = (char)( '0' + val );
+    }
+
+    return n;
+}
+
+/*============================================================================*/
+/*  VARFMT_Signed                                                             */
+/*!
+    Format a signed integer
+
+    The VARFMT_Signed function writes the decimal representation
+    of a signed integer, as "%" PRId64 would.
+
+    @param[in]
+        buf
+            pointer to the output buffer, which must have space
+            for at least 20 characters
+
+    @param[in]
+        val
+            value to format
+
+    @retval number of characters written
+
+==============================================================================*/
+size_t VARFMT_Signed( char *buf, int64_t val )
+{
+    size_t n = 0;
+
+    if ( val < 0 )
+    {
+        buf[n++] = '-';
+    }
+
+    /* negate in unsigned arithmetic so INT64_MIN is handled */
+    return n + VARFMT_Unsigned( &buf[n],
+                                ( val < 0 ) ? 0 - (uint64_t)val
+                                            : (uint64_t)val );
+}
+
+/*============================================================================*/
+/*  VARFMT_Float                                                              */
+/*!
+    Format a float
+
+    The VARFMT_Float function writes a float as "%f" would, with six
+    decimal places, rounding ties to even.
+
+    @param[in]
+        buf
+            pointer to the output buffer, which must have space
+            for at least VARFMT_MAX_LEN characters
+
+    @param[in]
+        val
+            value to format
+
+    @retval number of characters written
+    @retval 0 if the value must be formatted by the generic formatter
+
+==============================================================================*/
+size_t VARFMT_Float( char *buf, float val )
+{
+    size_t n = 0;
+    double scaled;
+    double rem;
+    uint64_t q;
+    uint64_t frac;
+
+    if ( ( isfinite( val ) ) &&
+         ( val < VARFMT_FLOAT_LIMIT ) &&
+         ( val > -VARFMT_FLOAT_LIMIT ) )
+    {
+        /* a float has at most 24 significant bits and 10^6 needs 14,
+           so the scaled value is exact in double precision */
+        scaled = (double)( ( val < 0 ) ? -val : val ) * VARFMT_FLOAT_SCALE;
+        q = (uint64_t)scaled;
+        rem = scaled - (double)q;
+        if ( ( rem > 0.5 ) ||
+             ( ( rem == 0.5 ) && ( ( q & 1 ) != 0 ) ) )
+        {
+            q++;
+        }
+
+        /* %f keeps the sign of negative values which round to zero */
+        if ( signbit( val ) )
+        {
+            buf[n++] = '-';
+        }
+
+        n += VARFMT_Unsigned( &buf[n], q / VARFMT_FLOAT_SCALE );
+        buf[n++] = '.';
+
+        frac = q % VARFMT_FLOAT_SCALE;
+        memcpy( &buf[n], &digitPairs[( frac / 10000 ) * 2], 2 );
+        memcpy( &buf[n + 2], &digitPairs[( ( frac / 100 ) % 100 ) * 2], 2 );
+        memcpy( &buf[n + 4], &digitPairs[( frac % 100 ) * 2], 2 );
+        n += 6;
+    }
+
+    return n;
+}
+
+/*============================================================================*/
+/*  VARFMT_Value                                                              */
+/*!
+    Format a numeric variable value
+
+    The VARFMT_Value function formats a numeric variable value the
+    same way as VAROBJECT_ToString.  Strings, blobs, and values which
+    cannot be formatted here are left to VAROBJECT_ToString.
+
+    @param[in]
+        buf
+            pointer to the output buffer, which must have space
+            for at least VARFMT_MAX_LEN characters
+
+    @param[in]
+        type
+            type of the variable
+
+    @param[in]
+        pVal
+            pointer to the variable value
+
+    @retval number of characters written
+    @retval 0 if the value must be formatted by VAROBJECT_ToString
+
+==============================================================================*/
+size_t VARFMT_Value( char *buf, VarType type, const VarData *pVal )
+{
+    size_t n = 0;
+
+    switch( type )
+    {
+        case VARTYPE_UINT16:
+            n = VARFMT_Unsigned( buf, pVal->ui );
+            break;
+
+        case VARTYPE_INT16:
+            n = VARFMT_Signed( buf, pVal->i );
+            break;
+
+        case VARTYPE_UINT32:
+            n = VARFMT_Unsigned( buf, pVal->ul );
+            break;
+
+        case VARTYPE_INT32:
+            n = VARFMT_Signed( buf, pVal->l );
+            break;
+
+        case VARTYPE_UINT64:
+            n = VARFMT_Unsigned( buf, pVal->ull );
+            break;
+
+        case VARTYPE_INT64:
+            n = VARFMT_Signed( buf, pVal->ll );
+            break;
+
+        case VARTYPE_FLOAT:
+            n = VARFMT_Float( buf, pVal->f );
+            break;
+
+        default:
+            break;
+    }
+
+    return n;
+}
+
+/*============================================================================*/
+/*  CountDigits                                                               */
+/*!
+    Count the decimal digits of an unsigned integer
+
+    The number of digits is estimated from the number of significant
+    bits (1233/4096 approximates log10(2)), then corrected with a
+    single comparison.
+
+    @param[in]
+        val
+            value to count the digits of
+
+    @retval number of decimal digits (at least 1)
+
+==============================================================================*/
+static size_t CountDigits( uint64_t val )
+{
+    size_t bits;
+    size_t t;
+
+    val |= 1;
+    bits = 64 - (size_t)__builtin_clzll( val );
+    t = ( bits * 1233 ) >> 12;
+
+    return t + 1 - ( val < powers10[t] );
+}
+
+/*! @}
+ * end of varfmt group */
@@ -0,0 +1,712 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+
+/*!
+ * @defgroup vartab Saved Variable Table
+ * @brief Table of the variable keys and most recently saved values
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file vartab.c
+
+    Saved Variable Table
+
+    The Saved Variable Table interns the key of each saved variable,
+    keyed by the variable handle and instance identifier.  Each entry
+    holds the pre-formatted "name=" or "[id]name=" text, so a variable
+    key is only formatted the first time the variable is saved.
+
+    The entry also records the value most recently saved for the
+    variable.  Small values are kept as text after the key, and larger
+    values as a hash.  This is used to determine which variables have
+    changed since the last save so only those variables need to be
+    written to the journal.
+
+    The table uses open addressing with linear probing and is doubled
+    in size whenever it becomes more than three quarters full.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <varserver/varserver.h>
+#include "hash.h"
+#include "varfmt.h"
+#include "vartab.h"
+
+/*==============================================================================
+       Definitions
+==============================================================================*/
+
+/*! granularity (in bytes) of an entry text buffer, so a value which
+    grows by a few bytes does not reallocate it */
+#define VARTAB_TEXT_ALIGN ( 16 )
+
+/*==============================================================================
+       Function declarations
+==============================================================================*/
+static uint64_t KeyHash( VAR_HANDLE hVar, uint32_t instanceID );
+static VarTabEntry *FindSlot( VarTabEntry *entries,
+                              size_t size,
+                              VAR_HANDLE hVar,
+                              uint32_t instanceID );
+static int SetKey( VarTab *pVarTab,
+                   VarTabEntry *pEntry,
+                   uint32_t instanceID,
+                   const char *name,
+                   size_t namelen );
+static bool Reserve( VarTab *pVarTab, VarTabEntry *pEntry, size_t len );
+static int Grow( VarTab *pVarTab );
+
+/*==============================================================================
+       Function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  VARTAB_Init                                                               */
+/*!
+    Initialize a saved variable table
+
+    @param[in,out]
+        pVarTab
+            pointer to the table to initialize
+
+    @param[in]
+        size
+            initial number of table slots.  This is rounded up to
+            a power of two.
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval ENOMEM - memory allocation failed
+
+==============================================================================*/
+int VARTAB_Init( VarTab *pVarTab, size_t size )
+{
+    int result = EINVAL;
+    size_t n = 16;
+
+    if ( pVarTab != NULL )
+    {
+        while ( n < size )
+        {
+            n <<= 1;
+        }
+
+        pVarTab->textBytes = 0;
+        pVarTab->entries = calloc( n, sizeof( VarTabEntry ) );
+        if ( pVarTab->entries != NULL )
+        {
+            pVarTab->size = n;
+            pVarTab->count = 0;
+            result = EOK;
+        }
+        else
+        {
+            pVarTab->size = 0;
+            pVarTab->count = 0;
+            result = ENOMEM;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  VARTAB_Intern                                                             */
+/*!
+    Get the table entry of a variable
+
+    The VARTAB_Intern function finds the entry of the specified variable,
+    adding it, with its pre-formatted key, if the variable is not in
+    the table.  The table is created on first use.
+
+    If the handle now refers to a variable with a different name, the
+    key is formatted again and the saved value is discarded.
+
+    @param[in,out]
+        pVarTab
+            pointer to the saved variable table
+
+    @param[in]
+        hVar
+            handle of the variable
+
+    @param[in]
+        instanceID
+            instance identifier of the variable
+
+    @param[in]
+        name
+            name of the variable
+
+    @param[in]
+        namelen
+            length of the variable name
+
+    @retval pointer to the variable entry.  This is valid until the
+            next call to VARTAB_Intern
+    @retval NULL if the handle is invalid or memory allocation failed
+
+==============================================================================*/
+VarTabEntry *VARTAB_Intern( VarTab *pVarTab,
+                            VAR_HANDLE hVar,
+                            uint32_t instanceID,
+                            const char *name,
+                            size_t namelen )
+{
+    VarTabEntry *pEntry = NULL;
+    int result = EINVAL;
+
+    if ( ( pVarTab != NULL ) &&
+         ( hVar != VAR_INVALID ) &&
+         ( name != NULL ) )
+    {
+        result = ( pVarTab->entries == NULL )
+                    ? VARTAB_Init( pVarTab, VARTAB_DEFAULT_SIZE )
+                    : EOK;
+
+        /* keep the load factor below 3/4 */
+        if ( ( result == EOK ) &&
+             ( ( pVarTab->count + 1 ) * 4 > pVarTab->size * 3 ) )
+        {
+            result = Grow( pVarTab );
+        }
+
+        if ( result == EOK )
+        {
+            pEntry = FindSlot( pVarTab->entries,
+                               pVarTab->size,
+                               hVar,
+                               instanceID );
+            if ( pEntry->hVar == VAR_INVALID )
+            {
+                /* new variable */
+                result = SetKey( pVarTab, pEntry, instanceID, name, namelen );
+                if ( result == EOK )
+                {
+                    pEntry->hVar = hVar;
+                    pEntry->instanceID = instanceID;
+                    pVarTab->count++;
+                }
+            }
+            else if ( ( pEntry->namelen != namelen ) ||
+                      ( memcmp( &pEntry->text[pEntry->keylen - namelen],
+                                name,
+                                namelen ) != 0 ) )
+            {
+                /* the handle was re-used by another variable */
+                result = SetKey( pVarTab, pEntry, instanceID, name, namelen );
+            }
+        }
+
+        if ( result != EOK )
+        {
+            pEntry = NULL;
+        }
+    }
+
+    return pEntry;
+}
+
+/*============================================================================*/
+/*  VARTAB_Changed                                                            */
+/*!
+    Check whether the value of a variable differs from its saved value
+
+    The VARTAB_Changed function compares a value with the recorded value
+    of the specified variable entry without recording it.  A variable
+    without a recorded value is reported as changed.
+
+    @param[in]
+        pVarTab
+            pointer to the saved variable table
+
+    @param[in]
+        pEntry
+            pointer to the variable entry
+
+    @param[in]
+        value
+            variable value text
+
+    @param[in]
+        len
+            length of the variable value text
+
+    @retval true - the value differs from the recorded value
+    @retval false - the value is unchanged
+
+==============================================================================*/
+bool VARTAB_Changed( VarTab *pVarTab,
+                     VarTabEntry *pEntry,
+                     const char *value,
+                     size_t len )
+{
+    bool changed = true;
+
+    if ( ( pVarTab != NULL ) &&
+         ( pEntry != NULL ) &&
+         ( value != NULL ) &&
+         ( pEntry->saved == true ) &&
+         ( pEntry->vallen == len ) )
+    {
+        if ( pEntry->cached == true )
+        {
+            changed = ( memcmp( &pEntry->text[pEntry->keylen + 1],
+                                value,
+                                len ) != 0 );
+        }
+        else
+        {
+            changed = ( pEntry->valhash != HASH_Update( HASH_INIT,
+                                                        value,
+                                                        len ) );
+        }
+    }
+
+    return changed;
+}
+
+/*============================================================================*/
+/*  VARTAB_Update                                                             */
+/*!
+    Record the saved value of a variable
+
+    The VARTAB_Update function records the value of the specified
+    variable entry and indicates whether it differs from the previously
+    recorded value.  A variable without a recorded value is reported
+    as changed.
+
+    @param[in,out]
+        pVarTab
+            pointer to the saved variable table
+
+    @param[in,out]
+        pEntry
+            pointer to the variable entry
+
+    @param[in]
+        value
+            variable value text
+
+    @param[in]
+        len
+            length of the variable value text
+
+    @retval true - the value differs from the recorded value
+    @retval false - the value is unchanged
+
+==============================================================================*/
+bool VARTAB_Update( VarTab *pVarTab,
+                    VarTabEntry *pEntry,
+                    const char *value,
+                    size_t len )
+{
+    bool changed = true;
+    uint64_t valhash = 0;
+    bool hashed = false;
+
+    if ( ( pVarTab != NULL ) &&
+         ( pEntry != NULL ) &&
+         ( value != NULL ) )
+    {
+        if ( ( pEntry->saved == true ) &&
+             ( pEntry->vallen == len ) )
+        {
+            if ( pEntry->cached == true )
+            {
+                /* compare with the saved value text */
+                changed = ( memcmp( &pEntry->text[pEntry->keylen + 1],
+                                    value,
+                                    len ) != 0 );
+            }
+            else
+            {
+                valhash = HASH_Update( HASH_INIT, value, len );
+                hashed = true;
+                changed = ( pEntry->valhash != valhash );
+            }
+        }
+
+        if ( changed == true )
+        {
+            pEntry->cached = ( len <= VARTAB_MAX_VALUE_SIZE ) &&
+                             ( Reserve( pVarTab, pEntry, len ) == true );
+            if ( pEntry->cached == true )
+            {
+                memcpy( &pEntry->text[pEntry->keylen + 1], value, len );
+            }
+            else if ( hashed == false )
+            {
+                valhash = HASH_Update( HASH_INIT, value, len );
+            }
+
+            pEntry->valhash = valhash;
+            pEntry->vallen = (uint32_t)len;
+            pEntry->saved = true;
+        }
+    }
+
+    return changed;
+}
+
+/*============================================================================*/
+/*  VARTAB_Clear                                                              */
+/*!
+    Discard the saved values of a saved variable table
+
+    The VARTAB_Clear function discards the recorded values of all of
+    the entries, so every variable is reported as changed, but retains
+    the entries and their keys for re-use.
+
+    @param[in,out]
+        pVarTab
+            pointer to the saved variable table
+
+==============================================================================*/
+void VARTAB_Clear( VarTab *pVarTab )
+{
+    size_t i;
+
+    if ( ( pVarTab != NULL ) &&
+         ( pVarTab->entries != NULL ) )
+    {
+        for ( i = 0; i < pVarTab->size; i++ )
+        {
+            pVarTab->entries[i].saved = false;
+        }
+    }
+}
+
+/*============================================================================*/
+/*  VARTAB_Memory                                                             */
+/*!
+    Get the memory used by a saved variable table
+
+    @param[in]
+        pVarTab
+            pointer to the saved variable table
+
+    @retval number of bytes allocated for the table slots and entry text
+
+==============================================================================*/
+size_t VARTAB_Memory( VarTab *pVarTab )
+{
+    size_t size = 0;
+
+    if ( pVarTab != NULL )
+    {
+        size = ( pVarTab->size * sizeof( VarTabEntry ) ) +
+               pVarTab->textBytes;
+    }
+
+    return size;
+}
+
+/*============================================================================*/
+/*  VARTAB_Free                                                               */
+/*!
+    Release the resources held by a saved variable table
+
+    @param[in,out]
+        pVarTab
+            pointer to the saved variable table
+
+==============================================================================*/
+void VARTAB_Free( VarTab *pVarTab )
+{
+    size_t i;
+
+    if ( pVarTab != NULL )
+    {
+        if ( pVarTab->entries != NULL )
+        {
+            for ( i = 0; i < pVarTab->size; i++ )
+            {
+                free( pVarTab->entries[i].text );
+            }
+        }
+
+        free( pVarTab->entries );
+        pVarTab->entries = NULL;
+        pVarTab->size = 0;
+        pVarTab->count = 0;
+        pVarTab->textBytes = 0;
+    }
+}
+
+/*============================================================================*/
+/*  KeyHash                                                                   */
+/*!
+    Hash a variable handle and instance identifier
+
+    @param[in]
+        hVar
+            handle of the variable
+
+    @param[in]
+        instanceID
+            instance identifier of the variable
+
+    @retval hash of the handle and instance identifier
+
+==============================================================================*/
+static uint64_t KeyHash( VAR_HANDLE hVar, uint32_t instanceID )
+{
+    uint64_t h = ( (uint64_t)hVar << 32 ) | instanceID;
+
+    /* mix the bits so consecutive handles spread across the table */
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+
+    return h;
+}
+
+/*============================================================================*/
+/*  FindSlot                                                                  */
+/*!
+    Find the table slot for a variable
+
+    The FindSlot function returns the slot which holds the specified
+    variable, or the empty slot where the variable should be inserted.
+
+    @param[in]
+        entries
+            pointer to the array of table slots
+
+    @param[in]
+        size
+            number of table slots (a power of two)
+
+    @param[in]
+        hVar
+            handle of the variable
+
+    @param[in]
+        instanceID
+            instance identifier of the variable
+
+    @retval pointer to the slot for the variable
+
+==============================================================================*/
+static VarTabEntry *FindSlot( VarTabEntry *entries,
+                              size_t size,
+                              VAR_HANDLE hVar,
+                              uint32_t instanceID )
+{
+    size_t mask = size - 1;
+    size_t idx = (size_t)KeyHash( hVar, instanceID ) & mask;
+
+    while ( entries[idx].hVar != VAR_INVALID )
+    {
+        if ( ( entries[idx].hVar == hVar ) &&
+             ( entries[idx].instanceID == instanceID ) )
+        {
+            break;
+        }
+
+        idx = ( idx + 1 ) & mask;
+    }
+
+    return &entries[idx];
+}
+
+/*============================================================================*/
+/*  SetKey                                                                    */
+/*!
+    Format the key text of a table entry
+
+    The SetKey function formats the "name=" or "[id]name=" key text of
+    the entry, and discards its saved value.
+
+    @param[in,out]
+        pVarTab
+            pointer to the saved variable table
+
+    @param[in,out]
+        pEntry
+            pointer to the table entry
+
+    @param[in]
+        instanceID
+            instance identifier of the variable
+
+    @param[in]
+        name
+            name of the variable
+
+    @param[in]
+        namelen
+            length of the variable name
+
+    @retval EOK - success
+    @retval E2BIG - the variable name is too long
+    @retval ENOMEM - memory allocation failed
+
+==============================================================================*/
+static int SetKey( VarTab *pVarTab,
+                   VarTabEntry *pEntry,
+                   uint32_t instanceID,
+                   const char *name,
+                   size_t namelen )
+{
+    int result = E2BIG;
+    char id[VARFMT_MAX_LEN + 2];
+    size_t idlen = 0;
+
+    if ( instanceID != 0 )
+    {
+        id[0] = '[';
+        idlen = 1 + VARFMT_Unsigned( &id[1], instanceID );
+        id[idlen++] = ']';
+    }
+
+    if ( namelen <= UINT32_MAX - VARTAB_MAX_VALUE_SIZE - sizeof id )
+    {
+        pEntry->keylen = 0;
+        pEntry->saved = false;
+
+        result = ( Reserve( pVarTab, pEntry, idlen + namelen ) == true )
+                    ? EOK
+                    : ENOMEM;
+        if ( result == EOK )
+        {
+            memcpy( pEntry->text, id, idlen );
+            memcpy( &pEntry->text[idlen], name, namelen );
+            pEntry->text[idlen + namelen] = '=';
+            pEntry->keylen = (uint32_t)( idlen + namelen );
+            pEntry->namelen = (uint32_t)namelen;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Reserve                                                                   */
+/*!
+    Ensure the text buffer of an entry can hold a value after its key
+
+    The text buffer is grown in multiples of VARTAB_TEXT_ALIGN bytes.
+
+    @param[in,out]
+        pVarTab
+            pointer to the saved variable table
+
+    @param[in,out]
+        pEntry
+            pointer to the table entry
+
+    @param[in]
+        len
+            length of the text to hold after the key and '='
+
+    @retval true - the text buffer is large enough
+    @retval false - memory allocation failed
+
+==============================================================================*/
+static bool Reserve( VarTab *pVarTab, VarTabEntry *pEntry, size_t len )
+{
+    bool result = true;
+    size_t size = pEntry->keylen + 1 + len;
+    char *text;
+
+    if ( size > pEntry->textSize )
+    {
+        size = ( size + VARTAB_TEXT_ALIGN - 1 ) & ~( VARTAB_TEXT_ALIGN - 1 );
+        text = realloc( pEntry->text, size );
+        if ( text != NULL )
+        {
+            pVarTab->textBytes += size - pEntry->textSize;
+            pEntry->text = text;
+            pEntry->textSize = (uint32_t)size;
+        }
+        else
+        {
+            result = false;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Grow                                                                      */
+/*!
+    Double the size of a saved variable table
+
+    @param[in,out]
+        pVarTab
+            pointer to the saved variable table
+
+    @retval EOK - success
+    @retval ENOMEM - memory allocation failed
+
+==============================================================================*/
+static int Grow( VarTab *pVarTab )
+{
+    int result = ENOMEM;
+    VarTabEntry *entries;
+    VarTabEntry *pEntry;
+    size_t size;
+    size_t i;
+
+    size = pVarTab->size * 2;
+    entries = calloc( size, sizeof( VarTabEntry ) );
+    if ( entries != NULL )
+    {
+        for ( i = 0; i < pVarTab->size; i++ )
+        {
+            if ( pVarTab->entries[i].hVar != VAR_INVALID )
+            {
+                pEntry = FindSlot( entries,
+                                   size,
+                                   pVarTab->entries[i].hVar,
+                                   pVarTab->entries[i].instanceID );
+                *pEntry = pVarTab->entries[i];
+            }
+        }
+
+        free( pVarTab->entries );
+        pVarTab->entries = entries;
+        pVarTab->size = size;
+        result = EOK;
+    }
+
+    return result;
+}
+
+/*! @}
+ * end of vartab group */
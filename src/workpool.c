@@ -0,0 +1,334 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup workpool Work Pool
+ * @brief Small pool of worker threads for the Save Service
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file workpool.c
+
+    Work Pool
+
+    The Work Pool runs a batch of independent work items across a
+    fixed set of persistent worker threads.  The calling thread takes
+    part in the work too, so a pool with no worker threads simply
+    performs every work item on the calling thread.
+
+    Work items are handed out one at a time by index, so a slow item
+    does not hold up the others, and WORKPOOL_Run returns once every
+    work item has been performed.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <varserver/varserver.h>
+#include "workpool.h"
+
+/*==============================================================================
+       Function declarations
+==============================================================================*/
+static void *WorkerThread( void *arg );
+static void PerformWork( WorkPool *pPool );
+
+/*==============================================================================
+       Function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  WORKPOOL_Init                                                             */
+/*!
+    Initialize a work pool
+
+    The WORKPOOL_Init function starts the worker threads of a work pool.
+
+    @param[in,out]
+        pPool
+            pointer to the work pool to initialize
+
+    @param[in]
+        nthreads
+            number of worker threads in addition to the calling thread
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+    @retval ENOMEM - memory allocation failed
+    @retval other error from pthread_create()
+
+==============================================================================*/
+int WORKPOOL_Init( WorkPool *pPool, size_t nthreads )
+{
+    int result = EINVAL;
+    size_t i;
+
+    if ( pPool != NULL )
+    {
+        memset( pPool, 0, sizeof( WorkPool ) );
+        pthread_mutex_init( &pPool->lock, NULL );
+        pthread_cond_init( &pPool->start, NULL );
+        pthread_cond_init( &pPool->done, NULL );
+        result = EOK;
+
+        if ( nthreads > 0 )
+        {
+            pPool->threads = calloc( nthreads, sizeof( pthread_t ) );
+            if ( pPool->threads == NULL )
+            {
+                result = ENOMEM;
+            }
+        }
+
+        for ( i = 0; ( i < nthreads ) && ( result == EOK ); i++ )
+        {
+            result = pthread_create( &pPool->threads[i],
+                                     NULL,
+                                     WorkerThread,
+                                     pPool );
+            if ( result == EOK )
+            {
+                pPool->nthreads++;
+            }
+        }
+
+        if ( result != EOK )
+        {
+            WORKPOOL_Free( pPool );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  WORKPOOL_Run                                                              */
+/*!
+    Perform a batch of work items
+
+    The WORKPOOL_Run function calls the work item function once for
+    each work item index, spread across the worker threads and the
+    calling thread, and waits for all of the work items to be performed.
+
+    @param[in,out]
+        pPool
+            pointer to the work pool
+
+    @param[in]
+        fn
+            work item function
+
+    @param[in]
+        arg
+            argument passed to the work item function
+
+    @param[in]
+        count
+            number of work items
+
+    @retval EOK - success
+    @retval EINVAL - invalid arguments
+
+==============================================================================*/
+int WORKPOOL_Run( WorkPool *pPool, WorkFn fn, void *arg, size_t count )
+{
+    int result = EINVAL;
+
+    if ( ( pPool != NULL ) &&
+         ( fn != NULL ) )
+    {
+        pthread_mutex_lock( &pPool->lock );
+        pPool->fn = fn;
+        pPool->arg = arg;
+        pPool->count = count;
+        pPool->next = 0;
+
+        /* only wake the worker threads if there is work to share */
+        if ( count > 1 )
+        {
+            pPool->active = pPool->nthreads;
+            pPool->generation++;
+            pthread_cond_broadcast( &pPool->start );
+        }
+
+        pthread_mutex_unlock( &pPool->lock );
+
+        PerformWork( pPool );
+
+        /* wait for the worker threads to finish their work items */
+        pthread_mutex_lock( &pPool->lock );
+        while ( pPool->active > 0 )
+        {
+            pthread_cond_wait( &pPool->done, &pPool->lock );
+        }
+
+        pthread_mutex_unlock( &pPool->lock );
+
+        result = EOK;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  WORKPOOL_Free                                                             */
+/*!
+    Stop the worker threads of a work pool
+
+    @param[in,out]
+        pPool
+            pointer to the work pool
+
+    @return none
+
+==============================================================================*/
+void WORKPOOL_Free( WorkPool *pPool )
+{
+    size_t i;
+
+    if ( pPool != NULL )
+    {
+        pthread_mutex_lock( &pPool->lock );
+        pPool->stop = true;
+        pthread_cond_broadcast( &pPool->start );
+        pthread_mutex_unlock( &pPool->lock );
+
+        for ( i = 0; i < pPool->nthreads; i++ )
+        {
+            pthread_join( pPool->threads[i], NULL );
+        }
+
+        free( pPool->threads );
+        pPool->threads = NULL;
+        pPool->nthreads = 0;
+
+        pthread_cond_destroy( &pPool->done );
+        pthread_cond_destroy( &pPool->start );
+        pthread_mutex_destroy( &pPool->lock );
+    }
+}
+
+/*============================================================================*/
+/*  WorkerThread                                                              */
+/*!
+    Work pool worker thread
+
+    The WorkerThread function waits for work to be started, and
+    performs work items until none remain.  Signals are blocked so
+    they are only received by the service thread.
+
+    @param[in]
+        arg
+            pointer to the work pool
+
+    @retval NULL
+
+==============================================================================*/
+static void *WorkerThread( void *arg )
+{
+    WorkPool *pPool = (WorkPool *)arg;
+    uint64_t generation = 0;
+    sigset_t mask;
+
+    sigfillset( &mask );
+    pthread_sigmask( SIG_BLOCK, &mask, NULL );
+
+    pthread_mutex_lock( &pPool->lock );
+
+    while ( pPool->stop == false )
+    {
+        if ( pPool->generation == generation )
+        {
+            pthread_cond_wait( &pPool->start, &pPool->lock );
+        }
+        else
+        {
+            generation = pPool->generation;
+            pthread_mutex_unlock( &pPool->lock );
+
+            PerformWork( pPool );
+
+            pthread_mutex_lock( &pPool->lock );
+            if ( --pPool->active == 0 )
+            {
+                pthread_cond_signal( &pPool->done );
+            }
+        }
+    }
+
+    pthread_mutex_unlock( &pPool->lock );
+
+    return NULL;
+}
+
+/*============================================================================*/
+/*  PerformWork                                                               */
+/*!
+    Perform work items until none remain
+
+    @param[in,out]
+        pPool
+            pointer to the work pool
+
+    @return none
+
+==============================================================================*/
+static void PerformWork( WorkPool *pPool )
+{
+    size_t idx = 0;
+    bool more = true;
+
+    while ( more == true )
+    {
+        pthread_mutex_lock( &pPool->lock );
+        idx = pPool->next;
+        more = ( idx < pPool->count );
+        if ( more == true )
+        {
+            pPool->next++;
+        }
+
+        pthread_mutex_unlock( &pPool->lock );
+
+        if ( more == true )
+        {
+            pPool->fn( pPool->arg, idx );
+        }
+    }
+}
+
+/*! @}
+ * end of workpool group */
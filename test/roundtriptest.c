@@ -0,0 +1,874 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup roundtriptest Configuration Round Trip Test
+ * @brief Binary to text to restore round trip test
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file roundtriptest.c
+
+    Configuration Round Trip Test
+
+    The Configuration Round Trip Test captures the variables of the mock
+    variable server into a binary configuration file, converts it to
+    text as savecvt does, and restores both files with the restore
+    parser used by saverestore.  Every variable must come back with
+    the value it was saved with.
+
+    It also restores hand written files covering "[id]name=value"
+    keys, empty values, a missing trailing newline, journals with a
+    matching and a mismatched base hash, and truncated and corrupt
+    binary files.
+
+    The test exits with a non-zero status if any check fails.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <varserver/varserver.h>
+#include <varserver/varquery.h>
+#include "savesvc.h"
+#include "restore.h"
+#include "mockvarserver.h"
+
+/*==============================================================================
+       Definitions
+==============================================================================*/
+
+/*! number of mock variables */
+#define TEST_VARS ( 64 )
+
+/*! size of the text of a variable value */
+#define VALUE_TEXT_SIZE ( 128 )
+
+/*! index of a string variable with instance identifier 3 */
+#define VAR_STR_ID3 ( 7 )
+
+/*! index of a string variable with instance identifier 1 */
+#define VAR_STR_ID1 ( 15 )
+
+/*! index of a string variable with instance identifier 4 */
+#define VAR_STR_ID4 ( 23 )
+
+/*! index of an INT16 variable without an instance identifier */
+#define VAR_INT16 ( 1 )
+
+/*! index of a FLOAT variable without an instance identifier */
+#define VAR_FLOAT ( 6 )
+
+/*==============================================================================
+       Type Definitions
+==============================================================================*/
+
+/*! text of the value of every mock variable */
+typedef struct _testValues
+{
+    /*! value text of each variable */
+    char text[TEST_VARS][VALUE_TEXT_SIZE];
+
+} TestValues;
+
+/*==============================================================================
+       Function declarations
+==============================================================================*/
+static size_t TestRoundTrip( void );
+static size_t TestText( void );
+static size_t TestJournal( void );
+static size_t TestCorrupt( void );
+static int WriteBinary( const char *filename );
+static int Convert( const char *input, const char *output, uint64_t *hash );
+static int Restore( const char *first, const char *second, uint64_t *failed );
+static int WriteFile( const char *filename, const void *data, size_t len );
+static int GetValues( TestValues *pValues );
+static int SetString( size_t idx, const char *value );
+static size_t Compare( const char *test, TestValues *pExpected );
+static size_t Check( const char *test, bool ok );
+
+/*==============================================================================
+      File Scoped Variables
+==============================================================================*/
+
+/*! test directory */
+static char dir[] = "/tmp/roundtripXXXXXX";
+
+/*! binary configuration file */
+static char binfile[sizeof dir + 16];
+
+/*! text configuration file converted from the binary file */
+static char textfile[sizeof dir + 16];
+
+/*! hand written test file */
+static char testfile[sizeof dir + 16];
+
+/*! journal file */
+static char journalfile[sizeof dir + 16];
+
+/*! values of the freshly initialized mock variables */
+static TestValues initial;
+
+/*! values of the mock variables when they were saved */
+static TestValues saved;
+
+/*==============================================================================
+       Function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  main                                                                      */
+/*!
+    Main entry point for the configuration round trip test
+
+    @retval 0 - all checks passed
+    @retval 1 - at least one check failed
+
+==============================================================================*/
+int main( void )
+{
+    size_t failures = 0;
+
+    if ( mkdtemp( dir ) == NULL )
+    {
+        fprintf( stderr,
+                 "Cannot create test directory: %s\n",
+                 strerror( errno ) );
+        failures++;
+    }
+    else
+    {
+        snprintf( binfile, sizeof binfile, "%s/config.bin", dir );
+        snprintf( textfile, sizeof textfile, "%s/config.txt", dir );
+        snprintf( testfile, sizeof testfile, "%s/test.txt", dir );
+        snprintf( journalfile, sizeof journalfile, "%s/journal.txt", dir );
+
+        if ( ( MOCKVARSERVER_Init( TEST_VARS ) != EOK ) ||
+             ( GetValues( &initial ) != EOK ) )
+        {
+            fprintf( stderr, "Cannot initialize the mock variables\n" );
+            failures++;
+        }
+        else
+        {
+            failures += TestRoundTrip();
+            failures += TestText();
+            failures += TestJournal();
+            failures += TestCorrupt();
+        }
+
+        (void)unlink( binfile );
+        (void)unlink( textfile );
+        (void)unlink( testfile );
+        (void)unlink( journalfile );
+        (void)rmdir( dir );
+    }
+
+    MOCKVARSERVER_Free();
+
+    if ( failures > 0 )
+    {
+        printf( "roundtriptest: %zu checks failed\n", failures );
+    }
+    else
+    {
+        printf( "roundtriptest: passed\n" );
+    }
+
+    return ( failures > 0 ) ? 1 : 0;
+}
+
+/*============================================================================*/
+/*  TestRoundTrip                                                             */
+/*!
+    Save, convert, and restore the mock variables
+
+    The variables are modified, including an empty string value and a
+    value containing '=', and saved to a binary file which is converted
+    to text.  Each file is restored into freshly initialized variables,
+    which must then match the saved values.
+
+    @retval number of failed checks
+
+==============================================================================*/
+static size_t TestRoundTrip( void )
+{
+    size_t failures = 0;
+    TestValues restored;
+    uint64_t failed = 0;
+    uint64_t hash;
+    size_t changed = 0;
+    size_t i;
+
+    MOCKVARSERVER_Modify( TEST_VARS * 3 );
+    failures += Check( "set empty value",
+                       SetString( VAR_STR_ID3, "" ) == EOK );
+    failures += Check( "set value containing '='",
+                       SetString( VAR_STR_ID4, "a=b" ) == EOK );
+    failures += Check( "get saved values", GetValues( &saved ) == EOK );
+
+    /* every variable must be restored for the comparisons to pass */
+    for ( i = 0; i < TEST_VARS; i++ )
+    {
+        if ( strcmp( saved.text[i], initial.text[i] ) != 0 )
+        {
+            changed++;
+        }
+    }
+
+    failures += Check( "modify every variable", changed == TEST_VARS );
+
+    failures += Check( "write binary", WriteBinary( binfile ) == EOK );
+    failures += Check( "convert binary",
+                       Convert( binfile, textfile, &hash ) == EOK );
+
+    /* the converted text restores the saved values */
+    (void)MOCKVARSERVER_Init( TEST_VARS );
+    failures += Check( "restore text",
+                       ( Restore( textfile, NULL, &failed ) == EOK ) &&
+                       ( failed == 0 ) );
+    failures += Compare( "restore text", &saved );
+
+    /* so does the binary file itself */
+    (void)MOCKVARSERVER_Init( TEST_VARS );
+    failures += Check( "restore binary",
+                       ( Restore( binfile, NULL, &failed ) == EOK ) &&
+                       ( failed == 0 ) );
+    failures += Compare( "restore binary", &saved );
+
+    /* restoring text over text gives the same values */
+    failures += Check( "get restored values", GetValues( &restored ) == EOK );
+    failures += Check( "restore twice",
+                       ( Restore( textfile, textfile, &failed ) == EOK ) &&
+                       ( failed == 0 ) );
+    failures += Compare( "restore twice", &restored );
+
+    return failures;
+}
+
+/*============================================================================*/
+/*  TestText                                                                  */
+/*!
+    Restore a hand written text file
+
+    The file has "[id]name=value" keys, an empty value, a CRLF line,
+    comments, and a last line without a trailing newline.  A key with
+    the wrong instance identifier is not restored.
+
+    @retval number of failed checks
+
+==============================================================================*/
+static size_t TestText( void )
+{
+    static const char text[] =
+        CONFIG_TITLE
+        "# comment\n"
+        "\n"
+        "[3]/bench/group0/var7=\n"
+        "/bench/group0/var1=-42\r\n"
+        "/bench/group0/var6=2.500000\n"
+        "[9]/bench/group0/var7=wrong instance\n"
+        "[1]/bench/group0/var15=no newline";
+    size_t failures = 0;
+    TestValues expected;
+    uint64_t failed = 0;
+
+    /* the previous test left a non-empty value in the variable */
+    (void)MOCKVARSERVER_Init( TEST_VARS );
+    (void)SetString( VAR_STR_ID3, "not empty" );
+
+    expected = initial;
+    expected.text[VAR_STR_ID3][0] = '\0';
+    strcpy( expected.text[VAR_INT16], "-42" );
+    strcpy( expected.text[VAR_FLOAT], "2.500000" );
+    strcpy( expected.text[VAR_STR_ID1], "no newline" );
+
+    failures += Check( "write text", WriteFile( testfile,
+                                                text,
+                                                sizeof( text ) - 1 ) == EOK );
+    failures += Check( "restore hand written text",
+                       ( Restore( testfile, NULL, &failed ) == EOK ) &&
+                       ( failed == 1 ) );
+    failures += Compare( "restore hand written text", &expected );
+
+    return failures;
+}
+
+/*============================================================================*/
+/*  TestJournal                                                               */
+/*!
+    Restore a configuration file followed by its journal
+
+    A journal whose base hash matches the configuration file is replayed
+    over it.  A journal with a mismatched base hash is ignored.
+
+    @retval number of failed checks
+
+==============================================================================*/
+static size_t TestJournal( void )
+{
+    size_t failures = 0;
+    TestValues expected;
+    char text[256];
+    uint64_t failed = 0;
+    uint64_t hash = 0;
+    int n;
+
+    failures += Check( "convert for journal",
+                       Convert( binfile, textfile, &hash ) == EOK );
+
+    /* a journal based on the configuration file is replayed */
+    n = snprintf( text,
+                  sizeof text,
+                  CONFIG_TITLE JOURNAL_BASE_COMMENT "%016" PRIx64 "\n\n"
+                  "/bench/group0/var1=7\n",
+                  hash );
+    failures += Check( "write journal",
+                       WriteFile( journalfile, text, (size_t)n ) == EOK );
+
+    expected = saved;
+    strcpy( expected.text[VAR_INT16], "7" );
+
+    (void)MOCKVARSERVER_Init( TEST_VARS );
+    failures += Check( "restore journal",
+                       ( Restore( textfile, journalfile, &failed ) == EOK ) &&
+                       ( failed == 0 ) );
+    failures += Compare( "restore journal", &expected );
+
+    /* a journal based on another configuration file is ignored */
+    n = snprintf( text,
+                  sizeof text,
+                  CONFIG_TITLE JOURNAL_BASE_COMMENT "%016" PRIx64 "\n\n"
+                  "/bench/group0/var1=7\n",
+                  hash ^ 1 );
+    failures += Check( "write stale journal",
+                       WriteFile( journalfile, text, (size_t)n ) == EOK );
+
+    (void)MOCKVARSERVER_Init( TEST_VARS );
+    failures += Check( "restore stale journal",
+                       ( Restore( textfile, journalfile, &failed ) == EOK ) &&
+                       ( failed == 0 ) );
+    failures += Compare( "restore stale journal", &saved );
+
+    return failures;
+}
+
+/*============================================================================*/
+/*  TestCorrupt                                                               */
+/*!
+    Reject truncated and corrupt binary files
+
+    Neither the conversion nor the restore may accept a binary file
+    whose records are truncated or whose header checksum is corrupt,
+    and no variable may be restored from one.  A file truncated within
+    its header is not recognized as binary, and fails to restore as
+    text.
+
+    @retval number of failed checks
+
+==============================================================================*/
+static size_t TestCorrupt( void )
+{
+    size_t failures = 0;
+    SaveFmtHeader header;
+    char data[4096];
+    uint64_t failed = 0;
+    uint64_t hash;
+    ssize_t n = -1;
+    size_t len = 0;
+    int rc;
+    int fd;
+
+    failures += Check( "write binary for corruption",
+                       WriteBinary( binfile ) == EOK );
+
+    fd = open( binfile, O_RDONLY );
+    if ( fd != -1 )
+    {
+        n = read( fd, data, sizeof data );
+        close( fd );
+    }
+
+    failures += Check( "read binary",
+                       ( n > 0 ) && ( (size_t)n < sizeof data ) &&
+                       ( (size_t)n > sizeof header ) );
+    if ( failures == 0 )
+    {
+        len = (size_t)n;
+
+        /* records truncated after the header */
+        failures += Check( "write truncated records",
+                           WriteFile( testfile,
+                                      data,
+                                      sizeof header + 8 ) == EOK );
+        failures += Check( "convert truncated records",
+                           Convert( testfile, textfile, &hash ) != EOK );
+        (void)MOCKVARSERVER_Init( TEST_VARS );
+        failures += Check( "restore truncated records",
+                           Restore( testfile, NULL, &failed ) != EOK );
+        failures += Compare( "restore truncated records", &initial );
+
+        /* header truncated before the record count */
+        failures += Check( "write truncated header",
+                           WriteFile( testfile, data, 8 ) == EOK );
+        failures += Check( "convert truncated header",
+                           Convert( testfile, textfile, &hash ) != EOK );
+        (void)MOCKVARSERVER_Init( TEST_VARS );
+        rc = Restore( testfile, NULL, &failed );
+        failures += Check( "restore truncated header",
+                           ( rc != EOK ) || ( failed > 0 ) );
+        failures += Compare( "restore truncated header", &initial );
+
+        /* corrupt record checksum in the header */
+        memcpy( &header, data, sizeof header );
+        header.checksum ^= 1;
+        memcpy( data, &header, sizeof header );
+        failures += Check( "write corrupt header",
+                           WriteFile( testfile, data, len ) == EOK );
+        failures += Check( "convert corrupt header",
+                           Convert( testfile, textfile, &hash ) != EOK );
+        (void)MOCKVARSERVER_Init( TEST_VARS );
+        failures += Check( "restore corrupt header",
+                           Restore( testfile, NULL, &failed ) != EOK );
+        failures += Compare( "restore corrupt header", &initial );
+    }
+
+    return failures;
+}
+
+/*============================================================================*/
+/*  WriteBinary                                                               */
+/*!
+    Save the mock variables to a binary configuration file
+
+    The variables are captured into a snapshot and written with the
+    binary format writer, as savesvc -F binary does.
+
+    @param[in]
+        filename
+            name of the binary configuration file
+
+    @retval EOK - success
+    @retval other error from capturing or writing the variables
+
+==============================================================================*/
+static int WriteBinary( const char *filename )
+{
+    int result;
+    SaveFmtWriter writer;
+    SnapshotRecord *pRecord;
+    Snapshot snapshot;
+    VarQuery query;
+    OutBuf out;
+    int fd;
+
+    memset( &snapshot, 0, sizeof snapshot );
+    memset( &out, 0, sizeof out );
+    memset( &query, 0, sizeof query );
+
+    query.type = QUERY_FLAGS;
+    query.flags = VARFLAG_DIRTY;
+
+    result = SNAPSHOT_Init( &snapshot, SNAPSHOT_DEFAULT_SIZE );
+    if ( result == EOK )
+    {
+        result = SNAPSHOT_Capture( &snapshot,
+                                   VARSERVER_Open(),
+                                   &query,
+                                   SNAPSHOT_DEFAULT_BATCH_SIZE );
+    }
+
+    if ( result == EOK )
+    {
+        result = OUTBUF_Init( &out, OUTBUF_DEFAULT_SIZE );
+    }
+
+    if ( result == EOK )
+    {
+        fd = open( filename, O_CREAT | O_TRUNC | O_WRONLY, 0644 );
+        if ( fd == -1 )
+        {
+            result = errno;
+        }
+        else
+        {
+            OUTBUF_Attach( &out, fd );
+            result = SAVEFMT_Begin( &writer, &out );
+
+            pRecord = SNAPSHOT_First( &snapshot );
+            while ( ( result == EOK ) && ( pRecord != NULL ) )
+            {
+                result = SAVEFMT_Write( &writer, pRecord );
+                pRecord = SNAPSHOT_Next( &snapshot, pRecord );
+            }
+
+            if ( result == EOK )
+            {
+                result = OUTBUF_Flush( &out );
+            }
+
+            if ( result == EOK )
+            {
+                result = SAVEFMT_End( &writer, fd );
+            }
+
+            close( fd );
+        }
+    }
+
+    OUTBUF_Free( &out );
+    SNAPSHOT_Free( &snapshot );
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Convert                                                                   */
+/*!
+    Convert a binary configuration file to text
+
+    The binary file is loaded and written out in the text format with
+    the same calls savecvt makes, and committed atomically.
+
+    @param[in]
+        input
+            name of the binary configuration file
+
+    @param[in]
+        output
+            name of the text configuration file
+
+    @param[out]
+        hash
+            pointer to the location to store the hash of the text file,
+            as recorded in the header of a journal based on it
+
+    @retval EOK - success
+    @retval other error from loading or converting the file
+
+==============================================================================*/
+static int Convert( const char *input, const char *output, uint64_t *hash )
+{
+    int result;
+    SaveSvcState state;
+    Snapshot snapshot;
+
+    memset( &state, 0, sizeof state );
+    memset( &snapshot, 0, sizeof snapshot );
+    state.fd = -1;
+    state.format = FORMAT_TEXT;
+    state.bufsize = OUTBUF_DEFAULT_SIZE;
+    state.durability = DURABILITY_NONE;
+    state.filename = (char *)output;
+
+    result = OUTBUF_Init( &state.out, state.bufsize );
+    if ( result == EOK )
+    {
+        result = SNAPSHOT_Init( &snapshot, SNAPSHOT_DEFAULT_SIZE );
+    }
+
+    if ( result == EOK )
+    {
+        result = SAVEFMT_Load( input, &snapshot );
+    }
+
+    if ( result == EOK )
+    {
+        result = InitConfig( &state );
+        if ( result == EOK )
+        {
+            result = WriteConfig( &state, &snapshot );
+            if ( result == EOK )
+            {
+                *hash = state.out.hash;
+                result = FinalizeConfig( &state );
+            }
+
+            if ( result != EOK )
+            {
+                DiscardConfig( &state );
+            }
+        }
+    }
+
+    OUTBUF_Free( &state.out );
+    ARENA_Free( &state.arena );
+    VARTAB_Free( &state.saved );
+    SNAPSHOT_Free( &snapshot );
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Restore                                                                   */
+/*!
+    Restore one or two configuration files into the mock variables
+
+    The files are restored in order, as saverestore does.
+
+    @param[in]
+        first
+            name of the first file
+
+    @param[in]
+        second
+            name of the file restored after it, or NULL
+
+    @param[out]
+        failed
+            pointer to the location to store the number of variables
+            which could not be restored
+
+    @retval EOK - success
+    @retval other error from the first file which could not be restored
+
+==============================================================================*/
+static int Restore( const char *first, const char *second, uint64_t *failed )
+{
+    int result;
+    RestoreState state;
+    int rc;
+
+    memset( &state, 0, sizeof state );
+    state.batchsize = RESTORE_DEFAULT_BATCH_SIZE;
+
+    result = RESTORE_Init( &state, VARSERVER_Open() );
+    if ( result == EOK )
+    {
+        result = RESTORE_File( &state, first );
+        if ( second != NULL )
+        {
+            rc = RESTORE_File( &state, second );
+            if ( result == EOK )
+            {
+                result = rc;
+            }
+        }
+    }
+
+    *failed = state.failed;
+
+    RESTORE_Free( &state );
+
+    return result;
+}
+
+/*============================================================================*/
+/*  WriteFile                                                                 */
+/*!
+    Write a test file
+
+    @param[in]
+        filename
+            name of the file
+
+    @param[in]
+        data
+            pointer to the file content
+
+    @param[in]
+        len
+            length of the file content
+
+    @retval EOK - success
+    @retval other error from open() or write()
+
+==============================================================================*/
+static int WriteFile( const char *filename, const void *data, size_t len )
+{
+    int result = EOK;
+    int fd;
+
+    fd = open( filename, O_CREAT | O_TRUNC | O_WRONLY, 0644 );
+    if ( fd == -1 )
+    {
+        result = errno;
+    }
+    else
+    {
+        if ( write( fd, data, len ) != (ssize_t)len )
+        {
+            result = EIO;
+        }
+
+        close( fd );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  GetValues                                                                 */
+/*!
+    Get the value text of every mock variable
+
+    @param[out]
+        pValues
+            pointer to the values to populate
+
+    @retval EOK - success
+    @retval other error from VAR_Get() or VAROBJECT_ToString()
+
+==============================================================================*/
+static int GetValues( TestValues *pValues )
+{
+    int result = EOK;
+    VARSERVER_HANDLE hVarServer = VARSERVER_Open();
+    char buf[VALUE_TEXT_SIZE];
+    VarObject obj;
+    size_t i;
+
+    for ( i = 0; ( i < TEST_VARS ) && ( result == EOK ); i++ )
+    {
+        obj.val.str = buf;
+        obj.len = sizeof buf;
+
+        result = VAR_Get( hVarServer, (VAR_HANDLE)( i + 1 ), &obj );
+        if ( result == EOK )
+        {
+            result = VAROBJECT_ToString( &obj,
+                                         pValues->text[i],
+                                         sizeof pValues->text[i] );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  SetString                                                                 */
+/*!
+    Set the value of a mock string variable
+
+    @param[in]
+        idx
+            index of the string variable
+
+    @param[in]
+        value
+            value to set
+
+    @retval EOK - success
+    @retval other error from VAR_Set()
+
+==============================================================================*/
+static int SetString( size_t idx, const char *value )
+{
+    VarObject obj;
+
+    obj.type = VARTYPE_STR;
+    obj.val.str = (char *)value;
+    obj.len = strlen( value ) + 1;
+
+    return VAR_Set( VARSERVER_Open(), (VAR_HANDLE)( idx + 1 ), &obj );
+}
+
+/*============================================================================*/
+/*  Compare                                                                   */
+/*!
+    Compare the mock variables with their expected values
+
+    @param[in]
+        test
+            name of the test
+
+    @param[in]
+        pExpected
+            pointer to the expected values
+
+    @retval number of variables which do not have their expected value
+
+==============================================================================*/
+static size_t Compare( const char *test, TestValues *pExpected )
+{
+    size_t failures = 0;
+    TestValues actual;
+    size_t i;
+
+    if ( GetValues( &actual ) != EOK )
+    {
+        printf( "%s: cannot get the variable values\n", test );
+        failures++;
+    }
+    else
+    {
+        for ( i = 0; i < TEST_VARS; i++ )
+        {
+            if ( strcmp( actual.text[i], pExpected->text[i] ) != 0 )
+            {
+                printf( "%s: var%zu is \"%s\", expected \"%s\"\n",
+                        test,
+                        i,
+                        actual.text[i],
+                        pExpected->text[i] );
+                failures++;
+            }
+        }
+    }
+
+    return failures;
+}
+
+/*============================================================================*/
+/*  Check                                                                     */
+/*!
+    Report a failed check
+
+    @param[in]
+        test
+            name of the check
+
+    @param[in]
+        ok
+            result of the check
+
+    @retval 0 - the check passed
+    @retval 1 - the check failed
+
+==============================================================================*/
+static size_t Check( const char *test, bool ok )
+{
+    if ( ok == false )
+    {
+        printf( "%s: failed\n", test );
+    }
+
+    return ( ok == true ) ? 0 : 1;
+}
+
+/*! @}
+ * end of roundtriptest group */
@@ -0,0 +1,417 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup varfmttest Value Formatter Test
+ * @brief Value Formatter conformance test
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file varfmttest.c
+
+    Value Formatter Test
+
+    The Value Formatter Test checks that the type specialized value
+    formatters produce the same text as snprintf() with the formats
+    used by VAROBJECT_ToString, so the configuration file does not
+    change when they are used.
+
+    The integer formatters are checked at the type limits and at each
+    change in the number of digits.  The float formatter is checked at
+    rounding boundaries, signed zeros, subnormals, exact ties, and the
+    limit above which values are left to the generic formatter, and
+    then against a sweep of pseudo-random float bit patterns.
+
+    The test exits with a non-zero status if any value differs.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+#include <varserver/varserver.h>
+#include "varfmt.h"
+
+/*==============================================================================
+       Definitions
+==============================================================================*/
+
+/*! number of pseudo-random float bit patterns checked */
+#define RANDOM_FLOATS ( 2000000 )
+
+/*! largest float magnitude expected to be formatted by VARFMT_Float */
+#define FLOAT_LIMIT ( 1e12f )
+
+/*==============================================================================
+       Function declarations
+==============================================================================*/
+static size_t CheckValue( VarType type, VarData *pVal, const char *expected );
+static size_t CheckUnsigned( uint64_t val );
+static size_t CheckSigned( int64_t val );
+static size_t CheckFloat( float val );
+static size_t TestIntegers( void );
+static size_t TestFloats( void );
+static uint32_t NextRandom( uint32_t *pSeed );
+
+/*==============================================================================
+       Function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  main                                                                      */
+/*!
+    Main entry point for the value formatter test
+
+    @retval 0 - all values were formatted correctly
+    @retval 1 - at least one value was formatted incorrectly
+
+==============================================================================*/
+int main( void )
+{
+    size_t failures = 0;
+
+    failures += TestIntegers();
+    failures += TestFloats();
+
+    if ( failures > 0 )
+    {
+        printf( "varfmttest: %zu values formatted incorrectly\n", failures );
+    }
+    else
+    {
+        printf( "varfmttest: passed\n" );
+    }
+
+    return ( failures > 0 ) ? 1 : 0;
+}
+
+/*============================================================================*/
+/*  TestIntegers                                                              */
+/*!
+    Check the integer formatters
+
+    Each integer type is checked at its limits through VARFMT_Value,
+    and the 64 bit formatters are checked on either side of every
+    power of 10.
+
+    @retval number of values formatted incorrectly
+
+==============================================================================*/
+static size_t TestIntegers( void )
+{
+    size_t failures = 0;
+    char expected[VARFMT_MAX_LEN + 1];
+    uint64_t p = 1;
+    VarData val;
+    size_t i;
+
+    val.ui = 0;
+    failures += CheckValue( VARTYPE_UINT16, &val, "0" );
+    val.ui = UINT16_MAX;
+    failures += CheckValue( VARTYPE_UINT16, &val, "65535" );
+    val.i = INT16_MIN;
+    failures += CheckValue( VARTYPE_INT16, &val, "-32768" );
+    val.i = INT16_MAX;
+    failures += CheckValue( VARTYPE_INT16, &val, "32767" );
+    val.ul = UINT32_MAX;
+    failures += CheckValue( VARTYPE_UINT32, &val, "4294967295" );
+    val.l = INT32_MIN;
+    failures += CheckValue( VARTYPE_INT32, &val, "-2147483648" );
+    val.l = INT32_MAX;
+    failures += CheckValue( VARTYPE_INT32, &val, "2147483647" );
+    val.l = -1;
+    failures += CheckValue( VARTYPE_INT32, &val, "-1" );
+    val.ull = UINT64_MAX;
+    snprintf( expected, sizeof expected, "%" PRIu64, val.ull );
+    failures += CheckValue( VARTYPE_UINT64, &val, expected );
+    val.ll = INT64_MIN;
+    snprintf( expected, sizeof expected, "%" PRId64, val.ll );
+    failures += CheckValue( VARTYPE_INT64, &val, expected );
+    val.ll = INT64_MAX;
+    snprintf( expected, sizeof expected, "%" PRId64, val.ll );
+    failures += CheckValue( VARTYPE_INT64, &val, expected );
+
+    /* each change in the number of digits */
+    for ( i = 0; i < 20; i++ )
+    {
+        failures += CheckUnsigned( p - 1 );
+        failures += CheckUnsigned( p );
+        failures += CheckUnsigned( p + 1 );
+        if ( p <= (uint64_t)INT64_MAX )
+        {
+            failures += CheckSigned( -(int64_t)( p - 1 ) );
+            failures += CheckSigned( (int64_t)p );
+            failures += CheckSigned( -(int64_t)p );
+        }
+
+        if ( i < 19 )
+        {
+            p *= 10;
+        }
+    }
+
+    failures += CheckUnsigned( UINT64_MAX );
+    failures += CheckSigned( INT64_MIN );
+
+    return failures;
+}
+
+/*============================================================================*/
+/*  TestFloats                                                                */
+/*!
+    Check the float formatter
+
+    @retval number of values formatted incorrectly
+
+==============================================================================*/
+static size_t TestFloats( void )
+{
+    static const float values[] =
+    {
+        0.0f,
+        -0.0f,
+        1.0f,
+        -1.0f,
+        0.0000005f,
+        -0.0000005f,
+        0.0000004999f,
+        0.0000015f,
+        0.1f,
+        0.5f,
+        123.456789f,
+        -123.456789f,
+        16777216.0f,
+        16777217.0f,
+        999999.9999995f,
+        999999930368.0f,
+        -999999930368.0f,
+        FLT_MIN,
+        -FLT_MIN,
+        FLT_TRUE_MIN,
+        -FLT_TRUE_MIN,
+        FLT_MIN / 3.0f,
+        FLT_EPSILON
+    };
+    static const float generic[] =
+    {
+        FLOAT_LIMIT,
+        -FLOAT_LIMIT,
+        1e20f,
+        FLT_MAX,
+        -FLT_MAX,
+        INFINITY,
+        -INFINITY,
+        NAN
+    };
+    size_t failures = 0;
+    char buf[VARFMT_MAX_LEN];
+    uint32_t seed = 1;
+    uint32_t bits;
+    float f;
+    size_t i;
+
+    for ( i = 0; i < sizeof( values ) / sizeof( values[0] ); i++ )
+    {
+        failures += CheckFloat( values[i] );
+    }
+
+    /* large values, infinities and NaNs are left to the generic
+       formatter */
+    for ( i = 0; i < sizeof( generic ) / sizeof( generic[0] ); i++ )
+    {
+        if ( VARFMT_Float( buf, generic[i] ) != 0 )
+        {
+            printf( "VARFMT_Float formatted %g\n", (double)generic[i] );
+            failures++;
+        }
+    }
+
+    /* multiples of 1/128 scaled by 10^6 end in exactly .5 when the
+       multiple is odd, so they round as ties */
+    for ( i = 0; i < 1000000; i++ )
+    {
+        failures += CheckFloat( (float)i / 128.0f );
+        failures += CheckFloat( -(float)i / 128.0f );
+    }
+
+    /* pseudo-random bit patterns across the whole float range */
+    for ( i = 0; i < RANDOM_FLOATS; i++ )
+    {
+        bits = NextRandom( &seed );
+        memcpy( &f, &bits, sizeof( f ) );
+        if ( ( isfinite( f ) ) && ( fabsf( f ) < FLOAT_LIMIT ) )
+        {
+            failures += CheckFloat( f );
+        }
+    }
+
+    return failures;
+}
+
+/*============================================================================*/
+/*  CheckValue                                                                */
+/*!
+    Check a value formatted by VARFMT_Value
+
+    @param[in]
+        type
+            type of the value
+
+    @param[in]
+        pVal
+            pointer to the value
+
+    @param[in]
+        expected
+            expected text
+
+    @retval 0 - the value was formatted correctly
+    @retval 1 - the value was formatted incorrectly
+
+==============================================================================*/
+static size_t CheckValue( VarType type, VarData *pVal, const char *expected )
+{
+    char buf[VARFMT_MAX_LEN + 1];
+    size_t n;
+
+    n = VARFMT_Value( buf, type, pVal );
+    buf[n] = '\0';
+
+    if ( strcmp( buf, expected ) != 0 )
+    {
+        printf( "type %d: expected %s, got %s\n", (int)type, expected, buf );
+    }
+
+    return ( strcmp( buf, expected ) != 0 ) ? 1 : 0;
+}
+
+/*============================================================================*/
+/*  CheckUnsigned                                                             */
+/*!
+    Check an unsigned integer against snprintf()
+
+    @param[in]
+        val
+            value to check
+
+    @retval 0 - the value was formatted correctly
+    @retval 1 - the value was formatted incorrectly
+
+==============================================================================*/
+static size_t CheckUnsigned( uint64_t val )
+{
+    char expected[VARFMT_MAX_LEN + 1];
+    VarData data;
+
+    snprintf( expected, sizeof expected, "%" PRIu64, val );
+    data.ull = val;
+
+    return CheckValue( VARTYPE_UINT64, &data, expected );
+}
+
+/*============================================================================*/
+/*  CheckSigned                                                               */
+/*!
+    Check a signed integer against snprintf()
+
+    @param[in]
+        val
+            value to check
+
+    @retval 0 - the value was formatted correctly
+    @retval 1 - the value was formatted incorrectly
+
+==============================================================================*/
+static size_t CheckSigned( int64_t val )
+{
+    char expected[VARFMT_MAX_LEN + 1];
+    VarData data;
+
+    snprintf( expected, sizeof expected, "%" PRId64, val );
+    data.ll = val;
+
+    return CheckValue( VARTYPE_INT64, &data, expected );
+}
+
+/*============================================================================*/
+/*  CheckFloat                                                                */
+/*!
+    Check a float against snprintf() with "%f"
+
+    @param[in]
+        val
+            value to check
+
+    @retval 0 - the value was formatted correctly
+    @retval 1 - the value was formatted incorrectly
+
+==============================================================================*/
+static size_t CheckFloat( float val )
+{
+    char expected[VARFMT_MAX_LEN + 1];
+    VarData data;
+
+    snprintf( expected, sizeof expected, "%f", (double)val );
+    data.f = val;
+
+    return CheckValue( VARTYPE_FLOAT, &data, expected );
+}
+
+/*============================================================================*/
+/*  NextRandom                                                                */
+/*!
+    Get the next number of a xorshift pseudo-random sequence
+
+    @param[in,out]
+        pSeed
+            pointer to the sequence state, which must not be zero
+
+    @retval the next pseudo-random number
+
+==============================================================================*/
+static uint32_t NextRandom( uint32_t *pSeed )
+{
+    uint32_t x = *pSeed;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *pSeed = x;
+
+    return x;
+}
+
+/*! @}
+ * end of varfmttest group */